@@ -0,0 +1,114 @@
+// atomic_shared_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Readers load a published instance while a single writer keeps
+// replacing it. atomic_shared_instance is compared to a std::shared_ptr
+// guarded by a mutex and to std::atomic_load/std::atomic_store, for 1
+// up to one less than the hardware threads of readers.
+
+#include "bench.hpp"
+
+#include "rebox/atomic_shared_instance.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace rebox;
+
+namespace
+{
+    class Table
+    {
+    public:
+        int entries[16]{};
+    };
+
+    // runs store on a writer thread while the readers run load
+    template<typename Load, typename Store>
+    void contended(bench::suite& suite, std::string const& name, std::size_t readers,
+                   std::size_t iterations, Load load, Store store)
+    {
+        std::atomic<bool> stop{false};
+
+        std::thread writer{[&]
+        {
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                store();
+            }
+        }};
+
+        suite.run_parallel(name + "/" + std::to_string(readers), readers, iterations, [&](std::size_t)
+        {
+            load();
+        });
+
+        stop = true;
+        writer.join();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+
+    std::size_t maxReaders{std::max(1u, std::thread::hardware_concurrency() - 1)};
+
+    bench::suite suite{"atomic_shared_instance"};
+
+    atomic_shared_instance<Table> holder{make_shared_instance<Table>()};
+
+    std::mutex mutex;
+    std::shared_ptr<Table> guarded{std::make_shared<Table>()};
+
+    std::shared_ptr<Table> published{std::make_shared<Table>()};
+
+    for (std::size_t readers = 1; readers <= maxReaders; readers *= 2)
+    {
+        contended(suite, "load/atomic_shared_instance", readers, iterations, [&]
+        {
+            auto table = holder.load();
+            bench::do_not_optimize(table.get().entries[0]);
+        },
+        [&]
+        {
+            holder.store(make_shared_instance<Table>());
+        });
+
+        contended(suite, "load/mutex_shared_ptr", readers, iterations, [&]
+        {
+            std::shared_ptr<Table> table;
+            {
+                std::lock_guard<std::mutex> lock{mutex};
+                table = guarded;
+            }
+            bench::do_not_optimize(table->entries[0]);
+        },
+        [&]
+        {
+            auto table = std::make_shared<Table>();
+            std::lock_guard<std::mutex> lock{mutex};
+            guarded.swap(table);
+        });
+
+        contended(suite, "load/atomic_load_shared_ptr", readers, iterations, [&]
+        {
+            auto table = std::atomic_load(&published);
+            bench::do_not_optimize(table->entries[0]);
+        },
+        [&]
+        {
+            std::atomic_store(&published, std::make_shared<Table>());
+        });
+    }
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,117 @@
+// batch_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Fanning one instance out to 256 workers and dropping a vector of
+// 1024 copies of four owners again. Copying and clearing one by one is
+// compared to acquire_n and release_batch, which modify the count of
+// counted policies once per owner. std::shared_ptr has no such path and
+// is listed for reference.
+
+#include "bench.hpp"
+
+#include "rebox/batch.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Batch
+    {
+    public:
+        int values[16]{};
+    };
+
+    template<typename Threading>
+    void fan_out(bench::suite& suite, std::string const& policy)
+    {
+        constexpr std::size_t iterations{20000};
+        constexpr std::size_t workers{256};
+
+        using instance = shared_instance<Batch, throw_invalid_argument, Threading>;
+
+        auto batch = make_shared_instance<Batch, throw_invalid_argument, Threading>();
+        std::vector<instance> copies;
+        copies.reserve(workers);
+
+        suite.run("fan_out/copy/" + policy, iterations, [&]
+        {
+            for (std::size_t i = 0; i < workers; ++i)
+            {
+                copies.push_back(batch);
+            }
+
+            bench::do_not_optimize(copies.back());
+            copies.clear();
+        });
+
+        suite.run("fan_out/batch/" + policy, iterations, [&]
+        {
+            acquire_n(batch, workers, std::back_inserter(copies));
+            bench::do_not_optimize(copies.back());
+            release_batch(copies);
+        });
+    }
+
+    template<typename Threading>
+    void fan_in(bench::suite& suite, std::string const& policy)
+    {
+        constexpr std::size_t iterations{5000};
+        constexpr std::size_t copies{1024};
+
+        using instance = shared_instance<Batch, throw_invalid_argument, Threading>;
+
+        std::vector<instance> owners;
+        for (int i = 0; i < 4; ++i)
+        {
+            owners.push_back(make_shared_instance<Batch, throw_invalid_argument, Threading>());
+        }
+
+        std::vector<instance> held;
+        held.reserve(copies);
+
+        // refilling is part of both measurements; it takes the copies
+        // of each owner at once, so the count traffic left is the release
+        auto refill = [&]
+        {
+            for (auto const& owner : owners)
+            {
+                acquire_n(owner, copies / owners.size(), std::back_inserter(held));
+            }
+        };
+
+        suite.run("fan_in/clear/" + policy, iterations, [&]
+        {
+            refill();
+            held.clear();
+        });
+
+        suite.run("fan_in/release_batch/" + policy, iterations, [&]
+        {
+            refill();
+            release_batch(held);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::suite suite{"batch"};
+
+    fan_out<multi_threaded>(suite, "multi_threaded");
+    fan_out<atomic_counted>(suite, "atomic_counted");
+    fan_out<single_threaded>(suite, "single_threaded");
+
+    fan_in<multi_threaded>(suite, "multi_threaded");
+    fan_in<atomic_counted>(suite, "atomic_counted");
+    fan_in<single_threaded>(suite, "single_threaded");
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,205 @@
+// bench.hpp -- a minimal timing harness for the benchmarks
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_BENCH_HPP
+#define REBOX_BENCH_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// keeps functions under test from being inlined into the benchmark
+#if defined(__GNUC__)
+#  define REBOX_BENCH_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#  define REBOX_BENCH_NOINLINE __declspec(noinline)
+#else
+#  define REBOX_BENCH_NOINLINE
+#endif
+
+namespace rebox
+{
+    namespace bench
+    {
+        // keeps the compiler from optimizing away the computation of value
+        template<typename T>
+        inline void do_not_optimize(T const& value)
+        {
+#if defined(__GNUC__)
+            asm volatile("" : : "r,m"(value) : "memory");
+#else
+            static_cast<void>(*reinterpret_cast<char const volatile*>(&value));
+#endif
+        }
+
+        enum class format
+        {
+            csv,
+            json
+        };
+
+        // selects the output format from the command line: --csv (default) or --json
+        inline format output_format(int argc, char** argv)
+        {
+            for (int i = 1; i < argc; ++i)
+            {
+                if (std::string(argv[i]) == "--json")
+                {
+                    return format::json;
+                }
+            }
+
+            return format::csv;
+        }
+
+        class result
+        {
+        public:
+            std::string suite;
+            std::string name;
+            std::size_t iterations;
+            double nsPerOp;
+        };
+
+        class suite
+        {
+        public:
+            explicit suite(std::string name, std::size_t repetitions = 5)
+                : m_name(std::move(name)),
+                  m_repetitions(repetitions)
+            {
+                // some standard libraries skip atomic reference counting
+                // until a second thread has been started
+                std::thread([]{}).join();
+            }
+
+            // calls function iterations times per repetition and records
+            // the fastest repetition
+            template<typename Function>
+            void run(std::string const& name, std::size_t iterations, Function function)
+            {
+                using clock = std::chrono::steady_clock;
+
+                double best{std::numeric_limits<double>::max()};
+
+                for (std::size_t repetition = 0; repetition < m_repetitions; ++repetition)
+                {
+                    auto start = clock::now();
+
+                    for (std::size_t i = 0; i < iterations; ++i)
+                    {
+                        function();
+                    }
+
+                    std::chrono::duration<double, std::nano> elapsed{clock::now() - start};
+                    best = std::min(best, elapsed.count());
+                }
+
+                m_results.push_back(result{m_name, name, iterations, best / iterations});
+            }
+
+            // calls function(thread) iterations times on each of threads
+            // threads started together and records the fastest
+            // repetition, per call of a single thread
+            template<typename Function>
+            void run_parallel(std::string const& name, std::size_t threads, std::size_t iterations, Function function)
+            {
+                using clock = std::chrono::steady_clock;
+
+                double best{std::numeric_limits<double>::max()};
+
+                for (std::size_t repetition = 0; repetition < m_repetitions; ++repetition)
+                {
+                    std::atomic<std::size_t> ready{0};
+                    std::vector<std::thread> workers;
+
+                    for (std::size_t thread = 0; thread < threads; ++thread)
+                    {
+                        workers.emplace_back([&, thread]
+                        {
+                            ++ready;
+                            while (ready.load() != threads + 1)
+                            {
+                                std::this_thread::yield();
+                            }
+
+                            for (std::size_t i = 0; i < iterations; ++i)
+                            {
+                                function(thread);
+                            }
+                        });
+                    }
+
+                    while (ready.load() != threads)
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    auto start = clock::now();
+                    ++ready;
+
+                    for (auto& worker : workers)
+                    {
+                        worker.join();
+                    }
+
+                    std::chrono::duration<double, std::nano> elapsed{clock::now() - start};
+                    best = std::min(best, elapsed.count());
+                }
+
+                m_results.push_back(result{m_name, name, iterations, best / iterations});
+            }
+
+            std::vector<result> const& results() const
+            {
+                return m_results;
+            }
+
+            void report(std::ostream& out, format fmt = format::csv) const
+            {
+                if (fmt == format::json)
+                {
+                    out << "{\"suite\": \"" << m_name << "\", \"results\": [";
+
+                    for (std::size_t i = 0; i < m_results.size(); ++i)
+                    {
+                        auto const& r = m_results[i];
+
+                        out << (i ? "," : "") << "\n  {\"benchmark\": \"" << r.name
+                            << "\", \"iterations\": " << r.iterations
+                            << ", \"ns_per_op\": " << r.nsPerOp << "}";
+                    }
+
+                    out << "\n]}\n";
+                }
+                else
+                {
+                    out << "suite,benchmark,iterations,ns_per_op\n";
+
+                    for (auto const& r : m_results)
+                    {
+                        out << r.suite << ',' << r.name << ',' << r.iterations << ',' << r.nsPerOp << '\n';
+                    }
+                }
+            }
+
+        private:
+            std::string m_name;
+            std::size_t m_repetitions;
+            std::vector<result> m_results;
+        };
+    }
+}
+
+#endif
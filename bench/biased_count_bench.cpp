@@ -0,0 +1,72 @@
+// biased_count_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Copies of an object on the thread which created it, where the biased
+// count does not need atomic operations, and on other threads, where it
+// pays for its bookkeeping on top of them.
+
+#include "bench.hpp"
+
+#include "rebox/biased_count.hpp"
+
+#include <iostream>
+
+using namespace rebox;
+
+namespace
+{
+    template<typename T>
+    using biased_instance = shared_instance<T, throw_invalid_argument, owner_biased>;
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{10000000};
+
+    bench::suite suite{"biased_count"};
+
+    shared_instance<int> shared{make_shared_instance<int>(42)};
+    biased_instance<int> biased{make_shared_instance<int, throw_invalid_argument, owner_biased>(42)};
+
+    suite.run("copy_on_owner/shared_instance", iterations, [&]
+    {
+        shared_instance<int> copy{shared};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("copy_on_owner/owner_biased", iterations, [&]
+    {
+        biased_instance<int> copy{biased};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run_parallel("copy_on_other/shared_instance", 1, iterations, [&](std::size_t)
+    {
+        shared_instance<int> copy{shared};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run_parallel("copy_on_other/owner_biased", 1, iterations, [&](std::size_t)
+    {
+        biased_instance<int> copy{biased};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("make/shared_instance", iterations / 10, []
+    {
+        auto obj = make_shared_instance<int>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make/owner_biased", iterations / 10, []
+    {
+        auto obj = make_shared_instance<int, throw_invalid_argument, owner_biased>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
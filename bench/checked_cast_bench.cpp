@@ -0,0 +1,150 @@
+// checked_cast_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// A message dispatcher downcasting each message by trying the message
+// types one after the other, with dynamic_pointer_cast and with
+// try_pointer_cast on messages made by make_shared_instance. The last
+// run dispatches messages created by new, for which try_pointer_cast
+// falls back to dynamic_cast.
+
+#include "bench.hpp"
+
+#include "rebox/checked_cast.hpp"
+
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Message : public type_tagged<Message>
+    {
+    public:
+        virtual ~Message() = default;
+
+        int value{1};
+    };
+
+    class Login final : public Message
+    {
+    };
+
+    class Quote final : public Message
+    {
+    };
+
+    class Trade final : public Message
+    {
+    };
+
+    class Logout final : public Message
+    {
+    };
+
+    using Messages = std::vector<shared_instance<Message>>;
+
+    template<typename Cast>
+    REBOX_BENCH_NOINLINE int dispatch(Messages const& messages, Cast cast)
+    {
+        int sum{0};
+
+        for (auto const& message : messages)
+        {
+            if (auto login = cast(message, static_cast<Login*>(nullptr)))
+            {
+                sum += login->value;
+            }
+            else if (auto quote = cast(message, static_cast<Quote*>(nullptr)))
+            {
+                sum += quote->value * 2;
+            }
+            else if (auto trade = cast(message, static_cast<Trade*>(nullptr)))
+            {
+                sum += trade->value * 3;
+            }
+            else if (auto logout = cast(message, static_cast<Logout*>(nullptr)))
+            {
+                sum += logout->value * 4;
+            }
+        }
+
+        return sum;
+    }
+
+    template<typename Make>
+    Messages messages(Make make)
+    {
+        Messages result;
+
+        for (int i = 0; i != 1024; ++i)
+        {
+            switch (i % 4)
+            {
+            case 0:
+                result.push_back(make(static_cast<Login*>(nullptr)));
+                break;
+            case 1:
+                result.push_back(make(static_cast<Quote*>(nullptr)));
+                break;
+            case 2:
+                result.push_back(make(static_cast<Trade*>(nullptr)));
+                break;
+            default:
+                result.push_back(make(static_cast<Logout*>(nullptr)));
+                break;
+            }
+        }
+
+        return result;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000};
+
+    bench::suite suite{"checked_cast"};
+
+    auto made = messages([](auto type)
+    {
+        return shared_instance<Message>{make_shared_instance<typename std::remove_pointer<decltype(type)>::type>()};
+    });
+
+    auto created = messages([](auto type)
+    {
+        return shared_instance<Message>{new typename std::remove_pointer<decltype(type)>::type()};
+    });
+
+    auto dynamicCast = [](shared_instance<Message> const& message, auto type)
+    {
+        return dynamic_pointer_cast<typename std::remove_pointer<decltype(type)>::type>(message);
+    };
+
+    auto tryCast = [](shared_instance<Message> const& message, auto type)
+    {
+        return try_pointer_cast<typename std::remove_pointer<decltype(type)>::type>(message);
+    };
+
+    suite.run("dispatch 1024/dynamic_pointer_cast", iterations, [&]
+    {
+        bench::do_not_optimize(dispatch(made, dynamicCast));
+    });
+
+    suite.run("dispatch 1024/try_pointer_cast", iterations, [&]
+    {
+        bench::do_not_optimize(dispatch(made, tryCast));
+    });
+
+    suite.run("dispatch 1024/try_pointer_cast untagged", iterations, [&]
+    {
+        bench::do_not_optimize(dispatch(created, tryCast));
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
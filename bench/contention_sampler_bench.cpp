@@ -0,0 +1,80 @@
+// contention_sampler_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// The cost of sampling: copying and dropping a shared_instance with
+// sampling switched off, at the default period and on every operation.
+// The parallel runs copy either one object shared by all threads or an
+// object per thread; the report of the sampler, written to stderr,
+// shows the difference per call site. Note that small objects made one
+// after the other may well share a cache line, and with it contention.
+
+#define REBOX_CONTENTION_SAMPLING 1
+
+#include "bench.hpp"
+
+#include "rebox/shared_instance.hpp"
+
+#include <iostream>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Node
+    {
+    public:
+        int value{0};
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+    constexpr std::size_t threads{4};
+
+    bench::suite suite{"contention_sampler"};
+    contention_sampler& sampler{contention_sampler::instance()};
+
+    auto shared = make_shared_instance<Node>();
+
+    std::vector<shared_instance<Node>> own;
+    for (std::size_t thread = 0; thread < threads; ++thread)
+    {
+        own.push_back(make_shared_instance<Node>());
+    }
+
+    for (std::size_t period : {0, 64, 1})
+    {
+        sampler.period(period);
+        std::string suffix{"/period " + std::to_string(period)};
+
+        suite.run("copy" + suffix, iterations, [&]
+        {
+            shared_instance<Node> copy{shared};
+            bench::do_not_optimize(copy);
+        });
+    }
+
+    sampler.reset();
+    sampler.period(64);
+
+    suite.run_parallel("copy/shared object", threads, iterations, [&](std::size_t)
+    {
+        shared_instance<Node> copy{shared};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run_parallel("copy/object per thread", threads, iterations, [&](std::size_t thread)
+    {
+        shared_instance<Node> copy{own[thread]};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+    sampler.report(std::cerr);
+}
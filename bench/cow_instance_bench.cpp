@@ -0,0 +1,148 @@
+// cow_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Requests working on a document of 1000 lines: each request takes its
+// own copy of the document, reads a few lines and, for a given share of
+// the requests, edits one and publishes its copy as the new document.
+// The copy is either a deep one made up front, or a cow_instance which
+// copies the document on the first edit only. The parallel runs only
+// read, from threads sharing the document.
+
+#include "bench.hpp"
+
+#include "rebox/cow_instance.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    using Document = std::vector<std::string>;
+
+    constexpr std::size_t lines{1000};
+    constexpr std::size_t reads{4};
+
+    Document make_document()
+    {
+        Document doc;
+
+        for (std::size_t line = 0; line < lines; ++line)
+        {
+            doc.push_back("line " + std::to_string(line) + " of a rather long document");
+        }
+
+        return doc;
+    }
+
+    std::size_t read(Document const& doc, std::size_t request)
+    {
+        std::size_t size{0};
+
+        for (std::size_t i = 0; i < reads; ++i)
+        {
+            size += doc[(request * 7 + i * 131) % lines].size();
+        }
+
+        return size;
+    }
+
+    void edit(Document& doc, std::size_t request)
+    {
+        doc[request % lines].back() = static_cast<char>('a' + request % 26);
+    }
+
+    // whether the request edits, for percent of the requests
+    bool edits(std::size_t request, std::size_t percent)
+    {
+        return request % 100 < percent;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{20000};
+    constexpr std::size_t threads{4};
+
+    bench::suite suite{"cow_instance"};
+
+    for (std::size_t percent : {0, 1, 10, 50, 100})
+    {
+        std::string mix{std::to_string(percent) + "% edits/"};
+
+        Document eager{make_document()};
+        std::size_t eagerRequest{0};
+
+        suite.run(mix + "eager copy", iterations, [&]
+        {
+            std::size_t request{eagerRequest++};
+            Document copy{eager};
+            bench::do_not_optimize(read(copy, request));
+
+            if (edits(request, percent))
+            {
+                edit(copy, request);
+                eager = std::move(copy);
+            }
+        });
+
+        cow_instance<Document> cow{make_document()};
+        std::size_t cowRequest{0};
+
+        suite.run(mix + "cow_instance", iterations, [&]
+        {
+            std::size_t request{cowRequest++};
+            cow_instance<Document> copy{cow};
+            bench::do_not_optimize(read(copy, request));
+
+            if (edits(request, percent))
+            {
+                edit(copy.mutate(), request);
+                cow = std::move(copy);
+            }
+        });
+    }
+
+    // edits of a document nobody else holds
+    Document plain{make_document()};
+    std::size_t plainRequest{0};
+
+    suite.run("in place/Document", iterations, [&]
+    {
+        edit(plain, plainRequest++);
+        bench::do_not_optimize(plain);
+    });
+
+    cow_instance<Document> owned{make_document()};
+    std::size_t ownedRequest{0};
+
+    suite.run("in place/cow_instance", iterations, [&]
+    {
+        edit(owned.mutate(), ownedRequest++);
+        bench::do_not_optimize(owned);
+    });
+
+    Document const shared{make_document()};
+
+    suite.run_parallel("parallel reads/eager copy", threads, iterations / threads, [&](std::size_t thread)
+    {
+        Document copy{shared};
+        bench::do_not_optimize(read(copy, thread));
+    });
+
+    cow_instance<Document> const sharedCow{make_document()};
+
+    suite.run_parallel("parallel reads/cow_instance", threads, iterations / threads, [&](std::size_t thread)
+    {
+        cow_instance<Document> copy{sharedCow};
+        bench::do_not_optimize(read(copy, thread));
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
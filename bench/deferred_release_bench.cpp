@@ -0,0 +1,86 @@
+// deferred_release_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Dropping the last reference to a large document, as a request thread
+// would. Each operation hands out a prebuilt document and releases it;
+// with deferred_delete the teardown runs on the reclamation thread
+// unless its queue is full. The split into deferred and inline
+// releases is printed to stderr.
+
+#include "bench.hpp"
+
+#include "rebox/deferred_release.hpp"
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Document
+    {
+    public:
+        explicit Document(std::size_t paragraphs)
+            : paragraphs(paragraphs, std::string(64, 'x'))
+        {
+        }
+
+        std::vector<std::string> paragraphs;
+    };
+
+    // releases prebuilt documents, so building them stays untimed
+    // as far as possible
+    template<typename Make>
+    void release(bench::suite& suite, std::string const& name, std::size_t iterations, Make make)
+    {
+        std::vector<shared_instance<Document>> documents;
+        documents.reserve(iterations * 5);
+
+        for (std::size_t i = 0; i < iterations * 5; ++i)
+        {
+            documents.push_back(make());
+        }
+
+        suite.run(name, iterations, [&]
+        {
+            documents.pop_back();
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{2000};
+
+    bench::suite suite{"deferred_release"};
+
+    for (std::size_t paragraphs : {16, 256, 4096})
+    {
+        std::string suffix{"/" + std::to_string(paragraphs)};
+
+        release(suite, "release/inline" + suffix, iterations, [&]
+        {
+            return make_shared_instance<Document>(paragraphs);
+        });
+
+        reclaimer target;
+
+        release(suite, "release/deferred" + suffix, iterations, [&]
+        {
+            return make_deferred_shared_instance<Document>(target, paragraphs);
+        });
+
+        auto statistics = target.statistics();
+        std::cerr << "deferred" << suffix << ": " << statistics.deferred << " queued, "
+                  << statistics.inlined << " inline\n";
+    }
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
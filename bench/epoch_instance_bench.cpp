@@ -0,0 +1,70 @@
+// epoch_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Read-side scalability: 1 up to the hardware threads of readers access
+// a single hot configuration object. Copying a shared_instance or loading
+// it from an atomic_shared_instance modifies the shared reference count,
+// reading through an epoch_guard only announces the epoch of the reader.
+
+#include "bench.hpp"
+
+#include "rebox/atomic_shared_instance.hpp"
+#include "rebox/epoch_instance.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace rebox;
+
+namespace
+{
+    class Config
+    {
+    public:
+        int values[16]{};
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+
+    std::size_t maxReaders{std::max(1u, std::thread::hardware_concurrency())};
+
+    bench::suite suite{"epoch_instance"};
+
+    auto config = make_shared_instance<Config>();
+    atomic_shared_instance<Config> atomicConfig{config};
+    epoch_instance<Config> epochConfig{config};
+
+    for (std::size_t readers = 1; readers <= maxReaders; readers *= 2)
+    {
+        std::string suffix{"/" + std::to_string(readers)};
+
+        suite.run_parallel("read/shared_instance_copy" + suffix, readers, iterations, [&](std::size_t)
+        {
+            shared_instance<Config> copy{config};
+            bench::do_not_optimize(copy.get().values[0]);
+        });
+
+        suite.run_parallel("read/atomic_shared_instance" + suffix, readers, iterations, [&](std::size_t)
+        {
+            auto copy = atomicConfig.load();
+            bench::do_not_optimize(copy.get().values[0]);
+        });
+
+        suite.run_parallel("read/epoch_instance" + suffix, readers, iterations, [&](std::size_t)
+        {
+            epoch_guard guard;
+            bench::do_not_optimize(epochConfig.get(guard).values[0]);
+        });
+    }
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,139 @@
+// instance_cache_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Interning lookups hitting 64 live schemas from 1 up to the hardware
+// threads, and filling an empty table with 4096 schemas. The usual
+// interning table, a std::map of weak pointers behind one mutex, is
+// compared to instance_cache, whose hits take no lock.
+
+#include "bench.hpp"
+
+#include "rebox/instance_cache.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Schema
+    {
+    public:
+        explicit Schema(int key)
+            : key(key)
+        {
+        }
+
+        int key;
+    };
+
+    // the hand-written interning table
+    class locked_map
+    {
+    public:
+        shared_instance<Schema> get(int key)
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+
+            auto& entry = m_entries[key];
+            if (auto obj = entry.lock())
+            {
+                return shared_instance<Schema>{std::move(obj)};
+            }
+
+            shared_instance<Schema> created{new Schema(key)};
+            entry = created.ptr();
+            return created;
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::map<int, std::weak_ptr<Schema>> m_entries;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{200000};
+    constexpr int keys{64};
+    constexpr int fillKeys{4096};
+
+    std::size_t maxThreads{std::max(1u, std::thread::hardware_concurrency())};
+
+    bench::suite suite{"instance_cache"};
+
+    locked_map locked;
+    instance_cache<int, Schema> cache;
+    std::vector<shared_instance<Schema>> pinned;
+
+    for (int key = 0; key < keys; ++key)
+    {
+        pinned.push_back(locked.get(key));
+        pinned.push_back(cache.get(key));
+    }
+
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        std::string suffix{"/" + std::to_string(threads)};
+
+        suite.run_parallel("hit/locked_map" + suffix, threads, iterations, [&](std::size_t thread)
+        {
+            static thread_local int next{0};
+            auto schema = locked.get((next++ + static_cast<int>(thread)) % keys);
+            bench::do_not_optimize(schema.get().key);
+        });
+
+        suite.run_parallel("hit/instance_cache" + suffix, threads, iterations, [&](std::size_t thread)
+        {
+            static thread_local int next{0};
+            auto schema = cache.get((next++ + static_cast<int>(thread)) % keys);
+            bench::do_not_optimize(schema.get().key);
+        });
+    }
+
+    // every run fills a new table, keeping its schemas alive
+    suite.run("fill/locked_map", 20, [&]
+    {
+        locked_map filled;
+        std::vector<shared_instance<Schema>> held;
+        held.reserve(fillKeys);
+
+        for (int key = 0; key < fillKeys; ++key)
+        {
+            held.push_back(filled.get(key));
+        }
+
+        bench::do_not_optimize(held.back().get().key);
+    });
+
+    suite.run("fill/instance_cache", 20, [&]
+    {
+        instance_cache<int, Schema> filled;
+        std::vector<shared_instance<Schema>> held;
+        held.reserve(fillKeys);
+
+        for (int key = 0; key < fillKeys; ++key)
+        {
+            held.push_back(filled.get(key));
+        }
+
+        bench::do_not_optimize(held.back().get().key);
+    });
+
+    auto statistics = cache.statistics();
+    std::cerr << "instance_cache: " << statistics.hits << " hits, " << statistics.misses << " misses, "
+              << statistics.evictions << " evictions\n";
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
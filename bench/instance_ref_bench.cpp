@@ -0,0 +1,72 @@
+// instance_ref_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// An object passed down a chain of calls, each level taking either a
+// shared_instance or an instance_ref by value. Measures the unchecked
+// instance_ref, the default.
+
+#include "bench.hpp"
+
+#include "rebox/instance_ref.hpp"
+
+#include <iostream>
+
+using namespace rebox;
+
+namespace
+{
+    class Request
+    {
+    public:
+        int value{42};
+    };
+
+    template<int Level>
+    REBOX_BENCH_NOINLINE int by_instance(shared_instance<Request> request)
+    {
+        return by_instance<Level - 1>(request) + 1;
+    }
+
+    template<>
+    REBOX_BENCH_NOINLINE int by_instance<0>(shared_instance<Request> request)
+    {
+        return request.get().value;
+    }
+
+    template<int Level>
+    REBOX_BENCH_NOINLINE int by_ref(instance_ref<Request> request)
+    {
+        return by_ref<Level - 1>(request) + 1;
+    }
+
+    template<>
+    REBOX_BENCH_NOINLINE int by_ref<0>(instance_ref<Request> request)
+    {
+        return request.get().value;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{10000000};
+
+    bench::suite suite{"instance_ref"};
+
+    auto request = make_shared_instance<Request>();
+
+    suite.run("call_chain_4/shared_instance", iterations, [&]
+    {
+        bench::do_not_optimize(by_instance<4>(request));
+    });
+
+    suite.run("call_chain_4/instance_ref", iterations, [&]
+    {
+        bench::do_not_optimize(by_ref<4>(request));
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,91 @@
+// instance_set_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Membership tests against a set of 4096 instances. A std::unordered_set
+// of std::shared_ptr is looked up through ptr(), copying the pointer;
+// a std::unordered_set of shared_instance and an instance_set look up
+// the instance itself without touching the count. Keyed by owner, the
+// instance_set holds local_shared_instance's, as std::shared_ptr keeps
+// its owner private.
+
+#include "bench.hpp"
+
+#include "rebox/instance_set.hpp"
+#include "rebox/local_shared_instance.hpp"
+
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Node
+    {
+    public:
+        int value{0};
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+    constexpr std::size_t elements{4096};
+
+    bench::suite suite{"instance_set"};
+
+    std::vector<shared_instance<Node>> nodes;
+    std::unordered_set<std::shared_ptr<Node>> pointers;
+    std::unordered_set<shared_instance<Node>> instances;
+    instance_set<shared_instance<Node>> flat;
+
+    // only the counted policies can be keyed by owner
+    std::vector<local_shared_instance<Node>> localNodes;
+    instance_set<local_shared_instance<Node>, owner_key> owners;
+
+    for (std::size_t i = 0; i < elements; ++i)
+    {
+        nodes.push_back(make_shared_instance<Node>());
+        pointers.insert(nodes.back().ptr());
+        instances.insert(nodes.back());
+        flat.insert(nodes.back());
+        localNodes.push_back(make_local_shared_instance<Node>());
+        owners.insert(localNodes.back());
+    }
+
+    std::size_t next{0};
+    auto probe = [&]() -> shared_instance<Node> const&
+    {
+        next = (next + 1) % elements;
+        return nodes[next];
+    };
+
+    suite.run("contains/unordered_set<shared_ptr>", iterations, [&]
+    {
+        bench::do_not_optimize(pointers.count(probe().ptr()));
+    });
+
+    suite.run("contains/unordered_set<shared_instance>", iterations, [&]
+    {
+        bench::do_not_optimize(instances.count(probe()));
+    });
+
+    suite.run("contains/instance_set", iterations, [&]
+    {
+        bench::do_not_optimize(flat.contains(probe()));
+    });
+
+    suite.run("contains/instance_set<owner_key>", iterations, [&]
+    {
+        next = (next + 1) % elements;
+        bench::do_not_optimize(owners.contains(localNodes[next]));
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,59 @@
+// intrusive_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+
+#include "rebox/intrusive_instance.hpp"
+
+#include <iostream>
+
+using namespace rebox;
+
+namespace
+{
+    class Message : public intrusive_counted<Message>
+    {
+    public:
+        int value{42};
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{10000000};
+
+    bench::suite suite{"intrusive_instance"};
+
+    shared_instance<Message> shared{make_shared_instance<Message>()};
+    intrusive_instance<Message> intrusive{make_intrusive_instance<Message>()};
+
+    suite.run("copy_shared_instance", iterations, [&]
+    {
+        shared_instance<Message> copy{shared};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("copy_intrusive_instance", iterations, [&]
+    {
+        intrusive_instance<Message> copy{intrusive};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("make_shared_instance", iterations / 10, []
+    {
+        auto obj = make_shared_instance<Message>();
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make_intrusive_instance", iterations / 10, []
+    {
+        auto obj = make_intrusive_instance<Message>();
+        bench::do_not_optimize(obj);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,57 @@
+// local_shared_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#include "bench.hpp"
+
+#include "rebox/local_shared_instance.hpp"
+
+#include <iostream>
+
+using namespace rebox;
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{10000000};
+
+    bench::suite suite{"local_shared_instance"};
+
+    std::shared_ptr<int> sharedPtr{std::make_shared<int>(42)};
+    shared_instance<int> shared{make_shared_instance<int>(42)};
+    local_shared_instance<int> local{make_local_shared_instance<int>(42)};
+
+    suite.run("copy_shared_ptr", iterations, [&]
+    {
+        std::shared_ptr<int> copy{sharedPtr};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("copy_shared_instance", iterations, [&]
+    {
+        shared_instance<int> copy{shared};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("copy_local_shared_instance", iterations, [&]
+    {
+        local_shared_instance<int> copy{local};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("make_shared_instance", iterations / 10, []
+    {
+        auto obj = make_shared_instance<int>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make_local_shared_instance", iterations / 10, []
+    {
+        auto obj = make_local_shared_instance<int>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
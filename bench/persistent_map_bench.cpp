@@ -0,0 +1,160 @@
+// persistent_map_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// State of 100000 entries of which every request takes a snapshot,
+// changing one entry or a batch of 100 before. The snapshot is either a
+// copy of a std::unordered_map or a persistent_map, changed entry by
+// entry or through a transient_map. Lookups and building the state
+// from scratch show what the trie costs otherwise.
+
+#include "bench.hpp"
+
+#include "rebox/persistent_map.hpp"
+
+#include <iostream>
+#include <unordered_map>
+
+using namespace rebox;
+
+namespace
+{
+    constexpr int entries{100000};
+    constexpr int batch{100};
+
+    // spreads the changes over the keys
+    int key_of(int request)
+    {
+        return static_cast<int>((static_cast<unsigned>(request) * 7919u) % entries);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::suite suite{"persistent_map"};
+
+    std::unordered_map<int, int> copied;
+    auto building = persistent_map<int, int>{}.transient();
+
+    for (int key = 0; key != entries; ++key)
+    {
+        copied[key] = key;
+        building.set(key, key);
+    }
+
+    persistent_map<int, int> shared{std::move(building).persistent()};
+
+    suite.run("snapshot/std::unordered_map", 10, [&]
+    {
+        std::unordered_map<int, int> snapshot{copied};
+        bench::do_not_optimize(snapshot);
+    });
+
+    suite.run("snapshot/persistent_map", 100000, [&]
+    {
+        persistent_map<int, int> snapshot{shared};
+        bench::do_not_optimize(snapshot);
+    });
+
+    int request{0};
+
+    suite.run("change one/std::unordered_map", 10, [&]
+    {
+        std::unordered_map<int, int> changed{copied};
+        ++request;
+        changed[key_of(request)] = request;
+        copied = std::move(changed);
+    });
+
+    suite.run("change one/persistent_map", 100000, [&]
+    {
+        ++request;
+        shared = shared.set(key_of(request), request);
+    });
+
+    suite.run("change batch/std::unordered_map", 10, [&]
+    {
+        std::unordered_map<int, int> changed{copied};
+
+        for (int change = 0; change != batch; ++change)
+        {
+            ++request;
+            changed[key_of(request)] = request;
+        }
+
+        copied = std::move(changed);
+    });
+
+    suite.run("change batch/persistent_map", 1000, [&]
+    {
+        for (int change = 0; change != batch; ++change)
+        {
+            ++request;
+            shared = shared.set(key_of(request), request);
+        }
+    });
+
+    suite.run("change batch/transient_map", 1000, [&]
+    {
+        auto changed = shared.transient();
+
+        for (int change = 0; change != batch; ++change)
+        {
+            ++request;
+            changed.set(key_of(request), request);
+        }
+
+        shared = std::move(changed).persistent();
+    });
+
+    suite.run("lookup/std::unordered_map", 1000000, [&]
+    {
+        bench::do_not_optimize(copied.find(key_of(++request))->second);
+    });
+
+    suite.run("lookup/persistent_map", 1000000, [&]
+    {
+        bench::do_not_optimize(*shared.find(key_of(++request)));
+    });
+
+    suite.run("build/std::unordered_map", 10, [&]
+    {
+        std::unordered_map<int, int> built;
+
+        for (int key = 0; key != entries; ++key)
+        {
+            built[key] = key;
+        }
+
+        bench::do_not_optimize(built);
+    });
+
+    suite.run("build/persistent_map", 10, [&]
+    {
+        persistent_map<int, int> built;
+
+        for (int key = 0; key != entries; ++key)
+        {
+            built = built.set(key, key);
+        }
+
+        bench::do_not_optimize(built);
+    });
+
+    suite.run("build/transient_map", 10, [&]
+    {
+        auto built = persistent_map<int, int>{}.transient();
+
+        for (int key = 0; key != entries; ++key)
+        {
+            built.set(key, key);
+        }
+
+        bench::do_not_optimize(built);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
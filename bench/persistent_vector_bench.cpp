@@ -0,0 +1,184 @@
+// persistent_vector_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// State of 100000 elements of which every request takes a snapshot,
+// changing one element or a batch of 100 before. The snapshot is either
+// a copy of a std::vector or a persistent_vector, changed element by
+// element or through a transient_vector. Reads and building the state
+// from scratch show what the trie costs otherwise.
+
+#include "bench.hpp"
+
+#include "rebox/persistent_vector.hpp"
+
+#include <iostream>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    constexpr std::size_t elements{100000};
+    constexpr std::size_t batch{100};
+
+    // spreads the changes over the state
+    std::size_t position(std::size_t request)
+    {
+        return (request * 7919) % elements;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bench::suite suite{"persistent_vector"};
+
+    std::vector<std::size_t> copied(elements);
+    transient_vector<std::size_t> building;
+
+    for (std::size_t index = 0; index != elements; ++index)
+    {
+        copied[index] = index;
+        building.push_back(index);
+    }
+
+    persistent_vector<std::size_t> shared{std::move(building).persistent()};
+
+    suite.run("snapshot/std::vector", 100, [&]
+    {
+        std::vector<std::size_t> snapshot{copied};
+        bench::do_not_optimize(snapshot);
+    });
+
+    suite.run("snapshot/persistent_vector", 100000, [&]
+    {
+        persistent_vector<std::size_t> snapshot{shared};
+        bench::do_not_optimize(snapshot);
+    });
+
+    std::size_t request{0};
+
+    suite.run("change one/std::vector", 100, [&]
+    {
+        std::vector<std::size_t> changed{copied};
+        ++request;
+        changed[position(request)] = request;
+        copied = std::move(changed);
+    });
+
+    suite.run("change one/persistent_vector", 100000, [&]
+    {
+        ++request;
+        shared = shared.set(position(request), request);
+    });
+
+    suite.run("change batch/std::vector", 100, [&]
+    {
+        std::vector<std::size_t> changed{copied};
+
+        for (std::size_t change = 0; change != batch; ++change)
+        {
+            ++request;
+            changed[position(request)] = request;
+        }
+
+        copied = std::move(changed);
+    });
+
+    suite.run("change batch/persistent_vector", 1000, [&]
+    {
+        for (std::size_t change = 0; change != batch; ++change)
+        {
+            ++request;
+            shared = shared.set(position(request), request);
+        }
+    });
+
+    suite.run("change batch/transient_vector", 1000, [&]
+    {
+        auto changed = shared.transient();
+
+        for (std::size_t change = 0; change != batch; ++change)
+        {
+            ++request;
+            changed.set(position(request), request);
+        }
+
+        shared = std::move(changed).persistent();
+    });
+
+    suite.run("random reads/std::vector", 1000000, [&]
+    {
+        bench::do_not_optimize(copied[position(++request)]);
+    });
+
+    suite.run("random reads/persistent_vector", 1000000, [&]
+    {
+        bench::do_not_optimize(shared[position(++request)]);
+    });
+
+    suite.run("iterate/std::vector", 100, [&]
+    {
+        std::size_t sum{0};
+
+        for (auto element : copied)
+        {
+            sum += element;
+        }
+
+        bench::do_not_optimize(sum);
+    });
+
+    suite.run("iterate/persistent_vector", 100, [&]
+    {
+        std::size_t sum{0};
+
+        for (auto element : shared)
+        {
+            sum += element;
+        }
+
+        bench::do_not_optimize(sum);
+    });
+
+    suite.run("build/std::vector", 100, [&]
+    {
+        std::vector<std::size_t> built;
+
+        for (std::size_t index = 0; index != elements; ++index)
+        {
+            built.push_back(index);
+        }
+
+        bench::do_not_optimize(built);
+    });
+
+    suite.run("build/persistent_vector", 10, [&]
+    {
+        persistent_vector<std::size_t> built;
+
+        for (std::size_t index = 0; index != elements; ++index)
+        {
+            built = built.push_back(index);
+        }
+
+        bench::do_not_optimize(built);
+    });
+
+    suite.run("build/transient_vector", 100, [&]
+    {
+        transient_vector<std::size_t> built;
+
+        for (std::size_t index = 0; index != elements; ++index)
+        {
+            built.push_back(index);
+        }
+
+        bench::do_not_optimize(built);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,93 @@
+// pool_allocator_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Creation of short-lived instances through the global heap compared
+// to the per-thread pools of pool_allocator.
+
+#include "bench.hpp"
+
+#include "rebox/pool_allocator.hpp"
+#include "rebox/local_shared_instance.hpp"
+
+#include <iostream>
+#include <thread>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Message
+    {
+    public:
+        explicit Message(int id)
+            : id(id)
+        {
+        }
+
+        int id;
+        char payload[48];
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+    constexpr std::size_t batch{1000};
+
+    bench::suite suite{"pool_allocator"};
+
+    suite.run("make/shared_instance", iterations, []
+    {
+        auto obj = make_shared_instance<Message>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make/pooled_shared_instance", iterations, []
+    {
+        auto obj = pooled_make_shared_instance<Message>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make/local_shared_instance", iterations, []
+    {
+        auto obj = make_local_shared_instance<Message>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make/pooled_local_shared_instance", iterations, []
+    {
+        auto obj = pooled_make_shared_instance<Message, throw_invalid_argument, single_threaded>(42);
+        bench::do_not_optimize(obj);
+    });
+
+    // a batch is created on this thread and released on another one
+    std::vector<shared_instance<Message>> instances;
+    instances.reserve(batch);
+
+    suite.run("cross_thread_batch/shared_instance", iterations / batch, [&]
+    {
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            instances.push_back(make_shared_instance<Message>(42));
+        }
+
+        std::thread{[&] { instances.clear(); }}.join();
+    });
+
+    suite.run("cross_thread_batch/pooled_shared_instance", iterations / batch, [&]
+    {
+        for (std::size_t i = 0; i < batch; ++i)
+        {
+            instances.push_back(pooled_make_shared_instance<Message>(42));
+        }
+
+        std::thread{[&] { instances.clear(); }}.join();
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,71 @@
+// sharded_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// A global object, like a logger, copied into every task by all
+// threads at once. Each thread keeps one copy of its own, as a worker
+// would, and copies from it. sharded_instance is compared to
+// shared_instance for 1 up to the hardware threads.
+
+#include "bench.hpp"
+
+#include "rebox/sharded_instance.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Logger
+    {
+    public:
+        int level{0};
+    };
+
+    template<typename Instance>
+    void copy_into_tasks(bench::suite& suite, std::string const& name, std::size_t threads,
+                         std::size_t iterations, Instance const& global)
+    {
+        std::vector<std::unique_ptr<Instance>> resident(threads);
+
+        suite.run_parallel(name + "/" + std::to_string(threads), threads, iterations, [&](std::size_t thread)
+        {
+            if (!resident[thread])
+            {
+                resident[thread].reset(new Instance{global});
+            }
+
+            Instance task{*resident[thread]};
+            bench::do_not_optimize(task.get().level);
+        });
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+
+    std::size_t maxThreads{std::max(1u, std::thread::hardware_concurrency())};
+
+    bench::suite suite{"sharded_instance"};
+
+    auto shared = make_shared_instance<Logger>();
+    auto sharded = make_sharded_instance<Logger>();
+
+    for (std::size_t threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        copy_into_tasks(suite, "copy/shared_instance", threads, iterations, shared);
+        copy_into_tasks(suite, "copy/sharded_instance", threads, iterations, sharded);
+    }
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
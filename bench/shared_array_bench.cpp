@@ -0,0 +1,160 @@
+// shared_array_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Message buffers held as a std::vector inside a shared_instance against
+// shared_instance<char[]> and trailing objects, which allocate the
+// reference count and the bytes in one go. Creating a buffer, and
+// reading a byte of each of many buffers, which for the vector takes
+// another pointer to be followed. The allocations of each benchmark
+// are counted by replacing operator new and written to stderr.
+
+#include "bench.hpp"
+
+#include "rebox/shared_array.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::atomic<std::size_t> allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using namespace rebox;
+
+namespace
+{
+    class Header
+    {
+    public:
+        explicit Header(int id)
+            : id(id)
+        {
+        }
+
+        int id;
+    };
+
+    constexpr std::size_t bufferSize{256};
+    constexpr std::size_t bufferCount{4096};
+
+    template<typename Buffers, typename Read>
+    REBOX_BENCH_NOINLINE unsigned read_all(Buffers const& buffers, Read read)
+    {
+        unsigned sum{0};
+        std::size_t index{0};
+
+        for (auto const& buffer : buffers)
+        {
+            sum += static_cast<unsigned char>(read(buffer, index++ % bufferSize));
+        }
+
+        return sum;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+
+    bench::suite suite{"shared_array"};
+    std::vector<std::pair<std::string, double>> counts;
+
+    auto run = [&](std::string const& name, std::size_t times, auto function)
+    {
+        std::size_t before{allocations.load()};
+        function();
+        counts.emplace_back(name, static_cast<double>(allocations.load() - before));
+
+        suite.run(name, times, function);
+    };
+
+    run("create/shared_instance<vector>", iterations, []
+    {
+        bench::do_not_optimize(make_shared_instance<std::vector<char>>(bufferSize));
+    });
+
+    run("create/shared_instance<char[]>", iterations, []
+    {
+        bench::do_not_optimize(make_shared_instance<char[]>(bufferSize));
+    });
+
+    run("create/trailing instance", iterations, []
+    {
+        bench::do_not_optimize(make_trailing_instance<Header, char>(bufferSize, 1));
+    });
+
+    std::vector<shared_instance<std::vector<char>>> vectors;
+    std::vector<shared_instance<char[]>> arrays;
+    std::vector<shared_instance<trailing<Header, char>>> trailings;
+
+    for (std::size_t i = 0; i != bufferCount; ++i)
+    {
+        vectors.push_back(make_shared_instance<std::vector<char>>(bufferSize, char(i)));
+        arrays.push_back(make_shared_instance<char[]>(bufferSize, char(i)));
+        trailings.push_back(make_trailing_instance<Header, char>(bufferSize, int(i)));
+    }
+
+    constexpr std::size_t reads{iterations / bufferCount};
+
+    run("read 4096/shared_instance<vector>", reads, [&]
+    {
+        bench::do_not_optimize(read_all(vectors, [](shared_instance<std::vector<char>> const& buffer, std::size_t index)
+        {
+            return buffer.get()[index];
+        }));
+    });
+
+    run("read 4096/shared_instance<char[]>", reads, [&]
+    {
+        bench::do_not_optimize(read_all(arrays, [](shared_instance<char[]> const& buffer, std::size_t index)
+        {
+            return buffer[index];
+        }));
+    });
+
+    run("read 4096/trailing instance", reads, [&]
+    {
+        bench::do_not_optimize(read_all(trailings, [](shared_instance<trailing<Header, char>> const& buffer, std::size_t index)
+        {
+            return buffer.get()[index];
+        }));
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+
+    for (auto const& count : counts)
+    {
+        std::cerr << count.first << ": " << count.second << " allocations\n";
+    }
+}
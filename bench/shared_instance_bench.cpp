@@ -0,0 +1,252 @@
+// shared_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Each shared_instance operation is measured next to the equivalent
+// std::shared_ptr operation, so that the cost of the wrapper can be
+// read off as the difference between the two.
+
+#include "bench.hpp"
+
+#include "rebox/shared_instance.hpp"
+
+#include <iostream>
+
+using namespace rebox;
+
+namespace
+{
+    class Base
+    {
+    public:
+        virtual ~Base() = default;
+
+        int value{42};
+    };
+
+    class Derived : public Base
+    {
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{10000000};
+    constexpr std::size_t allocations{iterations / 10};
+
+    bench::suite suite{"shared_instance"};
+
+    std::shared_ptr<Derived> derivedPtr{std::make_shared<Derived>()};
+    std::shared_ptr<Base> basePtr{derivedPtr};
+    std::shared_ptr<Base const> constPtr{derivedPtr};
+
+    shared_instance<Derived> derived{derivedPtr};
+    shared_instance<Base> base{derivedPtr};
+    shared_instance<Base const> constInstance{derivedPtr};
+
+    // construction
+    suite.run("construct_raw_pointer/shared_ptr", allocations, []
+    {
+        std::shared_ptr<Base> obj{new Base()};
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("construct_raw_pointer/shared_instance", allocations, []
+    {
+        shared_instance<Base> obj{new Base()};
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make/shared_ptr", allocations, []
+    {
+        auto obj = std::make_shared<Base>();
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("make/shared_instance", allocations, []
+    {
+        auto obj = make_shared_instance<Base>();
+        bench::do_not_optimize(obj);
+    });
+
+    suite.run("construct_shared_ptr/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> obj{basePtr};
+        bench::do_not_optimize(obj);
+    });
+
+    // copies and moves
+    suite.run("copy/shared_ptr", iterations, [&]
+    {
+        std::shared_ptr<Base> copy{basePtr};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("copy/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> copy{base};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("converting_copy/shared_ptr", iterations, [&]
+    {
+        std::shared_ptr<Base> copy{derivedPtr};
+        bench::do_not_optimize(copy);
+    });
+
+    suite.run("converting_copy/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> copy{derived};
+        bench::do_not_optimize(copy);
+    });
+
+    // includes the copy providing the source of the move
+    suite.run("copy_and_converting_move/shared_ptr", iterations, [&]
+    {
+        std::shared_ptr<Derived> source{derivedPtr};
+        std::shared_ptr<Base> moved{std::move(source)};
+        bench::do_not_optimize(moved);
+    });
+
+    suite.run("copy_and_converting_move/shared_instance", iterations, [&]
+    {
+        shared_instance<Derived> source{derived};
+        shared_instance<Base> moved{std::move(source)};
+        bench::do_not_optimize(moved);
+    });
+
+    // assignments
+    suite.run("assign_copy/shared_ptr", iterations, [&]
+    {
+        std::shared_ptr<Base> target{basePtr};
+        target = basePtr;
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_copy/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> target{base};
+        target = base;
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_move/shared_ptr", iterations, [&]
+    {
+        std::shared_ptr<Base> target{basePtr};
+        std::shared_ptr<Base> source{basePtr};
+        target = std::move(source);
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_move/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> target{base};
+        shared_instance<Base> source{base};
+        target = std::move(source);
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_shared_ptr/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> target{base};
+        target = basePtr;
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_moved_shared_ptr/shared_instance", iterations, [&]
+    {
+        shared_instance<Base> target{base};
+        std::shared_ptr<Base> source{basePtr};
+        target = std::move(source);
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_unique_ptr/shared_ptr", allocations, [&]
+    {
+        std::shared_ptr<Base> target{basePtr};
+        target = std::unique_ptr<Base>{new Base()};
+        bench::do_not_optimize(target);
+    });
+
+    suite.run("assign_unique_ptr/shared_instance", allocations, [&]
+    {
+        shared_instance<Base> target{base};
+        target = std::unique_ptr<Base>{new Base()};
+        bench::do_not_optimize(target);
+    });
+
+    // swap
+    std::shared_ptr<Base> otherPtr{std::make_shared<Base>()};
+    shared_instance<Base> other{otherPtr};
+
+    suite.run("swap/shared_ptr", iterations, [&]
+    {
+        basePtr.swap(otherPtr);
+        bench::do_not_optimize(basePtr);
+    });
+
+    suite.run("swap/shared_instance", iterations, [&]
+    {
+        base.swap(other);
+        bench::do_not_optimize(base);
+    });
+
+    suite.run("swap_shared_ptr/shared_instance", iterations, [&]
+    {
+        base.swap(otherPtr);
+        bench::do_not_optimize(base);
+    });
+
+    // access
+    suite.run("ptr/shared_instance", iterations, [&]
+    {
+        auto ptr = base.ptr();
+        bench::do_not_optimize(ptr);
+    });
+
+    suite.run("get/shared_ptr", iterations, [&]
+    {
+        bench::do_not_optimize(basePtr->value);
+    });
+
+    suite.run("get/shared_instance", iterations, [&]
+    {
+        bench::do_not_optimize(base.get().value);
+    });
+
+    // casts
+    suite.run("static_pointer_cast/shared_ptr", iterations, [&]
+    {
+        auto cast = std::static_pointer_cast<Derived>(basePtr);
+        bench::do_not_optimize(cast);
+    });
+
+    suite.run("static_pointer_cast/shared_instance", iterations, [&]
+    {
+        auto cast = static_pointer_cast<Derived>(base);
+        bench::do_not_optimize(cast);
+    });
+
+    suite.run("const_pointer_cast/shared_ptr", iterations, [&]
+    {
+        auto cast = std::const_pointer_cast<Base>(constPtr);
+        bench::do_not_optimize(cast);
+    });
+
+    suite.run("const_pointer_cast/shared_instance", iterations, [&]
+    {
+        auto cast = const_pointer_cast<Base>(constInstance);
+        bench::do_not_optimize(cast);
+    });
+
+    suite.run("dynamic_pointer_cast/shared_ptr", iterations, [&]
+    {
+        auto cast = std::dynamic_pointer_cast<Derived>(basePtr);
+        bench::do_not_optimize(cast);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
@@ -0,0 +1,90 @@
+// shared_instance_vector_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Sums a member of every element of a std::vector<shared_instance<T>>
+// and of a shared_instance_vector<T> holding the same objects, for
+// sequences fitting into the caches and for larger ones.
+
+#include "bench.hpp"
+
+#include "rebox/shared_instance_vector.hpp"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace rebox;
+
+namespace
+{
+    class Node
+    {
+    public:
+        explicit Node(int value)
+            : value(value)
+        {
+        }
+
+        int value;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    bench::suite suite{"shared_instance_vector"};
+
+    for (std::size_t size : {std::size_t{1000}, std::size_t{1000000}})
+    {
+        std::vector<shared_instance<Node>> vector;
+        shared_instance_vector<Node> split;
+
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            vector.push_back(make_shared_instance<Node>(static_cast<int>(i)));
+            split.push_back(vector.back());
+        }
+
+        std::size_t iterations{100000000 / size};
+        std::string suffix{"/" + std::to_string(size)};
+
+        suite.run("iterate/vector" + suffix, iterations, [&]
+        {
+            int sum{0};
+            for (Node const& node : vector)
+            {
+                sum += node.value;
+            }
+            bench::do_not_optimize(sum);
+        });
+
+        suite.run("iterate/shared_instance_vector" + suffix, iterations, [&]
+        {
+            int sum{0};
+            for (Node const& node : split)
+            {
+                sum += node.value;
+            }
+            bench::do_not_optimize(sum);
+        });
+
+        suite.run("append/vector" + suffix, 10, [&]
+        {
+            std::vector<shared_instance<Node>> copy;
+            copy.insert(copy.end(), vector.begin(), vector.end());
+            bench::do_not_optimize(copy);
+        });
+
+        suite.run("append/shared_instance_vector" + suffix, 10, [&]
+        {
+            shared_instance_vector<Node> copy;
+            copy.append(vector.begin(), vector.end());
+            bench::do_not_optimize(copy);
+        });
+    }
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+}
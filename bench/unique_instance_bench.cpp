@@ -0,0 +1,152 @@
+// unique_instance_bench.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// What shared_instance costs where ownership is never shared: creating
+// and destroying an object, and handing it to a function which keeps
+// it, the shared_instance being copied as usual. The allocations of
+// each benchmark are counted by replacing operator new and written to
+// stderr; the shared_instance's also pay an atomic increment and
+// decrement per copy, and an atomic decrement when destroyed.
+
+#include "bench.hpp"
+
+#include "rebox/unique_instance.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+    std::atomic<std::size_t> allocations{0};
+}
+
+void* operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size ? size : 1))
+    {
+        return ptr;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+using namespace rebox;
+
+namespace
+{
+    class Node
+    {
+    public:
+        int value{0};
+    };
+
+    // keeps the last object handed to it
+    class Sink
+    {
+    public:
+        REBOX_BENCH_NOINLINE void keep(unique_instance<Node> node)
+        {
+            m_unique.clear();
+            m_unique.push_back(std::move(node));
+        }
+
+        REBOX_BENCH_NOINLINE void keep(shared_instance<Node> node)
+        {
+            m_shared.clear();
+            m_shared.push_back(std::move(node));
+        }
+
+        std::vector<unique_instance<Node>> m_unique;
+        std::vector<shared_instance<Node>> m_shared;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    constexpr std::size_t iterations{1000000};
+
+    bench::suite suite{"unique_instance"};
+    std::vector<std::pair<std::string, double>> counts;
+
+    auto run = [&](std::string const& name, auto function)
+    {
+        std::size_t before{allocations.load()};
+        function();
+        counts.emplace_back(name, static_cast<double>(allocations.load() - before));
+
+        suite.run(name, iterations, function);
+    };
+
+    run("create/std::make_unique", []
+    {
+        bench::do_not_optimize(std::make_unique<Node>());
+    });
+
+    run("create/make_unique_instance", []
+    {
+        bench::do_not_optimize(make_unique_instance<Node>());
+    });
+
+    run("create/make_shared_instance", []
+    {
+        bench::do_not_optimize(make_shared_instance<Node>());
+    });
+
+    run("create/shared_instance(new)", []
+    {
+        bench::do_not_optimize(shared_instance<Node>{new Node()});
+    });
+
+    Sink sink;
+    sink.m_unique.reserve(1);
+    sink.m_shared.reserve(1);
+
+    auto node = make_shared_instance<Node>();
+    run("hand over/shared_instance copy", [&]
+    {
+        sink.keep(node);
+    });
+
+    run("hand over/shared_instance made", [&]
+    {
+        sink.keep(make_shared_instance<Node>());
+    });
+
+    run("hand over/unique_instance made", [&]
+    {
+        sink.keep(make_unique_instance<Node>());
+    });
+
+    run("into shared/make_unique_instance", []
+    {
+        shared_instance<Node> shared{make_unique_instance<Node>()};
+        bench::do_not_optimize(shared);
+    });
+
+    suite.report(std::cout, bench::output_format(argc, argv));
+
+    for (auto const& count : counts)
+    {
+        std::cerr << count.first << ": " << count.second << " allocations\n";
+    }
+}
@@ -0,0 +1,290 @@
+// atomic_shared_instance.hpp -- a lock-free atomic holder of a shared_instance
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_ATOMIC_SHARED_INSTANCE_HPP
+#define REBOX_ATOMIC_SHARED_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace rebox
+{
+    // Holds a shared_instance which can be loaded and replaced
+    // concurrently. Each stored value lives in a node carrying a count of
+    // its readers. The pointer to the current node shares a single 64 bit
+    // word with a local count, so that a reader pins the node with one
+    // atomic increment before touching it (split reference counting).
+    // When the node is replaced, the pins still recorded in the local
+    // count are transferred to the node itself.
+    //
+    // The local count takes the upper 16 bits, which assumes that
+    // addresses fit into 48 bits, as they do for user space on x86-64
+    // and AArch64, and that no more than 65535 loads are in flight at
+    // the same time.
+    template<typename T, typename Report>
+    class atomic_shared_instance
+    {
+    public:
+        using value_type = shared_instance<T, Report>;
+
+        explicit atomic_shared_instance(value_type);
+
+        atomic_shared_instance(atomic_shared_instance const&) = delete;
+        atomic_shared_instance& operator=(atomic_shared_instance const&) = delete;
+
+        ~atomic_shared_instance();
+
+        value_type load() const;
+        void store(value_type);
+        value_type exchange(value_type);
+
+        bool compare_exchange_weak(value_type& expected, value_type desired);
+        bool compare_exchange_strong(value_type& expected, value_type desired);
+
+        operator value_type() const;
+        atomic_shared_instance& operator=(value_type);
+
+        bool is_lock_free() const;
+
+    private:
+        class node
+        {
+        public:
+            explicit node(value_type&& value)
+                : value(std::move(value)),
+                  count(1)
+            {
+            }
+
+            value_type value;
+
+            // readers transferred from the local count, plus one while
+            // the node is the current one
+            std::atomic<long> count;
+        };
+
+        static constexpr int pointerBits = sizeof(void*) == 8 ? 48 : 32;
+        static constexpr std::uint64_t pointerMask = (std::uint64_t{1} << pointerBits) - 1;
+        static constexpr std::uint64_t pin = std::uint64_t{1} << pointerBits;
+
+        static node* pointer(std::uint64_t state);
+        static long pins(std::uint64_t state);
+        static std::uint64_t pack(node*);
+
+        static bool equivalent(value_type const&, value_type const&);
+
+        std::uint64_t acquire() const;
+        void release(node*) const;
+        void retire(std::uint64_t state, long extra) const;
+
+        bool compare_exchange(value_type& expected, value_type&& desired, bool retry);
+
+        mutable std::atomic<std::uint64_t> m_state;
+    };
+
+    template<typename T, typename Report>
+    atomic_shared_instance<T, Report>::atomic_shared_instance(value_type value)
+        : m_state(pack(new node(std::move(value))))
+    {
+    }
+
+    template<typename T, typename Report>
+    atomic_shared_instance<T, Report>::~atomic_shared_instance()
+    {
+        delete pointer(m_state.load(std::memory_order_acquire));
+    }
+
+    template<typename T, typename Report>
+    typename atomic_shared_instance<T, Report>::node*
+    atomic_shared_instance<T, Report>::pointer(std::uint64_t state)
+    {
+        return reinterpret_cast<node*>(static_cast<std::uintptr_t>(state & pointerMask));
+    }
+
+    template<typename T, typename Report>
+    long
+    atomic_shared_instance<T, Report>::pins(std::uint64_t state)
+    {
+        return static_cast<long>(state >> pointerBits);
+    }
+
+    template<typename T, typename Report>
+    std::uint64_t
+    atomic_shared_instance<T, Report>::pack(node* ptr)
+    {
+        return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(ptr));
+    }
+
+    template<typename T, typename Report>
+    bool
+    atomic_shared_instance<T, Report>::equivalent(value_type const& lhs, value_type const& rhs)
+    {
+        return &lhs.get() == &rhs.get() && !lhs.owner_before(rhs) && !rhs.owner_before(lhs);
+    }
+
+    // pins the current node, which stays alive until it is released
+    template<typename T, typename Report>
+    std::uint64_t
+    atomic_shared_instance<T, Report>::acquire() const
+    {
+        return m_state.fetch_add(pin, std::memory_order_acquire) + pin;
+    }
+
+    template<typename T, typename Report>
+    void
+    atomic_shared_instance<T, Report>::release(node* ptr) const
+    {
+        std::uint64_t state{m_state.load(std::memory_order_relaxed)};
+
+        // the pin is still part of the local count as long as the node is current
+        while (pointer(state) == ptr)
+        {
+            if (m_state.compare_exchange_weak(state, state - pin,
+                                              std::memory_order_release,
+                                              std::memory_order_relaxed))
+            {
+                return;
+            }
+        }
+
+        // otherwise it was transferred to the node when replacing it
+        if (ptr->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            delete ptr;
+        }
+    }
+
+    // transfers the local count of a replaced node, dropping its own
+    // reference as current node and extra pins of the caller
+    template<typename T, typename Report>
+    void
+    atomic_shared_instance<T, Report>::retire(std::uint64_t state, long extra) const
+    {
+        node* ptr{pointer(state)};
+        long transfer{pins(state) - 1 - extra};
+
+        if (ptr->count.fetch_add(transfer, std::memory_order_acq_rel) + transfer == 0)
+        {
+            delete ptr;
+        }
+    }
+
+    template<typename T, typename Report>
+    typename atomic_shared_instance<T, Report>::value_type
+    atomic_shared_instance<T, Report>::load() const
+    {
+        node* ptr{pointer(acquire())};
+        value_type result{ptr->value};
+        release(ptr);
+        return result;
+    }
+
+    template<typename T, typename Report>
+    void
+    atomic_shared_instance<T, Report>::store(value_type value)
+    {
+        retire(m_state.exchange(pack(new node(std::move(value))), std::memory_order_acq_rel), 0);
+    }
+
+    template<typename T, typename Report>
+    typename atomic_shared_instance<T, Report>::value_type
+    atomic_shared_instance<T, Report>::exchange(value_type value)
+    {
+        std::uint64_t state{m_state.exchange(pack(new node(std::move(value))), std::memory_order_acq_rel)};
+
+        // nobody else can read the node any more, except for the pinned readers
+        value_type result{pointer(state)->value};
+        retire(state, 0);
+        return result;
+    }
+
+    template<typename T, typename Report>
+    bool
+    atomic_shared_instance<T, Report>::compare_exchange_weak(value_type& expected, value_type desired)
+    {
+        return compare_exchange(expected, std::move(desired), false);
+    }
+
+    template<typename T, typename Report>
+    bool
+    atomic_shared_instance<T, Report>::compare_exchange_strong(value_type& expected, value_type desired)
+    {
+        return compare_exchange(expected, std::move(desired), true);
+    }
+
+    template<typename T, typename Report>
+    bool
+    atomic_shared_instance<T, Report>::compare_exchange(value_type& expected, value_type&& desired, bool retry)
+    {
+        node* replacement{nullptr};
+
+        for (;;)
+        {
+            std::uint64_t state{acquire()};
+            node* ptr{pointer(state)};
+
+            if (!equivalent(ptr->value, expected))
+            {
+                expected = ptr->value;
+                release(ptr);
+                delete replacement;
+                return false;
+            }
+
+            if (!replacement)
+            {
+                replacement = new node(std::move(desired));
+            }
+
+            while (pointer(state) == ptr)
+            {
+                if (m_state.compare_exchange_weak(state, pack(replacement),
+                                                  std::memory_order_acq_rel,
+                                                  std::memory_order_relaxed))
+                {
+                    retire(state, 1);
+                    return true;
+                }
+            }
+
+            // replaced by somebody else in between
+            release(ptr);
+
+            if (!retry)
+            {
+                delete replacement;
+                return false;
+            }
+        }
+    }
+
+    template<typename T, typename Report>
+    atomic_shared_instance<T, Report>::operator value_type() const
+    {
+        return load();
+    }
+
+    template<typename T, typename Report>
+    atomic_shared_instance<T, Report>&
+    atomic_shared_instance<T, Report>::operator=(value_type value)
+    {
+        store(std::move(value));
+        return *this;
+    }
+
+    template<typename T, typename Report>
+    bool
+    atomic_shared_instance<T, Report>::is_lock_free() const
+    {
+        return m_state.is_lock_free();
+    }
+}
+
+#endif
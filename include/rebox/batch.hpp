@@ -0,0 +1,180 @@
+// batch.hpp -- acquiring and releasing many references at once
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_BATCH_HPP
+#define REBOX_BATCH_HPP
+
+#include "shared_instance.hpp"
+#include "local_shared_instance.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace rebox
+{
+    namespace detail
+    {
+        // std::shared_ptr offers no access to its count, so references
+        // are taken and dropped one at a time
+        template<typename Instance>
+        class batch_ops
+        {
+        public:
+            template<typename Output>
+            static Output acquire_n(Instance const& instance, std::size_t n, Output out)
+            {
+                for (; n > 0; --n)
+                {
+                    *out++ = instance;
+                }
+
+                return out;
+            }
+
+            template<typename Container>
+            static void release(Container& instances)
+            {
+                instances.clear();
+            }
+        };
+
+        // counted_ptr's take and drop all references to a block with a
+        // single modification of its count
+        template<typename T, typename Report, typename Count>
+        class batch_ops<shared_instance<T, Report, counted<Count>>>
+        {
+        public:
+            using instance = shared_instance<T, Report, counted<Count>>;
+
+            template<typename Output>
+            static Output acquire_n(instance const& source, std::size_t n, Output out)
+            {
+                if (n == 0)
+                {
+                    return out;
+                }
+
+                counted_block<Count>* block{counted_access::block(instance_access::pointer(source))};
+                T* obj{&source.get()};
+
+                block->add_ref(static_cast<long>(n));
+                std::size_t taken{0};
+
+                try
+                {
+                    while (taken < n)
+                    {
+                        auto copy = instance_access::adopt<instance>(counted_access::adopt(obj, block));
+                        ++taken;
+                        *out++ = std::move(copy);
+                    }
+                }
+                catch (...)
+                {
+                    if (taken < n)
+                    {
+                        block->release(static_cast<long>(n - taken));
+                    }
+
+                    throw;
+                }
+
+                return out;
+            }
+
+            // gathers the references per block in a small table, which
+            // is flushed whenever it runs full
+            template<typename Container>
+            static void release(Container& instances)
+            {
+                constexpr std::size_t slots{16};
+
+                counted_block<Count>* blocks[slots];
+                long counts[slots];
+                std::size_t used{0};
+                std::size_t last{0};
+
+                for (auto& element : instances)
+                {
+                    counted_block<Count>* block{counted_access::detach(instance_access::pointer(element))};
+
+                    // moved-from instances hold no reference
+                    if (!block)
+                    {
+                        continue;
+                    }
+
+                    if (used == 0 || blocks[last] != block)
+                    {
+                        last = std::find(blocks, blocks + used, block) - blocks;
+
+                        if (last == slots)
+                        {
+                            flush(blocks, counts, used);
+                            last = 0;
+                        }
+
+                        if (last == used)
+                        {
+                            blocks[used] = block;
+                            counts[used] = 0;
+                            ++used;
+                        }
+                    }
+
+                    ++counts[last];
+                }
+
+                instances.clear();
+                flush(blocks, counts, used);
+            }
+
+        private:
+            static void flush(counted_block<Count>** blocks, long* counts, std::size_t& used)
+            {
+                for (std::size_t i = 0; i < used; ++i)
+                {
+                    blocks[i]->release(counts[i]);
+                }
+
+                used = 0;
+            }
+        };
+    }
+
+    // writes n copies of instance to out; for counted policies the
+    // count is raised once by n
+    template<typename T, typename Report, typename Threading, typename Output>
+    Output acquire_n(shared_instance<T, Report, Threading> const& instance, std::size_t n, Output out)
+    {
+        return detail::batch_ops<shared_instance<T, Report, Threading>>::acquire_n(instance, n, out);
+    }
+
+    template<typename T, typename Report, typename Threading>
+    std::vector<shared_instance<T, Report, Threading>>
+    acquire_n(shared_instance<T, Report, Threading> const& instance, std::size_t n)
+    {
+        std::vector<shared_instance<T, Report, Threading>> copies;
+        copies.reserve(n);
+        acquire_n(instance, n, std::back_inserter(copies));
+        return copies;
+    }
+
+    // drops all instances of a container like std::vector, leaving it
+    // empty; for counted policies the count of each object is lowered
+    // once by the number of its instances
+    template<typename Container>
+    void release_batch(Container& instances)
+    {
+        detail::batch_ops<typename Container::value_type>::release(instances);
+    }
+}
+
+#endif
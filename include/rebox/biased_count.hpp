@@ -0,0 +1,507 @@
+// biased_count.hpp -- a reference count biased towards its creating thread
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_BIASED_COUNT_HPP
+#define REBOX_BIASED_COUNT_HPP
+
+#include "count.hpp"
+#include "local_shared_instance.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+namespace rebox
+{
+    namespace detail
+    {
+        class biased_thread;
+    }
+
+    // Biased reference counting: the thread creating a count modifies a
+    // plain counter, all other threads an atomic one. The two are merged
+    // when the creating thread releases its last reference. References
+    // handed to other threads and released there may leave the atomic
+    // counter negative; such counts are queued to the creating thread,
+    // which merges them the next time it creates or releases a count,
+    // when calling collect() or when it exits. Until then, their objects
+    // stay alive.
+    //
+    // use_count() is exact only on the creating thread and once merged.
+    class biased_count
+    {
+    public:
+        class type
+        {
+        public:
+            explicit type(long initial);
+            ~type();
+
+            type(type const&) = delete;
+            type& operator=(type const&) = delete;
+
+        private:
+            friend class biased_count;
+            friend class detail::biased_thread;
+
+            detail::biased_thread* m_owner;
+
+            // owned by m_owner
+            long m_biased;
+            bool m_merged;
+            type* m_previous;
+            type* m_next;
+
+            // count of the other threads, times four, plus the flags
+            std::atomic<long> m_shared;
+            type* m_queued;
+
+            void* m_block;
+            void (*m_expire)(void*);
+        };
+
+        // weak references are rare enough for a plain atomic count
+        using weak_policy = atomic_count;
+
+        static void attach(type& count, void* block, void (*expire)(void*));
+
+        static void increment(type& count);
+        static void increment(type& count, long n);
+        static bool increment_if_nonzero(type& count);
+        static bool decrement(type& count);
+        static bool decrement(type& count, long n);
+        static long load(type const& count);
+
+        // merges the counts queued for the calling thread
+        static void collect();
+
+    private:
+        friend class detail::biased_thread;
+
+        static constexpr long merged = 1;
+        static constexpr long queued = 2;
+        static constexpr long unit = 4;
+
+        static long shared_count(long state)
+        {
+            return (state - (state & (unit - 1))) / unit;
+        }
+
+        static bool owned(type const& count);
+        static bool merge(type& count, bool dequeue);
+        static bool release_shared(type& count, long n);
+    };
+
+    namespace detail
+    {
+        // the counts created by a thread and those queued for merging
+        class biased_thread
+        {
+        public:
+            // the record of the calling thread, created on first use
+            static biased_thread* local();
+
+            static biased_thread* current()
+            {
+                return pointer();
+            }
+
+            void insert(biased_count::type& count)
+            {
+                count.m_previous = nullptr;
+                count.m_next = m_counts;
+
+                if (m_counts)
+                {
+                    m_counts->m_previous = &count;
+                }
+
+                m_counts = &count;
+            }
+
+            void remove(biased_count::type& count)
+            {
+                (count.m_previous ? count.m_previous->m_next : m_counts) = count.m_next;
+
+                if (count.m_next)
+                {
+                    count.m_next->m_previous = count.m_previous;
+                }
+            }
+
+            // returns false if the thread has exited
+            bool enqueue(biased_count::type& count)
+            {
+                biased_count::type* head{m_queue.load(std::memory_order_relaxed)};
+
+                do
+                {
+                    if (head == closed())
+                    {
+                        return false;
+                    }
+
+                    count.m_queued = head;
+                }
+                while (!m_queue.compare_exchange_weak(head, &count,
+                                                      std::memory_order_release,
+                                                      std::memory_order_relaxed));
+
+                return true;
+            }
+
+            void drain()
+            {
+                if (m_queue.load(std::memory_order_relaxed))
+                {
+                    process(m_queue.exchange(nullptr, std::memory_order_acquire));
+                }
+            }
+
+        private:
+            class holder
+            {
+            public:
+                holder()
+                    : thread(acquire())
+                {
+                    pointer() = thread;
+                }
+
+                ~holder()
+                {
+                    pointer() = nullptr;
+                    destroyed() = true;
+                    thread->exit();
+                }
+
+                biased_thread* thread;
+            };
+
+            biased_thread()
+                : m_used(true),
+                  m_queue(nullptr),
+                  m_counts(nullptr),
+                  m_next(nullptr)
+            {
+            }
+
+            static biased_thread*& pointer()
+            {
+                static thread_local biased_thread* thread{};
+                return thread;
+            }
+
+            static bool& destroyed()
+            {
+                static thread_local bool value{};
+                return value;
+            }
+
+            static std::atomic<biased_thread*>& threads()
+            {
+                static std::atomic<biased_thread*> head{nullptr};
+                return head;
+            }
+
+            // marks the queue of an exited thread, never dereferenced
+            static biased_count::type* closed()
+            {
+                static char marker;
+                return reinterpret_cast<biased_count::type*>(&marker);
+            }
+
+            // threads are never freed, as their counts may outlive them,
+            // but reused once they have exited
+            static biased_thread* acquire()
+            {
+                for (biased_thread* thread = threads().load(std::memory_order_acquire); thread; thread = thread->m_next)
+                {
+                    bool used{false};
+
+                    if (!thread->m_used.load(std::memory_order_relaxed)
+                        && thread->m_used.compare_exchange_strong(used, true, std::memory_order_acquire))
+                    {
+                        thread->m_queue.store(nullptr, std::memory_order_release);
+                        return thread;
+                    }
+                }
+
+                auto thread = new biased_thread;
+                thread->m_next = threads().load(std::memory_order_relaxed);
+
+                while (!threads().compare_exchange_weak(thread->m_next, thread,
+                                                        std::memory_order_release,
+                                                        std::memory_order_relaxed))
+                {
+                }
+
+                return thread;
+            }
+
+            void process(biased_count::type* count)
+            {
+                while (count)
+                {
+                    biased_count::type* next{count->m_queued};
+
+                    if (biased_count::merge(*count, true))
+                    {
+                        count->m_expire(count->m_block);
+                    }
+
+                    count = next;
+                }
+            }
+
+            // hands all counts over to the other threads
+            void exit()
+            {
+                process(m_queue.exchange(closed(), std::memory_order_acquire));
+
+                while (m_counts)
+                {
+                    biased_count::type& count{*m_counts};
+
+                    if (biased_count::merge(count, false))
+                    {
+                        count.m_expire(count.m_block);
+                    }
+                }
+
+                m_used.store(false, std::memory_order_release);
+            }
+
+            std::atomic<bool> m_used;
+            std::atomic<biased_count::type*> m_queue;
+            biased_count::type* m_counts;
+            biased_thread* m_next;
+        };
+
+        inline biased_thread* biased_thread::local()
+        {
+            biased_thread* thread{pointer()};
+
+            if (!thread && !destroyed())
+            {
+                static thread_local holder local;
+                thread = pointer();
+            }
+
+            return thread;
+        }
+    }
+
+    inline biased_count::type::type(long initial)
+        : m_owner(detail::biased_thread::local()),
+          m_biased(initial),
+          m_merged(false),
+          m_previous(nullptr),
+          m_next(nullptr),
+          m_shared(0),
+          m_queued(nullptr),
+          m_block(nullptr),
+          m_expire(nullptr)
+    {
+        if (m_owner)
+        {
+            m_owner->insert(*this);
+            m_owner->drain();
+        }
+        else
+        {
+            // created while the thread exits
+            m_biased = 0;
+            m_merged = true;
+            m_shared.store(initial * unit + merged, std::memory_order_relaxed);
+        }
+    }
+
+    inline biased_count::type::~type()
+    {
+        // counts are merged before their object is destroyed, unless
+        // constructing the object failed
+        if (!m_merged)
+        {
+            m_owner->remove(*this);
+        }
+    }
+
+    inline void biased_count::attach(type& count, void* block, void (*expire)(void*))
+    {
+        count.m_block = block;
+        count.m_expire = expire;
+    }
+
+    inline bool biased_count::owned(type const& count)
+    {
+        return count.m_owner == detail::biased_thread::current() && !count.m_merged;
+    }
+
+    inline void biased_count::increment(type& count)
+    {
+        increment(count, 1);
+    }
+
+    inline void biased_count::increment(type& count, long n)
+    {
+        if (owned(count))
+        {
+            count.m_biased += n;
+        }
+        else
+        {
+            count.m_shared.fetch_add(n * unit, std::memory_order_relaxed);
+        }
+    }
+
+    inline bool biased_count::increment_if_nonzero(type& count)
+    {
+        // the creating thread holds a reference as long as it has not merged
+        if (owned(count))
+        {
+            ++count.m_biased;
+            return true;
+        }
+
+        long state{count.m_shared.load(std::memory_order_relaxed)};
+
+        // objects whose merge is pending are revived rather than destroyed
+        while (!(state & merged) || shared_count(state) > 0)
+        {
+            if (count.m_shared.compare_exchange_weak(state, state + unit, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    inline bool biased_count::decrement(type& count)
+    {
+        return decrement(count, 1);
+    }
+
+    inline bool biased_count::decrement(type& count, long n)
+    {
+        if (owned(count))
+        {
+            if (n >= count.m_biased)
+            {
+                // the references beyond the biased count were counted
+                // by other threads and are released from the merged count
+                n -= count.m_biased;
+                count.m_biased = 0;
+
+                bool expired{merge(count, false)};
+                return n == 0 ? expired : release_shared(count, n);
+            }
+
+            count.m_biased -= n;
+
+            // other threads released more than they acquired, which may
+            // have been the last references
+            if (count.m_shared.load(std::memory_order_relaxed) & queued)
+            {
+                count.m_owner->drain();
+            }
+
+            return false;
+        }
+
+        return release_shared(count, n);
+    }
+
+    inline long biased_count::load(type const& count)
+    {
+        if (owned(count))
+        {
+            return count.m_biased + shared_count(count.m_shared.load(std::memory_order_relaxed));
+        }
+
+        long state{count.m_shared.load(std::memory_order_relaxed)};
+
+        // the creating thread holds at least one reference until it merges
+        return (state & merged) ? shared_count(state) : std::max(shared_count(state) + 1, 1L);
+    }
+
+    inline void biased_count::collect()
+    {
+        if (detail::biased_thread* thread = detail::biased_thread::local())
+        {
+            thread->drain();
+        }
+    }
+
+    // returns true if the object is to be destroyed
+    inline bool biased_count::release_shared(type& count, long n)
+    {
+        long state{count.m_shared.load(std::memory_order_relaxed)};
+        long next;
+
+        do
+        {
+            next = state - n * unit;
+
+            // the first time references of the creating thread are
+            // released elsewhere, it is asked to merge
+            if (!(state & (merged | queued)) && shared_count(next) < 0)
+            {
+                next |= queued;
+            }
+        }
+        while (!count.m_shared.compare_exchange_weak(state, next, std::memory_order_acq_rel));
+
+        if ((next & queued) && !(state & queued))
+        {
+            if (count.m_owner->enqueue(count))
+            {
+                return false;
+            }
+
+            // the creating thread has exited and merged the count already
+            // or will do so, seeing no queue request any more
+            state = count.m_shared.fetch_and(~queued, std::memory_order_acq_rel);
+            next = state & ~queued;
+        }
+
+        return (next & merged) && !(next & queued) && shared_count(next) == 0;
+    }
+
+    // merges the count of the owner into the shared one; returns true if
+    // the object is to be destroyed
+    inline bool biased_count::merge(type& count, bool dequeue)
+    {
+        long add{0};
+
+        if (!count.m_merged)
+        {
+            count.m_owner->remove(count);
+            count.m_merged = true;
+            add = count.m_biased * unit;
+            count.m_biased = 0;
+        }
+
+        long state{count.m_shared.load(std::memory_order_relaxed)};
+        long next;
+
+        do
+        {
+            next = (state + add) | merged;
+
+            if (dequeue)
+            {
+                next &= ~queued;
+            }
+        }
+        while (!count.m_shared.compare_exchange_weak(state, next, std::memory_order_acq_rel));
+
+        return !(next & queued) && shared_count(next) == 0;
+    }
+}
+
+#endif
@@ -0,0 +1,55 @@
+// call_site.hpp -- the source location of a call, for diagnostics
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_CALL_SITE_HPP
+#define REBOX_CALL_SITE_HPP
+
+// whether __builtin_FILE, __builtin_FUNCTION and __builtin_LINE exist;
+// clang defines __GNUC__ as well but has them only from version 9 on,
+// so it is asked by __has_builtin alone
+#if defined(__has_builtin)
+#  if __has_builtin(__builtin_FILE) && __has_builtin(__builtin_FUNCTION) && __has_builtin(__builtin_LINE)
+#    define REBOX_HAS_SOURCE_BUILTINS 1
+#  endif
+#elif defined(__GNUC__) && !defined(__clang__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+#  define REBOX_HAS_SOURCE_BUILTINS 1
+#elif defined(_MSC_VER) && _MSC_VER >= 1926
+#  define REBOX_HAS_SOURCE_BUILTINS 1
+#endif
+
+#ifndef REBOX_HAS_SOURCE_BUILTINS
+#  define REBOX_HAS_SOURCE_BUILTINS 0
+#endif
+
+namespace rebox
+{
+    // a location in the source, taken where a default argument is
+    // evaluated, that is in the calling code
+    class call_site
+    {
+    public:
+#if REBOX_HAS_SOURCE_BUILTINS
+        static constexpr call_site current(char const* file = __builtin_FILE(),
+                                           char const* function = __builtin_FUNCTION(),
+                                           unsigned line = __builtin_LINE())
+        {
+            return call_site{file, function, line};
+        }
+#else
+        static constexpr call_site current()
+        {
+            return call_site{"", "", 0};
+        }
+#endif
+
+        char const* file;
+        char const* function;
+        unsigned line;
+    };
+}
+
+#endif
@@ -0,0 +1,226 @@
+// checked_cast.hpp -- downcasts of shared_instance's by a type tag recorded at creation
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_CHECKED_CAST_HPP
+#define REBOX_CHECKED_CAST_HPP
+
+#include "shared_instance.hpp"
+
+#include <type_traits>
+#include <utility>
+
+// without RTTI, objects whose type was not recorded cannot be downcast
+#ifndef REBOX_HAS_RTTI
+#  if defined(__GXX_RTTI) || defined(_CPPRTTI) || defined(__cpp_rtti)
+#    define REBOX_HAS_RTTI 1
+#  else
+#    define REBOX_HAS_RTTI 0
+#  endif
+#endif
+
+namespace rebox
+{
+    namespace detail
+    {
+        // one per type; its address is the tag. It is writable, so that
+        // linkers folding identical constants keep the tags apart.
+        template<typename T>
+        class type_tag
+        {
+        public:
+            static char value;
+        };
+
+        template<typename T>
+        char type_tag<T>::value{0};
+    }
+
+    // The base of a class hierarchy rooted at Root whose objects remember
+    // their type when made by make_shared_instance,
+    // allocate_shared_instance or make_unique_instance. try_pointer_cast
+    // and checked_pointer_cast recognize such an object by a single
+    // comparison; objects created otherwise have no tag. Tags are compared
+    // by address, so an object made in another module which keeps its own
+    // copy of the tag is only recognized by dynamic_cast; without RTTI,
+    // objects have to be made in the module casting them.
+    template<typename Root>
+    class type_tagged
+    {
+    public:
+        using type_tagged_type = type_tagged;
+
+        // the tag of the type the object was made as, or null
+        void const* type_tag() const
+        {
+            return m_typeTag;
+        }
+
+        template<typename T>
+        static void const* tag_of()
+        {
+            return &detail::type_tag<T>::value;
+        }
+
+    protected:
+        type_tagged()
+            : m_typeTag(nullptr)
+        {
+        }
+
+        // a copy may be sliced, and is made as whatever the caller makes it
+        type_tagged(type_tagged const&)
+            : m_typeTag(nullptr)
+        {
+        }
+
+        type_tagged& operator=(type_tagged const&)
+        {
+            return *this;
+        }
+
+        ~type_tagged() = default;
+
+    private:
+        template<typename, typename>
+        friend class detail::type_tag_recorder;
+
+        static void record(type_tagged const& obj, void const* tag)
+        {
+            obj.m_typeTag = tag;
+        }
+
+        // set after the object, possibly a const one, is constructed
+        mutable void const* m_typeTag;
+    };
+
+    namespace detail
+    {
+        // compares the tag where Source is tagged and Target can be reached
+        // by a static_cast, which excludes virtual bases
+        template<typename Target, typename Source, typename = void>
+        class tag_check
+        {
+        public:
+            static Target* cast(Source&)
+            {
+                return nullptr;
+            }
+        };
+
+        template<typename Target, typename Source>
+        class tag_check<Target, Source,
+                        typename type_tag_void<decltype(static_cast<Target*>(std::declval<Source*>()),
+                                                        std::declval<typename Source::type_tagged_type&>())>::type>
+        {
+        public:
+            using tagged = typename Source::type_tagged_type;
+
+            static Target* cast(Source& obj)
+            {
+                if (obj.type_tag() == tagged::template tag_of<typename std::remove_cv<Target>::type>())
+                {
+                    return static_cast<Target*>(&obj);
+                }
+
+                return nullptr;
+            }
+        };
+
+        template<typename Target, typename Source>
+        Target* fallback_cast(Source& obj, std::true_type)
+        {
+            return dynamic_cast<Target*>(&obj);
+        }
+
+        template<typename Target, typename Source>
+        Target* fallback_cast(Source&, std::false_type)
+        {
+            return nullptr;
+        }
+
+        // obj as a Target if it is one, otherwise null
+        template<typename Target, typename Source>
+        Target* tagged_cast(Source& obj)
+        {
+            using check = tag_check<Target, Source>;
+
+            if (Target* target = check::cast(obj))
+            {
+                return target;
+            }
+
+            // a tag differing from the one of a final Target need not rule
+            // it out: Windows DLLs and -fvisibility=hidden give each module
+            // its own copy of type_tag<Target>
+            using dynamic = std::integral_constant<bool, REBOX_HAS_RTTI && std::is_polymorphic<Source>::value>;
+            return fallback_cast<Target>(obj, dynamic{});
+        }
+    }
+
+    // Casts obj down to Target. If obj was made as a Target this takes a
+    // single comparison, otherwise dynamic_cast is asked, where there is
+    // RTTI and Source is polymorphic. Like dynamic_pointer_cast, a
+    // (possibly null) pointer is returned.
+    template<typename Target, typename Source, typename Report, typename Threading>
+    typename Threading::template pointer<Target> try_pointer_cast(shared_instance<Source, Report, Threading> const& obj)
+    {
+        REBOX_INSTANCE_EVENT(Target, cast);
+
+        if (auto target = detail::tagged_cast<Target>(obj.get()))
+        {
+            return typename Threading::template pointer<Target>(detail::instance_access::pointer(obj), target);
+        }
+
+        return typename Threading::template pointer<Target>{};
+    }
+
+    // obj is left untouched if the cast fails
+    template<typename Target, typename Source, typename Report, typename Threading>
+    typename Threading::template pointer<Target> try_pointer_cast(shared_instance<Source, Report, Threading>&& obj)
+    {
+        REBOX_INSTANCE_EVENT(Target, cast);
+
+        if (auto target = detail::tagged_cast<Target>(obj.get()))
+        {
+            return Threading::alias(std::move(obj).ptr(), target);
+        }
+
+        return typename Threading::template pointer<Target>{};
+    }
+
+    // like try_pointer_cast, but reports a failing cast like a null pointer
+    template<typename Target, typename Source, typename Report, typename Threading>
+    shared_instance<Target, Report, Threading> checked_pointer_cast(shared_instance<Source, Report, Threading> const& obj)
+    {
+        using instance = shared_instance<Target, Report, Threading>;
+        REBOX_INSTANCE_EVENT(Target, cast);
+
+        if (auto target = detail::tagged_cast<Target>(obj.get()))
+        {
+            return detail::instance_access::adopt<instance>(
+                typename Threading::template pointer<Target>(detail::instance_access::pointer(obj), target));
+        }
+
+        return instance{typename Threading::template pointer<Target>{}};
+    }
+
+    template<typename Target, typename Source, typename Report, typename Threading>
+    shared_instance<Target, Report, Threading> checked_pointer_cast(shared_instance<Source, Report, Threading>&& obj)
+    {
+        using instance = shared_instance<Target, Report, Threading>;
+        REBOX_INSTANCE_EVENT(Target, cast);
+
+        if (auto target = detail::tagged_cast<Target>(obj.get()))
+        {
+            return detail::instance_access::adopt<instance>(Threading::alias(std::move(obj).ptr(), target));
+        }
+
+        return instance{typename Threading::template pointer<Target>{}};
+    }
+}
+
+#endif
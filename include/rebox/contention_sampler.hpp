@@ -0,0 +1,478 @@
+// contention_sampler.hpp -- timing sampled reference count operations by call site
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_CONTENTION_SAMPLER_HPP
+#define REBOX_CONTENTION_SAMPLER_HPP
+
+#include "call_site.hpp"
+#include "type_name.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <typeinfo>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define REBOX_HAS_RDTSC 1
+#elif defined(_M_X64) || defined(_M_IX86)
+#  include <intrin.h>
+#  define REBOX_HAS_RDTSC 1
+#else
+#  define REBOX_HAS_RDTSC 0
+#endif
+
+namespace rebox
+{
+    enum class count_operation
+    {
+        // copying a pointer to an object
+        copy,
+
+        // assigning to an instance, dropping its former object
+        assign,
+
+        // dropping a reference to an object which stays alive
+        drop
+    };
+
+    inline char const* operation_name(count_operation operation)
+    {
+        switch (operation)
+        {
+        case count_operation::copy:
+            return "copy";
+        case count_operation::assign:
+            return "assign";
+        default:
+            return "drop";
+        }
+    }
+
+    // the samples taken for one type, call site and operation
+    class contention_sample
+    {
+    public:
+        std::string type;
+        std::string file;
+        std::string function;
+        unsigned line;
+        count_operation operation;
+
+        std::size_t samples;
+        std::uint64_t cycles;
+        std::uint64_t maxCycles;
+    };
+
+    namespace detail
+    {
+        // time stamp counter, or nanoseconds where there is none
+        inline std::uint64_t read_cycles()
+        {
+#if REBOX_HAS_RDTSC
+            _mm_lfence();
+            std::uint64_t cycles{__rdtsc()};
+            _mm_lfence();
+            return cycles;
+#else
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+        }
+
+        class sample_key
+        {
+        public:
+            // by the names behind the pointers, which differ between
+            // translation units and shared objects
+            bool operator<(sample_key const& other) const
+            {
+                std::type_index thisType{*type};
+                std::type_index otherType{*other.type};
+
+                if (thisType != otherType)
+                {
+                    return thisType < otherType;
+                }
+
+                if (int order = std::strcmp(file, other.file))
+                {
+                    return order < 0;
+                }
+
+                return std::tie(line, operation) < std::tie(other.line, other.operation);
+            }
+
+            std::type_info const* type;
+            char const* file;
+            unsigned line;
+            count_operation operation;
+        };
+
+        class sample_totals
+        {
+        public:
+            char const* function;
+            std::size_t samples;
+            std::uint64_t cycles;
+            std::uint64_t maxCycles;
+        };
+
+        using sample_table = std::map<sample_key, sample_totals>;
+
+        inline void merge(sample_table& target, sample_table const& source)
+        {
+            for (auto const& entry : source)
+            {
+                auto inserted = target.insert(entry);
+
+                if (!inserted.second)
+                {
+                    sample_totals& totals = inserted.first->second;
+                    totals.samples += entry.second.samples;
+                    totals.cycles += entry.second.cycles;
+                    totals.maxCycles = std::max(totals.maxCycles, entry.second.maxCycles);
+                }
+            }
+        }
+
+        class thread_samples;
+    }
+
+    // Collects the samples of all threads. Every period-th reference
+    // count operation of a thread is timed, on average; the period can be
+    // changed at any time, 0 stops sampling.
+    class contention_sampler
+    {
+    public:
+        static contention_sampler& instance()
+        {
+            static contention_sampler sampler;
+            return sampler;
+        }
+
+        contention_sampler(contention_sampler const&) = delete;
+        contention_sampler& operator=(contention_sampler const&) = delete;
+
+        std::size_t period() const
+        {
+            return m_period.load(std::memory_order_relaxed);
+        }
+
+        void period(std::size_t operations)
+        {
+            m_period.store(operations, std::memory_order_relaxed);
+        }
+
+        // the samples of all threads, the most expensive call sites first
+        std::vector<contention_sample> collect() const;
+
+        void reset();
+
+        // one line per call site
+        void report(std::ostream& out) const;
+
+        // an array of objects with the members of contention_sample
+        void report_json(std::ostream& out) const;
+
+    private:
+        friend class detail::thread_samples;
+
+        contention_sampler()
+            : m_period(64),
+              m_threads()
+        {
+        }
+
+        std::atomic<std::size_t> m_period;
+
+        mutable std::mutex m_mutex;
+        std::vector<detail::thread_samples*> m_threads;
+        detail::sample_table m_retired;
+    };
+
+    namespace detail
+    {
+        // the samples of one thread; its lock is only contended while
+        // the samples are collected. Sampling runs in the noexcept copy
+        // constructor of shared_instance, so samples which cannot be
+        // stored are dropped instead of throwing.
+        class thread_samples
+        {
+        public:
+            thread_samples() noexcept
+                : m_countdown(0),
+                  m_random(0x9E3779B97F4A7C15ull ^ reinterpret_cast<std::uintptr_t>(this)),
+                  m_listed(false)
+            {
+                try
+                {
+                    contention_sampler& sampler{contention_sampler::instance()};
+                    std::lock_guard<std::mutex> lock{sampler.m_mutex};
+                    sampler.m_threads.push_back(this);
+                    m_listed = true;
+                }
+                catch (...)
+                {
+                }
+            }
+
+            ~thread_samples()
+            {
+                if (!m_listed)
+                {
+                    return;
+                }
+
+                contention_sampler& sampler{contention_sampler::instance()};
+
+                try
+                {
+                    std::lock_guard<std::mutex> lock{sampler.m_mutex};
+                    sampler.m_threads.erase(std::find(sampler.m_threads.begin(), sampler.m_threads.end(), this));
+                    merge(sampler.m_retired, m_table);
+                }
+                catch (...)
+                {
+                }
+            }
+
+            thread_samples(thread_samples const&) = delete;
+            thread_samples& operator=(thread_samples const&) = delete;
+
+            static thread_samples& current()
+            {
+                static thread_local thread_samples samples;
+                return samples;
+            }
+
+            bool due()
+            {
+                // a shortened period takes effect right away
+                std::size_t period{contention_sampler::instance().period()};
+
+                if (period == 0)
+                {
+                    return false;
+                }
+
+                if (m_countdown > 1 && m_countdown < 2 * period)
+                {
+                    --m_countdown;
+                    return false;
+                }
+
+                // the intervals vary around the period, so operations
+                // recurring at a fixed distance are not always or never
+                // sampled
+                m_random ^= m_random << 13;
+                m_random ^= m_random >> 7;
+                m_random ^= m_random << 17;
+
+                m_countdown = 1 + static_cast<std::size_t>(m_random % (2 * period - 1));
+                return true;
+            }
+
+            void record(sample_key const& key, char const* function, std::uint64_t cycles) noexcept
+            {
+                if (!m_listed)
+                {
+                    return;
+                }
+
+                try
+                {
+                    std::lock_guard<std::mutex> lock{m_mutex};
+                    auto inserted = m_table.insert({key, sample_totals{function, 0, 0, 0}});
+
+                    sample_totals& totals = inserted.first->second;
+                    ++totals.samples;
+                    totals.cycles += cycles;
+                    totals.maxCycles = std::max(totals.maxCycles, cycles);
+                }
+                catch (...)
+                {
+                }
+            }
+
+            void merge_into(sample_table& target)
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                merge(target, m_table);
+            }
+
+            void clear()
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                m_table.clear();
+            }
+
+        private:
+            std::size_t m_countdown;
+            std::uint64_t m_random;
+
+            bool m_listed;
+
+            std::mutex m_mutex;
+            sample_table m_table;
+        };
+
+        // runs operation, timing it if a sample is due
+        template<typename T, typename Operation>
+        void sample_count(count_operation operation, call_site const& site, Operation run)
+        {
+            thread_samples& samples{thread_samples::current()};
+
+            if (!samples.due())
+            {
+                run();
+                return;
+            }
+
+            std::uint64_t start{read_cycles()};
+            run();
+            std::uint64_t end{read_cycles()};
+
+            samples.record(sample_key{&typeid(T), site.file, site.line, operation}, site.function, end - start);
+        }
+
+        inline void write_json_string(std::ostream& out, std::string const& text)
+        {
+            out << '"';
+
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    out << '\\' << c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out << ' ';
+                }
+                else
+                {
+                    out << c;
+                }
+            }
+
+            out << '"';
+        }
+    }
+
+    inline std::vector<contention_sample>
+    contention_sampler::collect() const
+    {
+        detail::sample_table table;
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            table = m_retired;
+
+            for (auto thread : m_threads)
+            {
+                thread->merge_into(table);
+            }
+        }
+
+        std::vector<contention_sample> result;
+        result.reserve(table.size());
+
+        // the table is ordered by type, demangling each name once
+        std::type_info const* type{nullptr};
+        std::string typeName;
+
+        for (auto const& entry : table)
+        {
+            if (!type || *type != *entry.first.type)
+            {
+                type = entry.first.type;
+                typeName = detail::demangle(type->name());
+            }
+
+            result.push_back(contention_sample{
+                typeName,
+                entry.first.file,
+                entry.second.function,
+                entry.first.line,
+                entry.first.operation,
+                entry.second.samples,
+                entry.second.cycles,
+                entry.second.maxCycles
+            });
+        }
+
+        std::sort(result.begin(), result.end(), [](contention_sample const& lhs, contention_sample const& rhs)
+        {
+            return lhs.cycles > rhs.cycles;
+        });
+
+        return result;
+    }
+
+    inline void
+    contention_sampler::reset()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_retired.clear();
+
+        for (auto thread : m_threads)
+        {
+            thread->clear();
+        }
+    }
+
+    inline void
+    contention_sampler::report(std::ostream& out) const
+    {
+        for (auto const& sample : collect())
+        {
+            out << sample.file << ':' << sample.line << ' ' << sample.function
+                << ' ' << sample.type << ' ' << operation_name(sample.operation)
+                << ": samples=" << sample.samples
+                << " mean=" << sample.cycles / sample.samples
+                << " max=" << sample.maxCycles << '\n';
+        }
+    }
+
+    inline void
+    contention_sampler::report_json(std::ostream& out) const
+    {
+        out << '[';
+        bool first{true};
+
+        for (auto const& sample : collect())
+        {
+            out << (first ? "\n" : ",\n") << "  {\"type\": ";
+            detail::write_json_string(out, sample.type);
+            out << ", \"file\": ";
+            detail::write_json_string(out, sample.file);
+            out << ", \"function\": ";
+            detail::write_json_string(out, sample.function);
+            out << ", \"line\": " << sample.line
+                << ", \"operation\": \"" << operation_name(sample.operation) << '"'
+                << ", \"samples\": " << sample.samples
+                << ", \"cycles\": " << sample.cycles
+                << ", \"max_cycles\": " << sample.maxCycles << '}';
+            first = false;
+        }
+
+        out << (first ? "]\n" : "\n]\n");
+    }
+}
+
+#endif
@@ -0,0 +1,128 @@
+// count.hpp -- reference count policies
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_COUNT_HPP
+#define REBOX_COUNT_HPP
+
+#include <atomic>
+
+namespace rebox
+{
+    // reference count without any synchronisation -- only for objects
+    // which never leave the thread they were created on
+    class plain_count
+    {
+    public:
+        using type = long;
+
+        static void increment(type& count)
+        {
+            ++count;
+        }
+
+        static void increment(type& count, long n)
+        {
+            count += n;
+        }
+
+        static bool increment_if_nonzero(type& count)
+        {
+            if (count == 0)
+            {
+                return false;
+            }
+
+            ++count;
+            return true;
+        }
+
+        // returns true if the count dropped to zero; the n variants
+        // count n references at once
+        static bool decrement(type& count)
+        {
+            return --count == 0;
+        }
+
+        static bool decrement(type& count, long n)
+        {
+            return (count -= n) == 0;
+        }
+
+        static long load(type const& count)
+        {
+            return count;
+        }
+
+        // called by the control block owning count; only needed by
+        // policies which may find the count dropped to zero outside of
+        // decrement and then call expire(block)
+        static void attach(type&, void*, void (*)(void*))
+        {
+        }
+    };
+
+
+    // reference count safe to be modified from multiple threads
+    class atomic_count
+    {
+    public:
+        using type = std::atomic<long>;
+
+        static void increment(type& count)
+        {
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static void increment(type& count, long n)
+        {
+            count.fetch_add(n, std::memory_order_relaxed);
+        }
+
+        static bool increment_if_nonzero(type& count)
+        {
+            long current{count.load(std::memory_order_relaxed)};
+
+            while (current != 0)
+            {
+                if (count.compare_exchange_weak(current, current + 1, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        // returns true if the count dropped to zero
+        static bool decrement(type& count)
+        {
+            return decrement(count, 1);
+        }
+
+        static bool decrement(type& count, long n)
+        {
+            if (count.fetch_sub(n, std::memory_order_release) == n)
+            {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                return true;
+            }
+
+            return false;
+        }
+
+        static long load(type const& count)
+        {
+            return count.load(std::memory_order_relaxed);
+        }
+
+        static void attach(type&, void*, void (*)(void*))
+        {
+        }
+    };
+}
+
+#endif
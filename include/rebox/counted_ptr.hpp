@@ -0,0 +1,1054 @@
+// counted_ptr.hpp -- a shared pointer with a configurable reference count
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_COUNTED_PTR_HPP
+#define REBOX_COUNTED_PTR_HPP
+
+#include "shared_instance_fwd.hpp"
+#include "count.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+namespace rebox
+{
+    template<typename T, typename Count>
+    class counted_ptr;
+
+    template<typename T, typename Count>
+    class counted_weak_ptr;
+
+    template<typename T>
+    using local_shared_ptr = counted_ptr<T, plain_count>;
+
+    template<typename T>
+    using local_weak_ptr = counted_weak_ptr<T, plain_count>;
+
+    namespace detail
+    {
+        template<typename>
+        class always_void
+        {
+        public:
+            using type = void;
+        };
+
+        // the policy counting weak references: Count::weak_policy if
+        // present, Count otherwise
+        template<typename Count, typename = void>
+        class weak_policy_of
+        {
+        public:
+            using type = Count;
+        };
+
+        template<typename Count>
+        class weak_policy_of<Count, typename always_void<typename Count::weak_policy>::type>
+        {
+        public:
+            using type = typename Count::weak_policy;
+        };
+
+
+        template<typename Count>
+        class counted_block
+        {
+        public:
+            counted_block()
+                : m_use(1),
+                  m_weak(1)
+            {
+                Count::attach(m_use, this, &expire);
+            }
+
+            counted_block(counted_block const&) = delete;
+            counted_block& operator=(counted_block const&) = delete;
+
+            void add_ref()
+            {
+                Count::increment(m_use);
+            }
+
+            void add_ref(long n)
+            {
+                Count::increment(m_use, n);
+            }
+
+            bool add_ref_lock()
+            {
+                return Count::increment_if_nonzero(m_use);
+            }
+
+            void release()
+            {
+                if (Count::decrement(m_use))
+                {
+                    dispose();
+                    weak_release();
+                }
+            }
+
+            // drops n references at once
+            void release(long n)
+            {
+                if (Count::decrement(m_use, n))
+                {
+                    dispose();
+                    weak_release();
+                }
+            }
+
+            void weak_add_ref()
+            {
+                WeakCount::increment(m_weak);
+            }
+
+            void weak_release()
+            {
+                if (WeakCount::decrement(m_weak))
+                {
+                    destroy();
+                }
+            }
+
+            long use_count() const
+            {
+                return Count::load(m_use);
+            }
+
+            virtual void* get_deleter(std::type_info const&)
+            {
+                return nullptr;
+            }
+
+        protected:
+            virtual ~counted_block() = default;
+
+        private:
+            using WeakCount = typename weak_policy_of<Count>::type;
+
+            static void expire(void* block)
+            {
+                auto self = static_cast<counted_block*>(block);
+                self->dispose();
+                self->weak_release();
+            }
+
+            // destroys the managed object
+            virtual void dispose() = 0;
+
+            // releases the block itself
+            virtual void destroy() = 0;
+
+            typename Count::type m_use;
+            typename WeakCount::type m_weak;
+        };
+
+
+        // control block for an object allocated separately
+        template<typename Count, typename Y, typename Deleter, typename Alloc>
+        class pointer_block : public counted_block<Count>
+        {
+        public:
+            using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<pointer_block>;
+
+            pointer_block(Y* ptr, Deleter deleter, Alloc alloc)
+                : m_ptr(ptr),
+                  m_deleter(std::move(deleter)),
+                  m_alloc(std::move(alloc))
+            {
+            }
+
+            void* get_deleter(std::type_info const& type) override
+            {
+                return type == typeid(Deleter) ? std::addressof(m_deleter) : nullptr;
+            }
+
+        private:
+            void dispose() override
+            {
+                m_deleter(m_ptr);
+            }
+
+            void destroy() override
+            {
+                allocator_type alloc(m_alloc);
+                this->~pointer_block();
+                std::allocator_traits<allocator_type>::deallocate(alloc, this, 1);
+            }
+
+            Y* m_ptr;
+            Deleter m_deleter;
+            Alloc m_alloc;
+        };
+
+
+        // control block with the object embedded, as created by allocate_counted
+        template<typename Count, typename T, typename Alloc>
+        class inplace_block : public counted_block<Count>
+        {
+        public:
+            using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<inplace_block>;
+
+            template<typename... Args>
+            explicit inplace_block(Alloc alloc, Args&&... args)
+                : m_alloc(std::move(alloc))
+            {
+                value_allocator_type valueAlloc(m_alloc);
+                std::allocator_traits<value_allocator_type>::construct(valueAlloc,
+                                                                       value(),
+                                                                       std::forward<Args>(args)...);
+            }
+
+            T* get()
+            {
+                return value();
+            }
+
+        private:
+            using value_type = typename std::remove_cv<T>::type;
+            using value_allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<value_type>;
+
+            value_type* value()
+            {
+                return reinterpret_cast<value_type*>(&m_storage);
+            }
+
+            void dispose() override
+            {
+                value_allocator_type valueAlloc(m_alloc);
+                std::allocator_traits<value_allocator_type>::destroy(valueAlloc, value());
+            }
+
+            void destroy() override
+            {
+                allocator_type alloc(m_alloc);
+                this->~inplace_block();
+                std::allocator_traits<allocator_type>::deallocate(alloc, this, 1);
+            }
+
+            Alloc m_alloc;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type m_storage;
+        };
+
+
+        template<typename Count, typename Y, typename Deleter, typename Alloc>
+        counted_block<Count>* make_pointer_block(Y* ptr, Deleter deleter, Alloc alloc)
+        {
+            using block = pointer_block<Count, Y, Deleter, Alloc>;
+            using allocator_type = typename block::allocator_type;
+
+            allocator_type blockAlloc(alloc);
+            block* mem{};
+
+            try
+            {
+                mem = std::allocator_traits<allocator_type>::allocate(blockAlloc, 1);
+            }
+            catch (...)
+            {
+                deleter(ptr);
+                throw;
+            }
+
+            return ::new (static_cast<void*>(mem)) block(ptr, std::move(deleter), std::move(alloc));
+        }
+
+
+        // unique_ptr's holding a reference deleter are adopted by reference
+        template<typename Deleter>
+        using adopted_deleter = typename std::conditional<
+            std::is_reference<Deleter>::value,
+            std::reference_wrapper<typename std::remove_reference<Deleter>::type>,
+            Deleter>::type;
+
+
+        class counted_access
+        {
+        public:
+            template<typename T, typename Count>
+            static counted_ptr<T, Count> adopt(T* ptr, counted_block<Count>* block)
+            {
+                return counted_ptr<T, Count>{ptr, block};
+            }
+
+            template<typename T, typename Count>
+            static counted_block<Count>* block(counted_ptr<T, Count> const& ptr)
+            {
+                return ptr.m_block;
+            }
+
+            // empties ptr without releasing its reference, which is
+            // passed to the caller
+            template<typename T, typename Count>
+            static counted_block<Count>* detach(counted_ptr<T, Count>& ptr)
+            {
+                counted_block<Count>* block{ptr.m_block};
+                ptr.m_ptr = nullptr;
+                ptr.m_block = nullptr;
+                return block;
+            }
+        };
+    }
+
+
+    template<typename T, typename Count>
+    class counted_ptr
+    {
+    public:
+        using element_type = T;
+        using weak_type = counted_weak_ptr<T, Count>;
+
+        counted_ptr();
+        counted_ptr(std::nullptr_t);
+
+        // constructors from plain pointers
+        template<typename Y>
+        explicit counted_ptr(Y*);
+
+        template<typename Y, typename Deleter>
+        counted_ptr(Y*, Deleter);
+
+        template<typename Y, typename Deleter, typename Alloc>
+        counted_ptr(Y*, Deleter, Alloc);
+
+        // aliasing constructors
+        template<typename Y>
+        counted_ptr(counted_ptr<Y, Count> const&, T*);
+
+        template<typename Y>
+        counted_ptr(counted_ptr<Y, Count>&&, T*);
+
+        // constructors from other counted_ptr's
+        counted_ptr(counted_ptr const&);
+
+        template<typename Y,
+                 typename = typename std::enable_if<std::is_convertible<Y*, T*>::value>::type>
+        counted_ptr(counted_ptr<Y, Count> const&);
+
+        counted_ptr(counted_ptr&&) noexcept;
+
+        template<typename Y,
+                 typename = typename std::enable_if<std::is_convertible<Y*, T*>::value>::type>
+        counted_ptr(counted_ptr<Y, Count>&&) noexcept;
+
+        // constructor from counted_weak_ptr's, throws std::bad_weak_ptr if expired
+        template<typename Y>
+        explicit counted_ptr(counted_weak_ptr<Y, Count> const&);
+
+        // constructor from std::unique_ptr's
+        template<typename Y, typename Deleter>
+        counted_ptr(std::unique_ptr<Y, Deleter>&&);
+
+        ~counted_ptr();
+
+        counted_ptr& operator=(counted_ptr const&);
+        counted_ptr& operator=(counted_ptr&&) noexcept;
+
+        template<typename Y>
+        counted_ptr& operator=(counted_ptr<Y, Count> const&);
+
+        template<typename Y>
+        counted_ptr& operator=(counted_ptr<Y, Count>&&) noexcept;
+
+        template<typename Y, typename Deleter>
+        counted_ptr& operator=(std::unique_ptr<Y, Deleter>&&);
+
+        void reset();
+
+        template<typename Y>
+        void reset(Y*);
+
+        template<typename Y, typename Deleter>
+        void reset(Y*, Deleter);
+
+        template<typename Y, typename Deleter, typename Alloc>
+        void reset(Y*, Deleter, Alloc);
+
+        void swap(counted_ptr&) noexcept;
+
+        T* get() const;
+        typename std::add_lvalue_reference<T>::type operator*() const;
+        T* operator->() const;
+
+        long use_count() const;
+        bool unique() const;
+
+        explicit operator bool() const;
+
+        template<typename Y>
+        bool owner_before(counted_ptr<Y, Count> const&) const;
+
+        template<typename Y>
+        bool owner_before(counted_weak_ptr<Y, Count> const&) const;
+
+    private:
+        template<typename, typename>
+        friend class counted_ptr;
+
+        template<typename, typename>
+        friend class counted_weak_ptr;
+
+        friend class detail::counted_access;
+
+        counted_ptr(T*, detail::counted_block<Count>*);
+
+        T* m_ptr;
+        detail::counted_block<Count>* m_block;
+    };
+
+
+    template<typename T, typename Count>
+    class counted_weak_ptr
+    {
+    public:
+        using element_type = T;
+
+        counted_weak_ptr();
+
+        counted_weak_ptr(counted_weak_ptr const&);
+
+        template<typename Y,
+                 typename = typename std::enable_if<std::is_convertible<Y*, T*>::value>::type>
+        counted_weak_ptr(counted_weak_ptr<Y, Count> const&);
+
+        template<typename Y,
+                 typename = typename std::enable_if<std::is_convertible<Y*, T*>::value>::type>
+        counted_weak_ptr(counted_ptr<Y, Count> const&);
+
+        counted_weak_ptr(counted_weak_ptr&&) noexcept;
+
+        ~counted_weak_ptr();
+
+        counted_weak_ptr& operator=(counted_weak_ptr const&);
+        counted_weak_ptr& operator=(counted_weak_ptr&&) noexcept;
+
+        template<typename Y>
+        counted_weak_ptr& operator=(counted_ptr<Y, Count> const&);
+
+        void reset();
+        void swap(counted_weak_ptr&) noexcept;
+
+        long use_count() const;
+        bool expired() const;
+
+        counted_ptr<T, Count> lock() const;
+
+        template<typename Y>
+        bool owner_before(counted_ptr<Y, Count> const&) const;
+
+        template<typename Y>
+        bool owner_before(counted_weak_ptr<Y, Count> const&) const;
+
+    private:
+        template<typename, typename>
+        friend class counted_ptr;
+
+        template<typename, typename>
+        friend class counted_weak_ptr;
+
+        T* m_ptr;
+        detail::counted_block<Count>* m_block;
+    };
+
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::counted_ptr()
+        : m_ptr(nullptr),
+          m_block(nullptr)
+    {
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::counted_ptr(std::nullptr_t)
+        : counted_ptr()
+    {
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_ptr<T, Count>::counted_ptr(Y* ptr)
+        : counted_ptr(ptr, std::default_delete<Y>(), std::allocator<void>())
+    {
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename Deleter>
+    counted_ptr<T, Count>::counted_ptr(Y* ptr, Deleter deleter)
+        : counted_ptr(ptr, std::move(deleter), std::allocator<void>())
+    {
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename Deleter, typename Alloc>
+    counted_ptr<T, Count>::counted_ptr(Y* ptr, Deleter deleter, Alloc alloc)
+        : m_ptr(ptr),
+          m_block(detail::make_pointer_block<Count>(ptr, std::move(deleter), std::move(alloc)))
+    {
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_ptr<T, Count>::counted_ptr(counted_ptr<Y, Count> const& other, T* ptr)
+        : m_ptr(ptr),
+          m_block(other.m_block)
+    {
+        if (m_block)
+        {
+            m_block->add_ref();
+        }
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_ptr<T, Count>::counted_ptr(counted_ptr<Y, Count>&& other, T* ptr)
+        : m_ptr(ptr),
+          m_block(other.m_block)
+    {
+        other.m_ptr = nullptr;
+        other.m_block = nullptr;
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::counted_ptr(counted_ptr const& other)
+        : counted_ptr(other, other.m_ptr)
+    {
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename>
+    counted_ptr<T, Count>::counted_ptr(counted_ptr<Y, Count> const& other)
+        : counted_ptr(other, other.m_ptr)
+    {
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::counted_ptr(counted_ptr&& other) noexcept
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        other.m_ptr = nullptr;
+        other.m_block = nullptr;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename>
+    counted_ptr<T, Count>::counted_ptr(counted_ptr<Y, Count>&& other) noexcept
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        other.m_ptr = nullptr;
+        other.m_block = nullptr;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_ptr<T, Count>::counted_ptr(counted_weak_ptr<Y, Count> const& other)
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        if (!m_block || !m_block->add_ref_lock())
+        {
+            throw std::bad_weak_ptr();
+        }
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename Deleter>
+    counted_ptr<T, Count>::counted_ptr(std::unique_ptr<Y, Deleter>&& other)
+        : counted_ptr()
+    {
+        if (other)
+        {
+            using deleter_type = detail::adopted_deleter<Deleter>;
+
+            m_ptr = other.get();
+            m_block = detail::make_pointer_block<Count>(other.release(),
+                                                        deleter_type(std::forward<Deleter>(other.get_deleter())),
+                                                        std::allocator<void>());
+        }
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::counted_ptr(T* ptr, detail::counted_block<Count>* block)
+        : m_ptr(ptr),
+          m_block(block)
+    {
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::~counted_ptr()
+    {
+        if (m_block)
+        {
+            m_block->release();
+        }
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>&
+    counted_ptr<T, Count>::operator=(counted_ptr const& other)
+    {
+        counted_ptr(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>&
+    counted_ptr<T, Count>::operator=(counted_ptr&& other) noexcept
+    {
+        counted_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_ptr<T, Count>&
+    counted_ptr<T, Count>::operator=(counted_ptr<Y, Count> const& other)
+    {
+        counted_ptr(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_ptr<T, Count>&
+    counted_ptr<T, Count>::operator=(counted_ptr<Y, Count>&& other) noexcept
+    {
+        counted_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename Deleter>
+    counted_ptr<T, Count>&
+    counted_ptr<T, Count>::operator=(std::unique_ptr<Y, Deleter>&& other)
+    {
+        counted_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    void
+    counted_ptr<T, Count>::reset()
+    {
+        counted_ptr().swap(*this);
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    void
+    counted_ptr<T, Count>::reset(Y* ptr)
+    {
+        counted_ptr(ptr).swap(*this);
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename Deleter>
+    void
+    counted_ptr<T, Count>::reset(Y* ptr, Deleter deleter)
+    {
+        counted_ptr(ptr, std::move(deleter)).swap(*this);
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename Deleter, typename Alloc>
+    void
+    counted_ptr<T, Count>::reset(Y* ptr, Deleter deleter, Alloc alloc)
+    {
+        counted_ptr(ptr, std::move(deleter), std::move(alloc)).swap(*this);
+    }
+
+    template<typename T, typename Count>
+    void
+    counted_ptr<T, Count>::swap(counted_ptr& other) noexcept
+    {
+        std::swap(m_ptr, other.m_ptr);
+        std::swap(m_block, other.m_block);
+    }
+
+    template<typename T, typename Count>
+    T*
+    counted_ptr<T, Count>::get() const
+    {
+        return m_ptr;
+    }
+
+    template<typename T, typename Count>
+    typename std::add_lvalue_reference<T>::type
+    counted_ptr<T, Count>::operator*() const
+    {
+        return *m_ptr;
+    }
+
+    template<typename T, typename Count>
+    T*
+    counted_ptr<T, Count>::operator->() const
+    {
+        return m_ptr;
+    }
+
+    template<typename T, typename Count>
+    long
+    counted_ptr<T, Count>::use_count() const
+    {
+        return m_block ? m_block->use_count() : 0;
+    }
+
+    template<typename T, typename Count>
+    bool
+    counted_ptr<T, Count>::unique() const
+    {
+        return use_count() == 1;
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>::operator bool() const
+    {
+        return m_ptr != nullptr;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    bool
+    counted_ptr<T, Count>::owner_before(counted_ptr<Y, Count> const& other) const
+    {
+        return std::less<detail::counted_block<Count>*>()(m_block, other.m_block);
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    bool
+    counted_ptr<T, Count>::owner_before(counted_weak_ptr<Y, Count> const& other) const
+    {
+        return std::less<detail::counted_block<Count>*>()(m_block, other.m_block);
+    }
+
+
+    template<typename T, typename Count>
+    counted_weak_ptr<T, Count>::counted_weak_ptr()
+        : m_ptr(nullptr),
+          m_block(nullptr)
+    {
+    }
+
+    template<typename T, typename Count>
+    counted_weak_ptr<T, Count>::counted_weak_ptr(counted_weak_ptr const& other)
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        if (m_block)
+        {
+            m_block->weak_add_ref();
+        }
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename>
+    counted_weak_ptr<T, Count>::counted_weak_ptr(counted_weak_ptr<Y, Count> const& other)
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        if (m_block)
+        {
+            m_block->weak_add_ref();
+        }
+    }
+
+    template<typename T, typename Count>
+    template<typename Y, typename>
+    counted_weak_ptr<T, Count>::counted_weak_ptr(counted_ptr<Y, Count> const& other)
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        if (m_block)
+        {
+            m_block->weak_add_ref();
+        }
+    }
+
+    template<typename T, typename Count>
+    counted_weak_ptr<T, Count>::counted_weak_ptr(counted_weak_ptr&& other) noexcept
+        : m_ptr(other.m_ptr),
+          m_block(other.m_block)
+    {
+        other.m_ptr = nullptr;
+        other.m_block = nullptr;
+    }
+
+    template<typename T, typename Count>
+    counted_weak_ptr<T, Count>::~counted_weak_ptr()
+    {
+        if (m_block)
+        {
+            m_block->weak_release();
+        }
+    }
+
+    template<typename T, typename Count>
+    counted_weak_ptr<T, Count>&
+    counted_weak_ptr<T, Count>::operator=(counted_weak_ptr const& other)
+    {
+        counted_weak_ptr(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    counted_weak_ptr<T, Count>&
+    counted_weak_ptr<T, Count>::operator=(counted_weak_ptr&& other) noexcept
+    {
+        counted_weak_ptr(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    counted_weak_ptr<T, Count>&
+    counted_weak_ptr<T, Count>::operator=(counted_ptr<Y, Count> const& other)
+    {
+        counted_weak_ptr(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Count>
+    void
+    counted_weak_ptr<T, Count>::reset()
+    {
+        counted_weak_ptr().swap(*this);
+    }
+
+    template<typename T, typename Count>
+    void
+    counted_weak_ptr<T, Count>::swap(counted_weak_ptr& other) noexcept
+    {
+        std::swap(m_ptr, other.m_ptr);
+        std::swap(m_block, other.m_block);
+    }
+
+    template<typename T, typename Count>
+    long
+    counted_weak_ptr<T, Count>::use_count() const
+    {
+        return m_block ? m_block->use_count() : 0;
+    }
+
+    template<typename T, typename Count>
+    bool
+    counted_weak_ptr<T, Count>::expired() const
+    {
+        return use_count() == 0;
+    }
+
+    template<typename T, typename Count>
+    counted_ptr<T, Count>
+    counted_weak_ptr<T, Count>::lock() const
+    {
+        if (m_block && m_block->add_ref_lock())
+        {
+            return counted_ptr<T, Count>{m_ptr, m_block};
+        }
+
+        return counted_ptr<T, Count>{};
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    bool
+    counted_weak_ptr<T, Count>::owner_before(counted_ptr<Y, Count> const& other) const
+    {
+        return std::less<detail::counted_block<Count>*>()(m_block, other.m_block);
+    }
+
+    template<typename T, typename Count>
+    template<typename Y>
+    bool
+    counted_weak_ptr<T, Count>::owner_before(counted_weak_ptr<Y, Count> const& other) const
+    {
+        return std::less<detail::counted_block<Count>*>()(m_block, other.m_block);
+    }
+
+
+    // compare two counted_ptr's
+    template<typename T, typename U, typename Count>
+    bool operator==(counted_ptr<T, Count> const& lhs, counted_ptr<U, Count> const& rhs)
+    {
+        return lhs.get() == rhs.get();
+    }
+
+    template<typename T, typename U, typename Count>
+    bool operator!=(counted_ptr<T, Count> const& lhs, counted_ptr<U, Count> const& rhs)
+    {
+        return lhs.get() != rhs.get();
+    }
+
+    template<typename T, typename U, typename Count>
+    bool operator<(counted_ptr<T, Count> const& lhs, counted_ptr<U, Count> const& rhs)
+    {
+        using pointer = typename std::common_type<T*, U*>::type;
+        return std::less<pointer>()(lhs.get(), rhs.get());
+    }
+
+    template<typename T, typename U, typename Count>
+    bool operator>(counted_ptr<T, Count> const& lhs, counted_ptr<U, Count> const& rhs)
+    {
+        return rhs < lhs;
+    }
+
+    template<typename T, typename U, typename Count>
+    bool operator<=(counted_ptr<T, Count> const& lhs, counted_ptr<U, Count> const& rhs)
+    {
+        return !(rhs < lhs);
+    }
+
+    template<typename T, typename U, typename Count>
+    bool operator>=(counted_ptr<T, Count> const& lhs, counted_ptr<U, Count> const& rhs)
+    {
+        return !(lhs < rhs);
+    }
+
+    // compare counted_ptr with nullptr
+    template<typename T, typename Count>
+    bool operator==(counted_ptr<T, Count> const& lhs, std::nullptr_t)
+    {
+        return !lhs;
+    }
+
+    template<typename T, typename Count>
+    bool operator==(std::nullptr_t, counted_ptr<T, Count> const& rhs)
+    {
+        return !rhs;
+    }
+
+    template<typename T, typename Count>
+    bool operator!=(counted_ptr<T, Count> const& lhs, std::nullptr_t)
+    {
+        return static_cast<bool>(lhs);
+    }
+
+    template<typename T, typename Count>
+    bool operator!=(std::nullptr_t, counted_ptr<T, Count> const& rhs)
+    {
+        return static_cast<bool>(rhs);
+    }
+
+    template<typename T, typename U, typename V, typename Count>
+    std::basic_ostream<U, V>& operator<< (std::basic_ostream<U, V>& out, counted_ptr<T, Count> const& obj)
+    {
+        out << obj.get();
+        return out;
+    }
+
+    template<typename T, typename Count>
+    void
+    swap(counted_ptr<T, Count>& foo, counted_ptr<T, Count>& bar)
+    {
+        foo.swap(bar);
+    }
+
+    template<typename T, typename Count>
+    void
+    swap(counted_weak_ptr<T, Count>& foo, counted_weak_ptr<T, Count>& bar)
+    {
+        foo.swap(bar);
+    }
+
+    template<typename Deleter, typename T, typename Count>
+    Deleter* get_deleter(counted_ptr<T, Count> const& ptr)
+    {
+        auto block = detail::counted_access::block(ptr);
+        return block ? static_cast<Deleter*>(block->get_deleter(typeid(Deleter))) : nullptr;
+    }
+
+    template<typename Target, typename Source, typename Count>
+    counted_ptr<Target, Count> static_pointer_cast(counted_ptr<Source, Count> const& obj)
+    {
+        return counted_ptr<Target, Count>{obj, static_cast<Target*>(obj.get())};
+    }
+
+    template<typename Target, typename Source, typename Count>
+    counted_ptr<Target, Count> const_pointer_cast(counted_ptr<Source, Count> const& obj)
+    {
+        return counted_ptr<Target, Count>{obj, const_cast<Target*>(obj.get())};
+    }
+
+    template<typename Target, typename Source, typename Count>
+    counted_ptr<Target, Count> dynamic_pointer_cast(counted_ptr<Source, Count> const& obj)
+    {
+        if (auto ptr = dynamic_cast<Target*>(obj.get()))
+        {
+            return counted_ptr<Target, Count>{obj, ptr};
+        }
+
+        return counted_ptr<Target, Count>{};
+    }
+
+    // casts taking over the ownership of obj
+    template<typename Target, typename Source, typename Count>
+    counted_ptr<Target, Count> static_pointer_cast(counted_ptr<Source, Count>&& obj)
+    {
+        auto ptr = static_cast<Target*>(obj.get());
+        return counted_ptr<Target, Count>{std::move(obj), ptr};
+    }
+
+    template<typename Target, typename Source, typename Count>
+    counted_ptr<Target, Count> const_pointer_cast(counted_ptr<Source, Count>&& obj)
+    {
+        auto ptr = const_cast<Target*>(obj.get());
+        return counted_ptr<Target, Count>{std::move(obj), ptr};
+    }
+
+    // obj is left untouched if the cast fails
+    template<typename Target, typename Source, typename Count>
+    counted_ptr<Target, Count> dynamic_pointer_cast(counted_ptr<Source, Count>&& obj)
+    {
+        if (auto ptr = dynamic_cast<Target*>(obj.get()))
+        {
+            return counted_ptr<Target, Count>{std::move(obj), ptr};
+        }
+
+        return counted_ptr<Target, Count>{};
+    }
+
+
+    template<typename T, typename Count, typename Alloc, typename... Args>
+    counted_ptr<T, Count>
+    allocate_counted(Alloc const& alloc, Args&&... args)
+    {
+        using block = detail::inplace_block<Count, T, Alloc>;
+        using allocator_type = typename block::allocator_type;
+
+        allocator_type blockAlloc(alloc);
+        block* mem{std::allocator_traits<allocator_type>::allocate(blockAlloc, 1)};
+
+        try
+        {
+            ::new (static_cast<void*>(mem)) block(alloc, std::forward<Args>(args)...);
+        }
+        catch (...)
+        {
+            std::allocator_traits<allocator_type>::deallocate(blockAlloc, mem, 1);
+            throw;
+        }
+
+        return detail::counted_access::adopt<T, Count>(mem->get(), mem);
+    }
+
+    template<typename T, typename Count, typename... Args>
+    counted_ptr<T, Count>
+    make_counted(Args&&... args)
+    {
+        return allocate_counted<T, Count>(std::allocator<void>(), std::forward<Args>(args)...);
+    }
+}
+
+#endif
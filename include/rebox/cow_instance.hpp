@@ -0,0 +1,164 @@
+// cow_instance.hpp -- a copy-on-write value held by a shared_instance
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_COW_INSTANCE_HPP
+#define REBOX_COW_INSTANCE_HPP
+
+#include "optional_instance.hpp"
+#include "shared_instance.hpp"
+
+#include <utility>
+
+namespace rebox
+{
+    // A value of type T whose copies share one object until one of them
+    // is modified through mutate(), which copies the object first unless
+    // this instance holds it alone.
+    //
+    // Whether it does is taken from use_count(), which is sound because
+    // the shared_instance never leaves the cow_instance: no other
+    // shared_instance or weak_ptr can take a reference behind its back.
+    // A count of one can thus only rise through this very instance, and
+    // copying an instance while it is mutated is a data race anyway, as
+    // for any other value. The count dropping to one is a release of
+    // the other instance, which the acquire fence pairs with, so that
+    // the writes of mutate() happen after its last reads. (Thread
+    // sanitizers which do not model fences may report a race there.)
+    template<typename T>
+    class cow_instance
+    {
+    public:
+        using type = T;
+
+        cow_instance() = delete;
+
+        explicit cow_instance(T const& value);
+        explicit cow_instance(T&& value);
+
+        cow_instance(cow_instance const&) = default;
+        cow_instance(cow_instance&&) = default;
+
+        cow_instance& operator=(cow_instance const&) = default;
+        cow_instance& operator=(cow_instance&&) = default;
+
+        operator T const&() const;
+        T const& get() const;
+
+        // The object for modification, copied first if shared. The
+        // reference must not be used once this instance is copied, as
+        // the object is shared then.
+        T& mutate();
+
+        // whether mutate() would modify the object in place
+        bool unique() const;
+        long use_count() const;
+
+        void swap(cow_instance&);
+
+    private:
+        template<typename Y, typename... Args>
+        friend cow_instance<Y> make_cow_instance(Args&&...);
+
+        explicit cow_instance(shared_instance<T>&& obj);
+
+        shared_instance<T> m_obj;
+    };
+
+    template<typename T>
+    cow_instance<T>::cow_instance(T const& value)
+        : m_obj(make_shared_instance<T>(value))
+    {
+    }
+
+    template<typename T>
+    cow_instance<T>::cow_instance(T&& value)
+        : m_obj(make_shared_instance<T>(std::move(value)))
+    {
+    }
+
+    template<typename T>
+    cow_instance<T>::cow_instance(shared_instance<T>&& obj)
+        : m_obj(std::move(obj))
+    {
+    }
+
+    template<typename T>
+    cow_instance<T>::operator T const&() const
+    {
+        return m_obj.get();
+    }
+
+    template<typename T>
+    T const&
+    cow_instance<T>::get() const
+    {
+        return m_obj.get();
+    }
+
+    template<typename T>
+    T&
+    cow_instance<T>::mutate()
+    {
+        if (!detail::held_alone(m_obj))
+        {
+            m_obj = make_shared_instance<T>(get());
+        }
+
+        return m_obj.get();
+    }
+
+    template<typename T>
+    bool
+    cow_instance<T>::unique() const
+    {
+        return m_obj.use_count() == 1;
+    }
+
+    template<typename T>
+    long
+    cow_instance<T>::use_count() const
+    {
+        return m_obj.use_count();
+    }
+
+    template<typename T>
+    void
+    cow_instance<T>::swap(cow_instance& other)
+    {
+        m_obj.swap(other.m_obj);
+    }
+
+    // compare the values, which are equal for instances sharing an object
+    template<typename T>
+    bool operator==(cow_instance<T> const& lhs, cow_instance<T> const& rhs)
+    {
+        return &lhs.get() == &rhs.get() || lhs.get() == rhs.get();
+    }
+
+    template<typename T>
+    bool operator!=(cow_instance<T> const& lhs, cow_instance<T> const& rhs)
+    {
+        return !(lhs == rhs);
+    }
+
+    template<typename T>
+    void
+    swap(cow_instance<T>& foo, cow_instance<T>& bar)
+    {
+        foo.swap(bar);
+    }
+
+
+    template<typename T, typename... Args>
+    cow_instance<T>
+    make_cow_instance(Args&&... args)
+    {
+        return cow_instance<T>{make_shared_instance<T>(std::forward<Args>(args)...)};
+    }
+}
+
+#endif
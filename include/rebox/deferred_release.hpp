@@ -0,0 +1,277 @@
+// deferred_release.hpp -- releasing instances on a background thread
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_DEFERRED_RELEASE_HPP
+#define REBOX_DEFERRED_RELEASE_HPP
+
+#include "shared_instance.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rebox
+{
+    class reclaimer_statistics
+    {
+    public:
+        // objects handed to the reclamation thread
+        std::size_t deferred;
+
+        // objects destroyed by the releasing thread as the queue was full
+        std::size_t inlined;
+
+        // objects queued but not destroyed yet
+        std::size_t pending;
+    };
+
+    // Destroys objects on a thread of its own. The queue has a fixed
+    // capacity; objects released while it is full are destroyed right
+    // away by the releasing thread.
+    class reclaimer
+    {
+    public:
+        static constexpr std::size_t default_capacity = 1024;
+
+        // the reclaimer used by deferred_delete unless told otherwise
+        static reclaimer& instance();
+
+        explicit reclaimer(std::size_t capacity = default_capacity);
+
+        reclaimer(reclaimer const&) = delete;
+        reclaimer& operator=(reclaimer const&) = delete;
+
+        // destroys everything still queued before returning
+        ~reclaimer();
+
+        // calls destroy(ptr) on the reclamation thread, or inline if
+        // the queue is full
+        void release(void* ptr, void (*destroy)(void*));
+
+        // waits until everything released so far has been destroyed;
+        // returns at once when called from the reclamation thread
+        void drain();
+
+        reclaimer_statistics statistics() const;
+
+        std::size_t capacity() const
+        {
+            return m_queue.size();
+        }
+
+    private:
+        class entry
+        {
+        public:
+            void* ptr;
+            void (*destroy)(void*);
+        };
+
+        void run();
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_idle;
+
+        // ring buffer of m_size entries starting at m_head
+        std::vector<entry> m_queue;
+        std::size_t m_head;
+        std::size_t m_size;
+
+        bool m_busy;
+        bool m_stopping;
+
+        std::atomic<std::size_t> m_deferred;
+        std::atomic<std::size_t> m_inlined;
+
+        std::thread m_thread;
+    };
+
+    inline reclaimer& reclaimer::instance()
+    {
+        static reclaimer global;
+        return global;
+    }
+
+    inline reclaimer::reclaimer(std::size_t capacity)
+        : m_queue(capacity > 0 ? capacity : 1),
+          m_head(0),
+          m_size(0),
+          m_busy(false),
+          m_stopping(false),
+          m_deferred(0),
+          m_inlined(0)
+    {
+        m_thread = std::thread([this] { run(); });
+    }
+
+    inline reclaimer::~reclaimer()
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_stopping = true;
+        }
+
+        m_wake.notify_one();
+        m_thread.join();
+    }
+
+    inline void reclaimer::release(void* ptr, void (*destroy)(void*))
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+
+            if (m_size < m_queue.size() && !m_stopping)
+            {
+                m_queue[(m_head + m_size) % m_queue.size()] = entry{ptr, destroy};
+                ++m_size;
+                m_deferred.fetch_add(1, std::memory_order_relaxed);
+                destroy = nullptr;
+            }
+        }
+
+        if (destroy)
+        {
+            m_inlined.fetch_add(1, std::memory_order_relaxed);
+            destroy(ptr);
+        }
+        else
+        {
+            m_wake.notify_one();
+        }
+    }
+
+    inline void reclaimer::drain()
+    {
+        if (std::this_thread::get_id() == m_thread.get_id())
+        {
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_idle.wait(lock, [this] { return m_size == 0 && !m_busy; });
+    }
+
+    inline reclaimer_statistics reclaimer::statistics() const
+    {
+        std::size_t pending;
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            pending = m_size;
+        }
+
+        return reclaimer_statistics{m_deferred.load(std::memory_order_relaxed),
+                                    m_inlined.load(std::memory_order_relaxed),
+                                    pending};
+    }
+
+    // destroys one entry at a time, so objects released while the
+    // thread is busy find room in the queue again soon
+    inline void reclaimer::run()
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+
+        for (;;)
+        {
+            m_wake.wait(lock, [this] { return m_size != 0 || m_stopping; });
+
+            if (m_size == 0)
+            {
+                return;
+            }
+
+            entry next{m_queue[m_head]};
+            m_head = (m_head + 1) % m_queue.size();
+            --m_size;
+            m_busy = true;
+
+            lock.unlock();
+            next.destroy(next.ptr);
+            lock.lock();
+
+            m_busy = false;
+
+            if (m_size == 0)
+            {
+                m_idle.notify_all();
+            }
+        }
+    }
+
+
+    // Deleter handing the object to a reclaimer instead of deleting it
+    // on the thread dropping the last reference. Only the object is
+    // deferred; the control block of the shared_ptr is freed inline.
+    template<typename T>
+    class deferred_delete
+    {
+    public:
+        deferred_delete()
+            : m_reclaimer(&reclaimer::instance())
+        {
+        }
+
+        explicit deferred_delete(reclaimer& target)
+            : m_reclaimer(&target)
+        {
+        }
+
+        template<typename Y>
+        deferred_delete(deferred_delete<Y> const& other)
+            : m_reclaimer(other.target())
+        {
+        }
+
+        void operator()(T* ptr) const
+        {
+            m_reclaimer->release(const_cast<void*>(static_cast<void const volatile*>(ptr)), &destroy);
+        }
+
+        reclaimer* target() const
+        {
+            return m_reclaimer;
+        }
+
+    private:
+        static void destroy(void* ptr)
+        {
+            delete static_cast<T*>(ptr);
+        }
+
+        reclaimer* m_reclaimer;
+    };
+
+
+    // creates an instance whose object is destroyed by target once the
+    // last reference is gone
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename... Args>
+    shared_instance<T, Report>
+    make_deferred_shared_instance(reclaimer& target, Args&&... args)
+    {
+        using instance = shared_instance<T, Report>;
+        return detail::instance_access::adopt<instance>(
+            std::shared_ptr<T>(new T(std::forward<Args>(args)...), deferred_delete<T>(target)));
+    }
+
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename... Args>
+    shared_instance<T, Report>
+    make_deferred_shared_instance(Args&&... args)
+    {
+        return make_deferred_shared_instance<T, Report>(reclaimer::instance(), std::forward<Args>(args)...);
+    }
+}
+
+#endif
@@ -0,0 +1,370 @@
+// epoch_instance.hpp -- a shared_instance slot read without reference counting
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_EPOCH_INSTANCE_HPP
+#define REBOX_EPOCH_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace rebox
+{
+    namespace detail
+    {
+        // announcement of a thread which may be reading protected data
+        class epoch_record
+        {
+        public:
+            epoch_record()
+                : epoch(0),
+                  used(true),
+                  nesting(0),
+                  next(nullptr)
+            {
+            }
+
+            // the global epoch observed when entering, 0 when not reading
+            std::atomic<std::uint64_t> epoch;
+            std::atomic<bool> used;
+
+            // only touched by the owning thread
+            unsigned nesting;
+
+            epoch_record* next;
+
+            // keeps the epochs of different threads on different cache lines
+            char padding[64];
+        };
+    }
+
+    // Process-wide epoch-based reclamation. Readers announce the epoch
+    // they entered in, objects retired by writers are released once
+    // every thread has left the epoch they were retired in.
+    class epoch_domain
+    {
+    public:
+        static epoch_domain& instance();
+
+        epoch_domain(epoch_domain const&) = delete;
+        epoch_domain& operator=(epoch_domain const&) = delete;
+
+        // releases ptr through deleter once no reader can access it
+        void retire(void* ptr, void (*deleter)(void*));
+
+        // advances the epoch if possible and releases what has become
+        // unreachable; never blocks on readers
+        void collect();
+
+        // number of retired objects not yet released
+        std::size_t pending() const;
+
+        detail::epoch_record* local_record();
+
+        std::uint64_t epoch() const
+        {
+            return m_epoch.load(std::memory_order_seq_cst);
+        }
+
+    private:
+        class retired
+        {
+        public:
+            std::uint64_t epoch;
+            void* ptr;
+            void (*deleter)(void*);
+        };
+
+        class record_holder
+        {
+        public:
+            explicit record_holder(epoch_domain& domain)
+                : record(domain.acquire_record())
+            {
+            }
+
+            ~record_holder()
+            {
+                record->epoch.store(0, std::memory_order_release);
+                record->used.store(false, std::memory_order_release);
+            }
+
+            detail::epoch_record* record;
+        };
+
+        epoch_domain()
+            : m_epoch(1),
+              m_records(nullptr)
+        {
+        }
+
+        ~epoch_domain();
+
+        detail::epoch_record* acquire_record();
+        bool try_advance(std::uint64_t epoch);
+
+        std::atomic<std::uint64_t> m_epoch;
+        std::atomic<detail::epoch_record*> m_records;
+
+        mutable std::mutex m_mutex;
+        std::vector<retired> m_retired;
+    };
+
+    inline epoch_domain& epoch_domain::instance()
+    {
+        static epoch_domain domain;
+        return domain;
+    }
+
+    inline epoch_domain::~epoch_domain()
+    {
+        // no reader is left at exit
+        for (auto& entry : m_retired)
+        {
+            entry.deleter(entry.ptr);
+        }
+
+        detail::epoch_record* record{m_records.load()};
+        while (record)
+        {
+            detail::epoch_record* next{record->next};
+            delete record;
+            record = next;
+        }
+    }
+
+    inline detail::epoch_record* epoch_domain::local_record()
+    {
+        static thread_local record_holder holder{*this};
+        return holder.record;
+    }
+
+    inline detail::epoch_record* epoch_domain::acquire_record()
+    {
+        // reuse the record of a thread which has exited
+        for (detail::epoch_record* record = m_records.load(std::memory_order_acquire); record; record = record->next)
+        {
+            bool used{false};
+
+            if (!record->used.load(std::memory_order_relaxed)
+                && record->used.compare_exchange_strong(used, true, std::memory_order_acquire))
+            {
+                return record;
+            }
+        }
+
+        auto record = new detail::epoch_record;
+        record->next = m_records.load(std::memory_order_relaxed);
+
+        while (!m_records.compare_exchange_weak(record->next, record,
+                                                std::memory_order_release,
+                                                std::memory_order_relaxed))
+        {
+        }
+
+        return record;
+    }
+
+    inline bool epoch_domain::try_advance(std::uint64_t epoch)
+    {
+        for (detail::epoch_record* record = m_records.load(std::memory_order_acquire); record; record = record->next)
+        {
+            std::uint64_t announced{record->epoch.load(std::memory_order_seq_cst)};
+
+            if (announced != 0 && announced != epoch)
+            {
+                return false;
+            }
+        }
+
+        return m_epoch.compare_exchange_strong(epoch, epoch + 1, std::memory_order_seq_cst);
+    }
+
+    inline void epoch_domain::retire(void* ptr, void (*deleter)(void*))
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_retired.push_back(retired{m_epoch.load(std::memory_order_seq_cst), ptr, deleter});
+        }
+
+        collect();
+    }
+
+    inline void epoch_domain::collect()
+    {
+        std::vector<retired> released;
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+
+            if (m_retired.empty())
+            {
+                return;
+            }
+
+            std::uint64_t epoch{m_epoch.load(std::memory_order_seq_cst)};
+            if (try_advance(epoch))
+            {
+                ++epoch;
+            }
+
+            // readers of an object retired in epoch e have all left
+            // once the epoch reached e + 2
+            auto keep = m_retired.begin();
+            for (auto& entry : m_retired)
+            {
+                if (entry.epoch + 2 <= epoch)
+                {
+                    released.push_back(entry);
+                }
+                else
+                {
+                    *keep++ = entry;
+                }
+            }
+
+            m_retired.erase(keep, m_retired.end());
+        }
+
+        for (auto& entry : released)
+        {
+            entry.deleter(entry.ptr);
+        }
+    }
+
+    inline std::size_t epoch_domain::pending() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_retired.size();
+    }
+
+
+    // Protects everything read through epoch_instance::get for its
+    // lifetime. Guards may be nested; they must not be kept for long,
+    // as they hold back the release of all retired instances.
+    class epoch_guard
+    {
+    public:
+        epoch_guard()
+            : m_record(epoch_domain::instance().local_record())
+        {
+            if (m_record->nesting++ == 0)
+            {
+                m_record->epoch.store(epoch_domain::instance().epoch(), std::memory_order_seq_cst);
+            }
+        }
+
+        epoch_guard(epoch_guard const&) = delete;
+        epoch_guard& operator=(epoch_guard const&) = delete;
+
+        ~epoch_guard()
+        {
+            if (--m_record->nesting == 0)
+            {
+                m_record->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+    private:
+        detail::epoch_record* m_record;
+    };
+
+
+    // A slot holding a shared_instance, whose object can be read under an
+    // epoch_guard without touching the reference count. Replaced
+    // instances are released through the epoch_domain as soon as no
+    // guard can refer to them any more.
+    template<typename T, typename Report = throw_invalid_argument>
+    class epoch_instance
+    {
+    public:
+        using value_type = shared_instance<T, Report>;
+
+        explicit epoch_instance(value_type);
+
+        epoch_instance(epoch_instance const&) = delete;
+        epoch_instance& operator=(epoch_instance const&) = delete;
+
+        ~epoch_instance();
+
+        // the object stays valid at least as long as guard
+        T& get(epoch_guard const& guard) const;
+
+        // a new reference, for readers who need to keep the object
+        value_type load() const;
+
+        void store(value_type);
+
+    private:
+        class node
+        {
+        public:
+            explicit node(value_type&& value)
+                : value(std::move(value))
+            {
+            }
+
+            value_type value;
+        };
+
+        static void release(void*);
+
+        std::atomic<node*> m_node;
+    };
+
+    template<typename T, typename Report>
+    epoch_instance<T, Report>::epoch_instance(value_type value)
+        : m_node(new node(std::move(value)))
+    {
+        // the domain is created first, so that it is destroyed after
+        // static instances, whose destructor retires into it
+        epoch_domain::instance();
+    }
+
+    template<typename T, typename Report>
+    epoch_instance<T, Report>::~epoch_instance()
+    {
+        epoch_domain::instance().retire(m_node.load(std::memory_order_relaxed), &release);
+    }
+
+    template<typename T, typename Report>
+    T&
+    epoch_instance<T, Report>::get(epoch_guard const&) const
+    {
+        return m_node.load(std::memory_order_seq_cst)->value.get();
+    }
+
+    template<typename T, typename Report>
+    typename epoch_instance<T, Report>::value_type
+    epoch_instance<T, Report>::load() const
+    {
+        epoch_guard guard;
+        return m_node.load(std::memory_order_seq_cst)->value;
+    }
+
+    template<typename T, typename Report>
+    void
+    epoch_instance<T, Report>::store(value_type value)
+    {
+        node* previous{m_node.exchange(new node(std::move(value)), std::memory_order_seq_cst)};
+        epoch_domain::instance().retire(previous, &release);
+    }
+
+    template<typename T, typename Report>
+    void
+    epoch_instance<T, Report>::release(void* ptr)
+    {
+        delete static_cast<node*>(ptr);
+    }
+}
+
+#endif
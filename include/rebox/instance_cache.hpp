@@ -0,0 +1,510 @@
+// instance_cache.hpp -- a concurrent cache interning shared_instance's by key
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_INSTANCE_CACHE_HPP
+#define REBOX_INSTANCE_CACHE_HPP
+
+#include "shared_instance.hpp"
+#include "epoch_instance.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace rebox
+{
+    class instance_cache_statistics
+    {
+    public:
+        // lookups finding a live object
+        std::size_t hits;
+
+        // lookups creating the object
+        std::size_t misses;
+
+        // entries dropped after their object was destroyed
+        std::size_t evictions;
+    };
+
+    // Hands out the live object of a key or creates it, so equal keys
+    // share a single object as long as anyone holds it. The cache only
+    // keeps weak references.
+    //
+    // Keys are spread over shards, each a hash table whose buckets hold
+    // chains of immutable entries, read under an epoch_guard, so hits
+    // neither lock nor touch any count but that of the object found.
+    // Misses lock their shard and prepend an entry to the bucket, after
+    // copying the bucket if it holds entries whose objects are gone; only
+    // when the table grows are all its entries copied, so a miss costs
+    // O(1) amortized. Replaced chains and tables are retired through the
+    // epoch_domain. As creating the object happens under the lock, each
+    // key is created once at a time. Objects created by make_shared keep
+    // their memory until their entry is dropped; the default creation
+    // allocates them apart from the count.
+    template<typename Key,
+             typename T,
+             typename Hash = std::hash<Key>,
+             typename Equal = std::equal_to<Key>>
+    class instance_cache
+    {
+    public:
+        using key_type = Key;
+        using value_type = shared_instance<T>;
+
+        // shards defaults to the number of hardware threads
+        explicit instance_cache(std::size_t shards = 0);
+
+        instance_cache(instance_cache const&) = delete;
+        instance_cache& operator=(instance_cache const&) = delete;
+
+        // the object of key; creates it by make(key), which yields a
+        // shared_instance<T>, if there is none; make must not use the
+        // cache itself
+        template<typename Factory>
+        value_type get(Key const& key, Factory make);
+
+        // the object of key; creates it as T(key) if there is none
+        value_type get(Key const& key);
+
+        // the object of key if it is alive, null otherwise
+        std::shared_ptr<T> find(Key const& key) const;
+
+        // drops the entries of all objects destroyed meanwhile
+        void purge();
+
+        // entries held, including those not purged yet
+        std::size_t size() const;
+
+        instance_cache_statistics statistics() const;
+
+    private:
+        class entry
+        {
+        public:
+            entry(Key const& key, std::weak_ptr<T> obj, std::uint64_t hash, entry* next)
+                : key(key),
+                  obj(std::move(obj)),
+                  hash(hash),
+                  next(next)
+            {
+            }
+
+            Key const key;
+            std::weak_ptr<T> const obj;
+            std::uint64_t const hash;
+            entry* const next;
+        };
+
+        // buckets selected by the upper bits of the hash; the table owns
+        // the chains of its buckets
+        class table
+        {
+        public:
+            explicit table(unsigned bits)
+                : bits(bits),
+                  buckets(new std::atomic<entry*>[std::size_t{1} << bits])
+            {
+                for (std::size_t i = 0; i < bucket_count(); ++i)
+                {
+                    buckets[i].store(nullptr, std::memory_order_relaxed);
+                }
+            }
+
+            table(table const&) = delete;
+            table& operator=(table const&) = delete;
+
+            ~table()
+            {
+                for (std::size_t i = 0; i < bucket_count(); ++i)
+                {
+                    delete_chain(buckets[i].load(std::memory_order_relaxed));
+                }
+            }
+
+            std::size_t bucket_count() const
+            {
+                return std::size_t{1} << bits;
+            }
+
+            std::atomic<entry*>& bucket(std::uint64_t hash) const
+            {
+                return buckets[static_cast<std::size_t>(hash >> (64 - bits))];
+            }
+
+            unsigned const bits;
+            std::unique_ptr<std::atomic<entry*>[]> const buckets;
+        };
+
+        class shard
+        {
+        public:
+            shard()
+                : entries(new table(minimumBits)),
+                  count(0),
+                  hits(0),
+                  misses(0),
+                  evictions(0)
+            {
+            }
+
+            shard(shard const&) = delete;
+            shard& operator=(shard const&) = delete;
+
+            ~shard()
+            {
+                delete entries.load(std::memory_order_relaxed);
+            }
+
+            // serializes writers
+            std::mutex mutex;
+
+            std::atomic<table*> entries;
+
+            // entries in the table, written under the lock
+            std::atomic<std::size_t> count;
+
+            std::atomic<std::size_t> hits;
+            std::atomic<std::size_t> misses;
+            std::atomic<std::size_t> evictions;
+
+            // keeps the counters of different shards on different cache lines
+            char padding[64];
+        };
+
+        static constexpr unsigned minimumBits = 3;
+
+        std::uint64_t hash_of(Key const& key) const;
+        shard& shard_of(std::uint64_t hash) const;
+
+        // the entry of key in chain, null if there is none
+        entry* find_entry(entry* chain, Key const& key, std::uint64_t hash) const;
+
+        // replaces the chain of bucket by a copy without expired entries
+        void drop_expired(shard&, std::atomic<entry*>& bucket);
+
+        // replaces the table of target by one with room for another entry
+        void grow(shard& target);
+
+        static void delete_chain(entry*);
+        static void release_chain(void*);
+        static void release_table(void*);
+
+        std::unique_ptr<shard[]> m_shards;
+        std::size_t m_mask;
+        Hash m_hash;
+        Equal m_equal;
+    };
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    instance_cache<Key, T, Hash, Equal>::instance_cache(std::size_t shards)
+        : m_mask(0)
+    {
+        if (shards == 0)
+        {
+            shards = std::max(std::thread::hardware_concurrency(), 1u);
+        }
+
+        std::size_t count{1};
+        while (count < shards)
+        {
+            count *= 2;
+        }
+
+        m_shards.reset(new shard[count]);
+        m_mask = count - 1;
+
+        // retired chains and tables must not outlive the domain
+        epoch_domain::instance();
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    std::uint64_t
+    instance_cache<Key, T, Hash, Equal>::hash_of(Key const& key) const
+    {
+        // spreads the hash into the upper bits, which std::hash leaves
+        // poor for integers
+        return static_cast<std::uint64_t>(m_hash(key)) * 0x9E3779B97F4A7C15ull;
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    typename instance_cache<Key, T, Hash, Equal>::shard&
+    instance_cache<Key, T, Hash, Equal>::shard_of(std::uint64_t hash) const
+    {
+        // the buckets take the bits from the top down
+        return m_shards[static_cast<std::size_t>(hash >> 32) & m_mask];
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    typename instance_cache<Key, T, Hash, Equal>::entry*
+    instance_cache<Key, T, Hash, Equal>::find_entry(entry* chain, Key const& key, std::uint64_t hash) const
+    {
+        for (; chain; chain = chain->next)
+        {
+            if (chain->hash == hash && m_equal(chain->key, key))
+            {
+                return chain;
+            }
+        }
+
+        return nullptr;
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    std::shared_ptr<T>
+    instance_cache<Key, T, Hash, Equal>::find(Key const& key) const
+    {
+        std::uint64_t hash{hash_of(key)};
+        shard& target{shard_of(hash)};
+
+        epoch_guard guard;
+        table const& entries{*target.entries.load(std::memory_order_seq_cst)};
+
+        entry* found{find_entry(entries.bucket(hash).load(std::memory_order_seq_cst), key, hash)};
+        return found ? found->obj.lock() : std::shared_ptr<T>{};
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    template<typename Factory>
+    typename instance_cache<Key, T, Hash, Equal>::value_type
+    instance_cache<Key, T, Hash, Equal>::get(Key const& key, Factory make)
+    {
+        std::uint64_t hash{hash_of(key)};
+        shard& target{shard_of(hash)};
+
+        {
+            epoch_guard guard;
+            table const& entries{*target.entries.load(std::memory_order_seq_cst)};
+
+            if (entry* found = find_entry(entries.bucket(hash).load(std::memory_order_seq_cst), key, hash))
+            {
+                if (auto obj = found->obj.lock())
+                {
+                    target.hits.fetch_add(1, std::memory_order_relaxed);
+                    return detail::instance_access::adopt<value_type>(std::move(obj));
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lock{target.mutex};
+
+        // another thread may have created it meanwhile
+        std::atomic<entry*>* bucket{&target.entries.load(std::memory_order_relaxed)->bucket(hash)};
+        entry* found{find_entry(bucket->load(std::memory_order_relaxed), key, hash)};
+
+        if (found)
+        {
+            if (auto obj = found->obj.lock())
+            {
+                target.hits.fetch_add(1, std::memory_order_relaxed);
+                return detail::instance_access::adopt<value_type>(std::move(obj));
+            }
+        }
+
+        value_type created{make(key)};
+
+        if (found)
+        {
+            drop_expired(target, *bucket);
+        }
+
+        if (target.count.load(std::memory_order_relaxed) >= target.entries.load(std::memory_order_relaxed)->bucket_count())
+        {
+            grow(target);
+            bucket = &target.entries.load(std::memory_order_relaxed)->bucket(hash);
+        }
+
+        entry* head{bucket->load(std::memory_order_relaxed)};
+        bucket->store(new entry(key, detail::instance_access::pointer(created), hash, head), std::memory_order_seq_cst);
+        target.count.fetch_add(1, std::memory_order_relaxed);
+
+        target.misses.fetch_add(1, std::memory_order_relaxed);
+        return created;
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    typename instance_cache<Key, T, Hash, Equal>::value_type
+    instance_cache<Key, T, Hash, Equal>::get(Key const& key)
+    {
+        return get(key, [](Key const& k)
+        {
+            return value_type{new T(k)};
+        });
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    void
+    instance_cache<Key, T, Hash, Equal>::drop_expired(shard& target, std::atomic<entry*>& bucket)
+    {
+        entry* current{bucket.load(std::memory_order_relaxed)};
+        entry* copy{nullptr};
+        std::size_t expired{0};
+
+        try
+        {
+            for (entry* item = current; item; item = item->next)
+            {
+                if (item->obj.expired())
+                {
+                    ++expired;
+                }
+                else
+                {
+                    copy = new entry(item->key, item->obj, item->hash, copy);
+                }
+            }
+        }
+        catch (...)
+        {
+            delete_chain(copy);
+            throw;
+        }
+
+        bucket.store(copy, std::memory_order_seq_cst);
+        epoch_domain::instance().retire(current, &release_chain);
+
+        target.count.fetch_sub(expired, std::memory_order_relaxed);
+        target.evictions.fetch_add(expired, std::memory_order_relaxed);
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    void
+    instance_cache<Key, T, Hash, Equal>::grow(shard& target)
+    {
+        table* current{target.entries.load(std::memory_order_relaxed)};
+
+        std::size_t live{0};
+        for (std::size_t i = 0; i < current->bucket_count(); ++i)
+        {
+            for (entry* item = current->buckets[i].load(std::memory_order_relaxed); item; item = item->next)
+            {
+                live += !item->obj.expired();
+            }
+        }
+
+        // leaves the table at most half full after the next entry
+        unsigned bits{minimumBits};
+        while ((std::size_t{1} << bits) < 2 * (live + 1))
+        {
+            ++bits;
+        }
+
+        std::unique_ptr<table> next{new table(bits)};
+        std::size_t copied{0};
+
+        for (std::size_t i = 0; i < current->bucket_count(); ++i)
+        {
+            for (entry* item = current->buckets[i].load(std::memory_order_relaxed); item; item = item->next)
+            {
+                // objects may have gone since counting
+                if (!item->obj.expired())
+                {
+                    std::atomic<entry*>& bucket{next->bucket(item->hash)};
+                    bucket.store(new entry(item->key, item->obj, item->hash, bucket.load(std::memory_order_relaxed)),
+                                 std::memory_order_relaxed);
+                    ++copied;
+                }
+            }
+        }
+
+        std::size_t expired{target.count.load(std::memory_order_relaxed) - copied};
+
+        target.entries.store(next.release(), std::memory_order_seq_cst);
+        epoch_domain::instance().retire(current, &release_table);
+
+        target.count.store(copied, std::memory_order_relaxed);
+        target.evictions.fetch_add(expired, std::memory_order_relaxed);
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    void
+    instance_cache<Key, T, Hash, Equal>::delete_chain(entry* chain)
+    {
+        while (chain)
+        {
+            entry* next{chain->next};
+            delete chain;
+            chain = next;
+        }
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    void
+    instance_cache<Key, T, Hash, Equal>::release_chain(void* chain)
+    {
+        delete_chain(static_cast<entry*>(chain));
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    void
+    instance_cache<Key, T, Hash, Equal>::release_table(void* entries)
+    {
+        delete static_cast<table*>(entries);
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    void
+    instance_cache<Key, T, Hash, Equal>::purge()
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i)
+        {
+            shard& target{m_shards[i]};
+            std::lock_guard<std::mutex> lock{target.mutex};
+
+            table& entries{*target.entries.load(std::memory_order_relaxed)};
+
+            for (std::size_t b = 0; b < entries.bucket_count(); ++b)
+            {
+                for (entry* item = entries.buckets[b].load(std::memory_order_relaxed); item; item = item->next)
+                {
+                    if (item->obj.expired())
+                    {
+                        drop_expired(target, entries.buckets[b]);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    std::size_t
+    instance_cache<Key, T, Hash, Equal>::size() const
+    {
+        std::size_t count{0};
+
+        for (std::size_t i = 0; i <= m_mask; ++i)
+        {
+            count += m_shards[i].count.load(std::memory_order_relaxed);
+        }
+
+        return count;
+    }
+
+    template<typename Key, typename T, typename Hash, typename Equal>
+    instance_cache_statistics
+    instance_cache<Key, T, Hash, Equal>::statistics() const
+    {
+        instance_cache_statistics result{0, 0, 0};
+
+        for (std::size_t i = 0; i <= m_mask; ++i)
+        {
+            result.hits += m_shards[i].hits.load(std::memory_order_relaxed);
+            result.misses += m_shards[i].misses.load(std::memory_order_relaxed);
+            result.evictions += m_shards[i].evictions.load(std::memory_order_relaxed);
+        }
+
+        return result;
+    }
+}
+
+#endif
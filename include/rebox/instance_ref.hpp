@@ -0,0 +1,166 @@
+// instance_ref.hpp -- a borrowed reference to a shared_instance
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_INSTANCE_REF_HPP
+#define REBOX_INSTANCE_REF_HPP
+
+#include "shared_instance.hpp"
+
+#include <cassert>
+
+// called with a description when a checked instance_ref is misused
+#ifndef REBOX_REF_VIOLATION
+#  define REBOX_REF_VIOLATION(message) assert(!message)
+#endif
+
+namespace rebox
+{
+#if REBOX_CHECKED_REFS
+    namespace detail
+    {
+        // a counted reference to the token of the owner of an instance_ref
+        class owner_watch
+        {
+        public:
+            explicit owner_watch(owner_token* token)
+                : m_token(token)
+            {
+            }
+
+            owner_watch(owner_watch const& other)
+                : m_token(other.m_token)
+            {
+                m_token->acquire();
+            }
+
+            owner_watch& operator=(owner_watch const& other)
+            {
+                other.m_token->acquire();
+                m_token->release();
+                m_token = other.m_token;
+                return *this;
+            }
+
+            ~owner_watch()
+            {
+                m_token->release();
+            }
+
+            bool alive() const
+            {
+                return m_token->alive();
+            }
+
+        private:
+            owner_token* m_token;
+        };
+    }
+#endif
+
+    // A non-owning reference to a shared_instance, created without
+    // touching the reference count. It is meant to be passed down call
+    // chains by value in place of the shared_instance, and promoted back
+    // to one by callees which need to keep the object. The owner must
+    // outlive the reference and keep holding the same object.
+    template<typename T, typename Report, typename Threading>
+    class instance_ref
+    {
+    public:
+        using type = T;
+        using owner_type = shared_instance<T, Report, Threading>;
+
+        instance_ref(owner_type const& owner);
+
+        // temporaries are gone before the reference is used
+        instance_ref(owner_type&&) = delete;
+
+        operator T&() const;
+        T& get() const;
+
+        // a new shared_instance sharing the ownership of the owner
+        owner_type promote() const;
+
+    private:
+        void check() const;
+
+        owner_type const* m_owner;
+
+#if REBOX_CHECKED_REFS
+        T* m_obj;
+        typename Threading::template weak_pointer<T> m_alive;
+        detail::owner_watch m_owned;
+#endif
+    };
+
+    template<typename T, typename Report, typename Threading>
+    instance_ref<T, Report, Threading>::instance_ref(owner_type const& owner)
+        : m_owner(&owner)
+#if REBOX_CHECKED_REFS
+        , m_obj(&owner.get()),
+          m_alive(owner.ptr()),
+          m_owned(detail::instance_access::borrow(owner))
+#endif
+    {
+    }
+
+    template<typename T, typename Report, typename Threading>
+    instance_ref<T, Report, Threading>::operator T&() const
+    {
+        return get();
+    }
+
+    template<typename T, typename Report, typename Threading>
+    T&
+    instance_ref<T, Report, Threading>::get() const
+    {
+        check();
+        return m_owner->get();
+    }
+
+    template<typename T, typename Report, typename Threading>
+    typename instance_ref<T, Report, Threading>::owner_type
+    instance_ref<T, Report, Threading>::promote() const
+    {
+        check();
+        return *m_owner;
+    }
+
+    template<typename T, typename Report, typename Threading>
+    void
+    instance_ref<T, Report, Threading>::check() const
+    {
+#if REBOX_CHECKED_REFS
+        // the owner is checked first, as only a live owner may be read
+        if (!m_owned.alive())
+        {
+            REBOX_REF_VIOLATION("instance_ref used after its owner was destroyed");
+        }
+        else if (m_alive.expired())
+        {
+            REBOX_REF_VIOLATION("instance_ref used after its object was destroyed");
+        }
+        else if (&m_owner->get() != m_obj)
+        {
+            REBOX_REF_VIOLATION("instance_ref used after its owner was reassigned");
+        }
+#endif
+    }
+
+    template<typename T, typename Report, typename Threading>
+    bool operator==(instance_ref<T, Report, Threading> const& lhs, instance_ref<T, Report, Threading> const& rhs)
+    {
+        return &lhs.get() == &rhs.get();
+    }
+
+    template<typename T, typename Report, typename Threading>
+    bool operator!=(instance_ref<T, Report, Threading> const& lhs, instance_ref<T, Report, Threading> const& rhs)
+    {
+        return !(lhs == rhs);
+    }
+}
+
+#endif
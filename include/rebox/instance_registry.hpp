@@ -0,0 +1,563 @@
+// instance_registry.hpp -- listing the objects owned by shared_instance's
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_INSTANCE_REGISTRY_HPP
+#define REBOX_INSTANCE_REGISTRY_HPP
+
+#include "shared_instance_fwd.hpp"
+#include "call_site.hpp"
+#include "type_name.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+// the address the current function returns to, identifying the caller
+// of functions which cannot take a call_site
+#if defined(__GNUC__) || defined(__clang__)
+#  define REBOX_RETURN_ADDRESS() __builtin_extract_return_addr(__builtin_return_address(0))
+#  define REBOX_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#  include <intrin.h>
+#  define REBOX_RETURN_ADDRESS() _ReturnAddress()
+#  define REBOX_NOINLINE __declspec(noinline)
+#else
+#  define REBOX_RETURN_ADDRESS() nullptr
+#  define REBOX_NOINLINE
+#endif
+
+namespace rebox
+{
+    // an object alive at the time of instance_registry::collect()
+    class live_instance
+    {
+    public:
+        std::string type;
+        std::size_t size;
+        void const* object;
+        long useCount;
+
+        // where the object was handed to a shared_instance; objects made
+        // by make_shared_instance only know the address returned to
+        call_site site;
+        void const* caller;
+    };
+
+    namespace detail
+    {
+        class registry_node
+        {
+        public:
+            registry_node* previous;
+            registry_node* next;
+
+            // empty until the owning pointer exists
+            std::weak_ptr<void const> owner;
+
+            // for owners other than std::shared_ptr, the object and its
+            // control block, whose use count is read under the lock of
+            // the shard, as the object leaves the registry before its
+            // block can go away
+            void const* object;
+            void const* block;
+            long (*use_count)(void const* block);
+
+            char const* type;
+            std::size_t size;
+            call_site site;
+            void const* caller;
+
+            std::size_t shard;
+        };
+    }
+
+    // The control blocks of objects given to shared_instance's, each in a
+    // list of the shard of the thread which created it, so that threads
+    // creating and destroying objects rarely contend.
+    class instance_registry
+    {
+    public:
+        static instance_registry& instance()
+        {
+            static instance_registry registry;
+            return registry;
+        }
+
+        instance_registry(instance_registry const&) = delete;
+        instance_registry& operator=(instance_registry const&) = delete;
+
+        // the objects alive, grouped by type
+        std::vector<live_instance> collect() const;
+
+        // the number of objects alive
+        std::size_t size() const;
+
+        // per type the number of objects and their size, followed by the
+        // objects with their use counts and where they were created
+        void report(std::ostream& out) const;
+
+        // a node for an object about to be created, listed once its
+        // owner is known; leave() drops it in either case
+        detail::registry_node* enter(char const* type, std::size_t size, call_site site, void const* caller);
+        void own(detail::registry_node* node, std::weak_ptr<void const> owner);
+        void own(detail::registry_node* node, void const* object, void const* block, long (*use_count)(void const*));
+        void leave(detail::registry_node* node);
+
+    private:
+        class alignas(64) shard
+        {
+        public:
+            shard()
+            {
+                head.previous = &head;
+                head.next = &head;
+            }
+
+            mutable std::mutex mutex;
+            detail::registry_node head;
+        };
+
+        static constexpr std::size_t shardCount = 16;
+
+        instance_registry() = default;
+
+        // the shard of the calling thread
+        std::size_t local_shard()
+        {
+            static thread_local std::size_t index{m_nextShard.fetch_add(1, std::memory_order_relaxed) % shardCount};
+            return index;
+        }
+
+        shard m_shards[shardCount];
+        std::atomic<std::size_t> m_nextShard{0};
+    };
+
+    inline detail::registry_node*
+    instance_registry::enter(char const* type, std::size_t size, call_site site, void const* caller)
+    {
+        return new detail::registry_node{nullptr, nullptr, {}, nullptr, nullptr, nullptr,
+                                         type, size, site, caller, local_shard()};
+    }
+
+    inline void
+    instance_registry::own(detail::registry_node* node, std::weak_ptr<void const> owner)
+    {
+        shard& target{m_shards[node->shard]};
+        std::lock_guard<std::mutex> lock{target.mutex};
+
+        node->owner = std::move(owner);
+        node->previous = &target.head;
+        node->next = target.head.next;
+        target.head.next->previous = node;
+        target.head.next = node;
+    }
+
+    inline void
+    instance_registry::own(detail::registry_node* node, void const* object, void const* block, long (*use_count)(void const*))
+    {
+        shard& target{m_shards[node->shard]};
+        std::lock_guard<std::mutex> lock{target.mutex};
+
+        node->object = object;
+        node->block = block;
+        node->use_count = use_count;
+        node->previous = &target.head;
+        node->next = target.head.next;
+        target.head.next->previous = node;
+        target.head.next = node;
+    }
+
+    inline void
+    instance_registry::leave(detail::registry_node* node)
+    {
+        // not listed if creating the object failed
+        if (node->previous)
+        {
+            std::lock_guard<std::mutex> lock{m_shards[node->shard].mutex};
+            node->previous->next = node->next;
+            node->next->previous = node->previous;
+        }
+
+        delete node;
+    }
+
+    inline std::vector<live_instance>
+    instance_registry::collect() const
+    {
+        std::vector<live_instance> result;
+
+        // most types have many objects, each naming the type alike
+        std::map<char const*, std::string> names;
+        auto name_of = [&names](char const* type) -> std::string const&
+        {
+            auto found = names.find(type);
+            if (found == names.end())
+            {
+                found = names.emplace(type, detail::demangle(type)).first;
+            }
+
+            return found->second;
+        };
+
+        for (shard const& source : m_shards)
+        {
+            // released after the lock, as dropping the last reference
+            // leaves the registry
+            std::vector<std::shared_ptr<void const>> owners;
+            std::lock_guard<std::mutex> lock{source.mutex};
+
+            for (auto node = source.head.next; node != &source.head; node = node->next)
+            {
+                // skips objects still being created or just being destroyed
+                if (auto owner = node->owner.lock())
+                {
+                    result.push_back(live_instance{name_of(node->type), node->size, owner.get(),
+                                                   owner.use_count() - 1, node->site, node->caller});
+                    owners.push_back(std::move(owner));
+                }
+                else if (node->block)
+                {
+                    long useCount{node->use_count(node->block)};
+
+                    if (useCount > 0)
+                    {
+                        result.push_back(live_instance{name_of(node->type), node->size, node->object,
+                                                       useCount, node->site, node->caller});
+                    }
+                }
+            }
+        }
+
+        std::stable_sort(result.begin(), result.end(), [](live_instance const& lhs, live_instance const& rhs)
+        {
+            return lhs.type < rhs.type;
+        });
+
+        return result;
+    }
+
+    inline std::size_t
+    instance_registry::size() const
+    {
+        std::size_t count{0};
+
+        for (shard const& source : m_shards)
+        {
+            std::lock_guard<std::mutex> lock{source.mutex};
+
+            for (auto node = source.head.next; node != &source.head; node = node->next)
+            {
+                count += node->block ? node->use_count(node->block) > 0 : !node->owner.expired();
+            }
+        }
+
+        return count;
+    }
+
+    inline void
+    instance_registry::report(std::ostream& out) const
+    {
+        auto instances = collect();
+
+        // the types holding the most memory first
+        std::map<std::string, std::pair<std::size_t, std::size_t>> totals;
+        for (auto const& obj : instances)
+        {
+            auto& total = totals[obj.type];
+            ++total.first;
+            total.second += obj.size;
+        }
+
+        std::vector<std::pair<std::size_t, std::string>> order;
+        for (auto const& total : totals)
+        {
+            order.emplace_back(total.second.second, total.first);
+        }
+
+        std::sort(order.rbegin(), order.rend());
+
+        for (auto const& type : order)
+        {
+            auto const& total = totals[type.second];
+            out << type.second << ": " << total.first << " alive, " << total.second << " bytes\n";
+
+            for (auto const& obj : instances)
+            {
+                if (obj.type != type.second)
+                {
+                    continue;
+                }
+
+                out << "    " << obj.object << " use_count=" << obj.useCount;
+
+                if (obj.site.line)
+                {
+                    out << ' ' << obj.site.file << ':' << obj.site.line << ' ' << obj.site.function;
+                }
+                else
+                {
+                    out << " from " << obj.caller;
+                }
+
+                out << '\n';
+            }
+        }
+    }
+
+    namespace detail
+    {
+        // deletes through Deleter, removing the object from the registry
+        template<typename Deleter>
+        class registering_deleter
+        {
+        public:
+            registering_deleter(Deleter deleter, registry_node* node)
+                : deleter(std::move(deleter)),
+                  node(node)
+            {
+            }
+
+            template<typename Y>
+            void operator()(Y* obj)
+            {
+                if (node)
+                {
+                    instance_registry::instance().leave(node);
+                }
+
+                deleter(obj);
+            }
+
+            Deleter deleter;
+            registry_node* node;
+        };
+
+        // allocates through Inner, removing the object from the registry
+        // when it is destroyed
+        template<typename T, typename Inner = std::allocator<T>>
+        class registering_allocator
+        {
+        public:
+            using value_type = T;
+
+            template<typename U>
+            struct rebind
+            {
+                using other = registering_allocator<U, typename std::allocator_traits<Inner>::template rebind_alloc<U>>;
+            };
+
+            registering_allocator(Inner const& inner, registry_node* node)
+                : inner(inner),
+                  node(node)
+            {
+            }
+
+            template<typename U, typename UInner>
+            registering_allocator(registering_allocator<U, UInner> const& other)
+                : inner(other.inner),
+                  node(other.node)
+            {
+            }
+
+            T* allocate(std::size_t n)
+            {
+                return std::allocator_traits<Inner>::allocate(inner, n);
+            }
+
+            void deallocate(T* ptr, std::size_t n)
+            {
+                std::allocator_traits<Inner>::deallocate(inner, ptr, n);
+            }
+
+            template<typename U, typename... Args>
+            void construct(U* ptr, Args&&... args)
+            {
+                typename std::allocator_traits<Inner>::template rebind_alloc<typename std::remove_cv<U>::type> target(inner);
+                std::allocator_traits<decltype(target)>::construct(target, ptr, std::forward<Args>(args)...);
+            }
+
+            template<typename U>
+            void destroy(U* ptr)
+            {
+                if (node)
+                {
+                    instance_registry::instance().leave(node);
+                    node = nullptr;
+                }
+
+                typename std::allocator_traits<Inner>::template rebind_alloc<typename std::remove_cv<U>::type> target(inner);
+                std::allocator_traits<decltype(target)>::destroy(target, ptr);
+            }
+
+            template<typename U, typename UInner>
+            bool operator==(registering_allocator<U, UInner> const& other) const
+            {
+                return inner == other.inner;
+            }
+
+            template<typename U, typename UInner>
+            bool operator!=(registering_allocator<U, UInner> const& other) const
+            {
+                return inner != other.inner;
+            }
+
+            Inner inner;
+            registry_node* node;
+        };
+
+        // a std::shared_ptr owning obj, registered as created at site
+        template<typename Y, typename Deleter>
+        std::shared_ptr<Y> registered(Y* obj, Deleter deleter, call_site site)
+        {
+            if (!obj)
+            {
+                return std::shared_ptr<Y>(obj, std::move(deleter));
+            }
+
+            auto node = instance_registry::instance().enter(typeid(Y).name(), sizeof(Y), site, nullptr);
+
+            // deletes obj and leaves the registry if this throws
+            std::shared_ptr<Y> result(obj, registering_deleter<Deleter>{std::move(deleter), node});
+            instance_registry::instance().own(node, result);
+            return result;
+        }
+
+        // caller identifies the creator where no site is known
+        template<typename Y, typename Deleter, typename Alloc>
+        std::shared_ptr<Y> registered(Y* obj, Deleter deleter, Alloc alloc, call_site site, void const* caller = nullptr)
+        {
+            if (!obj)
+            {
+                return std::shared_ptr<Y>(obj, std::move(deleter), std::move(alloc));
+            }
+
+            auto node = instance_registry::instance().enter(typeid(Y).name(), sizeof(Y), site, caller);
+
+            std::shared_ptr<Y> result(obj, registering_deleter<Deleter>{std::move(deleter), node}, std::move(alloc));
+            instance_registry::instance().own(node, result);
+            return result;
+        }
+
+        // releases other into a registered std::shared_ptr
+        template<typename Y, typename Deleter>
+        std::shared_ptr<Y> registered(std::unique_ptr<Y, Deleter>&& other, call_site site, void const* caller = nullptr)
+        {
+            using stored = typename std::conditional<std::is_reference<Deleter>::value,
+                                                     std::reference_wrapper<typename std::remove_reference<Deleter>::type>,
+                                                     Deleter>::type;
+
+            stored deleter(std::forward<Deleter>(other.get_deleter()));
+            return registered(other.release(), std::move(deleter), std::allocator<void>(), site, caller);
+        }
+
+        template<typename T, typename Alloc, typename... Args>
+        std::shared_ptr<T> allocate_registered(void const* caller, Alloc const& alloc, Args&&... args)
+        {
+            auto node = instance_registry::instance().enter(typeid(T).name(), sizeof(T), call_site{"", "", 0}, caller);
+
+            try
+            {
+                registering_allocator<T, Alloc> registering(alloc, node);
+                auto result = std::allocate_shared<T>(registering, std::forward<Args>(args)...);
+                instance_registry::instance().own(node, result);
+                return result;
+            }
+            catch (...)
+            {
+                instance_registry::instance().leave(node);
+                throw;
+            }
+        }
+
+        // registers the objects made or adopted by Threading; policies
+        // without a specialization are left out of the registry
+        template<typename Threading>
+        class registering_make
+        {
+        public:
+            template<typename T, typename... Args>
+            static auto make_shared(void const*, Args&&... args)
+                -> decltype(Threading::template make_shared<T>(std::forward<Args>(args)...))
+            {
+                return Threading::template make_shared<T>(std::forward<Args>(args)...);
+            }
+
+            template<typename T, typename Alloc, typename... Args>
+            static auto allocate_shared(void const*, Alloc const& alloc, Args&&... args)
+                -> decltype(Threading::template allocate_shared<T>(alloc, std::forward<Args>(args)...))
+            {
+                return Threading::template allocate_shared<T>(alloc, std::forward<Args>(args)...);
+            }
+
+            template<typename Y, typename Deleter>
+            static typename Threading::template pointer<Y> adopt(Y* obj, Deleter deleter, call_site)
+            {
+                return typename Threading::template pointer<Y>(obj, std::move(deleter));
+            }
+
+            template<typename Y, typename Deleter, typename Alloc>
+            static typename Threading::template pointer<Y> adopt(Y* obj, Deleter deleter, Alloc alloc, call_site)
+            {
+                return typename Threading::template pointer<Y>(obj, std::move(deleter), std::move(alloc));
+            }
+
+            template<typename Y, typename Deleter>
+            static typename Threading::template pointer<Y> adopt(std::unique_ptr<Y, Deleter>&& other, call_site, void const* = nullptr)
+            {
+                return typename Threading::template pointer<Y>(std::move(other));
+            }
+        };
+
+        template<>
+        class registering_make<multi_threaded>
+        {
+        public:
+            template<typename T, typename... Args>
+            static std::shared_ptr<T> make_shared(void const* caller, Args&&... args)
+            {
+                using object = typename std::remove_const<T>::type;
+                return allocate_registered<T>(caller, std::allocator<object>(), std::forward<Args>(args)...);
+            }
+
+            template<typename T, typename Alloc, typename... Args>
+            static std::shared_ptr<T> allocate_shared(void const* caller, Alloc const& alloc, Args&&... args)
+            {
+                return allocate_registered<T>(caller, alloc, std::forward<Args>(args)...);
+            }
+
+            template<typename Y, typename Deleter>
+            static std::shared_ptr<Y> adopt(Y* obj, Deleter deleter, call_site site)
+            {
+                return registered(obj, std::move(deleter), site);
+            }
+
+            template<typename Y, typename Deleter, typename Alloc>
+            static std::shared_ptr<Y> adopt(Y* obj, Deleter deleter, Alloc alloc, call_site site)
+            {
+                return registered(obj, std::move(deleter), std::move(alloc), site);
+            }
+
+            template<typename Y, typename Deleter>
+            static std::shared_ptr<Y> adopt(std::unique_ptr<Y, Deleter>&& other, call_site site, void const* caller = nullptr)
+            {
+                return registered(std::move(other), site, caller);
+            }
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,706 @@
+// instance_set.hpp -- flat hash sets and maps keyed by shared_instance's
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_INSTANCE_SET_HPP
+#define REBOX_INSTANCE_SET_HPP
+
+#include "shared_instance.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace rebox
+{
+    // identifies instances by the address of their object, like the
+    // comparison operators do; lookups may also pass the object itself
+    class address_key
+    {
+    public:
+        template<typename T, typename Report, typename Threading>
+        static void const* of(shared_instance<T, Report, Threading> const& obj)
+        {
+            return std::addressof(obj.get());
+        }
+
+        template<typename T>
+        static void const* of(T const& obj)
+        {
+            return std::addressof(obj);
+        }
+    };
+
+    // identifies instances by their owner, like owner_before does; only
+    // the counted policies tell the address of the owner
+    class owner_key
+    {
+    public:
+        template<typename T, typename Report, typename Threading>
+        static void const* of(shared_instance<T, Report, Threading> const& obj)
+        {
+            static_assert(detail::has_owner<Threading>::value, "keying by owner needs a counted policy");
+
+            void const* owner{Threading::owner(detail::instance_access::pointer(obj))};
+
+            // instances aliasing an empty owner are all equivalent
+            return owner ? owner : unowned();
+        }
+
+    private:
+        static void const* unowned()
+        {
+            static char marker;
+            return &marker;
+        }
+    };
+
+    namespace detail
+    {
+        // Open addressing table with linear probing. The keys are kept
+        // apart from the entries, so probing only reads the keys; a null
+        // key marks an empty slot. Erasing shifts the following entries
+        // back instead of leaving tombstones.
+        template<typename Entry>
+        class flat_table
+        {
+        public:
+            flat_table()
+                : m_capacity(0),
+                  m_size(0),
+                  m_shift(64)
+            {
+            }
+
+            flat_table(flat_table const& other)
+                : flat_table()
+            {
+                allocate(other.m_capacity);
+
+                // keeps the slots of other; if copying throws, the
+                // destructor releases the entries copied so far
+                for (std::size_t i = other.next(0); i != other.m_capacity; i = other.next(i + 1))
+                {
+                    ::new (static_cast<void*>(&m_entries[i])) Entry(other.entry(i));
+                    m_keys[i] = other.m_keys[i];
+                    ++m_size;
+                }
+            }
+
+            flat_table(flat_table&& other)
+                : flat_table()
+            {
+                swap(other);
+            }
+
+            flat_table& operator=(flat_table const& other)
+            {
+                flat_table(other).swap(*this);
+                return *this;
+            }
+
+            flat_table& operator=(flat_table&& other)
+            {
+                flat_table(std::move(other)).swap(*this);
+                return *this;
+            }
+
+            ~flat_table()
+            {
+                clear();
+            }
+
+            void swap(flat_table& other)
+            {
+                std::swap(m_keys, other.m_keys);
+                std::swap(m_entries, other.m_entries);
+                std::swap(m_capacity, other.m_capacity);
+                std::swap(m_size, other.m_size);
+                std::swap(m_shift, other.m_shift);
+            }
+
+            std::size_t size() const
+            {
+                return m_size;
+            }
+
+            std::size_t capacity() const
+            {
+                return m_capacity;
+            }
+
+            void clear()
+            {
+                for (std::size_t i = next(0); i != m_capacity; i = next(i + 1))
+                {
+                    entry(i).~Entry();
+                    m_keys[i] = nullptr;
+                }
+
+                m_size = 0;
+            }
+
+            // makes room for count entries without rehashing
+            void reserve(std::size_t count)
+            {
+                if (count == 0)
+                {
+                    return;
+                }
+
+                std::size_t capacity{m_capacity ? m_capacity : initial_capacity};
+
+                while (count > max_load(capacity))
+                {
+                    capacity *= 2;
+                }
+
+                if (capacity != m_capacity)
+                {
+                    rehash(capacity);
+                }
+            }
+
+            // the slot of key, capacity() if absent
+            std::size_t find(void const* key) const
+            {
+                if (m_size == 0)
+                {
+                    return m_capacity;
+                }
+
+                for (std::size_t i = home(key);; i = (i + 1) & (m_capacity - 1))
+                {
+                    if (m_keys[i] == key)
+                    {
+                        return i;
+                    }
+
+                    if (!m_keys[i])
+                    {
+                        return m_capacity;
+                    }
+                }
+            }
+
+            // constructs an entry from args unless key is present already
+            template<typename... Args>
+            std::pair<std::size_t, bool> emplace(void const* key, Args&&... args)
+            {
+                std::size_t found{find(key)};
+
+                if (found != m_capacity)
+                {
+                    return std::make_pair(found, false);
+                }
+
+                reserve(m_size + 1);
+
+                std::size_t i{home(key)};
+                while (m_keys[i])
+                {
+                    i = (i + 1) & (m_capacity - 1);
+                }
+
+                ::new (static_cast<void*>(&m_entries[i])) Entry(std::forward<Args>(args)...);
+                m_keys[i] = key;
+                ++m_size;
+
+                return std::make_pair(i, true);
+            }
+
+            bool erase(void const* key)
+            {
+                std::size_t hole{find(key)};
+
+                if (hole == m_capacity)
+                {
+                    return false;
+                }
+
+                std::size_t mask{m_capacity - 1};
+
+                entry(hole).~Entry();
+                m_keys[hole] = nullptr;
+                --m_size;
+
+                // entries whose probe sequence passes the hole move into it
+                for (std::size_t i = (hole + 1) & mask; m_keys[i]; i = (i + 1) & mask)
+                {
+                    if (((i - home(m_keys[i])) & mask) >= ((i - hole) & mask))
+                    {
+                        move(i, hole);
+                        hole = i;
+                    }
+                }
+
+                return true;
+            }
+
+            // the first occupied slot from i on, capacity() if none
+            std::size_t next(std::size_t i) const
+            {
+                while (i < m_capacity && !m_keys[i])
+                {
+                    ++i;
+                }
+
+                return i;
+            }
+
+            Entry& entry(std::size_t i)
+            {
+                return *reinterpret_cast<Entry*>(&m_entries[i]);
+            }
+
+            Entry const& entry(std::size_t i) const
+            {
+                return *reinterpret_cast<Entry const*>(&m_entries[i]);
+            }
+
+        private:
+            using storage = typename std::aligned_storage<sizeof(Entry), alignof(Entry)>::type;
+
+            static constexpr std::size_t initial_capacity = 16;
+
+            static std::size_t max_load(std::size_t capacity)
+            {
+                return capacity - capacity / 4;
+            }
+
+            // Fibonacci hashing, taking the upper bits of the product
+            std::size_t home(void const* key) const
+            {
+                auto bits = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(key));
+                return static_cast<std::size_t>((bits * 0x9E3779B97F4A7C15ull) >> m_shift);
+            }
+
+            void allocate(std::size_t capacity)
+            {
+                if (capacity == 0)
+                {
+                    return;
+                }
+
+                m_entries.reset(new storage[capacity]);
+                m_keys.reset(new void const*[capacity]());
+                m_capacity = capacity;
+
+                m_shift = 64;
+                while (capacity > 1)
+                {
+                    capacity /= 2;
+                    --m_shift;
+                }
+            }
+
+            void rehash(std::size_t capacity)
+            {
+                flat_table larger;
+                larger.allocate(capacity);
+
+                for (std::size_t i = next(0); i != m_capacity; i = next(i + 1))
+                {
+                    std::size_t slot{larger.home(m_keys[i])};
+                    while (larger.m_keys[slot])
+                    {
+                        slot = (slot + 1) & (capacity - 1);
+                    }
+
+                    ::new (static_cast<void*>(&larger.m_entries[slot])) Entry(std::move(entry(i)));
+                    larger.m_keys[slot] = m_keys[i];
+                    ++larger.m_size;
+                }
+
+                swap(larger);
+            }
+
+            void move(std::size_t from, std::size_t to)
+            {
+                ::new (static_cast<void*>(&m_entries[to])) Entry(std::move(entry(from)));
+                entry(from).~Entry();
+
+                m_keys[to] = m_keys[from];
+                m_keys[from] = nullptr;
+            }
+
+            std::unique_ptr<void const*[]> m_keys;
+            std::unique_ptr<storage[]> m_entries;
+            std::size_t m_capacity;
+            std::size_t m_size;
+            unsigned m_shift;
+        };
+
+
+        template<typename Table, typename Value>
+        class flat_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = typename std::remove_cv<Value>::type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = Value*;
+            using reference = Value&;
+
+            flat_iterator()
+                : m_table(nullptr),
+                  m_index(0)
+            {
+            }
+
+            flat_iterator(Table* table, std::size_t index)
+                : m_table(table),
+                  m_index(index)
+            {
+            }
+
+            // iterators convert to const_iterators
+            template<typename OtherTable, typename OtherValue,
+                     typename = typename std::enable_if<std::is_convertible<OtherValue*, Value*>::value>::type>
+            flat_iterator(flat_iterator<OtherTable, OtherValue> const& other)
+                : m_table(other.table()),
+                  m_index(other.index())
+            {
+            }
+
+            // maps keep their entries as std::pair<Instance, Value>, so
+            // that rehashing and erasure can move them, and hand them out
+            // as std::pair<Instance const, Value>
+            Value& operator*() const
+            {
+                return reinterpret_cast<Value&>(m_table->entry(m_index));
+            }
+
+            Value* operator->() const
+            {
+                return std::addressof(**this);
+            }
+
+            flat_iterator& operator++()
+            {
+                m_index = m_table->next(m_index + 1);
+                return *this;
+            }
+
+            flat_iterator operator++(int)
+            {
+                flat_iterator previous{*this};
+                ++*this;
+                return previous;
+            }
+
+            friend bool operator==(flat_iterator const& lhs, flat_iterator const& rhs)
+            {
+                return lhs.m_index == rhs.m_index;
+            }
+
+            friend bool operator!=(flat_iterator const& lhs, flat_iterator const& rhs)
+            {
+                return lhs.m_index != rhs.m_index;
+            }
+
+            Table* table() const
+            {
+                return m_table;
+            }
+
+            std::size_t index() const
+            {
+                return m_index;
+            }
+
+        private:
+            Table* m_table;
+            std::size_t m_index;
+        };
+    }
+
+
+    // A hash set of instances in a single flat array. Inserting copies
+    // or moves the instance in, and lookups only read keys. Neither they
+    // nor rehashing touch a reference count; erasing releases the erased
+    // instance alone. Iterators and references are invalidated by
+    // insertion and erasure.
+    template<typename Instance, typename Key>
+    class instance_set
+    {
+    private:
+        using table = detail::flat_table<Instance>;
+
+    public:
+        using value_type = Instance;
+        using key_type = Instance;
+        using size_type = std::size_t;
+        using iterator = detail::flat_iterator<table const, Instance const>;
+        using const_iterator = iterator;
+
+        iterator begin() const
+        {
+            return iterator{&m_table, m_table.next(0)};
+        }
+
+        iterator end() const
+        {
+            return iterator{&m_table, m_table.capacity()};
+        }
+
+        bool empty() const
+        {
+            return m_table.size() == 0;
+        }
+
+        size_type size() const
+        {
+            return m_table.size();
+        }
+
+        void clear()
+        {
+            m_table.clear();
+        }
+
+        void reserve(size_type count)
+        {
+            m_table.reserve(count);
+        }
+
+        std::pair<iterator, bool> insert(Instance const& obj)
+        {
+            return wrap(m_table.emplace(Key::of(obj), obj));
+        }
+
+        std::pair<iterator, bool> insert(Instance&& obj)
+        {
+            void const* key{Key::of(obj)};
+            return wrap(m_table.emplace(key, std::move(obj)));
+        }
+
+        // key is an instance, or the object itself for address_key
+        template<typename K>
+        iterator find(K const& key) const
+        {
+            return iterator{&m_table, m_table.find(Key::of(key))};
+        }
+
+        template<typename K>
+        bool contains(K const& key) const
+        {
+            return m_table.find(Key::of(key)) != m_table.capacity();
+        }
+
+        template<typename K>
+        size_type count(K const& key) const
+        {
+            return contains(key) ? 1 : 0;
+        }
+
+        template<typename K>
+        size_type erase(K const& key)
+        {
+            return m_table.erase(Key::of(key)) ? 1 : 0;
+        }
+
+        void swap(instance_set& other)
+        {
+            m_table.swap(other.m_table);
+        }
+
+    private:
+        std::pair<iterator, bool> wrap(std::pair<std::size_t, bool> result) const
+        {
+            return std::make_pair(iterator{&m_table, result.first}, result.second);
+        }
+
+        table m_table;
+    };
+
+
+    // A hash map from instances to values in a single flat array, with
+    // the same properties as instance_set. The keys are stored mutable,
+    // so rehashing and erasure move the entries instead of copying them.
+    template<typename Instance, typename Value, typename Key>
+    class instance_map
+    {
+    private:
+        using table = detail::flat_table<std::pair<Instance, Value>>;
+
+        static_assert(sizeof(std::pair<Instance, Value>) == sizeof(std::pair<Instance const, Value>)
+                      && alignof(std::pair<Instance, Value>) == alignof(std::pair<Instance const, Value>),
+                      "entries must be viewable with a const key");
+
+    public:
+        using key_type = Instance;
+        using mapped_type = Value;
+        using value_type = std::pair<Instance const, Value>;
+        using size_type = std::size_t;
+        using iterator = detail::flat_iterator<table, value_type>;
+        using const_iterator = detail::flat_iterator<table const, value_type const>;
+
+        iterator begin()
+        {
+            return iterator{&m_table, m_table.next(0)};
+        }
+
+        iterator end()
+        {
+            return iterator{&m_table, m_table.capacity()};
+        }
+
+        const_iterator begin() const
+        {
+            return const_iterator{&m_table, m_table.next(0)};
+        }
+
+        const_iterator end() const
+        {
+            return const_iterator{&m_table, m_table.capacity()};
+        }
+
+        bool empty() const
+        {
+            return m_table.size() == 0;
+        }
+
+        size_type size() const
+        {
+            return m_table.size();
+        }
+
+        void clear()
+        {
+            m_table.clear();
+        }
+
+        void reserve(size_type count)
+        {
+            m_table.reserve(count);
+        }
+
+        std::pair<iterator, bool> insert(value_type const& value)
+        {
+            return wrap(m_table.emplace(Key::of(value.first), value));
+        }
+
+        std::pair<iterator, bool> insert(value_type&& value)
+        {
+            void const* key{Key::of(value.first)};
+            return wrap(m_table.emplace(key, std::move(value)));
+        }
+
+        // constructs the value from args unless obj is present already
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(Instance const& obj, Args&&... args)
+        {
+            return wrap(m_table.emplace(Key::of(obj),
+                                        std::piecewise_construct,
+                                        std::forward_as_tuple(obj),
+                                        std::forward_as_tuple(std::forward<Args>(args)...)));
+        }
+
+        template<typename... Args>
+        std::pair<iterator, bool> try_emplace(Instance&& obj, Args&&... args)
+        {
+            void const* key{Key::of(obj)};
+            return wrap(m_table.emplace(key,
+                                        std::piecewise_construct,
+                                        std::forward_as_tuple(std::move(obj)),
+                                        std::forward_as_tuple(std::forward<Args>(args)...)));
+        }
+
+        Value& operator[](Instance const& obj)
+        {
+            return try_emplace(obj).first->second;
+        }
+
+        Value& operator[](Instance&& obj)
+        {
+            return try_emplace(std::move(obj)).first->second;
+        }
+
+        template<typename K>
+        Value& at(K const& key)
+        {
+            return const_cast<Value&>(static_cast<instance_map const&>(*this).at(key));
+        }
+
+        template<typename K>
+        Value const& at(K const& key) const
+        {
+            std::size_t i{m_table.find(Key::of(key))};
+
+            if (i == m_table.capacity())
+            {
+                throw std::out_of_range("instance_map::at: key not found");
+            }
+
+            return m_table.entry(i).second;
+        }
+
+        // key is an instance, or the object itself for address_key
+        template<typename K>
+        iterator find(K const& key)
+        {
+            return iterator{&m_table, m_table.find(Key::of(key))};
+        }
+
+        template<typename K>
+        const_iterator find(K const& key) const
+        {
+            return const_iterator{&m_table, m_table.find(Key::of(key))};
+        }
+
+        template<typename K>
+        bool contains(K const& key) const
+        {
+            return m_table.find(Key::of(key)) != m_table.capacity();
+        }
+
+        template<typename K>
+        size_type count(K const& key) const
+        {
+            return contains(key) ? 1 : 0;
+        }
+
+        template<typename K>
+        size_type erase(K const& key)
+        {
+            return m_table.erase(Key::of(key)) ? 1 : 0;
+        }
+
+        void swap(instance_map& other)
+        {
+            m_table.swap(other.m_table);
+        }
+
+    private:
+        std::pair<iterator, bool> wrap(std::pair<std::size_t, bool> result)
+        {
+            return std::make_pair(iterator{&m_table, result.first}, result.second);
+        }
+
+        table m_table;
+    };
+
+    template<typename Instance, typename Key>
+    void swap(instance_set<Instance, Key>& lhs, instance_set<Instance, Key>& rhs)
+    {
+        lhs.swap(rhs);
+    }
+
+    template<typename Instance, typename Value, typename Key>
+    void swap(instance_map<Instance, Value, Key>& lhs, instance_map<Instance, Value, Key>& rhs)
+    {
+        lhs.swap(rhs);
+    }
+}
+
+#endif
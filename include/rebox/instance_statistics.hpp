@@ -0,0 +1,320 @@
+// instance_statistics.hpp -- counting the operations on shared_instance's per type
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_INSTANCE_STATISTICS_HPP
+#define REBOX_INSTANCE_STATISTICS_HPP
+
+#include "type_name.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <typeinfo>
+
+namespace rebox
+{
+    // operations recorded by shared_instance when built with
+    // REBOX_INSTANCE_STATISTICS
+    enum class instance_event
+    {
+        // constructions by source
+        from_pointer,
+        from_shared_ptr,
+        from_weak_ptr,
+        from_unique_ptr,
+        made,
+
+        // copies and moves from other instances, including converting ones
+        copied,
+        moved,
+
+        assigned,
+
+        // ptr() and the conversion to std::shared_ptr; only the lvalue
+        // calls copy the pointer
+        ptr_copied,
+        ptr_moved,
+
+        // pointer casts, counted for the target type
+        cast,
+
+        // aliasing constructions and projections, counted for the member
+        projected,
+
+        // attempts to set an instance to null
+        null_rejected
+    };
+
+    constexpr std::size_t instance_event_count = static_cast<std::size_t>(instance_event::null_rejected) + 1;
+
+    inline char const* event_name(instance_event event)
+    {
+        static char const* const names[instance_event_count] = {
+            "from_pointer",
+            "from_shared_ptr",
+            "from_weak_ptr",
+            "from_unique_ptr",
+            "made",
+            "copied",
+            "moved",
+            "assigned",
+            "ptr_copied",
+            "ptr_moved",
+            "cast",
+            "projected",
+            "null_rejected"
+        };
+
+        return names[static_cast<std::size_t>(event)];
+    }
+
+    class instance_counts
+    {
+    public:
+        std::size_t operator[](instance_event event) const
+        {
+            return counts[static_cast<std::size_t>(event)];
+        }
+
+        std::size_t counts[instance_event_count];
+    };
+
+    namespace detail
+    {
+        class type_statistics;
+
+        // the counters of one thread for one type; only the owning
+        // thread writes them, so no read-modify-write is needed
+        class event_counters
+        {
+        public:
+            explicit event_counters(type_statistics& type);
+            ~event_counters();
+
+            event_counters(event_counters const&) = delete;
+            event_counters& operator=(event_counters const&) = delete;
+
+            void record(instance_event event)
+            {
+                auto& counter = m_counts[static_cast<std::size_t>(event)];
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+
+        private:
+            friend class type_statistics;
+
+            type_statistics& m_type;
+            std::atomic<std::size_t> m_counts[instance_event_count];
+            event_counters* m_previous;
+            event_counters* m_next;
+        };
+
+        // The counters of all threads for one type, and the totals of
+        // the threads which have exited. All types are listed in a
+        // process-wide chain for reporting.
+        class type_statistics
+        {
+        public:
+            explicit type_statistics(char const* name)
+                : m_name(name),
+                  m_threads(nullptr),
+                  m_retired()
+            {
+                std::lock_guard<std::mutex> lock{chain_mutex()};
+                m_next = chain();
+                chain() = this;
+            }
+
+            type_statistics(type_statistics const&) = delete;
+            type_statistics& operator=(type_statistics const&) = delete;
+
+            char const* name() const
+            {
+                return m_name;
+            }
+
+            instance_counts collect() const
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                instance_counts result;
+
+                for (std::size_t i = 0; i < instance_event_count; ++i)
+                {
+                    result.counts[i] = m_retired[i];
+                }
+
+                for (event_counters* thread = m_threads; thread; thread = thread->m_next)
+                {
+                    for (std::size_t i = 0; i < instance_event_count; ++i)
+                    {
+                        result.counts[i] += thread->m_counts[i].load(std::memory_order_relaxed);
+                    }
+                }
+
+                return result;
+            }
+
+            void reset()
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+
+                for (std::size_t i = 0; i < instance_event_count; ++i)
+                {
+                    m_retired[i] = 0;
+                }
+
+                // races with the owning threads, which may lose an
+                // event recorded meanwhile
+                for (event_counters* thread = m_threads; thread; thread = thread->m_next)
+                {
+                    for (std::size_t i = 0; i < instance_event_count; ++i)
+                    {
+                        thread->m_counts[i].store(0, std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            void attach(event_counters& thread)
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+
+                thread.m_previous = nullptr;
+                thread.m_next = m_threads;
+
+                if (m_threads)
+                {
+                    m_threads->m_previous = &thread;
+                }
+
+                m_threads = &thread;
+            }
+
+            void detach(event_counters& thread)
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+
+                for (std::size_t i = 0; i < instance_event_count; ++i)
+                {
+                    m_retired[i] += thread.m_counts[i].load(std::memory_order_relaxed);
+                }
+
+                (thread.m_previous ? thread.m_previous->m_next : m_threads) = thread.m_next;
+
+                if (thread.m_next)
+                {
+                    thread.m_next->m_previous = thread.m_previous;
+                }
+            }
+
+            template<typename Function>
+            static void for_each(Function function)
+            {
+                std::lock_guard<std::mutex> lock{chain_mutex()};
+
+                for (type_statistics* type = chain(); type; type = type->m_next)
+                {
+                    function(*type);
+                }
+            }
+
+        private:
+            static type_statistics*& chain()
+            {
+                static type_statistics* head{nullptr};
+                return head;
+            }
+
+            static std::mutex& chain_mutex()
+            {
+                static std::mutex mutex;
+                return mutex;
+            }
+
+            char const* m_name;
+            type_statistics* m_next;
+
+            mutable std::mutex m_mutex;
+            event_counters* m_threads;
+            std::size_t m_retired[instance_event_count];
+        };
+
+        inline event_counters::event_counters(type_statistics& type)
+            : m_type(type),
+              m_previous(nullptr),
+              m_next(nullptr)
+        {
+            for (auto& counter : m_counts)
+            {
+                counter.store(0, std::memory_order_relaxed);
+            }
+
+            m_type.attach(*this);
+        }
+
+        inline event_counters::~event_counters()
+        {
+            m_type.detach(*this);
+        }
+    }
+
+
+    // the operations recorded for shared_instance<T> and shared_instance<T const>
+    template<typename T>
+    class instance_statistics
+    {
+    public:
+        static void record(instance_event event)
+        {
+            static thread_local detail::event_counters counters{type()};
+            counters.record(event);
+        }
+
+        // sums up the counters of all threads
+        static instance_counts collect()
+        {
+            return type().collect();
+        }
+
+        static void reset()
+        {
+            type().reset();
+        }
+
+    private:
+        static detail::type_statistics& type()
+        {
+            static detail::type_statistics statistics{typeid(T).name()};
+            return statistics;
+        }
+    };
+
+
+    // writes the counts of all types recorded so far, one line per type
+    // with its name and the events which occurred
+    inline void report_instance_statistics(std::ostream& out)
+    {
+        detail::type_statistics::for_each([&](detail::type_statistics const& type)
+        {
+            instance_counts counts{type.collect()};
+            out << detail::demangle(type.name()) << ':';
+
+            for (std::size_t i = 0; i < instance_event_count; ++i)
+            {
+                if (counts.counts[i])
+                {
+                    out << ' ' << event_name(static_cast<instance_event>(i)) << '=' << counts.counts[i];
+                }
+            }
+
+            out << '\n';
+        });
+    }
+}
+
+#endif
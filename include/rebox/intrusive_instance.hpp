@@ -0,0 +1,316 @@
+// intrusive_instance.hpp -- a never-null handle to an object carrying its own reference count
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_INTRUSIVE_INSTANCE_HPP
+#define REBOX_INTRUSIVE_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+#include "count.hpp"
+
+#include <functional>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+namespace rebox
+{
+    // Base class providing the reference count for intrusive_instance.
+    // Types not deriving from it need to provide the hooks
+    // intrusive_ptr_add_ref(T*) and intrusive_ptr_release(T*) found
+    // by argument dependent lookup, like for boost::intrusive_ptr.
+    template<typename Derived, typename Count = atomic_count>
+    class intrusive_counted
+    {
+    public:
+        long use_count() const
+        {
+            return Count::load(m_count);
+        }
+
+    protected:
+        intrusive_counted()
+            : m_count(0)
+        {
+        }
+
+        // copies start with a count of their own
+        intrusive_counted(intrusive_counted const&)
+            : m_count(0)
+        {
+        }
+
+        intrusive_counted& operator=(intrusive_counted const&)
+        {
+            return *this;
+        }
+
+        ~intrusive_counted() = default;
+
+    private:
+        friend void intrusive_ptr_add_ref(intrusive_counted const* obj)
+        {
+            Count::increment(obj->m_count);
+        }
+
+        friend void intrusive_ptr_release(intrusive_counted const* obj)
+        {
+            if (Count::decrement(obj->m_count))
+            {
+                delete static_cast<Derived const*>(obj);
+            }
+        }
+
+        mutable typename Count::type m_count;
+    };
+
+
+    template<typename T, typename Report>
+    class intrusive_instance
+    {
+    public:
+        using type = T;
+
+        intrusive_instance() = delete;
+
+        // constructors from other intrusive_instance's
+        intrusive_instance(intrusive_instance const&);
+
+        template<typename Y, typename Z>
+        intrusive_instance(intrusive_instance<Y, Z> const&);
+
+        intrusive_instance(intrusive_instance&&) noexcept;
+
+        template<typename Y, typename Z>
+        intrusive_instance(intrusive_instance<Y, Z>&&);
+
+        // constructors from plain pointers, taking a reference
+        template<typename Y>
+        explicit intrusive_instance(Y*);
+
+        ~intrusive_instance();
+
+        intrusive_instance& operator=(intrusive_instance const& other);
+        intrusive_instance& operator=(intrusive_instance&& other) noexcept;
+
+        template<typename Y, typename Z>
+        intrusive_instance& operator=(intrusive_instance<Y, Z> const& other);
+
+        operator T&() const;
+        T& get() const;
+
+        void swap(intrusive_instance&) noexcept;
+
+        T* ptr() const;
+
+    private:
+        template<typename, typename>
+        friend class intrusive_instance;
+
+        template<typename Y>
+        void check(Y const&) const;
+
+        T* m_obj;
+    };
+
+    template<typename T, typename Report>
+    intrusive_instance<T, Report>::intrusive_instance(intrusive_instance const& other)
+        : m_obj(other.m_obj)
+    {
+        // null after other was moved from
+        if (m_obj)
+        {
+            intrusive_ptr_add_ref(m_obj);
+        }
+    }
+
+    template<typename T, typename Report>
+    template<typename Y, typename Z>
+    intrusive_instance<T, Report>::intrusive_instance(intrusive_instance<Y, Z> const& other)
+        : m_obj(other.m_obj)
+    {
+        check(m_obj);
+        if (m_obj)
+        {
+            intrusive_ptr_add_ref(m_obj);
+        }
+    }
+
+    template<typename T, typename Report>
+    intrusive_instance<T, Report>::intrusive_instance(intrusive_instance&& other) noexcept
+        : m_obj(other.m_obj)
+    {
+        other.m_obj = nullptr;
+    }
+
+    template<typename T, typename Report>
+    template<typename Y, typename Z>
+    intrusive_instance<T, Report>::intrusive_instance(intrusive_instance<Y, Z>&& other)
+        : m_obj(other.m_obj)
+    {
+        check(m_obj);
+        other.m_obj = nullptr;
+    }
+
+    template<typename T, typename Report>
+    template<typename Y>
+    intrusive_instance<T, Report>::intrusive_instance(Y* obj)
+        : m_obj(obj)
+    {
+        // a Report that does not throw leaves the instance null
+        check(m_obj);
+        if (m_obj)
+        {
+            intrusive_ptr_add_ref(m_obj);
+        }
+    }
+
+    template<typename T, typename Report>
+    intrusive_instance<T, Report>::~intrusive_instance()
+    {
+        // only null after being moved from
+        if (m_obj)
+        {
+            intrusive_ptr_release(m_obj);
+        }
+    }
+
+    template<typename T, typename Report>
+    intrusive_instance<T, Report>&
+    intrusive_instance<T, Report>::operator=(intrusive_instance const& other)
+    {
+        intrusive_instance(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Report>
+    intrusive_instance<T, Report>&
+    intrusive_instance<T, Report>::operator=(intrusive_instance&& other) noexcept
+    {
+        intrusive_instance(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Report>
+    template<typename Y, typename Z>
+    intrusive_instance<T, Report>&
+    intrusive_instance<T, Report>::operator=(intrusive_instance<Y, Z> const& other)
+    {
+        intrusive_instance(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Report>
+    intrusive_instance<T, Report>::operator T&() const
+    {
+        return *m_obj;
+    }
+
+    template<typename T, typename Report>
+    T&
+    intrusive_instance<T, Report>::get() const
+    {
+        return *m_obj;
+    }
+
+    template<typename T, typename Report>
+    void
+    intrusive_instance<T, Report>::swap(intrusive_instance& other) noexcept
+    {
+        std::swap(m_obj, other.m_obj);
+    }
+
+    template<typename T, typename Report>
+    T*
+    intrusive_instance<T, Report>::ptr() const
+    {
+        return m_obj;
+    }
+
+    template<typename T, typename Report>
+    template<typename Y>
+    void
+    intrusive_instance<T, Report>::check(Y const& ptr) const
+    {
+        if (!ptr)
+        {
+            Report()();
+        }
+    }
+
+    // compare two intrusive_instances
+    template<typename T, typename TReport, typename U, typename UReport>
+    bool operator==(const intrusive_instance<T, TReport>& lhs, const intrusive_instance<U, UReport>& rhs)
+    {
+        return lhs.ptr() == rhs.ptr();
+    }
+
+    template<typename T, typename TReport, typename U, typename UReport>
+    bool operator!=(const intrusive_instance<T, TReport>& lhs, const intrusive_instance<U, UReport>& rhs)
+    {
+        return lhs.ptr() != rhs.ptr();
+    }
+
+    template<typename T, typename TReport, typename U, typename UReport>
+    bool operator<(const intrusive_instance<T, TReport>& lhs, const intrusive_instance<U, UReport>& rhs)
+    {
+        return std::less<typename std::common_type<T*, U*>::type>()(lhs.ptr(), rhs.ptr());
+    }
+
+    template<typename T, typename TReport, typename U, typename UReport>
+    bool operator>(const intrusive_instance<T, TReport>& lhs, const intrusive_instance<U, UReport>& rhs)
+    {
+        return rhs < lhs;
+    }
+
+    template<typename T, typename TReport, typename U, typename UReport>
+    bool operator<=(const intrusive_instance<T, TReport>& lhs, const intrusive_instance<U, UReport>& rhs)
+    {
+        return !(rhs < lhs);
+    }
+
+    template<typename T, typename TReport, typename U, typename UReport>
+    bool operator>=(const intrusive_instance<T, TReport>& lhs, const intrusive_instance<U, UReport>& rhs)
+    {
+        return !(lhs < rhs);
+    }
+
+    template<typename T, typename U, typename V, typename Report>
+    std::basic_ostream<U, V>& operator<< (std::basic_ostream<U, V>& out, intrusive_instance<T, Report> const& obj)
+    {
+        out << obj.ptr();
+        return out;
+    }
+
+    template<typename Target, typename Source, typename Report>
+    intrusive_instance<Target, Report> static_pointer_cast(intrusive_instance<Source, Report> const& obj)
+    {
+        return intrusive_instance<Target, Report>{static_cast<Target*>(obj.ptr())};
+    }
+
+    template<typename Target, typename Source, typename Report>
+    intrusive_instance<Target, Report> const_pointer_cast(intrusive_instance<Source, Report> const& obj)
+    {
+        return intrusive_instance<Target, Report>{const_cast<Target*>(obj.ptr())};
+    }
+
+    template<typename T, typename Report>
+    void
+    swap(intrusive_instance<T, Report>& foo, intrusive_instance<T, Report>& bar)
+    {
+        foo.swap(bar);
+    }
+
+
+    template<typename T, typename Report = throw_invalid_argument, typename... Args>
+    intrusive_instance<T, Report>
+    make_intrusive_instance(Args&&... args)
+    {
+        return intrusive_instance<T, Report>{new T(std::forward<Args>(args)...)};
+    }
+}
+
+#endif
@@ -0,0 +1,149 @@
+// local_shared_instance.hpp -- a shared_instance with a non-atomic reference count
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_LOCAL_SHARED_INSTANCE_HPP
+#define REBOX_LOCAL_SHARED_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+#include "counted_ptr.hpp"
+
+#include <memory>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+namespace rebox
+{
+    // reference counting through counted_ptr using the given Count policy
+    template<typename Count>
+    class counted
+    {
+    public:
+        template<typename T>
+        using pointer = counted_ptr<T, Count>;
+
+        template<typename T>
+        using weak_pointer = counted_weak_ptr<T, Count>;
+
+        template<typename T, typename... Args>
+        static counted_ptr<T, Count> make_shared(Args&&... args)
+        {
+            return make_counted<T, Count>(std::forward<Args>(args)...);
+        }
+
+        template<typename T, typename Alloc, typename... Args>
+        static counted_ptr<T, Count> allocate_shared(Alloc const& alloc, Args&&... args)
+        {
+            return allocate_counted<T, Count>(alloc, std::forward<Args>(args)...);
+        }
+
+        // transfers the ownership of ptr to target, which points into the same object
+        template<typename Target, typename Source>
+        static counted_ptr<Target, Count> alias(counted_ptr<Source, Count>&& ptr, Target* target)
+        {
+            return counted_ptr<Target, Count>(std::move(ptr), target);
+        }
+
+        // the address of the control block, which identifies the owner
+        template<typename T>
+        static void const* owner(counted_ptr<T, Count> const& ptr)
+        {
+            return detail::counted_access::block(ptr);
+        }
+    };
+
+#if REBOX_INSTANCE_REGISTRY
+    namespace detail
+    {
+        template<typename Count>
+        long block_use_count(void const* block)
+        {
+            return static_cast<counted_block<Count> const*>(block)->use_count();
+        }
+
+        // registers the objects of counted_ptr's by their control block;
+        // the counts of single_threaded instances are read without
+        // synchronisation, so collect them on the thread using them
+        template<typename Count>
+        class registering_make<counted<Count>>
+        {
+        public:
+            template<typename T, typename... Args>
+            static counted_ptr<T, Count> make_shared(void const* caller, Args&&... args)
+            {
+                using object = typename std::remove_const<T>::type;
+                return allocate_shared<T>(caller, std::allocator<object>(), std::forward<Args>(args)...);
+            }
+
+            template<typename T, typename Alloc, typename... Args>
+            static counted_ptr<T, Count> allocate_shared(void const* caller, Alloc const& alloc, Args&&... args)
+            {
+                auto node = instance_registry::instance().enter(typeid(T).name(), sizeof(T), call_site{"", "", 0}, caller);
+
+                try
+                {
+                    registering_allocator<T, Alloc> registering(alloc, node);
+                    auto result = allocate_counted<T, Count>(registering, std::forward<Args>(args)...);
+                    own(node, result);
+                    return result;
+                }
+                catch (...)
+                {
+                    instance_registry::instance().leave(node);
+                    throw;
+                }
+            }
+
+            template<typename Y, typename Deleter>
+            static counted_ptr<Y, Count> adopt(Y* obj, Deleter deleter, call_site site)
+            {
+                return adopt(obj, std::move(deleter), std::allocator<void>(), site);
+            }
+
+            template<typename Y, typename Deleter, typename Alloc>
+            static counted_ptr<Y, Count> adopt(Y* obj, Deleter deleter, Alloc alloc, call_site site, void const* caller = nullptr)
+            {
+                if (!obj)
+                {
+                    return counted_ptr<Y, Count>(obj, std::move(deleter), std::move(alloc));
+                }
+
+                auto node = instance_registry::instance().enter(typeid(Y).name(), sizeof(Y), site, caller);
+
+                // deletes obj and leaves the registry if this throws
+                counted_ptr<Y, Count> result(obj, registering_deleter<Deleter>{std::move(deleter), node}, std::move(alloc));
+                own(node, result);
+                return result;
+            }
+
+            template<typename Y, typename Deleter>
+            static counted_ptr<Y, Count> adopt(std::unique_ptr<Y, Deleter>&& other, call_site site, void const* caller = nullptr)
+            {
+                adopted_deleter<Deleter> deleter(std::forward<Deleter>(other.get_deleter()));
+                return adopt(other.release(), std::move(deleter), std::allocator<void>(), site, caller);
+            }
+
+        private:
+            template<typename T>
+            static void own(registry_node* node, counted_ptr<T, Count> const& ptr)
+            {
+                instance_registry::instance().own(node, ptr.get(), counted_access::block(ptr), &block_use_count<Count>);
+            }
+        };
+    }
+#endif
+
+
+    template<typename T, typename Report = throw_invalid_argument, typename... Args>
+    local_shared_instance<T, Report>
+    make_local_shared_instance(Args&&... args)
+    {
+        return make_shared_instance<T, Report, single_threaded>(std::forward<Args>(args)...);
+    }
+}
+
+#endif
@@ -0,0 +1,200 @@
+// optional_instance.hpp -- internals shared by cow_instance and the persistent containers
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_OPTIONAL_INSTANCE_HPP
+#define REBOX_OPTIONAL_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace rebox
+{
+    namespace detail
+    {
+        // whether obj, which must not have been handed out, is held by the
+        // caller alone; if so, writes which follow happen after the last
+        // reads of previous owners, see cow_instance
+        template<typename T>
+        bool held_alone(shared_instance<T> const& obj)
+        {
+            if (obj.use_count() != 1)
+            {
+                return false;
+            }
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return true;
+        }
+
+        // a shared_instance which may be absent, as std::optional needs
+        // C++17; moving one leaves the source absent
+        template<typename T>
+        class optional_instance
+        {
+        public:
+            optional_instance() noexcept;
+            optional_instance(optional_instance const& other) noexcept;
+            optional_instance(optional_instance&& other) noexcept;
+
+            optional_instance& operator=(optional_instance const& other) noexcept;
+            optional_instance& operator=(optional_instance&& other) noexcept;
+
+            ~optional_instance();
+
+            explicit operator bool() const;
+
+            shared_instance<T>& operator*();
+            shared_instance<T> const& operator*() const;
+
+            shared_instance<T>* operator->();
+            shared_instance<T> const* operator->() const;
+
+            void emplace(shared_instance<T> value) noexcept;
+            void reset() noexcept;
+
+        private:
+            union
+            {
+                shared_instance<T> m_value;
+            };
+
+            bool m_engaged;
+        };
+
+        template<typename T>
+        optional_instance<T>::optional_instance() noexcept
+            : m_engaged(false)
+        {
+        }
+
+        template<typename T>
+        optional_instance<T>::optional_instance(optional_instance const& other) noexcept
+            : m_engaged(false)
+        {
+            if (other.m_engaged)
+            {
+                emplace(other.m_value);
+            }
+        }
+
+        template<typename T>
+        optional_instance<T>::optional_instance(optional_instance&& other) noexcept
+            : m_engaged(false)
+        {
+            if (other.m_engaged)
+            {
+                emplace(std::move(other.m_value));
+                other.reset();
+            }
+        }
+
+        template<typename T>
+        optional_instance<T>&
+        optional_instance<T>::operator=(optional_instance const& other) noexcept
+        {
+            if (!other.m_engaged)
+            {
+                reset();
+            }
+            else if (this != &other)
+            {
+                emplace(other.m_value);
+            }
+
+            return *this;
+        }
+
+        template<typename T>
+        optional_instance<T>&
+        optional_instance<T>::operator=(optional_instance&& other) noexcept
+        {
+            if (this != &other)
+            {
+                reset();
+
+                if (other.m_engaged)
+                {
+                    emplace(std::move(other.m_value));
+                    other.reset();
+                }
+            }
+
+            return *this;
+        }
+
+        template<typename T>
+        optional_instance<T>::~optional_instance()
+        {
+            reset();
+        }
+
+        template<typename T>
+        optional_instance<T>::operator bool() const
+        {
+            return m_engaged;
+        }
+
+        template<typename T>
+        shared_instance<T>&
+        optional_instance<T>::operator*()
+        {
+            return m_value;
+        }
+
+        template<typename T>
+        shared_instance<T> const&
+        optional_instance<T>::operator*() const
+        {
+            return m_value;
+        }
+
+        template<typename T>
+        shared_instance<T>*
+        optional_instance<T>::operator->()
+        {
+            return &m_value;
+        }
+
+        template<typename T>
+        shared_instance<T> const*
+        optional_instance<T>::operator->() const
+        {
+            return &m_value;
+        }
+
+        template<typename T>
+        void
+        optional_instance<T>::emplace(shared_instance<T> value) noexcept
+        {
+            if (m_engaged)
+            {
+                m_value = std::move(value);
+            }
+            else
+            {
+                ::new (static_cast<void*>(&m_value)) shared_instance<T>(std::move(value));
+                m_engaged = true;
+            }
+        }
+
+        template<typename T>
+        void
+        optional_instance<T>::reset() noexcept
+        {
+            if (m_engaged)
+            {
+                m_value.~shared_instance<T>();
+                m_engaged = false;
+            }
+        }
+    }
+}
+
+#endif
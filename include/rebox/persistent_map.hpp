@@ -0,0 +1,979 @@
+// persistent_map.hpp -- an immutable hash map sharing structure between its versions
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_PERSISTENT_MAP_HPP
+#define REBOX_PERSISTENT_MAP_HPP
+
+#include "optional_instance.hpp"
+#include "shared_array.hpp"
+#include "shared_instance.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rebox
+{
+    namespace detail
+    {
+        constexpr unsigned map_bits{5};
+        constexpr std::size_t map_mask{(std::size_t{1} << map_bits) - 1};
+        constexpr unsigned hash_bits{std::numeric_limits<std::size_t>::digits};
+
+        // the levels consuming the hash, and one for collisions below
+        constexpr std::size_t map_depth{(hash_bits + map_bits - 1) / map_bits + 1};
+
+        inline unsigned popcount(std::uint32_t bits)
+        {
+#if defined(__GNUC__)
+            return static_cast<unsigned>(__builtin_popcount(bits));
+#else
+            bits = bits - ((bits >> 1) & 0x55555555u);
+            bits = (bits & 0x33333333u) + ((bits >> 2) & 0x33333333u);
+            return (((bits + (bits >> 4)) & 0x0F0F0F0Fu) * 0x01010101u) >> 24;
+#endif
+        }
+
+        // which of the 32 slots a node would have are taken; nodes below
+        // the last bits of the hash hold colliding entries and leave it 0
+        class map_header
+        {
+        public:
+            explicit map_header(std::uint32_t bitmap)
+                : bitmap(bitmap)
+            {
+            }
+
+            std::uint32_t bitmap;
+        };
+
+        template<typename Entry>
+        class map_node;
+
+        // an entry, or a node of the entries whose hashes agree this far
+        template<typename Entry>
+        class map_slot
+        {
+        public:
+            using node_type = shared_instance<map_node<Entry>>;
+
+            explicit map_slot(Entry const& entry);
+            explicit map_slot(Entry&& entry);
+            explicit map_slot(node_type&& node) noexcept;
+
+            map_slot(map_slot const& other);
+            map_slot(map_slot&& other) noexcept(std::is_nothrow_move_constructible<Entry>::value);
+
+            map_slot& operator=(map_slot const&) = delete;
+            map_slot& operator=(map_slot&&) = delete;
+
+            ~map_slot();
+
+            // destroys the content before moving other in, so moving
+            // other must not throw
+            void replace(map_slot&& other) noexcept;
+
+            bool holds_entry() const;
+
+            Entry& entry();
+            Entry const& entry() const;
+
+            node_type& node();
+            node_type const& node() const;
+
+        private:
+            void destroy();
+
+            union
+            {
+                Entry m_entry;
+                node_type m_node;
+            };
+
+            bool m_isEntry;
+        };
+
+        template<typename Entry>
+        map_slot<Entry>::map_slot(Entry const& entry)
+            : m_entry(entry),
+              m_isEntry(true)
+        {
+        }
+
+        template<typename Entry>
+        map_slot<Entry>::map_slot(Entry&& entry)
+            : m_entry(std::move(entry)),
+              m_isEntry(true)
+        {
+        }
+
+        template<typename Entry>
+        map_slot<Entry>::map_slot(node_type&& node) noexcept
+            : m_node(std::move(node)),
+              m_isEntry(false)
+        {
+        }
+
+        template<typename Entry>
+        map_slot<Entry>::map_slot(map_slot const& other)
+            : m_isEntry(other.m_isEntry)
+        {
+            if (m_isEntry)
+            {
+                ::new (static_cast<void*>(&m_entry)) Entry(other.m_entry);
+            }
+            else
+            {
+                ::new (static_cast<void*>(&m_node)) node_type(other.m_node);
+            }
+        }
+
+        template<typename Entry>
+        map_slot<Entry>::map_slot(map_slot&& other) noexcept(std::is_nothrow_move_constructible<Entry>::value)
+            : m_isEntry(other.m_isEntry)
+        {
+            if (m_isEntry)
+            {
+                ::new (static_cast<void*>(&m_entry)) Entry(std::move(other.m_entry));
+            }
+            else
+            {
+                ::new (static_cast<void*>(&m_node)) node_type(std::move(other.m_node));
+            }
+        }
+
+        template<typename Entry>
+        map_slot<Entry>::~map_slot()
+        {
+            destroy();
+        }
+
+        template<typename Entry>
+        void
+        map_slot<Entry>::replace(map_slot&& other) noexcept
+        {
+            destroy();
+            ::new (static_cast<void*>(this)) map_slot(std::move(other));
+        }
+
+        template<typename Entry>
+        bool
+        map_slot<Entry>::holds_entry() const
+        {
+            return m_isEntry;
+        }
+
+        template<typename Entry>
+        Entry&
+        map_slot<Entry>::entry()
+        {
+            return m_entry;
+        }
+
+        template<typename Entry>
+        Entry const&
+        map_slot<Entry>::entry() const
+        {
+            return m_entry;
+        }
+
+        template<typename Entry>
+        typename map_slot<Entry>::node_type&
+        map_slot<Entry>::node()
+        {
+            return m_node;
+        }
+
+        template<typename Entry>
+        typename map_slot<Entry>::node_type const&
+        map_slot<Entry>::node() const
+        {
+            return m_node;
+        }
+
+        template<typename Entry>
+        void
+        map_slot<Entry>::destroy()
+        {
+            if (m_isEntry)
+            {
+                m_entry.~Entry();
+            }
+            else
+            {
+                m_node.~node_type();
+            }
+        }
+
+        // the taken slots in order, allocated with the reference count
+        template<typename Entry>
+        class map_node : public trailing<map_header, map_slot<Entry>>
+        {
+        public:
+            using trailing<map_header, map_slot<Entry>>::trailing;
+        };
+
+        // a node holding size slots, which are moved from
+        template<typename Entry>
+        shared_instance<map_node<Entry>> make_map_node(std::uint32_t bitmap, map_slot<Entry>* slots, std::size_t size)
+        {
+            auto init = [slots](map_slot<Entry>* first, std::size_t count)
+            {
+                std::size_t index{0};
+                construct_elements(first, count, [&](void* element)
+                {
+                    ::new (element) map_slot<Entry>(std::move(slots[index++]));
+                });
+            };
+
+            return instance_access::adopt<shared_instance<map_node<Entry>>>(
+                make_trailing<map_node<Entry>, multi_threaded>(size, init, bitmap));
+        }
+
+        // A copy of source where erased slots at index are replaced by
+        // inserted, if not null. The slots of source are moved if it is
+        // held alone and that cannot throw.
+        template<typename Entry>
+        shared_instance<map_node<Entry>> splice(map_node<Entry>& source,
+                                                bool alone,
+                                                std::size_t index,
+                                                std::size_t erased,
+                                                map_slot<Entry>* inserted,
+                                                std::uint32_t bitmap)
+        {
+            bool move{alone && std::is_nothrow_move_constructible<map_slot<Entry>>::value};
+            std::size_t added{inserted ? std::size_t{1} : 0};
+
+            auto init = [&](map_slot<Entry>* first, std::size_t count)
+            {
+                std::size_t to{0};
+                construct_elements(first, count, [&](void* element)
+                {
+                    if (inserted && to == index)
+                    {
+                        ::new (element) map_slot<Entry>(std::move(*inserted));
+                    }
+                    else
+                    {
+                        auto& from = source[to < index ? to : to + erased - added];
+
+                        if (move)
+                        {
+                            ::new (element) map_slot<Entry>(std::move(from));
+                        }
+                        else
+                        {
+                            ::new (element) map_slot<Entry>(from);
+                        }
+                    }
+
+                    ++to;
+                });
+            };
+
+            return instance_access::adopt<shared_instance<map_node<Entry>>>(
+                make_trailing<map_node<Entry>, multi_threaded>(source.size() - erased + added, init, bitmap));
+        }
+
+        // visits the entries depth first
+        template<typename Entry>
+        class map_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Entry;
+            using difference_type = std::ptrdiff_t;
+            using pointer = Entry const*;
+            using reference = Entry const&;
+
+            map_iterator()
+                : m_depth(0)
+            {
+            }
+
+            explicit map_iterator(map_node<Entry> const& root)
+                : m_depth(0)
+            {
+                m_stack[m_depth++] = position{&root, 0};
+                advance();
+            }
+
+            Entry const& operator*() const
+            {
+                auto const& top = m_stack[m_depth - 1];
+                return (*top.node)[top.index].entry();
+            }
+
+            Entry const* operator->() const
+            {
+                return &**this;
+            }
+
+            map_iterator& operator++()
+            {
+                ++m_stack[m_depth - 1].index;
+                advance();
+                return *this;
+            }
+
+            map_iterator operator++(int)
+            {
+                map_iterator previous{*this};
+                ++*this;
+                return previous;
+            }
+
+            friend bool operator==(map_iterator const& lhs, map_iterator const& rhs)
+            {
+                return lhs.m_depth == rhs.m_depth &&
+                       (lhs.m_depth == 0 || (lhs.m_stack[lhs.m_depth - 1].node == rhs.m_stack[rhs.m_depth - 1].node &&
+                                             lhs.m_stack[lhs.m_depth - 1].index == rhs.m_stack[rhs.m_depth - 1].index));
+            }
+
+            friend bool operator!=(map_iterator const& lhs, map_iterator const& rhs)
+            {
+                return !(lhs == rhs);
+            }
+
+        private:
+            class position
+            {
+            public:
+                map_node<Entry> const* node;
+                std::size_t index;
+            };
+
+            // from the current slot on to the next entry, or the end
+            void advance()
+            {
+                while (m_depth != 0)
+                {
+                    auto& top = m_stack[m_depth - 1];
+
+                    if (top.index == top.node->size())
+                    {
+                        if (--m_depth != 0)
+                        {
+                            ++m_stack[m_depth - 1].index;
+                        }
+
+                        continue;
+                    }
+
+                    auto const& slot = (*top.node)[top.index];
+
+                    if (slot.holds_entry())
+                    {
+                        return;
+                    }
+
+                    m_stack[m_depth++] = position{&slot.node().get(), 0};
+                }
+            }
+
+            std::array<position, map_depth> m_stack;
+            std::size_t m_depth;
+        };
+    }
+
+    // An immutable hash map from Key to Value. Changing it yields a new
+    // map which shares all but the changed path with the old one: a hash
+    // array mapped trie whose nodes are shared_instance's holding only
+    // the slots taken, 5 bits of the hash per level. Copies take constant
+    // time, changes an allocation per level, and lookups walk the trie
+    // without checking for null. Keys whose hashes are equal end up in a
+    // node searched linearly.
+    //
+    // As for persistent_vector, batches of changes are better made
+    // through a transient_map, and versions can be used from any thread.
+    template<typename Key,
+             typename Value,
+             typename Hash = std::hash<Key>,
+             typename Equal = std::equal_to<Key>>
+    class persistent_map
+    {
+    public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key, Value>;
+        using size_type = std::size_t;
+        using hasher = Hash;
+        using key_equal = Equal;
+        using iterator = detail::map_iterator<value_type>;
+        using const_iterator = iterator;
+
+        explicit persistent_map(Hash const& hash = Hash(), Equal const& equal = Equal());
+
+        persistent_map(persistent_map const&) = default;
+        persistent_map& operator=(persistent_map const&) = default;
+
+        // leave other empty
+        persistent_map(persistent_map&& other);
+        persistent_map& operator=(persistent_map&& other);
+
+        std::size_t size() const;
+        bool empty() const;
+
+        // the value mapped to key, or null
+        Value const* find(Key const& key) const;
+        bool contains(Key const& key) const;
+
+        // in no particular order
+        iterator begin() const;
+        iterator end() const;
+
+        // the map with a change applied; this one is left untouched
+        persistent_map set(Key key, Value value) const;
+        persistent_map erase(Key const& key) const;
+
+        transient_map<Key, Value, Hash, Equal> transient() const;
+
+    private:
+        friend class transient_map<Key, Value, Hash, Equal>;
+
+        using entry = value_type;
+        using node = detail::map_node<entry>;
+        using slot = detail::map_slot<entry>;
+        using instance = shared_instance<node>;
+
+        void assign(Key&& key, Value&& value);
+        void remove(Key const& key);
+
+        // whether added was new below target, whose node is at shift
+        bool insert(instance& target, unsigned shift, std::size_t hash, entry& added);
+        bool remove(instance& target, unsigned shift, std::size_t hash, Key const& key);
+
+        // whether a single entry is left in below after a removal, which
+        // then takes the place of the node
+        bool lifted(instance const& below) const;
+
+        // that entry, moved out if below is held alone
+        slot lift(instance& below) const;
+
+        void replace_value(instance& target, bool alone, std::size_t index, entry& added);
+        instance pair_node(unsigned shift, entry const& first, std::size_t firstHash, entry&& second, std::size_t secondHash) const;
+
+        std::size_t m_size;
+
+        // absent while the map is empty
+        detail::optional_instance<node> m_root;
+
+        Hash m_hash;
+        Equal m_equal;
+    };
+
+    // A persistent_map to be changed in place, like transient_vector.
+    // Replacing a value takes no allocation once the path to it is held
+    // alone; adding or removing a key reallocates the node holding it.
+    template<typename Key,
+             typename Value,
+             typename Hash = std::hash<Key>,
+             typename Equal = std::equal_to<Key>>
+    class transient_map
+    {
+    public:
+        using key_type = Key;
+        using mapped_type = Value;
+        using value_type = std::pair<Key, Value>;
+        using size_type = std::size_t;
+
+        explicit transient_map(Hash const& hash = Hash(), Equal const& equal = Equal());
+        explicit transient_map(persistent_map<Key, Value, Hash, Equal> map);
+
+        std::size_t size() const;
+        bool empty() const;
+
+        Value const* find(Key const& key) const;
+        bool contains(Key const& key) const;
+
+        void set(Key key, Value value);
+        void erase(Key const& key);
+
+        persistent_map<Key, Value, Hash, Equal> persistent() const&;
+        persistent_map<Key, Value, Hash, Equal> persistent() &&;
+
+    private:
+        persistent_map<Key, Value, Hash, Equal> m_map;
+    };
+
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>::persistent_map(Hash const& hash, Equal const& equal)
+        : m_size(0),
+          m_hash(hash),
+          m_equal(equal)
+    {
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>::persistent_map(persistent_map&& other)
+        : m_size(other.m_size),
+          m_root(std::move(other.m_root)),
+          m_hash(other.m_hash),
+          m_equal(other.m_equal)
+    {
+        other.m_size = 0;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>&
+    persistent_map<Key, Value, Hash, Equal>::operator=(persistent_map&& other)
+    {
+        if (this != &other)
+        {
+            m_size = other.m_size;
+            m_root = std::move(other.m_root);
+            m_hash = other.m_hash;
+            m_equal = other.m_equal;
+
+            other.m_size = 0;
+        }
+
+        return *this;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    std::size_t
+    persistent_map<Key, Value, Hash, Equal>::size() const
+    {
+        return m_size;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    persistent_map<Key, Value, Hash, Equal>::empty() const
+    {
+        return m_size == 0;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    Value const*
+    persistent_map<Key, Value, Hash, Equal>::find(Key const& key) const
+    {
+        if (!m_root)
+        {
+            return nullptr;
+        }
+
+        std::size_t hash{m_hash(key)};
+        node const* current{&m_root->get()};
+
+        for (unsigned shift = 0; shift < detail::hash_bits; shift += detail::map_bits)
+        {
+            std::uint32_t bit{std::uint32_t{1} << ((hash >> shift) & detail::map_mask)};
+            std::uint32_t bitmap{current->header().bitmap};
+
+            if (!(bitmap & bit))
+            {
+                return nullptr;
+            }
+
+            auto const& found = (*current)[detail::popcount(bitmap & (bit - 1))];
+
+            if (found.holds_entry())
+            {
+                auto const& existing = found.entry();
+                return m_equal(existing.first, key) ? &existing.second : nullptr;
+            }
+
+            current = &found.node().get();
+        }
+
+        for (auto const& colliding : *current)
+        {
+            auto const& existing = colliding.entry();
+
+            if (m_equal(existing.first, key))
+            {
+                return &existing.second;
+            }
+        }
+
+        return nullptr;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    persistent_map<Key, Value, Hash, Equal>::contains(Key const& key) const
+    {
+        return find(key) != nullptr;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    typename persistent_map<Key, Value, Hash, Equal>::iterator
+    persistent_map<Key, Value, Hash, Equal>::begin() const
+    {
+        return m_root ? iterator{m_root->get()} : iterator{};
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    typename persistent_map<Key, Value, Hash, Equal>::iterator
+    persistent_map<Key, Value, Hash, Equal>::end() const
+    {
+        return iterator{};
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>
+    persistent_map<Key, Value, Hash, Equal>::set(Key key, Value value) const
+    {
+        persistent_map result{*this};
+        result.assign(std::move(key), std::move(value));
+        return result;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>
+    persistent_map<Key, Value, Hash, Equal>::erase(Key const& key) const
+    {
+        persistent_map result{*this};
+        result.remove(key);
+        return result;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    transient_map<Key, Value, Hash, Equal>
+    persistent_map<Key, Value, Hash, Equal>::transient() const
+    {
+        return transient_map<Key, Value, Hash, Equal>{*this};
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    void
+    persistent_map<Key, Value, Hash, Equal>::assign(Key&& key, Value&& value)
+    {
+        std::size_t hash{m_hash(key)};
+        entry added{std::move(key), std::move(value)};
+
+        if (!m_root)
+        {
+            slot first{std::move(added)};
+            m_root.emplace(detail::make_map_node<entry>(std::uint32_t{1} << (hash & detail::map_mask), &first, 1));
+            m_size = 1;
+            return;
+        }
+
+        if (insert(*m_root, 0, hash, added))
+        {
+            ++m_size;
+        }
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    void
+    persistent_map<Key, Value, Hash, Equal>::remove(Key const& key)
+    {
+        if (m_root && remove(*m_root, 0, m_hash(key), key) && --m_size == 0)
+        {
+            m_root.reset();
+        }
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    persistent_map<Key, Value, Hash, Equal>::insert(instance& target, unsigned shift, std::size_t hash, entry& added)
+    {
+        node& current{target.get()};
+        bool alone{detail::held_alone(target)};
+
+        if (shift >= detail::hash_bits)
+        {
+            for (std::size_t index = 0; index != current.size(); ++index)
+            {
+                if (m_equal(current[index].entry().first, added.first))
+                {
+                    replace_value(target, alone, index, added);
+                    return false;
+                }
+            }
+
+            slot inserted{std::move(added)};
+            target = detail::splice(current, alone, current.size(), 0, &inserted, 0);
+            return true;
+        }
+
+        std::uint32_t bit{std::uint32_t{1} << ((hash >> shift) & detail::map_mask)};
+        std::uint32_t bitmap{current.header().bitmap};
+        std::size_t index{detail::popcount(bitmap & (bit - 1))};
+
+        if (!(bitmap & bit))
+        {
+            slot inserted{std::move(added)};
+            target = detail::splice(current, alone, index, 0, &inserted, bitmap | bit);
+            return true;
+        }
+
+        slot& found{current[index]};
+
+        if (found.holds_entry())
+        {
+            auto const& existing = found.entry();
+
+            if (m_equal(existing.first, added.first))
+            {
+                replace_value(target, alone, index, added);
+                return false;
+            }
+
+            // both entries move a level down
+            slot replacement{pair_node(shift + detail::map_bits, existing, m_hash(existing.first), std::move(added), hash)};
+
+            if (alone)
+            {
+                found.replace(std::move(replacement));
+            }
+            else
+            {
+                target = detail::splice(current, false, index, 1, &replacement, bitmap);
+            }
+
+            return true;
+        }
+
+        auto& child = found.node();
+
+        if (alone)
+        {
+            return insert(child, shift + detail::map_bits, hash, added);
+        }
+
+        instance copy{child};
+        bool inserted{insert(copy, shift + detail::map_bits, hash, added)};
+
+        slot replacement{std::move(copy)};
+        target = detail::splice(current, false, index, 1, &replacement, bitmap);
+        return inserted;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    persistent_map<Key, Value, Hash, Equal>::remove(instance& target, unsigned shift, std::size_t hash, Key const& key)
+    {
+        node& current{target.get()};
+
+        if (shift >= detail::hash_bits)
+        {
+            for (std::size_t index = 0; index != current.size(); ++index)
+            {
+                if (m_equal(current[index].entry().first, key))
+                {
+                    target = detail::splice(current, detail::held_alone(target), index, 1, static_cast<slot*>(nullptr), 0);
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        std::uint32_t bit{std::uint32_t{1} << ((hash >> shift) & detail::map_mask)};
+        std::uint32_t bitmap{current.header().bitmap};
+        std::size_t index{detail::popcount(bitmap & (bit - 1))};
+
+        if (!(bitmap & bit))
+        {
+            return false;
+        }
+
+        slot& found{current[index]};
+
+        if (found.holds_entry())
+        {
+            if (!m_equal(found.entry().first, key))
+            {
+                return false;
+            }
+
+            target = detail::splice(current, detail::held_alone(target), index, 1, static_cast<slot*>(nullptr), bitmap & ~bit);
+            return true;
+        }
+
+        auto& child = found.node();
+
+        if (detail::held_alone(target))
+        {
+            if (!remove(child, shift + detail::map_bits, hash, key))
+            {
+                return false;
+            }
+
+            if (lifted(child))
+            {
+                slot single{lift(child)};
+
+                if (std::is_nothrow_move_constructible<slot>::value)
+                {
+                    found.replace(std::move(single));
+                }
+                else
+                {
+                    target = detail::splice(current, true, index, 1, &single, bitmap);
+                }
+            }
+
+            return true;
+        }
+
+        instance copy{child};
+
+        if (!remove(copy, shift + detail::map_bits, hash, key))
+        {
+            return false;
+        }
+
+        slot replacement{lifted(copy) ? lift(copy) : slot{std::move(copy)}};
+        target = detail::splice(current, false, index, 1, &replacement, bitmap);
+        return true;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    persistent_map<Key, Value, Hash, Equal>::lifted(instance const& below) const
+    {
+        node const& single{below.get()};
+        return single.size() == 1 && single[0].holds_entry();
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    typename persistent_map<Key, Value, Hash, Equal>::slot
+    persistent_map<Key, Value, Hash, Equal>::lift(instance& below) const
+    {
+        auto& last = below.get()[0].entry();
+
+        if (std::is_nothrow_move_constructible<entry>::value && detail::held_alone(below))
+        {
+            return slot{std::move(last)};
+        }
+
+        return slot{static_cast<entry const&>(last)};
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    void
+    persistent_map<Key, Value, Hash, Equal>::replace_value(instance& target, bool alone, std::size_t index, entry& added)
+    {
+        if (alone)
+        {
+            target.get()[index].entry().second = std::move(added.second);
+            return;
+        }
+
+        slot replacement{std::move(added)};
+        target = detail::splice(target.get(), false, index, 1, &replacement, target.get().header().bitmap);
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    typename persistent_map<Key, Value, Hash, Equal>::instance
+    persistent_map<Key, Value, Hash, Equal>::pair_node(unsigned shift,
+                                                       entry const& first,
+                                                       std::size_t firstHash,
+                                                       entry&& second,
+                                                       std::size_t secondHash) const
+    {
+        if (shift >= detail::hash_bits)
+        {
+            slot slots[2]{slot{first}, slot{std::move(second)}};
+            return detail::make_map_node<entry>(0, slots, 2);
+        }
+
+        std::size_t firstBit{(firstHash >> shift) & detail::map_mask};
+        std::size_t secondBit{(secondHash >> shift) & detail::map_mask};
+
+        if (firstBit == secondBit)
+        {
+            slot below{pair_node(shift + detail::map_bits, first, firstHash, std::move(second), secondHash)};
+            return detail::make_map_node<entry>(std::uint32_t{1} << firstBit, &below, 1);
+        }
+
+        std::uint32_t bitmap{(std::uint32_t{1} << firstBit) | (std::uint32_t{1} << secondBit)};
+
+        if (firstBit < secondBit)
+        {
+            slot slots[2]{slot{first}, slot{std::move(second)}};
+            return detail::make_map_node<entry>(bitmap, slots, 2);
+        }
+
+        slot slots[2]{slot{std::move(second)}, slot{first}};
+        return detail::make_map_node<entry>(bitmap, slots, 2);
+    }
+
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    transient_map<Key, Value, Hash, Equal>::transient_map(Hash const& hash, Equal const& equal)
+        : m_map(hash, equal)
+    {
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    transient_map<Key, Value, Hash, Equal>::transient_map(persistent_map<Key, Value, Hash, Equal> map)
+        : m_map(std::move(map))
+    {
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    std::size_t
+    transient_map<Key, Value, Hash, Equal>::size() const
+    {
+        return m_map.size();
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    transient_map<Key, Value, Hash, Equal>::empty() const
+    {
+        return m_map.empty();
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    Value const*
+    transient_map<Key, Value, Hash, Equal>::find(Key const& key) const
+    {
+        return m_map.find(key);
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    bool
+    transient_map<Key, Value, Hash, Equal>::contains(Key const& key) const
+    {
+        return m_map.contains(key);
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    void
+    transient_map<Key, Value, Hash, Equal>::set(Key key, Value value)
+    {
+        m_map.assign(std::move(key), std::move(value));
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    void
+    transient_map<Key, Value, Hash, Equal>::erase(Key const& key)
+    {
+        m_map.remove(key);
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>
+    transient_map<Key, Value, Hash, Equal>::persistent() const&
+    {
+        return m_map;
+    }
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    persistent_map<Key, Value, Hash, Equal>
+    transient_map<Key, Value, Hash, Equal>::persistent() &&
+    {
+        return std::move(m_map);
+    }
+}
+
+#endif
@@ -0,0 +1,715 @@
+// persistent_vector.hpp -- an immutable vector sharing structure between its versions
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_PERSISTENT_VECTOR_HPP
+#define REBOX_PERSISTENT_VECTOR_HPP
+
+#include "optional_instance.hpp"
+#include "shared_instance.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <utility>
+
+namespace rebox
+{
+    namespace detail
+    {
+        constexpr unsigned vector_bits{5};
+        constexpr std::size_t vector_width{std::size_t{1} << vector_bits};
+        constexpr std::size_t vector_mask{vector_width - 1};
+
+        // up to vector_width Ts stored in place
+        template<typename T>
+        class vector_chunk
+        {
+        public:
+            vector_chunk()
+                : m_size(0)
+            {
+            }
+
+            vector_chunk(vector_chunk const& other)
+                : m_size(0)
+            {
+                try
+                {
+                    for (std::size_t index = 0; index != other.m_size; ++index)
+                    {
+                        emplace_back(other[index]);
+                    }
+                }
+                catch (...)
+                {
+                    clear();
+                    throw;
+                }
+            }
+
+            vector_chunk& operator=(vector_chunk const&) = delete;
+
+            ~vector_chunk()
+            {
+                clear();
+            }
+
+            std::size_t size() const
+            {
+                return m_size;
+            }
+
+            T& operator[](std::size_t index)
+            {
+                assert(index < m_size && "vector_chunk index out of bounds");
+                return data()[index];
+            }
+
+            T const& operator[](std::size_t index) const
+            {
+                assert(index < m_size && "vector_chunk index out of bounds");
+                return data()[index];
+            }
+
+            T* data()
+            {
+                return reinterpret_cast<T*>(m_storage);
+            }
+
+            T const* data() const
+            {
+                return reinterpret_cast<T const*>(m_storage);
+            }
+
+            template<typename... Args>
+            void emplace_back(Args&&... args)
+            {
+                assert(m_size < vector_width && "vector_chunk is full");
+                ::new (static_cast<void*>(data() + m_size)) T(std::forward<Args>(args)...);
+                ++m_size;
+            }
+
+            void pop_back()
+            {
+                assert(m_size != 0 && "vector_chunk is empty");
+                data()[--m_size].~T();
+            }
+
+        private:
+            void clear()
+            {
+                while (m_size != 0)
+                {
+                    pop_back();
+                }
+            }
+
+            alignas(T) unsigned char m_storage[vector_width * sizeof(T)];
+            std::size_t m_size;
+        };
+
+        // The nodes of the trie: branches hold nodes of the level below,
+        // leaves hold the elements. Which one a node is follows from its
+        // level.
+        class vector_node
+        {
+        };
+
+        class vector_branch : public vector_node
+        {
+        public:
+            vector_chunk<shared_instance<vector_node>> children;
+        };
+
+        template<typename T>
+        class vector_leaf : public vector_node
+        {
+        public:
+            vector_chunk<T> elements;
+        };
+
+        // the Node in slot for writing, copied first unless held alone
+        template<typename Node>
+        Node& edit(shared_instance<vector_node>& slot)
+        {
+            if (!held_alone(slot))
+            {
+                slot = shared_instance<vector_node>{make_shared_instance<Node>(static_cast<Node const&>(slot.get()))};
+            }
+
+            return static_cast<Node&>(slot.get());
+        }
+
+        // the leaf holding index below root at level shift
+        inline shared_instance<vector_node> const& leaf_slot(shared_instance<vector_node> const& root,
+                                                             unsigned shift,
+                                                             std::size_t index)
+        {
+            shared_instance<vector_node> const* slot{&root};
+
+            for (unsigned level = shift; level != 0; level -= vector_bits)
+            {
+                slot = &static_cast<vector_branch const&>(slot->get()).children[(index >> level) & vector_mask];
+            }
+
+            return *slot;
+        }
+
+        // leaf below branches down from level
+        inline shared_instance<vector_node> new_path(unsigned level, shared_instance<vector_node> const& leaf)
+        {
+            if (level == 0)
+            {
+                return leaf;
+            }
+
+            auto branch = make_shared_instance<vector_branch>();
+            branch.get().children.emplace_back(new_path(level - vector_bits, leaf));
+            return shared_instance<vector_node>{std::move(branch)};
+        }
+
+        // appends leaf below parent at level, last being the index of its
+        // last element
+        inline void push_leaf(vector_branch& parent,
+                              unsigned level,
+                              std::size_t last,
+                              shared_instance<vector_node> const& leaf)
+        {
+            if (level == vector_bits)
+            {
+                parent.children.emplace_back(leaf);
+                return;
+            }
+
+            std::size_t index{(last >> level) & vector_mask};
+
+            if (index < parent.children.size())
+            {
+                push_leaf(edit<vector_branch>(parent.children[index]), level - vector_bits, last, leaf);
+            }
+            else
+            {
+                parent.children.emplace_back(new_path(level - vector_bits, leaf));
+            }
+        }
+
+        // removes the leaf below parent at level which holds last, the
+        // last element left; returns whether parent is empty then
+        inline bool pop_leaf(vector_branch& parent, unsigned level, std::size_t last)
+        {
+            if (level != vector_bits)
+            {
+                auto& child = edit<vector_branch>(parent.children[(last >> level) & vector_mask]);
+
+                if (!pop_leaf(child, level - vector_bits, last))
+                {
+                    return false;
+                }
+            }
+
+            parent.children.pop_back();
+            return parent.children.size() == 0;
+        }
+
+        // visits the leaves one after the other
+        template<typename T>
+        class vector_iterator
+        {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = T;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T const*;
+            using reference = T const&;
+
+            vector_iterator()
+                : m_vector(nullptr),
+                  m_index(0),
+                  m_leaf(nullptr)
+            {
+            }
+
+            vector_iterator(persistent_vector<T> const& vector, std::size_t index)
+                : m_vector(&vector),
+                  m_index(index),
+                  m_leaf(index < vector.size() ? vector.leaf_of(index) : nullptr)
+            {
+            }
+
+            T const& operator*() const
+            {
+                return m_leaf[m_index & vector_mask];
+            }
+
+            T const* operator->() const
+            {
+                return &m_leaf[m_index & vector_mask];
+            }
+
+            vector_iterator& operator++()
+            {
+                if ((++m_index & vector_mask) == 0 && m_index < m_vector->size())
+                {
+                    m_leaf = m_vector->leaf_of(m_index);
+                }
+
+                return *this;
+            }
+
+            vector_iterator operator++(int)
+            {
+                vector_iterator previous{*this};
+                ++*this;
+                return previous;
+            }
+
+            friend bool operator==(vector_iterator const& lhs, vector_iterator const& rhs)
+            {
+                return lhs.m_index == rhs.m_index;
+            }
+
+            friend bool operator!=(vector_iterator const& lhs, vector_iterator const& rhs)
+            {
+                return lhs.m_index != rhs.m_index;
+            }
+
+        private:
+            persistent_vector<T> const* m_vector;
+            std::size_t m_index;
+            T const* m_leaf;
+        };
+    }
+
+    // An immutable sequence of Ts. Changing it yields a new vector which
+    // shares all but the changed path with the old one: a trie of
+    // shared_instance's, 32 children per branch, plus a tail leaf taking
+    // the last elements. Copies take constant time, changes a logarithmic
+    // number of allocations, and lookups walk the trie without checking
+    // for null.
+    //
+    // Batches of changes are better made through a transient_vector,
+    // which writes to the nodes it holds alone in place. As nodes are
+    // never handed out, this is the same as for cow_instance, and
+    // versions can be read and changed from any thread.
+    template<typename T>
+    class persistent_vector
+    {
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using const_reference = T const&;
+        using iterator = detail::vector_iterator<T>;
+        using const_iterator = iterator;
+
+        persistent_vector();
+        persistent_vector(std::initializer_list<T> elements);
+
+        persistent_vector(persistent_vector const&) = default;
+        persistent_vector& operator=(persistent_vector const&) = default;
+
+        // leave other empty
+        persistent_vector(persistent_vector&& other);
+        persistent_vector& operator=(persistent_vector&& other);
+
+        std::size_t size() const;
+        bool empty() const;
+
+        // bounds are checked unless NDEBUG is defined
+        T const& operator[](std::size_t index) const;
+        T const& back() const;
+
+        iterator begin() const;
+        iterator end() const;
+
+        // the vector with a change applied; this one is left untouched
+        persistent_vector push_back(T value) const;
+        persistent_vector set(std::size_t index, T value) const;
+        persistent_vector pop_back() const;
+
+        transient_vector<T> transient() const;
+
+    private:
+        friend class transient_vector<T>;
+        friend class detail::vector_iterator<T>;
+
+        using leaf = detail::vector_leaf<T>;
+
+        std::size_t tail_offset() const;
+        T const* leaf_of(std::size_t index) const;
+
+        void append(T&& value);
+        void assign(std::size_t index, T&& value);
+        void remove_last();
+
+        std::size_t m_size;
+        unsigned m_shift;
+
+        // the trie is absent until the tail overflows, the tail while
+        // the vector is empty
+        detail::optional_instance<detail::vector_node> m_root;
+        detail::optional_instance<detail::vector_node> m_tail;
+    };
+
+    // A persistent_vector to be changed in place. Its nodes are copied
+    // on the first write after they were shared, for example by
+    // persistent(), which takes constant time. References to elements
+    // are invalidated by any change.
+    template<typename T>
+    class transient_vector
+    {
+    public:
+        using value_type = T;
+        using size_type = std::size_t;
+        using const_reference = T const&;
+
+        transient_vector() = default;
+        explicit transient_vector(persistent_vector<T> vector);
+
+        std::size_t size() const;
+        bool empty() const;
+
+        T const& operator[](std::size_t index) const;
+        T const& back() const;
+
+        void push_back(T value);
+        void set(std::size_t index, T value);
+        void pop_back();
+
+        persistent_vector<T> persistent() const&;
+        persistent_vector<T> persistent() &&;
+
+    private:
+        persistent_vector<T> m_vector;
+    };
+
+
+    template<typename T>
+    persistent_vector<T>::persistent_vector()
+        : m_size(0),
+          m_shift(0)
+    {
+    }
+
+    template<typename T>
+    persistent_vector<T>::persistent_vector(std::initializer_list<T> elements)
+        : persistent_vector()
+    {
+        for (auto const& element : elements)
+        {
+            append(T(element));
+        }
+    }
+
+    template<typename T>
+    persistent_vector<T>::persistent_vector(persistent_vector&& other)
+        : m_size(other.m_size),
+          m_shift(other.m_shift),
+          m_root(std::move(other.m_root)),
+          m_tail(std::move(other.m_tail))
+    {
+        other.m_size = 0;
+        other.m_shift = 0;
+    }
+
+    template<typename T>
+    persistent_vector<T>&
+    persistent_vector<T>::operator=(persistent_vector&& other)
+    {
+        if (this != &other)
+        {
+            m_size = other.m_size;
+            m_shift = other.m_shift;
+            m_root = std::move(other.m_root);
+            m_tail = std::move(other.m_tail);
+
+            other.m_size = 0;
+            other.m_shift = 0;
+        }
+
+        return *this;
+    }
+
+    template<typename T>
+    std::size_t
+    persistent_vector<T>::size() const
+    {
+        return m_size;
+    }
+
+    template<typename T>
+    bool
+    persistent_vector<T>::empty() const
+    {
+        return m_size == 0;
+    }
+
+    template<typename T>
+    T const&
+    persistent_vector<T>::operator[](std::size_t index) const
+    {
+        assert(index < m_size && "persistent_vector index out of bounds");
+        return leaf_of(index)[index & detail::vector_mask];
+    }
+
+    template<typename T>
+    T const&
+    persistent_vector<T>::back() const
+    {
+        return (*this)[m_size - 1];
+    }
+
+    template<typename T>
+    typename persistent_vector<T>::iterator
+    persistent_vector<T>::begin() const
+    {
+        return iterator{*this, 0};
+    }
+
+    template<typename T>
+    typename persistent_vector<T>::iterator
+    persistent_vector<T>::end() const
+    {
+        return iterator{*this, m_size};
+    }
+
+    template<typename T>
+    persistent_vector<T>
+    persistent_vector<T>::push_back(T value) const
+    {
+        persistent_vector result{*this};
+        result.append(std::move(value));
+        return result;
+    }
+
+    template<typename T>
+    persistent_vector<T>
+    persistent_vector<T>::set(std::size_t index, T value) const
+    {
+        persistent_vector result{*this};
+        result.assign(index, std::move(value));
+        return result;
+    }
+
+    template<typename T>
+    persistent_vector<T>
+    persistent_vector<T>::pop_back() const
+    {
+        persistent_vector result{*this};
+        result.remove_last();
+        return result;
+    }
+
+    template<typename T>
+    transient_vector<T>
+    persistent_vector<T>::transient() const
+    {
+        return transient_vector<T>{*this};
+    }
+
+    template<typename T>
+    std::size_t
+    persistent_vector<T>::tail_offset() const
+    {
+        return m_size < detail::vector_width ? 0 : ((m_size - 1) >> detail::vector_bits) << detail::vector_bits;
+    }
+
+    template<typename T>
+    T const*
+    persistent_vector<T>::leaf_of(std::size_t index) const
+    {
+        if (index >= tail_offset())
+        {
+            return static_cast<leaf const&>(m_tail->get()).elements.data();
+        }
+
+        auto const& slot = detail::leaf_slot(*m_root, m_shift, index);
+        return static_cast<leaf const&>(slot.get()).elements.data();
+    }
+
+    template<typename T>
+    void
+    persistent_vector<T>::append(T&& value)
+    {
+        if (!m_tail)
+        {
+            m_tail.emplace(make_shared_instance<leaf>());
+        }
+        else if (m_size - tail_offset() == detail::vector_width)
+        {
+            // the value goes to a new tail, the full one into the trie
+            auto tail = make_shared_instance<leaf>();
+            tail.get().elements.emplace_back(std::move(value));
+
+            if (!m_root)
+            {
+                auto root = make_shared_instance<detail::vector_branch>();
+                root.get().children.emplace_back(*m_tail);
+                m_root.emplace(std::move(root));
+                m_shift = detail::vector_bits;
+            }
+            else if ((m_size >> detail::vector_bits) > (std::size_t{1} << m_shift))
+            {
+                // the trie is full and grows by a level
+                auto root = make_shared_instance<detail::vector_branch>();
+                auto path = detail::new_path(m_shift, *m_tail);
+                root.get().children.emplace_back(*m_root);
+                root.get().children.emplace_back(std::move(path));
+                m_root.emplace(std::move(root));
+                m_shift += detail::vector_bits;
+            }
+            else
+            {
+                detail::push_leaf(detail::edit<detail::vector_branch>(*m_root), m_shift, m_size - 1, *m_tail);
+            }
+
+            m_tail.emplace(std::move(tail));
+            ++m_size;
+            return;
+        }
+
+        detail::edit<leaf>(*m_tail).elements.emplace_back(std::move(value));
+        ++m_size;
+    }
+
+    template<typename T>
+    void
+    persistent_vector<T>::assign(std::size_t index, T&& value)
+    {
+        assert(index < m_size && "persistent_vector index out of bounds");
+
+        if (index >= tail_offset())
+        {
+            detail::edit<leaf>(*m_tail).elements[index & detail::vector_mask] = std::move(value);
+            return;
+        }
+
+        auto* branch = &detail::edit<detail::vector_branch>(*m_root);
+
+        for (unsigned level = m_shift; level != detail::vector_bits; level -= detail::vector_bits)
+        {
+            branch = &detail::edit<detail::vector_branch>(branch->children[(index >> level) & detail::vector_mask]);
+        }
+
+        auto& target = detail::edit<leaf>(branch->children[(index >> detail::vector_bits) & detail::vector_mask]);
+        target.elements[index & detail::vector_mask] = std::move(value);
+    }
+
+    template<typename T>
+    void
+    persistent_vector<T>::remove_last()
+    {
+        assert(m_size != 0 && "pop_back from an empty persistent_vector");
+
+        if (m_size == 1)
+        {
+            m_tail.reset();
+            m_size = 0;
+            return;
+        }
+
+        if (m_size - tail_offset() != 1)
+        {
+            detail::edit<leaf>(*m_tail).elements.pop_back();
+            --m_size;
+            return;
+        }
+
+        // the tail is left empty, the last leaf of the trie replaces it
+        std::size_t last{m_size - 2};
+        shared_instance<detail::vector_node> tail{detail::leaf_slot(*m_root, m_shift, last)};
+        auto& root = detail::edit<detail::vector_branch>(*m_root);
+
+        if (detail::pop_leaf(root, m_shift, last))
+        {
+            m_root.reset();
+            m_shift = 0;
+        }
+        else if (m_shift != detail::vector_bits && root.children.size() == 1)
+        {
+            shared_instance<detail::vector_node> child{root.children[0]};
+            m_root.emplace(std::move(child));
+            m_shift -= detail::vector_bits;
+        }
+
+        m_tail.emplace(std::move(tail));
+        --m_size;
+    }
+
+
+    template<typename T>
+    transient_vector<T>::transient_vector(persistent_vector<T> vector)
+        : m_vector(std::move(vector))
+    {
+    }
+
+    template<typename T>
+    std::size_t
+    transient_vector<T>::size() const
+    {
+        return m_vector.size();
+    }
+
+    template<typename T>
+    bool
+    transient_vector<T>::empty() const
+    {
+        return m_vector.empty();
+    }
+
+    template<typename T>
+    T const&
+    transient_vector<T>::operator[](std::size_t index) const
+    {
+        return m_vector[index];
+    }
+
+    template<typename T>
+    T const&
+    transient_vector<T>::back() const
+    {
+        return m_vector.back();
+    }
+
+    template<typename T>
+    void
+    transient_vector<T>::push_back(T value)
+    {
+        m_vector.append(std::move(value));
+    }
+
+    template<typename T>
+    void
+    transient_vector<T>::set(std::size_t index, T value)
+    {
+        m_vector.assign(index, std::move(value));
+    }
+
+    template<typename T>
+    void
+    transient_vector<T>::pop_back()
+    {
+        m_vector.remove_last();
+    }
+
+    template<typename T>
+    persistent_vector<T>
+    transient_vector<T>::persistent() const&
+    {
+        return m_vector;
+    }
+
+    template<typename T>
+    persistent_vector<T>
+    transient_vector<T>::persistent() &&
+    {
+        return std::move(m_vector);
+    }
+}
+
+#endif
@@ -0,0 +1,380 @@
+// pool_allocator.hpp -- an allocator caching small blocks in per-thread pools
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_POOL_ALLOCATOR_HPP
+#define REBOX_POOL_ALLOCATOR_HPP
+
+#include "shared_instance.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace rebox
+{
+    // statistics of the pool of the calling thread
+    class pool_statistics
+    {
+    public:
+        // allocations served from a free list
+        std::size_t hits;
+
+        // allocations which needed fresh memory
+        std::size_t misses;
+
+        // memory held by the pool but not handed out
+        std::size_t bytesRetained;
+    };
+
+    namespace detail
+    {
+        // Pool of a single thread, handing out blocks of a fixed set of
+        // size classes. Blocks carry a header naming their pool. Blocks
+        // freed by another thread are pushed onto a lock-free list of
+        // the owning pool, which takes them back once its own free list
+        // of that size class runs empty.
+        class block_pool
+        {
+        public:
+            static constexpr std::size_t granularity = alignof(std::max_align_t);
+            static constexpr std::size_t classes = 32;
+            static constexpr std::size_t blocksPerSlab = 64;
+
+            static bool pooled(std::size_t size, std::size_t alignment)
+            {
+                return size != 0 && size <= granularity * classes && alignment <= granularity;
+            }
+
+            block_pool()
+                : m_free(),
+                  m_remote(),
+                  m_cursor(),
+                  m_end(),
+                  m_hits(0),
+                  m_misses(0),
+                  m_slabBytes(0),
+                  m_outstandingBytes(0),
+                  m_debt(0)
+            {
+            }
+
+            block_pool(block_pool const&) = delete;
+            block_pool& operator=(block_pool const&) = delete;
+
+            ~block_pool()
+            {
+                for (void* slab : m_slabs)
+                {
+                    ::operator delete(slab);
+                }
+            }
+
+            static void* allocate(std::size_t size);
+            static void deallocate(void* ptr, std::size_t size);
+
+            static block_pool* local();
+
+            pool_statistics statistics() const
+            {
+                auto used = static_cast<std::ptrdiff_t>(m_outstandingBytes) + m_debt.load(std::memory_order_relaxed);
+                return pool_statistics{m_hits, m_misses, m_slabBytes - static_cast<std::size_t>(used)};
+            }
+
+            // called when the owning thread exits; the pool is deleted
+            // as soon as all of its blocks are returned
+            void orphan()
+            {
+                auto outstanding = static_cast<std::ptrdiff_t>(m_outstandingBytes);
+
+                if (m_debt.fetch_add(outstanding, std::memory_order_acq_rel) + outstanding == 0)
+                {
+                    delete this;
+                }
+            }
+
+        private:
+            class alignas(std::max_align_t) header
+            {
+            public:
+                block_pool* owner;
+                header* next;
+            };
+
+            static std::size_t size_class(std::size_t size)
+            {
+                return (size - 1) / granularity;
+            }
+
+            static std::size_t block_size(std::size_t index)
+            {
+                return sizeof(header) + (index + 1) * granularity;
+            }
+
+            header* take(std::size_t index)
+            {
+                header* block{m_free[index]};
+
+                if (!block)
+                {
+                    block = m_remote[index].exchange(nullptr, std::memory_order_acquire);
+                }
+
+                if (block)
+                {
+                    m_free[index] = block->next;
+                    ++m_hits;
+                }
+                else
+                {
+                    block = carve(index);
+                    ++m_misses;
+                }
+
+                m_outstandingBytes += block_size(index);
+                return block;
+            }
+
+            header* carve(std::size_t index)
+            {
+                std::size_t size{block_size(index)};
+
+                if (m_cursor[index] == m_end[index])
+                {
+                    std::size_t bytes{size * blocksPerSlab};
+                    m_slabs.reserve(m_slabs.size() + 1);
+
+                    auto slab = static_cast<char*>(::operator new(bytes));
+                    m_slabs.push_back(slab);
+                    m_slabBytes += bytes;
+
+                    m_cursor[index] = slab;
+                    m_end[index] = slab + bytes;
+                }
+
+                auto block = reinterpret_cast<header*>(m_cursor[index]);
+                m_cursor[index] += size;
+
+                block->owner = this;
+                return block;
+            }
+
+            void give_back(header* block, std::size_t index)
+            {
+                block->next = m_free[index];
+                m_free[index] = block;
+                m_outstandingBytes -= block_size(index);
+            }
+
+            void give_back_remote(header* block, std::size_t index)
+            {
+                auto& head = m_remote[index];
+                block->next = head.load(std::memory_order_relaxed);
+
+                while (!head.compare_exchange_weak(block->next, block,
+                                                   std::memory_order_release,
+                                                   std::memory_order_relaxed))
+                {
+                }
+
+                // the debt only turns positive once the pool is orphaned
+                auto bytes = static_cast<std::ptrdiff_t>(block_size(index));
+
+                if (m_debt.fetch_sub(bytes, std::memory_order_acq_rel) == bytes)
+                {
+                    delete this;
+                }
+            }
+
+            header* m_free[classes];
+            std::atomic<header*> m_remote[classes];
+            char* m_cursor[classes];
+            char* m_end[classes];
+            std::vector<void*> m_slabs;
+
+            std::size_t m_hits;
+            std::size_t m_misses;
+            std::size_t m_slabBytes;
+            std::size_t m_outstandingBytes;
+
+            // bytes returned by other threads, negated; the outstanding
+            // bytes are added when the pool is orphaned
+            std::atomic<std::ptrdiff_t> m_debt;
+        };
+
+
+        class pool_holder
+        {
+        public:
+            pool_holder()
+                : m_pool(new block_pool)
+            {
+                pointer() = m_pool;
+            }
+
+            ~pool_holder()
+            {
+                pointer() = nullptr;
+                destroyed() = true;
+                m_pool->orphan();
+            }
+
+            static block_pool*& pointer()
+            {
+                static thread_local block_pool* pool{};
+                return pool;
+            }
+
+            static bool& destroyed()
+            {
+                static thread_local bool value{};
+                return value;
+            }
+
+        private:
+            block_pool* m_pool;
+        };
+
+
+        inline block_pool* block_pool::local()
+        {
+            block_pool* pool{pool_holder::pointer()};
+
+            if (!pool && !pool_holder::destroyed())
+            {
+                static thread_local pool_holder holder;
+                pool = pool_holder::pointer();
+            }
+
+            return pool;
+        }
+
+        inline void* block_pool::allocate(std::size_t size)
+        {
+            std::size_t index{size_class(size)};
+            block_pool* pool{local()};
+
+            // threads being torn down allocate without a pool
+            if (!pool)
+            {
+                auto block = static_cast<header*>(::operator new(block_size(index)));
+                block->owner = nullptr;
+                return block + 1;
+            }
+
+            return pool->take(index) + 1;
+        }
+
+        inline void block_pool::deallocate(void* ptr, std::size_t size)
+        {
+            auto block = static_cast<header*>(ptr) - 1;
+            block_pool* owner{block->owner};
+
+            if (!owner)
+            {
+                ::operator delete(block);
+            }
+            else if (owner == pool_holder::pointer())
+            {
+                owner->give_back(block, size_class(size));
+            }
+            else
+            {
+                owner->give_back_remote(block, size_class(size));
+            }
+        }
+    }
+
+
+    // Allocator for allocate_shared_instance serving small blocks, like
+    // the fused control block and object, from a pool of the calling
+    // thread; larger and over-aligned blocks come from operator new
+    template<typename T>
+    class pool_allocator
+    {
+#ifndef __cpp_aligned_new
+        static_assert(alignof(T) <= alignof(std::max_align_t),
+                      "over-aligned types need the aligned operator new of C++17");
+#endif
+
+    public:
+        using value_type = T;
+
+        pool_allocator() = default;
+
+        template<typename U>
+        pool_allocator(pool_allocator<U> const&)
+        {
+        }
+
+        T* allocate(std::size_t n)
+        {
+            if (!detail::block_pool::pooled(n * sizeof(T), alignof(T)))
+            {
+#ifdef __cpp_aligned_new
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                {
+                    return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t{alignof(T)}));
+                }
+#endif
+                return static_cast<T*>(::operator new(n * sizeof(T)));
+            }
+
+            return static_cast<T*>(detail::block_pool::allocate(n * sizeof(T)));
+        }
+
+        void deallocate(T* ptr, std::size_t n)
+        {
+            if (!detail::block_pool::pooled(n * sizeof(T), alignof(T)))
+            {
+#ifdef __cpp_aligned_new
+                if (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                {
+                    ::operator delete(ptr, std::align_val_t{alignof(T)});
+                    return;
+                }
+#endif
+                ::operator delete(ptr);
+                return;
+            }
+
+            detail::block_pool::deallocate(ptr, n * sizeof(T));
+        }
+    };
+
+    template<typename T, typename U>
+    bool operator==(pool_allocator<T> const&, pool_allocator<U> const&)
+    {
+        return true;
+    }
+
+    template<typename T, typename U>
+    bool operator!=(pool_allocator<T> const&, pool_allocator<U> const&)
+    {
+        return false;
+    }
+
+    inline pool_statistics local_pool_statistics()
+    {
+        detail::block_pool* pool{detail::block_pool::local()};
+        return pool ? pool->statistics() : pool_statistics{0, 0, 0};
+    }
+
+
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Threading = multi_threaded,
+             typename... Args>
+    shared_instance<T, Report, Threading>
+    pooled_make_shared_instance(Args&&... args)
+    {
+        return allocate_shared_instance<T, Report, Threading>(pool_allocator<T>(), std::forward<Args>(args)...);
+    }
+}
+
+#endif
@@ -0,0 +1,288 @@
+// sharded_instance.hpp -- a shared_instance with its count split across threads
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_SHARDED_INSTANCE_HPP
+#define REBOX_SHARDED_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace rebox
+{
+    namespace detail
+    {
+        class sharded_block;
+
+        // the references taken by the threads mapped to it
+        class sharded_shard
+        {
+        public:
+            std::atomic<long> count;
+            sharded_block* block;
+
+            // keeps the counts of different shards on different cache lines
+            char padding[64];
+        };
+
+        // Keeps the object alive as long as any shard holds a reference.
+        // A shard holds one reference of the block while its own count
+        // is not zero, so the block is only touched when a shard empties
+        // or fills again.
+        class sharded_block
+        {
+        public:
+            explicit sharded_block(std::shared_ptr<void> anchor);
+
+            sharded_block(sharded_block const&) = delete;
+            sharded_block& operator=(sharded_block const&) = delete;
+
+            // takes a reference in the shard of the calling thread
+            sharded_shard* acquire();
+
+            static void release(sharded_shard*);
+
+            long use_count() const;
+
+            std::shared_ptr<void> const& anchor() const
+            {
+                return m_anchor;
+            }
+
+        private:
+            static std::size_t thread_index();
+
+            std::shared_ptr<void> m_anchor;
+            std::size_t m_size;
+            std::unique_ptr<sharded_shard[]> m_shards;
+
+            // number of shards holding references
+            std::atomic<long> m_active;
+        };
+
+        inline sharded_block::sharded_block(std::shared_ptr<void> anchor)
+            : m_anchor(std::move(anchor)),
+              m_size(std::max(std::thread::hardware_concurrency(), 1u)),
+              m_shards(new sharded_shard[m_size]),
+              m_active(0)
+        {
+            for (std::size_t i = 0; i < m_size; ++i)
+            {
+                m_shards[i].count.store(0, std::memory_order_relaxed);
+                m_shards[i].block = this;
+            }
+        }
+
+        inline std::size_t sharded_block::thread_index()
+        {
+            static std::atomic<std::size_t> next{0};
+            static thread_local std::size_t index{next.fetch_add(1, std::memory_order_relaxed)};
+            return index;
+        }
+
+        // A shard emptying and another one filling at the same time never
+        // drop the active count to zero: whoever fills a shard copies from
+        // a reference held in another shard, which stays active meanwhile.
+        inline sharded_shard* sharded_block::acquire()
+        {
+            sharded_shard& shard{m_shards[thread_index() % m_size]};
+
+            if (shard.count.fetch_add(1, std::memory_order_relaxed) == 0)
+            {
+                m_active.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return &shard;
+        }
+
+        inline void sharded_block::release(sharded_shard* shard)
+        {
+            if (shard->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                sharded_block* block{shard->block};
+
+                if (block->m_active.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete block;
+                }
+            }
+        }
+
+        inline long sharded_block::use_count() const
+        {
+            long count{0};
+
+            for (std::size_t i = 0; i < m_size; ++i)
+            {
+                count += m_shards[i].count.load(std::memory_order_relaxed);
+            }
+
+            return count;
+        }
+    }
+
+    // A shared_instance for objects copied by many threads at once, like
+    // loggers or registries. Each copy counts in the shard of the thread
+    // making it and is released from that one, so threads copying the
+    // same object do not contend for a single counter. Threads keeping a
+    // copy around keep their shard filled and never touch shared state.
+    template<typename T, typename Report>
+    class sharded_instance
+    {
+    public:
+        using type = T;
+
+        sharded_instance() = delete;
+
+        sharded_instance(sharded_instance const&);
+        sharded_instance(sharded_instance&&);
+
+        template<typename Y>
+        sharded_instance(sharded_instance<Y, Report> const&);
+
+        template<typename Y, typename Z>
+        explicit sharded_instance(shared_instance<Y, Z> const&);
+
+        ~sharded_instance();
+
+        sharded_instance& operator=(sharded_instance const&);
+        sharded_instance& operator=(sharded_instance&&);
+
+        operator T&() const;
+        T& get() const;
+
+        // shares ownership through the single count of the original
+        // shared_instance
+        operator shared_instance<T, Report>() const;
+        shared_instance<T, Report> shared() const;
+
+        long use_count() const;
+
+        void swap(sharded_instance&);
+
+    private:
+        template<typename Y, typename Z>
+        friend class sharded_instance;
+
+        T* m_obj;
+        detail::sharded_shard* m_shard;
+    };
+
+    template<typename T, typename Report = throw_invalid_argument, typename... Args>
+    sharded_instance<T, Report> make_sharded_instance(Args&&... args);
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>::sharded_instance(sharded_instance const& other)
+        : m_obj(other.m_obj),
+          m_shard(other.m_shard->block->acquire())
+    {
+    }
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>::sharded_instance(sharded_instance&& other)
+        : m_obj(other.m_obj),
+          m_shard(other.m_shard)
+    {
+        other.m_shard = nullptr;
+    }
+
+    template<typename T, typename Report>
+    template<typename Y>
+    sharded_instance<T, Report>::sharded_instance(sharded_instance<Y, Report> const& other)
+        : m_obj(other.m_obj),
+          m_shard(other.m_shard->block->acquire())
+    {
+    }
+
+    template<typename T, typename Report>
+    template<typename Y, typename Z>
+    sharded_instance<T, Report>::sharded_instance(shared_instance<Y, Z> const& instance)
+        : m_obj(&instance.get()),
+          m_shard((new detail::sharded_block(instance.ptr()))->acquire())
+    {
+    }
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>::~sharded_instance()
+    {
+        if (m_shard)
+        {
+            detail::sharded_block::release(m_shard);
+        }
+    }
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>&
+    sharded_instance<T, Report>::operator=(sharded_instance const& other)
+    {
+        sharded_instance(other).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>&
+    sharded_instance<T, Report>::operator=(sharded_instance&& other)
+    {
+        sharded_instance(std::move(other)).swap(*this);
+        return *this;
+    }
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>::operator T&() const
+    {
+        return *m_obj;
+    }
+
+    template<typename T, typename Report>
+    T&
+    sharded_instance<T, Report>::get() const
+    {
+        return *m_obj;
+    }
+
+    template<typename T, typename Report>
+    sharded_instance<T, Report>::operator shared_instance<T, Report>() const
+    {
+        return shared();
+    }
+
+    template<typename T, typename Report>
+    shared_instance<T, Report>
+    sharded_instance<T, Report>::shared() const
+    {
+        return detail::instance_access::adopt<shared_instance<T, Report>>(
+            std::shared_ptr<T>(m_shard->block->anchor(), m_obj));
+    }
+
+    template<typename T, typename Report>
+    long
+    sharded_instance<T, Report>::use_count() const
+    {
+        return m_shard->block->use_count();
+    }
+
+    template<typename T, typename Report>
+    void
+    sharded_instance<T, Report>::swap(sharded_instance& other)
+    {
+        std::swap(m_obj, other.m_obj);
+        std::swap(m_shard, other.m_shard);
+    }
+
+    template<typename T, typename Report, typename... Args>
+    sharded_instance<T, Report> make_sharded_instance(Args&&... args)
+    {
+        return sharded_instance<T, Report>(make_shared_instance<T, Report>(std::forward<Args>(args)...));
+    }
+}
+
+#endif
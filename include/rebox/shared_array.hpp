@@ -0,0 +1,764 @@
+// shared_array.hpp -- shared_instance's of arrays and of objects with trailing elements
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_SHARED_ARRAY_HPP
+#define REBOX_SHARED_ARRAY_HPP
+
+#include "shared_instance.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace rebox
+{
+    namespace detail
+    {
+        // where trailing_allocator placed the elements behind the block
+        // it allocated last
+        class trailing_placement
+        {
+        public:
+            void* storage;
+        };
+
+        // Allocates the control block of a std::shared_ptr or counted_ptr
+        // with room for the trailing elements right behind it; both make
+        // a single allocation through the allocator given.
+        template<typename T>
+        class trailing_allocator
+        {
+        public:
+            using value_type = T;
+
+            trailing_allocator(trailing_placement& placement, std::size_t bytes, std::size_t alignment)
+                : m_placement(&placement),
+                  m_bytes(bytes),
+                  m_alignment(alignment)
+            {
+            }
+
+            template<typename U>
+            trailing_allocator(trailing_allocator<U> const& other)
+                : m_placement(other.m_placement),
+                  m_bytes(other.m_bytes),
+                  m_alignment(other.m_alignment)
+            {
+            }
+
+            T* allocate(std::size_t n)
+            {
+                std::size_t offset{(n * sizeof(T) + m_alignment - 1) / m_alignment * m_alignment};
+
+                // room for aligning the block by hand and for the address
+                // allocated in front of it
+                std::size_t padding{over_aligned() ? alignment() - 1 + sizeof(void*) : 0};
+
+                if (m_bytes > std::numeric_limits<std::size_t>::max() - offset - padding)
+                {
+                    throw std::bad_array_new_length();
+                }
+
+                void* allocated{::operator new(offset + m_bytes + padding)};
+                char* block{static_cast<char*>(allocated)};
+
+                if (over_aligned())
+                {
+                    auto address = reinterpret_cast<std::uintptr_t>(block) + sizeof(void*);
+                    block += (address + alignment() - 1) / alignment() * alignment() - reinterpret_cast<std::uintptr_t>(block);
+                    std::memcpy(block - sizeof(void*), &allocated, sizeof(void*));
+                }
+
+                m_placement->storage = block + offset;
+                return reinterpret_cast<T*>(block);
+            }
+
+            void deallocate(T* block, std::size_t)
+            {
+                void* allocated{block};
+
+                // the address is computed as an integer, as allocate() does,
+                // since compilers which do not know whether the block is
+                // over-aligned would warn of reading in front of it
+                if (over_aligned())
+                {
+                    auto address = reinterpret_cast<std::uintptr_t>(block) - sizeof(void*);
+                    std::memcpy(&allocated, reinterpret_cast<void const*>(address), sizeof(void*));
+                }
+
+                ::operator delete(allocated);
+            }
+
+            template<typename U>
+            bool operator==(trailing_allocator<U> const& other) const
+            {
+                return m_bytes == other.m_bytes && m_alignment == other.m_alignment;
+            }
+
+            template<typename U>
+            bool operator!=(trailing_allocator<U> const& other) const
+            {
+                return !(*this == other);
+            }
+
+        private:
+            template<typename>
+            friend class trailing_allocator;
+
+            std::size_t alignment() const
+            {
+                return alignof(T) > m_alignment ? alignof(T) : m_alignment;
+            }
+
+            // whether operator new does not align the block well enough
+            bool over_aligned() const
+            {
+                return alignment() > alignof(std::max_align_t);
+            }
+
+            // only used while allocating, which is before the block
+            // holding a copy of this allocator is constructed
+            trailing_placement* m_placement;
+
+            std::size_t m_bytes;
+            std::size_t m_alignment;
+        };
+
+        // what a trailing object is constructed from besides its header
+        template<typename Init>
+        class trailing_elements
+        {
+        public:
+            trailing_placement const& placement;
+            std::size_t size;
+            Init init;
+        };
+
+        template<typename T>
+        std::size_t trailing_bytes(std::size_t size)
+        {
+            if (size > std::numeric_limits<std::size_t>::max() / sizeof(T))
+            {
+                throw std::bad_array_new_length();
+            }
+
+            return size * sizeof(T);
+        }
+
+        // constructs size Ts at first using construct, destroying them
+        // again if one throws
+        template<typename T, typename Construct>
+        void construct_elements(T* first, std::size_t size, Construct construct)
+        {
+            std::size_t constructed{0};
+
+            try
+            {
+                for (; constructed != size; ++constructed)
+                {
+                    construct(static_cast<void*>(first + constructed));
+                }
+            }
+            catch (...)
+            {
+                while (constructed != 0)
+                {
+                    first[--constructed].~T();
+                }
+
+                throw;
+            }
+        }
+
+        template<typename T>
+        class value_init
+        {
+        public:
+            void operator()(T* first, std::size_t size) const
+            {
+                // zero bits value-initialize scalars other than pointers
+                // to members, which are all ones on the Itanium ABI; for
+                // other trivial types compilers lower the loop to a memset
+                // where that is valid
+                if (std::is_scalar<T>::value && !std::is_member_pointer<T>::value)
+                {
+                    std::memset(static_cast<void*>(first), 0, size * sizeof(T));
+                    return;
+                }
+
+                construct_elements(first, size, [](void* element) { ::new (element) T(); });
+            }
+        };
+
+        template<typename T>
+        class copy_init
+        {
+        public:
+            void operator()(T* first, std::size_t size) const
+            {
+                T const& copied{value};
+                construct_elements(first, size, [&copied](void* element) { ::new (element) T(copied); });
+            }
+
+            T const& value;
+        };
+
+        // the number of elements of a shared_instance<T[]>; that of a
+        // shared_instance<T[N]> takes no space
+        template<typename Array>
+        class array_extent;
+
+        template<typename T>
+        class array_extent<T[]>
+        {
+        public:
+            explicit array_extent(std::size_t size)
+                : m_size(size)
+            {
+            }
+
+            std::size_t size() const
+            {
+                return m_size;
+            }
+
+        private:
+            std::size_t m_size;
+        };
+
+        template<typename T, std::size_t N>
+        class array_extent<T[N]>
+        {
+        public:
+            explicit array_extent(std::size_t)
+            {
+            }
+
+            static constexpr std::size_t size()
+            {
+                return N;
+            }
+        };
+
+        // the implementation of shared_instance<T[]> and shared_instance<T[N]>
+        template<typename Array, typename Report>
+        class shared_array : private array_extent<Array>
+        {
+        public:
+            using type = Array;
+            using element_type = typename std::remove_extent<Array>::type;
+            using iterator = element_type*;
+
+            // owns the elements through their first one, which
+            // std::shared_ptr<T[]> does only from C++17 on
+            using pointer = std::shared_ptr<element_type>;
+
+            shared_array() = delete;
+
+            shared_array(pointer const&, std::size_t size);
+            shared_array(pointer&&, std::size_t size);
+
+            template<typename Deleter>
+            shared_array(std::unique_ptr<element_type[], Deleter>&&, std::size_t size);
+
+            operator Array&() const;
+            Array& get() const;
+
+            // bounds are checked unless NDEBUG is defined
+            element_type& operator[](std::size_t index) const;
+
+            using array_extent<Array>::size;
+            bool empty() const;
+
+            element_type* data() const;
+            iterator begin() const;
+            iterator end() const;
+
+            explicit operator pointer() const;
+
+            long use_count() const;
+            bool unique() const;
+
+            pointer ptr() const&;
+            pointer ptr() &&;
+
+            template<typename Y, typename Z>
+            bool owner_before(shared_array<Y, Z> const&) const;
+
+            template<typename Y>
+            bool owner_before(std::shared_ptr<Y> const&) const;
+
+        protected:
+            void swap(shared_array&);
+
+        private:
+            template<typename, typename>
+            friend class shared_array;
+
+            friend class detail::instance_access;
+
+            template<typename Y>
+            void check(Y const&) const;
+
+            pointer m_obj;
+        };
+
+        template<typename Array, typename Report>
+        shared_array<Array, Report>::shared_array(pointer const& other, std::size_t size)
+            : array_extent<Array>(size),
+              m_obj(other)
+        {
+            check(m_obj);
+        }
+
+        template<typename Array, typename Report>
+        shared_array<Array, Report>::shared_array(pointer&& other, std::size_t size)
+            : array_extent<Array>(size),
+              m_obj(std::move(other))
+        {
+            check(m_obj);
+        }
+
+        template<typename Array, typename Report>
+        template<typename Deleter>
+        shared_array<Array, Report>::shared_array(std::unique_ptr<element_type[], Deleter>&& other, std::size_t size)
+            : array_extent<Array>(size)
+        {
+            check(other);
+
+            // a std::shared_ptr<T> takes a std::unique_ptr<T[]> only by
+            // its pointer and deleter, which deletes the elements if this
+            // throws
+            using stored = typename std::conditional<std::is_reference<Deleter>::value,
+                                                     std::reference_wrapper<typename std::remove_reference<Deleter>::type>,
+                                                     Deleter>::type;
+
+            stored deleter(std::forward<Deleter>(other.get_deleter()));
+            m_obj = pointer(other.release(), std::move(deleter));
+        }
+
+        template<typename Array, typename Report>
+        shared_array<Array, Report>::operator Array&() const
+        {
+            return get();
+        }
+
+        template<typename Array, typename Report>
+        Array&
+        shared_array<Array, Report>::get() const
+        {
+            return *reinterpret_cast<Array*>(m_obj.get());
+        }
+
+        template<typename Array, typename Report>
+        typename shared_array<Array, Report>::element_type&
+        shared_array<Array, Report>::operator[](std::size_t index) const
+        {
+            assert(index < size() && "shared_instance index out of bounds");
+            return m_obj.get()[index];
+        }
+
+        template<typename Array, typename Report>
+        bool
+        shared_array<Array, Report>::empty() const
+        {
+            return size() == 0;
+        }
+
+        template<typename Array, typename Report>
+        typename shared_array<Array, Report>::element_type*
+        shared_array<Array, Report>::data() const
+        {
+            return m_obj.get();
+        }
+
+        template<typename Array, typename Report>
+        typename shared_array<Array, Report>::iterator
+        shared_array<Array, Report>::begin() const
+        {
+            return m_obj.get();
+        }
+
+        template<typename Array, typename Report>
+        typename shared_array<Array, Report>::iterator
+        shared_array<Array, Report>::end() const
+        {
+            return m_obj.get() + size();
+        }
+
+        template<typename Array, typename Report>
+        shared_array<Array, Report>::operator pointer() const
+        {
+            return m_obj;
+        }
+
+        template<typename Array, typename Report>
+        long
+        shared_array<Array, Report>::use_count() const
+        {
+            return m_obj.use_count();
+        }
+
+        template<typename Array, typename Report>
+        bool
+        shared_array<Array, Report>::unique() const
+        {
+            return m_obj.use_count() == 1;
+        }
+
+        template<typename Array, typename Report>
+        typename shared_array<Array, Report>::pointer
+        shared_array<Array, Report>::ptr() const&
+        {
+            return m_obj;
+        }
+
+        template<typename Array, typename Report>
+        typename shared_array<Array, Report>::pointer
+        shared_array<Array, Report>::ptr() &&
+        {
+            return std::move(m_obj);
+        }
+
+        template<typename Array, typename Report>
+        template<typename Y, typename Z>
+        bool
+        shared_array<Array, Report>::owner_before(shared_array<Y, Z> const& other) const
+        {
+            return m_obj.owner_before(other.m_obj);
+        }
+
+        template<typename Array, typename Report>
+        template<typename Y>
+        bool
+        shared_array<Array, Report>::owner_before(std::shared_ptr<Y> const& other) const
+        {
+            return m_obj.owner_before(other);
+        }
+
+        template<typename Array, typename Report>
+        void
+        shared_array<Array, Report>::swap(shared_array& other)
+        {
+            std::swap(static_cast<array_extent<Array>&>(*this), static_cast<array_extent<Array>&>(other));
+            m_obj.swap(other.m_obj);
+        }
+
+        template<typename Array, typename Report>
+        template<typename Y>
+        void
+        shared_array<Array, Report>::check(Y const& ptr) const
+        {
+            if (!ptr)
+            {
+                Report()();
+            }
+        }
+    }
+
+    // A shared_instance of an array of unknown bound, which knows its
+    // size. It holds a std::shared_ptr<T> to the first element and,
+    // unlike one, never points to null; an empty array still has an
+    // address.
+    template<typename T, typename Report>
+    class shared_instance<T[], Report, multi_threaded> : public detail::shared_array<T[], Report>
+    {
+    public:
+        using detail::shared_array<T[], Report>::shared_array;
+
+        void swap(shared_instance& other)
+        {
+            detail::shared_array<T[], Report>::swap(other);
+        }
+    };
+
+    template<typename T, std::size_t N, typename Report>
+    class shared_instance<T[N], Report, multi_threaded> : public detail::shared_array<T[N], Report>
+    {
+    public:
+        // other points to the first of N elements
+        explicit shared_instance(std::shared_ptr<T> const& other)
+            : detail::shared_array<T[N], Report>(other, N)
+        {
+        }
+
+        explicit shared_instance(std::shared_ptr<T>&& other)
+            : detail::shared_array<T[N], Report>(std::move(other), N)
+        {
+        }
+
+        template<typename Deleter>
+        explicit shared_instance(std::unique_ptr<T[], Deleter>&& other)
+            : detail::shared_array<T[N], Report>(std::move(other), N)
+        {
+        }
+
+        void swap(shared_instance& other)
+        {
+            detail::shared_array<T[N], Report>::swap(other);
+        }
+    };
+
+    // A Header followed by a run of Ts which are allocated together with
+    // the reference count, as made by make_trailing_instance. The Ts
+    // are constructed after and destroyed before the Header.
+    template<typename Header, typename T>
+    class trailing
+    {
+    public:
+        using header_type = Header;
+        using element_type = T;
+        using iterator = T*;
+
+        template<typename Init, typename... Args>
+        explicit trailing(detail::trailing_elements<Init> const& elements, Args&&... args);
+
+        trailing(trailing const&) = delete;
+        trailing& operator=(trailing const&) = delete;
+
+        ~trailing();
+
+        Header& header();
+        Header const& header() const;
+
+        // bounds are checked unless NDEBUG is defined
+        T& operator[](std::size_t index);
+        T const& operator[](std::size_t index) const;
+
+        std::size_t size() const;
+        bool empty() const;
+
+        T* data();
+        T const* data() const;
+
+        iterator begin();
+        iterator end();
+        T const* begin() const;
+        T const* end() const;
+
+    private:
+        Header m_header;
+        T* m_data;
+        std::size_t m_size;
+    };
+
+    template<typename Header, typename T>
+    template<typename Init, typename... Args>
+    trailing<Header, T>::trailing(detail::trailing_elements<Init> const& elements, Args&&... args)
+        : m_header(std::forward<Args>(args)...),
+          m_data(static_cast<T*>(elements.placement.storage)),
+          m_size(elements.size)
+    {
+        elements.init(m_data, m_size);
+    }
+
+    template<typename Header, typename T>
+    trailing<Header, T>::~trailing()
+    {
+        for (std::size_t index = m_size; index != 0; --index)
+        {
+            m_data[index - 1].~T();
+        }
+    }
+
+    template<typename Header, typename T>
+    Header&
+    trailing<Header, T>::header()
+    {
+        return m_header;
+    }
+
+    template<typename Header, typename T>
+    Header const&
+    trailing<Header, T>::header() const
+    {
+        return m_header;
+    }
+
+    template<typename Header, typename T>
+    T&
+    trailing<Header, T>::operator[](std::size_t index)
+    {
+        assert(index < m_size && "trailing index out of bounds");
+        return m_data[index];
+    }
+
+    template<typename Header, typename T>
+    T const&
+    trailing<Header, T>::operator[](std::size_t index) const
+    {
+        assert(index < m_size && "trailing index out of bounds");
+        return m_data[index];
+    }
+
+    template<typename Header, typename T>
+    std::size_t
+    trailing<Header, T>::size() const
+    {
+        return m_size;
+    }
+
+    template<typename Header, typename T>
+    bool
+    trailing<Header, T>::empty() const
+    {
+        return m_size == 0;
+    }
+
+    template<typename Header, typename T>
+    T*
+    trailing<Header, T>::data()
+    {
+        return m_data;
+    }
+
+    template<typename Header, typename T>
+    T const*
+    trailing<Header, T>::data() const
+    {
+        return m_data;
+    }
+
+    template<typename Header, typename T>
+    typename trailing<Header, T>::iterator
+    trailing<Header, T>::begin()
+    {
+        return m_data;
+    }
+
+    template<typename Header, typename T>
+    typename trailing<Header, T>::iterator
+    trailing<Header, T>::end()
+    {
+        return m_data + m_size;
+    }
+
+    template<typename Header, typename T>
+    T const*
+    trailing<Header, T>::begin() const
+    {
+        return m_data;
+    }
+
+    template<typename Header, typename T>
+    T const*
+    trailing<Header, T>::end() const
+    {
+        return m_data + m_size;
+    }
+
+    namespace detail
+    {
+        class no_header
+        {
+        };
+
+        // the reference count, the trailing object and its elements in
+        // one allocation
+        template<typename Trailing, typename Threading, typename Init, typename... Args>
+        typename Threading::template pointer<Trailing>
+        make_trailing(std::size_t size, Init init, Args&&... args)
+        {
+            using element_type = typename Trailing::element_type;
+
+            trailing_placement placement{nullptr};
+            trailing_allocator<Trailing> alloc{placement,
+                                               trailing_bytes<element_type>(size),
+                                               alignof(element_type)};
+
+            return Threading::template allocate_shared<Trailing>(alloc,
+                                                                 trailing_elements<Init>{placement, size, init},
+                                                                 std::forward<Args>(args)...);
+        }
+
+        // the first element of a trailing object sharing its ownership,
+        // see multi_threaded::alias
+        template<typename Block>
+        std::shared_ptr<typename Block::element_type> alias_elements(std::shared_ptr<Block>&& block)
+        {
+            auto elements = block->data();
+#if __cplusplus > 201703L
+            return std::shared_ptr<typename Block::element_type>(std::move(block), elements);
+#else
+            return std::shared_ptr<typename Block::element_type>(block, elements);
+#endif
+        }
+
+        template<typename T, typename Report, typename Init>
+        shared_instance<T[], Report>
+        make_array(std::size_t size, Init init)
+        {
+            auto block = make_trailing<trailing<no_header, T>, multi_threaded>(size, init);
+            return shared_instance<T[], Report>{alias_elements(std::move(block)), size};
+        }
+    }
+
+    // size value-initialized Ts, allocated together with the reference count
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Size>
+    typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0,
+                            shared_instance<T, Report>>::type
+    make_shared_instance(Size&& size)
+    {
+        using element_type = typename std::remove_extent<T>::type;
+        return detail::make_array<element_type, Report>(size, detail::value_init<element_type>{});
+    }
+
+    // size copies of value
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Size,
+             typename Value>
+    typename std::enable_if<std::is_array<T>::value && std::extent<T>::value == 0,
+                            shared_instance<T, Report>>::type
+    make_shared_instance(Size&& size, Value&& value)
+    {
+        using element_type = typename std::remove_extent<T>::type;
+        element_type const& fill(std::forward<Value>(value));
+        return detail::make_array<element_type, Report>(size, detail::copy_init<element_type>{fill});
+    }
+
+    // N value-initialized Ts
+    template<typename T, typename Report = throw_invalid_argument>
+    typename std::enable_if<std::is_array<T>::value && std::extent<T>::value != 0,
+                            shared_instance<T, Report>>::type
+    make_shared_instance()
+    {
+        using element_type = typename std::remove_extent<T>::type;
+        auto block = detail::make_trailing<trailing<detail::no_header, element_type>, multi_threaded>(
+            std::extent<T>::value, detail::value_init<element_type>{});
+
+        return shared_instance<T, Report>{detail::alias_elements(std::move(block))};
+    }
+
+    // a Header constructed from args, followed by size value-initialized
+    // Ts, allocated together with the reference count
+    template<typename Header,
+             typename T,
+             typename Report = throw_invalid_argument,
+             typename Threading = multi_threaded,
+             typename... Args>
+    shared_instance<trailing<Header, T>, Report, Threading>
+    make_trailing_instance(std::size_t size, Args&&... args)
+    {
+        using object = trailing<Header, T>;
+        using instance = shared_instance<object, Report, Threading>;
+        REBOX_INSTANCE_EVENT(object, made);
+        return detail::instance_access::adopt<instance>(
+            detail::make_trailing<trailing<Header, T>, Threading>(size, detail::value_init<T>{}, std::forward<Args>(args)...));
+    }
+}
+
+#endif
@@ -10,8 +10,70 @@
 
 #include "shared_instance_fwd.hpp"
 
+#include <cstddef>
+#include <functional>
 #include <memory>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// Counts the operations on shared_instance's for each type, see
+// instance_statistics.hpp; off by default, leaving no trace in the code
+#ifndef REBOX_INSTANCE_STATISTICS
+#  define REBOX_INSTANCE_STATISTICS 0
+#endif
+
+#if REBOX_INSTANCE_STATISTICS
+#  include "instance_statistics.hpp"
+#  define REBOX_INSTANCE_EVENT(T, event) \
+    ::rebox::instance_statistics<typename std::remove_cv<T>::type>::record(::rebox::instance_event::event)
+#else
+#  define REBOX_INSTANCE_EVENT(T, event)
+#endif
+
+// Times sampled reference count operations by the call site of the
+// copy, see contention_sampler.hpp; off by default
+#ifndef REBOX_CONTENTION_SAMPLING
+#  define REBOX_CONTENTION_SAMPLING 0
+#endif
+
+#if REBOX_CONTENTION_SAMPLING
+#  include "contention_sampler.hpp"
+#  define REBOX_CALL_SITE_DEFAULT , ::rebox::call_site = ::rebox::call_site::current()
+#  define REBOX_CALL_SITE , ::rebox::call_site site
+#else
+#  define REBOX_CALL_SITE_DEFAULT
+#  define REBOX_CALL_SITE
+#endif
+
+// Lists the objects owned by shared_instance's with their use counts and
+// where they were created, see instance_registry.hpp; off by default
+#ifndef REBOX_INSTANCE_REGISTRY
+#  define REBOX_INSTANCE_REGISTRY 0
+#endif
+
+#if REBOX_INSTANCE_REGISTRY
+#  include "instance_registry.hpp"
+#  define REBOX_ALLOCATION_SITE_DEFAULT , ::rebox::call_site = ::rebox::call_site::current()
+#  define REBOX_ALLOCATION_SITE , ::rebox::call_site allocationSite
+#  define REBOX_REGISTRY_NOINLINE REBOX_NOINLINE
+#else
+#  define REBOX_ALLOCATION_SITE_DEFAULT
+#  define REBOX_ALLOCATION_SITE
+#  define REBOX_REGISTRY_NOINLINE
+#endif
+
+// Checked instance_refs verify on each access that their owner and the
+// object they borrow are still alive, see instance_ref.hpp. Every
+// shared_instance then carries a token for them, which changes its
+// layout; off by default, and to be set alike across a program
+#ifndef REBOX_CHECKED_REFS
+#  define REBOX_CHECKED_REFS 0
+#endif
+
+#if REBOX_CHECKED_REFS
+#  include <atomic>
+#endif
 
 namespace rebox
 {
@@ -24,57 +86,337 @@ namespace rebox
         };
     };
 
-    template<typename T, typename Report>
+    // reference counting through std::shared_ptr, safe to share across threads
+    class multi_threaded
+    {
+    public:
+        template<typename T>
+        using pointer = std::shared_ptr<T>;
+
+        template<typename T>
+        using weak_pointer = std::weak_ptr<T>;
+
+        template<typename T, typename... Args>
+        static std::shared_ptr<T> make_shared(Args&&... args)
+        {
+            return std::make_shared<T>(std::forward<Args>(args)...);
+        }
+
+        template<typename T, typename Alloc, typename... Args>
+        static std::shared_ptr<T> allocate_shared(Alloc const& alloc, Args&&... args)
+        {
+            return std::allocate_shared<T>(alloc, std::forward<Args>(args)...);
+        }
+
+        // transfers the ownership of ptr to target, which points into the
+        // same object; before C++20 only an implicit conversion of the
+        // pointer can be moved, any other target costs a copy
+        template<typename Target, typename Source>
+        static std::shared_ptr<Target> alias(std::shared_ptr<Source>&& ptr, Target* target)
+        {
+#if __cplusplus > 201703L
+            return std::shared_ptr<Target>(std::move(ptr), target);
+#else
+            return alias(std::move(ptr), target, std::is_convertible<Source*, Target*>{});
+#endif
+        }
+
+    private:
+        // upcasts and conversions adding const, which the converting move
+        // constructor performs itself
+        template<typename Target, typename Source>
+        static std::shared_ptr<Target> alias(std::shared_ptr<Source>&& ptr, Target* target, std::true_type)
+        {
+            if (static_cast<Target*>(ptr.get()) == target)
+            {
+                return std::shared_ptr<Target>(std::move(ptr));
+            }
+
+            return std::shared_ptr<Target>(ptr, target);
+        }
+
+        // downcasts, removing const and members
+        template<typename Target, typename Source>
+        static std::shared_ptr<Target> alias(std::shared_ptr<Source>&& ptr, Target* target, std::false_type)
+        {
+            return std::shared_ptr<Target>(ptr, target);
+        }
+    };
+
+    namespace detail
+    {
+#if REBOX_CHECKED_REFS
+        // tells the checked instance_refs of a shared_instance whether it
+        // still exists; shared by the instance and its refs
+        class owner_token
+        {
+        public:
+            void acquire()
+            {
+                m_refs.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            void release()
+            {
+                if (m_refs.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                {
+                    delete this;
+                }
+            }
+
+            bool alive() const
+            {
+                return m_alive.load(std::memory_order_acquire);
+            }
+
+            void expire()
+            {
+                m_alive.store(false, std::memory_order_release);
+            }
+
+        private:
+            std::atomic<long> m_refs{1};
+            std::atomic<bool> m_alive{true};
+        };
+
+        // the token of a shared_instance, made when it is first borrowed;
+        // copies and assignments leave it with the instance it belongs to
+        class owner_liveness
+        {
+        public:
+            owner_liveness() = default;
+
+            owner_liveness(owner_liveness const&) noexcept
+            {
+            }
+
+            owner_liveness& operator=(owner_liveness const&) noexcept
+            {
+                return *this;
+            }
+
+            ~owner_liveness()
+            {
+                if (auto token = m_token.load(std::memory_order_acquire))
+                {
+                    token->expire();
+                    token->release();
+                }
+            }
+
+            // the token with a reference taken for the caller
+            owner_token* borrow() const
+            {
+                auto token = m_token.load(std::memory_order_acquire);
+                if (!token)
+                {
+                    auto made = new owner_token;
+                    if (m_token.compare_exchange_strong(token, made, std::memory_order_acq_rel))
+                    {
+                        token = made;
+                    }
+                    else
+                    {
+                        delete made;
+                    }
+                }
+
+                token->acquire();
+                return token;
+            }
+
+        private:
+            mutable std::atomic<owner_token*> m_token{nullptr};
+        };
+#endif
+
+        // orders addresses like the comparison operators of std::shared_ptr
+        template<typename T, typename U>
+        bool address_less(T* lhs, U* rhs)
+        {
+            using common = typename std::common_type<T*, U*>::type;
+            return std::less<common>()(lhs, rhs);
+        }
+
+        // the type of a member M of a T, as const and volatile as T
+        template<typename T, typename M>
+        class member_type
+        {
+            using qualified = typename std::conditional<std::is_const<T>::value, M const, M>::type;
+
+        public:
+            using type = typename std::conditional<std::is_volatile<T>::value, qualified volatile, qualified>::type;
+        };
+
+        // creates shared_instance's from pointers which are known not to
+        // be null, skipping the check
+        class instance_access
+        {
+        public:
+            template<typename Instance, typename Pointer>
+            static Instance adopt(Pointer&& ptr)
+            {
+                return Instance{std::forward<Pointer>(ptr), typename Instance::unchecked{}};
+            }
+
+            // the pointer held by instance; it must not be left null
+            // unless instance is destroyed right away
+            template<typename Instance>
+            static auto pointer(Instance& instance) -> decltype((instance.m_obj))
+            {
+                return instance.m_obj;
+            }
+
+#if REBOX_CHECKED_REFS
+            // a reference to the token telling whether instance still exists
+            template<typename Instance>
+            static owner_token* borrow(Instance const& instance)
+            {
+                return instance.m_liveness.borrow();
+            }
+#endif
+        };
+
+        template<typename>
+        class type_tag_void
+        {
+        public:
+            using type = void;
+        };
+
+        // whether Pointer is a pointer of the Threading policy, in the
+        // same way a std::shared_ptr is one of multi_threaded
+        template<typename Threading, typename Pointer, typename = void>
+        class is_pointer_of : public std::false_type
+        {
+        };
+
+        template<typename Threading, typename Pointer>
+        class is_pointer_of<Threading, Pointer, typename type_tag_void<typename Pointer::element_type>::type>
+            : public std::is_same<Pointer, typename Threading::template pointer<typename Pointer::element_type>>
+        {
+        };
+
+        template<typename Threading, typename Pointer, typename = void>
+        class is_weak_pointer_of : public std::false_type
+        {
+        };
+
+        template<typename Threading, typename Pointer>
+        class is_weak_pointer_of<Threading, Pointer, typename type_tag_void<typename Pointer::element_type>::type>
+            : public std::is_same<Pointer, typename Threading::template weak_pointer<typename Pointer::element_type>>
+        {
+        };
+
+        template<typename Threading, typename Pointer>
+        using enable_if_pointer_of = typename std::enable_if<is_pointer_of<Threading, Pointer>::value, int>::type;
+
+        template<typename Threading, typename Pointer>
+        using enable_if_weak_pointer_of = typename std::enable_if<is_weak_pointer_of<Threading, Pointer>::value, int>::type;
+
+        template<typename Threading, typename Pointer>
+        using enable_if_any_pointer_of = typename std::enable_if<is_pointer_of<Threading, Pointer>::value
+                                                                 || is_weak_pointer_of<Threading, Pointer>::value, int>::type;
+
+        // remembers the type of the objects made by make_shared_instance
+        // whose class derives from type_tagged, see checked_cast.hpp
+        template<typename T, typename = void>
+        class type_tag_recorder
+        {
+        public:
+            static void record(T const&)
+            {
+            }
+        };
+
+        template<typename T>
+        class type_tag_recorder<T, typename type_tag_void<typename T::type_tagged_type>::type>
+        {
+        public:
+            static void record(T const& obj)
+            {
+                using tagged = typename T::type_tagged_type;
+                tagged::record(obj, tagged::template tag_of<typename std::remove_cv<T>::type>());
+            }
+        };
+    }
+
+    // Threading supplies the pointer holding the object, std::shared_ptr
+    // for multi_threaded and counted_ptr for the counted policies
+    template<typename T, typename Report, typename Threading>
     class shared_instance
     {
     public:
         using type = T;
+        using pointer = typename Threading::template pointer<T>;
 
         shared_instance() = delete;
 
         // constructors from other shared_instance's
+#if REBOX_CONTENTION_SAMPLING
+        shared_instance(shared_instance const& REBOX_CALL_SITE_DEFAULT) noexcept;
+        shared_instance(shared_instance&&) noexcept;
+        ~shared_instance();
+#elif REBOX_INSTANCE_STATISTICS
+        shared_instance(shared_instance const&) noexcept;
+        shared_instance(shared_instance&&) noexcept;
+#else
         shared_instance(shared_instance const&) = default;
+        shared_instance(shared_instance&&) = default;
+#endif
 
         template<typename Y, typename Z>
-        shared_instance(shared_instance<Y, Z> const&);
+        shared_instance(shared_instance<Y, Z, Threading> const& REBOX_CALL_SITE_DEFAULT);
 
         template<typename Y, typename Z>
-        shared_instance(shared_instance<Y, Z>&&);
+        shared_instance(shared_instance<Y, Z, Threading>&&);
 
-        // constructors from std::shared_ptr's
-        explicit shared_instance(std::shared_ptr<T> const&);
+        // aliasing constructors, sharing the ownership of owner while
+        // referring to obj, usually a part of the object of owner; being
+        // a reference, obj needs no check. Moving owner costs no count
+        // operation, except with multi_threaded before C++20 when obj is
+        // not the object of owner itself.
+        template<typename Y, typename Z>
+        shared_instance(shared_instance<Y, Z, Threading> const& owner, T& obj REBOX_CALL_SITE_DEFAULT);
 
-        template<typename Y>
-        explicit shared_instance(std::shared_ptr<Y> const&);
+        template<typename Y, typename Z>
+        shared_instance(shared_instance<Y, Z, Threading>&& owner, T& obj);
 
-        explicit shared_instance(std::shared_ptr<T>&&);
+        // constructors from the pointers of Threading, std::shared_ptr's
+        // or counted_ptr's
+        explicit shared_instance(pointer const& REBOX_CALL_SITE_DEFAULT);
 
-        template<typename Y>
-        explicit shared_instance(std::shared_ptr<Y>&&);
+        template<typename Pointer, detail::enable_if_pointer_of<Threading, Pointer> = 0>
+        explicit shared_instance(Pointer const& REBOX_CALL_SITE_DEFAULT);
 
-        // constructors from std::weak_ptr's
-        template<typename Y>
-        explicit shared_instance(std::weak_ptr<Y> const&);
+        explicit shared_instance(pointer&&);
+
+        template<typename Pointer, detail::enable_if_pointer_of<Threading, Pointer> = 0>
+        explicit shared_instance(Pointer&&);
+
+        // constructors from the weak pointers of Threading
+        template<typename Weak, detail::enable_if_weak_pointer_of<Threading, Weak> = 0>
+        explicit shared_instance(Weak const& REBOX_CALL_SITE_DEFAULT);
 
         // constructors from std:unique_ptr's
         template<typename Y, typename Deleter>
-        shared_instance(std::unique_ptr<Y, Deleter>&&);
+        shared_instance(std::unique_ptr<Y, Deleter>&& REBOX_ALLOCATION_SITE_DEFAULT);
 
         // constructors from plain pointers
         template<typename Y>
-        explicit shared_instance(Y*);
+        explicit shared_instance(Y* REBOX_ALLOCATION_SITE_DEFAULT);
 
         template<typename Y, typename Deleter>
-        shared_instance(Y*, Deleter);
+        shared_instance(Y*, Deleter REBOX_ALLOCATION_SITE_DEFAULT);
 
         template<typename Y, typename Deleter, typename Alloc>
-        shared_instance(Y*, Deleter, Alloc);
+        shared_instance(Y*, Deleter, Alloc REBOX_ALLOCATION_SITE_DEFAULT);
 
         shared_instance& operator=(shared_instance const& other);
         shared_instance& operator=(shared_instance&& other);
 
-        shared_instance& operator=(std::shared_ptr<T> const& other);
-        shared_instance& operator=(std::shared_ptr<T>&& other);
+        shared_instance& operator=(pointer const& other);
+        shared_instance& operator=(pointer&& other);
 
         template<typename Y, typename Deleter>
         shared_instance& operator=(std::unique_ptr<Y,Deleter>&& r);
@@ -82,409 +424,793 @@ namespace rebox
         operator T&() const;
         T& get() const;
 
-        explicit operator std::shared_ptr<T>() const;
+        explicit operator pointer() const;
 
         long use_count() const;
         bool unique() const;
 
         template<typename Z>
-        void swap(shared_instance<T, Z>&);
+        void swap(shared_instance<T, Z, Threading>&);
 
-        void swap(std::shared_ptr<T>&);
+        void swap(pointer&);
 
-        std::shared_ptr<T> ptr() const;
+#if REBOX_CONTENTION_SAMPLING
+        pointer ptr(call_site = call_site::current()) const&;
+#else
+        pointer ptr() const&;
+#endif
+        pointer ptr() &&;
 
-        template<typename Y, typename Z>
-        bool owner_before(const shared_instance<Y, Z>&) const;
+        // the member of the object, sharing its ownership; projecting an
+        // rvalue leaves it empty. The counted policies leave the reference
+        // count untouched, as does multi_threaded from C++20 on; before,
+        // multi_threaded copies its std::shared_ptr for the member.
+        template<typename M, typename C>
+        shared_instance<typename detail::member_type<T, M>::type, Report, Threading>
+        project(M C::* REBOX_CALL_SITE_DEFAULT) const&;
 
-        template<typename Y>
-        bool owner_before(const std::shared_ptr<Y>&) const;
+        template<typename M, typename C>
+        shared_instance<typename detail::member_type<T, M>::type, Report, Threading>
+        project(M C::*) &&;
 
-        template<typename Y>
-        bool owner_before(const std::weak_ptr<Y>&) const;
+        template<typename Y, typename Z>
+        bool owner_before(const shared_instance<Y, Z, Threading>&) const;
+
+        // pointers and weak pointers of Threading
+        template<typename Pointer, detail::enable_if_any_pointer_of<Threading, Pointer> = 0>
+        bool owner_before(const Pointer&) const;
 
     private:
+        template<typename, typename, typename>
+        friend class shared_instance;
+
+        friend class detail::instance_access;
+
+        class unchecked
+        {
+        };
+
+        shared_instance(pointer&&, unchecked);
+
         template<typename Y>
         void check(Y const&) const;
 
-        std::shared_ptr<T> m_obj;
+        pointer m_obj;
+
+#if REBOX_CHECKED_REFS
+        detail::owner_liveness m_liveness;
+#endif
+
+#if REBOX_CONTENTION_SAMPLING
+        // where the reference was taken, for sampling its drop
+        call_site m_site{"(unknown)", "", 0};
+#endif
     };
 
-    template<typename T, typename Report>
+#if REBOX_CONTENTION_SAMPLING
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance const& other REBOX_CALL_SITE) noexcept
+        : m_site(site)
+    {
+        REBOX_INSTANCE_EVENT(T, copied);
+        detail::sample_count<T>(count_operation::copy, site, [&] { m_obj = other.m_obj; });
+    }
+
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance&& other) noexcept
+        : m_obj(std::move(other.m_obj)),
+          m_site(other.m_site)
+    {
+        REBOX_INSTANCE_EVENT(T, moved);
+    }
+
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::~shared_instance()
+    {
+        // dropping the last reference destroys the object, which is not
+        // what is to be measured
+        if (m_obj && m_obj.use_count() > 1)
+        {
+            detail::sample_count<T>(count_operation::drop, m_site, [&] { m_obj.reset(); });
+        }
+    }
+#elif REBOX_INSTANCE_STATISTICS
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance const& other) noexcept
+        : m_obj(other.m_obj)
+    {
+        REBOX_INSTANCE_EVENT(T, copied);
+    }
+
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance&& other) noexcept
+        : m_obj(std::move(other.m_obj))
+    {
+        REBOX_INSTANCE_EVENT(T, moved);
+    }
+#endif
+
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Z>
-    shared_instance<T, Report>::shared_instance(const shared_instance<Y, Z>& other)
+    shared_instance<T, Report, Threading>::shared_instance(const shared_instance<Y, Z, Threading>& other REBOX_CALL_SITE)
+#if REBOX_CONTENTION_SAMPLING
+        : m_site(site)
+    {
+        REBOX_INSTANCE_EVENT(Y, ptr_copied);
+        REBOX_INSTANCE_EVENT(T, copied);
+        detail::sample_count<T>(count_operation::copy, site, [&] { m_obj = other.m_obj; });
+        check(m_obj);
+    }
+#else
         : m_obj(other.ptr())
     {
+        REBOX_INSTANCE_EVENT(T, copied);
         check(m_obj);
     }
+#endif
+
+    template<typename T, typename Report, typename Threading>
+    template<typename Y, typename Z>
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance<Y, Z, Threading>&& other)
+        : m_obj(std::move(other).ptr())
+#if REBOX_CONTENTION_SAMPLING
+        , m_site(other.m_site)
+#endif
+    {
+        REBOX_INSTANCE_EVENT(T, moved);
+    }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Z>
-    shared_instance<T, Report>::shared_instance(shared_instance<Y, Z>&& other)
-        : m_obj(std::move(other.ptr()))
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance<Y, Z, Threading> const& owner, T& obj REBOX_CALL_SITE)
+#if REBOX_CONTENTION_SAMPLING
+        : m_site(site)
+    {
+        REBOX_INSTANCE_EVENT(T, projected);
+        detail::sample_count<T>(count_operation::copy, site, [&] { m_obj = pointer(owner.m_obj, &obj); });
+    }
+#else
+        : m_obj(owner.m_obj, &obj)
+    {
+        REBOX_INSTANCE_EVENT(T, projected);
+    }
+#endif
+
+    template<typename T, typename Report, typename Threading>
+    template<typename Y, typename Z>
+    shared_instance<T, Report, Threading>::shared_instance(shared_instance<Y, Z, Threading>&& owner, T& obj)
+        : m_obj(Threading::alias(std::move(owner).ptr(), &obj))
+#if REBOX_CONTENTION_SAMPLING
+        , m_site(owner.m_site)
+#endif
     {
+        REBOX_INSTANCE_EVENT(T, projected);
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y>
-    shared_instance<T, Report>::shared_instance(Y* obj)
+    shared_instance<T, Report, Threading>::shared_instance(Y* obj REBOX_ALLOCATION_SITE)
+#if REBOX_INSTANCE_REGISTRY
+        : m_obj(detail::registering_make<Threading>::adopt(obj, std::default_delete<Y>(), allocationSite))
+#else
         : m_obj(obj)
+#endif
     {
+        REBOX_INSTANCE_EVENT(T, from_pointer);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Deleter>
-    shared_instance<T, Report>::shared_instance(Y* obj, Deleter deleter)
+    shared_instance<T, Report, Threading>::shared_instance(Y* obj, Deleter deleter REBOX_ALLOCATION_SITE)
+#if REBOX_INSTANCE_REGISTRY
+        : m_obj(detail::registering_make<Threading>::adopt(obj, deleter, allocationSite))
+#else
         : m_obj(obj, deleter)
+#endif
     {
+        REBOX_INSTANCE_EVENT(T, from_pointer);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Deleter, typename Alloc>
-    shared_instance<T, Report>::shared_instance(Y* obj, Deleter deleter, Alloc alloc)
+    shared_instance<T, Report, Threading>::shared_instance(Y* obj, Deleter deleter, Alloc alloc REBOX_ALLOCATION_SITE)
+#if REBOX_INSTANCE_REGISTRY
+        : m_obj(detail::registering_make<Threading>::adopt(obj, deleter, alloc, allocationSite))
+#else
         : m_obj(obj, deleter, alloc)
+#endif
     {
+        REBOX_INSTANCE_EVENT(T, from_pointer);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>::shared_instance(std::shared_ptr<T> const& other)
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(pointer const& other REBOX_CALL_SITE)
+#if REBOX_CONTENTION_SAMPLING
+        : m_site(site)
+    {
+        REBOX_INSTANCE_EVENT(T, from_shared_ptr);
+        detail::sample_count<T>(count_operation::copy, site, [&] { m_obj = other; });
+        check(m_obj);
+    }
+#else
         : m_obj(other)
     {
+        REBOX_INSTANCE_EVENT(T, from_shared_ptr);
         check(m_obj);
     }
+#endif
 
-    template<typename T, typename Report>
-    template<typename Y>
-    shared_instance<T, Report>::shared_instance(std::shared_ptr<Y> const& other)
+    template<typename T, typename Report, typename Threading>
+    template<typename Pointer, detail::enable_if_pointer_of<Threading, Pointer>>
+    shared_instance<T, Report, Threading>::shared_instance(Pointer const& other REBOX_CALL_SITE)
+#if REBOX_CONTENTION_SAMPLING
+        : m_site(site)
+    {
+        REBOX_INSTANCE_EVENT(T, from_shared_ptr);
+        detail::sample_count<T>(count_operation::copy, site, [&] { m_obj = other; });
+        check(m_obj);
+    }
+#else
         : m_obj(other)
     {
+        REBOX_INSTANCE_EVENT(T, from_shared_ptr);
         check(m_obj);
     }
+#endif
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>::shared_instance(std::shared_ptr<T>&& other)
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(pointer&& other)
         : m_obj(std::move(other))
     {
+        REBOX_INSTANCE_EVENT(T, from_shared_ptr);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
-    template<typename Y>
-    shared_instance<T, Report>::shared_instance(std::shared_ptr<Y>&& other)
+    template<typename T, typename Report, typename Threading>
+    template<typename Pointer, detail::enable_if_pointer_of<Threading, Pointer>>
+    shared_instance<T, Report, Threading>::shared_instance(Pointer&& other)
         : m_obj(std::move(other))
     {
+        REBOX_INSTANCE_EVENT(T, from_shared_ptr);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
-    template<typename Y>
-    shared_instance<T, Report>::shared_instance(const std::weak_ptr<Y>& other)
+    template<typename T, typename Report, typename Threading>
+    template<typename Weak, detail::enable_if_weak_pointer_of<Threading, Weak>>
+    shared_instance<T, Report, Threading>::shared_instance(Weak const& other REBOX_CALL_SITE)
         : m_obj(other.lock())
+#if REBOX_CONTENTION_SAMPLING
+        , m_site(site)
+#endif
     {
+        REBOX_INSTANCE_EVENT(T, from_weak_ptr);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Deleter>
-    shared_instance<T, Report>::shared_instance(std::unique_ptr<Y, Deleter>&& other)
+    shared_instance<T, Report, Threading>::shared_instance(std::unique_ptr<Y, Deleter>&& other REBOX_ALLOCATION_SITE)
+#if REBOX_INSTANCE_REGISTRY
+        : m_obj(detail::registering_make<Threading>::adopt(std::move(other), allocationSite))
+#else
         : m_obj(std::move(other))
+#endif
     {
+        REBOX_INSTANCE_EVENT(T, from_unique_ptr);
         check(m_obj);
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>&
-    shared_instance<T, Report>::operator=(shared_instance const& other)
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::shared_instance(pointer&& other, unchecked)
+        : m_obj(std::move(other))
+    {
+    }
+
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>&
+    shared_instance<T, Report, Threading>::operator=(shared_instance const& other)
     {
+        REBOX_INSTANCE_EVENT(T, assigned);
+#if REBOX_CONTENTION_SAMPLING
+        detail::sample_count<T>(count_operation::assign, m_site, [&] { m_obj = other.m_obj; });
+#else
         m_obj = other.m_obj;
+#endif
         return *this;
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>&
-    shared_instance<T, Report>::operator=(shared_instance&& other)
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>&
+    shared_instance<T, Report, Threading>::operator=(shared_instance&& other)
     {
+        REBOX_INSTANCE_EVENT(T, assigned);
         m_obj = std::move(other.m_obj);
+#if REBOX_CONTENTION_SAMPLING
+        m_site = other.m_site;
+#endif
         return *this;
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>&
-    shared_instance<T, Report>::operator=(std::shared_ptr<T> const& other)
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>&
+    shared_instance<T, Report, Threading>::operator=(pointer const& other)
     {
+        REBOX_INSTANCE_EVENT(T, assigned);
         check(other);
         m_obj = other;
         return *this;
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>&
-    shared_instance<T, Report>::operator=(std::shared_ptr<T>&& other)
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>&
+    shared_instance<T, Report, Threading>::operator=(pointer&& other)
     {
+        REBOX_INSTANCE_EVENT(T, assigned);
         check(other);
         m_obj = std::move(other);
         return *this;
     }
 
-    template<typename T, typename Report>
+    // operators take no default arguments, so the registry lists the
+    // object by the address it was assigned from
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Deleter>
-    shared_instance<T, Report>&
-    shared_instance<T, Report>::operator=(std::unique_ptr<Y,Deleter>&& other)
+    REBOX_REGISTRY_NOINLINE shared_instance<T, Report, Threading>&
+    shared_instance<T, Report, Threading>::operator=(std::unique_ptr<Y,Deleter>&& other)
     {
+        REBOX_INSTANCE_EVENT(T, assigned);
         check(other);
+#if REBOX_INSTANCE_REGISTRY
+        m_obj = detail::registering_make<Threading>::adopt(std::move(other), call_site{"", "", 0}, REBOX_RETURN_ADDRESS());
+#else
         m_obj = std::move(other);
+#endif
         return *this;
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>::operator std::shared_ptr<T>() const
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::operator pointer() const
     {
+        REBOX_INSTANCE_EVENT(T, ptr_copied);
+#if REBOX_CONTENTION_SAMPLING
+        pointer copy;
+        detail::sample_count<T>(count_operation::copy, m_site, [&] { copy = m_obj; });
+        return copy;
+#else
         return m_obj;
+#endif
     }
 
-    template<typename T, typename Report>
-    shared_instance<T, Report>::operator T&() const
+    template<typename T, typename Report, typename Threading>
+    shared_instance<T, Report, Threading>::operator T&() const
     {
         return *m_obj;
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     T&
-    shared_instance<T, Report>::get() const
+    shared_instance<T, Report, Threading>::get() const
     {
         return *m_obj.get();
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Z>
     void
-    shared_instance<T, Report>::swap(shared_instance<T, Z>& other)
+    shared_instance<T, Report, Threading>::swap(shared_instance<T, Z, Threading>& other)
     {
         m_obj.swap(other.m_obj);
+#if REBOX_CONTENTION_SAMPLING
+        std::swap(m_site, other.m_site);
+#endif
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     void
-    shared_instance<T, Report>::swap(std::shared_ptr<T>& ptr)
+    shared_instance<T, Report, Threading>::swap(pointer& ptr)
     {
-        if (!ptr)
-        {
-            Report()();
-        }
-
+        check(ptr);
         m_obj.swap(ptr);
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y>
     void
-    shared_instance<T, Report>::check(Y const& ptr) const
+    shared_instance<T, Report, Threading>::check(Y const& ptr) const
     {
         if (!ptr)
         {
+            REBOX_INSTANCE_EVENT(T, null_rejected);
             Report()();
         }
     }
 
-    template<typename T, typename Report>
-    std::shared_ptr<T>
-    shared_instance<T, Report>::ptr() const
+#if REBOX_CONTENTION_SAMPLING
+    template<typename T, typename Report, typename Threading>
+    typename shared_instance<T, Report, Threading>::pointer
+    shared_instance<T, Report, Threading>::ptr(call_site site) const&
     {
+        REBOX_INSTANCE_EVENT(T, ptr_copied);
+
+        pointer copy;
+        detail::sample_count<T>(count_operation::copy, site, [&] { copy = m_obj; });
+        return copy;
+    }
+#else
+    template<typename T, typename Report, typename Threading>
+    typename shared_instance<T, Report, Threading>::pointer
+    shared_instance<T, Report, Threading>::ptr() const&
+    {
+        REBOX_INSTANCE_EVENT(T, ptr_copied);
         return m_obj;
     }
+#endif
+
+    template<typename T, typename Report, typename Threading>
+    typename shared_instance<T, Report, Threading>::pointer
+    shared_instance<T, Report, Threading>::ptr() &&
+    {
+        REBOX_INSTANCE_EVENT(T, ptr_moved);
+        return std::move(m_obj);
+    }
+
+#if REBOX_CONTENTION_SAMPLING
+    template<typename T, typename Report, typename Threading>
+    template<typename M, typename C>
+    shared_instance<typename detail::member_type<T, M>::type, Report, Threading>
+    shared_instance<T, Report, Threading>::project(M C::* member, call_site site) const&
+    {
+        static_assert(!std::is_function<M>::value, "only data members can be projected");
+        return {*this, get().*member, site};
+    }
+#else
+    template<typename T, typename Report, typename Threading>
+    template<typename M, typename C>
+    shared_instance<typename detail::member_type<T, M>::type, Report, Threading>
+    shared_instance<T, Report, Threading>::project(M C::* member) const&
+    {
+        static_assert(!std::is_function<M>::value, "only data members can be projected");
+        return {*this, get().*member};
+    }
+#endif
+
+    template<typename T, typename Report, typename Threading>
+    template<typename M, typename C>
+    shared_instance<typename detail::member_type<T, M>::type, Report, Threading>
+    shared_instance<T, Report, Threading>::project(M C::* member) &&
+    {
+        static_assert(!std::is_function<M>::value, "only data members can be projected");
+        auto& obj = get().*member;
+        return {std::move(*this), obj};
+    }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     long
-    shared_instance<T, Report>::use_count() const
+    shared_instance<T, Report, Threading>::use_count() const
     {
         return m_obj.use_count();
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     bool
-    shared_instance<T, Report>::unique() const
+    shared_instance<T, Report, Threading>::unique() const
     {
-        return m_obj.unique();
+        return m_obj.use_count() == 1;
     }
 
-    template<typename T, typename Report>
+    template<typename T, typename Report, typename Threading>
     template<typename Y, typename Z>
     bool
-    shared_instance<T, Report>::owner_before(const shared_instance<Y, Z>& other) const
+    shared_instance<T, Report, Threading>::owner_before(const shared_instance<Y, Z, Threading>& other) const
     {
         return m_obj.owner_before(other.m_obj);
     }
 
-    template<typename T, typename Report>
-    template<typename Y>
-    bool
-    shared_instance<T, Report>::owner_before(const std::shared_ptr<Y>& other) const
-    {
-        return m_obj.owner_before(other);
-    }
-
-    template<typename T, typename Report>
-    template<typename Y>
+    template<typename T, typename Report, typename Threading>
+    template<typename Pointer, detail::enable_if_any_pointer_of<Threading, Pointer>>
     bool
-    shared_instance<T, Report>::owner_before(const std::weak_ptr<Y>& other) const
+    shared_instance<T, Report, Threading>::owner_before(const Pointer& other) const
     {
         return m_obj.owner_before(other);
     }
 
     // compare two shared_instances
-    template<typename T, typename TReport, typename U, typename UReport>
-    bool operator==(const shared_instance<T, TReport>& lhs, const shared_instance<U, UReport>& rhs)
+    template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+    bool operator==(const shared_instance<T, TReport, Threading>& lhs, const shared_instance<U, UReport, Threading>& rhs)
     {
-        return lhs.ptr() == rhs.ptr();
+        return &lhs.get() == &rhs.get();
     }
 
-    template<typename T, typename TReport, typename U, typename UReport>
-    bool operator!=(const shared_instance<T, TReport>& lhs, const shared_instance<U, UReport>& rhs)
+    template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+    bool operator!=(const shared_instance<T, TReport, Threading>& lhs, const shared_instance<U, UReport, Threading>& rhs)
     {
-        return lhs.ptr() != rhs.ptr();
+        return &lhs.get() != &rhs.get();
     }
 
-    template<typename T, typename TReport, typename U, typename UReport>
-    bool operator<(const shared_instance<T, TReport>& lhs, const shared_instance<U, UReport>& rhs)
+    template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+    bool operator<(const shared_instance<T, TReport, Threading>& lhs, const shared_instance<U, UReport, Threading>& rhs)
     {
-        return lhs.ptr() < rhs.ptr();
+        return detail::address_less(&lhs.get(), &rhs.get());
     }
 
-    template<typename T, typename TReport, typename U, typename UReport>
-    bool operator>(const shared_instance<T, TReport>& lhs, const shared_instance<U, UReport>& rhs)
+    template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+    bool operator>(const shared_instance<T, TReport, Threading>& lhs, const shared_instance<U, UReport, Threading>& rhs)
     {
-        return lhs.ptr() > rhs.ptr();
+        return detail::address_less(&rhs.get(), &lhs.get());
     }
 
-    template<typename T, typename TReport, typename U, typename UReport>
-    bool operator<=(const shared_instance<T, TReport>& lhs, const shared_instance<U, UReport>& rhs)
+    template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+    bool operator<=(const shared_instance<T, TReport, Threading>& lhs, const shared_instance<U, UReport, Threading>& rhs)
     {
-        return lhs.ptr() <= rhs.ptr();
+        return !detail::address_less(&rhs.get(), &lhs.get());
     }
 
-    template<typename T, typename TReport, typename U, typename UReport>
-    bool operator>=(const shared_instance<T, TReport>& lhs, const shared_instance<U, UReport>& rhs)
+    template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+    bool operator>=(const shared_instance<T, TReport, Threading>& lhs, const shared_instance<U, UReport, Threading>& rhs)
     {
-        return lhs.ptr() >= rhs.ptr();
+        return !detail::address_less(&lhs.get(), &rhs.get());
     }
 
     // compare shared_instance with shared_ptr (rhs)
     template<typename T, typename Report, typename U>
     bool operator==(const shared_instance<T, Report>& lhs, const std::shared_ptr<U>& rhs)
     {
-        return lhs.ptr() == rhs;
+        return &lhs.get() == rhs.get();
     }
 
     template<typename T, typename Report, typename U>
     bool operator!=(const shared_instance<T, Report>& lhs, const std::shared_ptr<U>& rhs)
     {
-        return lhs.ptr() != rhs;
+        return &lhs.get() != rhs.get();
     }
 
     template<typename T, typename Report, typename U>
     bool operator<(const shared_instance<T, Report>& lhs, const std::shared_ptr<U>& rhs)
     {
-        return lhs.ptr() < rhs;
+        return detail::address_less(&lhs.get(), rhs.get());
     }
 
     template<typename T, typename Report, typename U>
     bool operator>(const shared_instance<T, Report>& lhs, const std::shared_ptr<U>& rhs)
     {
-        return lhs.ptr() > rhs;
+        return detail::address_less(rhs.get(), &lhs.get());
     }
 
     template<typename T, typename Report, typename U>
     bool operator<=(const shared_instance<T, Report>& lhs, const std::shared_ptr<U>& rhs)
     {
-        return lhs.ptr() <= rhs;
+        return !detail::address_less(rhs.get(), &lhs.get());
     }
 
     template<typename T, typename Report, typename U>
     bool operator>=(const shared_instance<T, Report>& lhs, const std::shared_ptr<U>& rhs)
     {
-        return lhs.ptr() >= rhs;
+        return !detail::address_less(&lhs.get(), rhs.get());
     }
 
     // compare shared_instance with shared_ptr (lhs)
     template<typename T, typename U, typename Report>
     bool operator==(const std::shared_ptr<T>& lhs, const shared_instance<U, Report>& rhs)
     {
-        return lhs == rhs.ptr();
+        return lhs.get() == &rhs.get();
     }
 
     template<typename T, typename U, typename Report>
     bool operator!=(const std::shared_ptr<T>& lhs, const shared_instance<U, Report>& rhs)
     {
-        return lhs != rhs.ptr();
+        return lhs.get() != &rhs.get();
     }
 
     template<typename T, typename U, typename Report>
     bool operator<(const std::shared_ptr<T>& lhs, const shared_instance<U, Report>& rhs)
     {
-        return lhs < rhs.ptr();
+        return detail::address_less(lhs.get(), &rhs.get());
     }
 
     template<typename T, typename U, typename Report>
     bool operator>(const std::shared_ptr<T>& lhs, const shared_instance<U, Report>& rhs)
     {
-        return lhs > rhs.ptr();
+        return detail::address_less(&rhs.get(), lhs.get());
     }
 
     template<typename T, typename U, typename Report>
     bool operator<=(const std::shared_ptr<T>& lhs, const shared_instance<U, Report>& rhs)
     {
-        return lhs <= rhs.ptr();
+        return !detail::address_less(&rhs.get(), lhs.get());
     }
 
     template<typename T, typename U, typename Report>
     bool operator>=(const std::shared_ptr<T>& lhs, const shared_instance<U, Report>& rhs)
     {
-        return lhs >= rhs.ptr();
+        return !detail::address_less(lhs.get(), &rhs.get());
     }
 
-    template<typename T, typename U, typename V, typename Report>
-    std::basic_ostream<U, V>& operator<< (std::basic_ostream<U, V>& out, shared_instance<T, Report> const& obj)
+    template<typename T, typename U, typename V, typename Report, typename Threading>
+    std::basic_ostream<U, V>& operator<< (std::basic_ostream<U, V>& out, shared_instance<T, Report, Threading> const& obj)
     {
         out << obj.ptr();
         return out;
     }
 
-    template<typename Deleter, typename T, typename Report>
-    Deleter* get_deleter(shared_instance<T, Report> const& ptr)
+    template<typename Deleter, typename T, typename Report, typename Threading>
+    Deleter* get_deleter(shared_instance<T, Report, Threading> const& ptr)
     {
+#if REBOX_INSTANCE_REGISTRY
+        if (auto registering = get_deleter<detail::registering_deleter<Deleter>>(ptr.ptr()))
+        {
+            return &registering->deleter;
+        }
+#endif
         return get_deleter<Deleter>(ptr.ptr());
     }
 
-    template<typename Target, typename Source, typename Report>
-    shared_instance<Target, Report> static_pointer_cast(shared_instance<Source, Report> const& obj)
+    template<typename Target, typename Source, typename Report, typename Threading>
+    shared_instance<Target, Report, Threading> static_pointer_cast(shared_instance<Source, Report, Threading> const& obj)
     {
-        return shared_instance<Target, Report>{static_pointer_cast<Target>(obj.ptr())};
+        REBOX_INSTANCE_EVENT(Target, cast);
+        return shared_instance<Target, Report, Threading>{static_pointer_cast<Target>(obj.ptr())};
     }
 
-    template<typename Target, typename Source, typename Report>
-    shared_instance<Target, Report> const_pointer_cast(shared_instance<Source, Report> const& obj)
+    template<typename Target, typename Source, typename Report, typename Threading>
+    shared_instance<Target, Report, Threading> const_pointer_cast(shared_instance<Source, Report, Threading> const& obj)
     {
-        return shared_instance<Target, Report>{const_pointer_cast<Target>(obj.ptr())};
+        REBOX_INSTANCE_EVENT(Target, cast);
+        return shared_instance<Target, Report, Threading>{const_pointer_cast<Target>(obj.ptr())};
     }
 
-    template<typename T, typename Report>
+    // as the cast may fail, a (possibly null) pointer is returned
+    template<typename Target, typename Source, typename Report, typename Threading>
+    typename Threading::template pointer<Target> dynamic_pointer_cast(shared_instance<Source, Report, Threading> const& obj)
+    {
+        REBOX_INSTANCE_EVENT(Target, cast);
+
+        if (auto target = dynamic_cast<Target*>(&obj.get()))
+        {
+            return Threading::alias(obj.ptr(), target);
+        }
+
+        return typename Threading::template pointer<Target>{};
+    }
+
+    // casts taking over the ownership of obj, leaving obj empty
+    template<typename Target, typename Source, typename Report, typename Threading>
+    shared_instance<Target, Report, Threading> static_pointer_cast(shared_instance<Source, Report, Threading>&& obj)
+    {
+        REBOX_INSTANCE_EVENT(Target, cast);
+        auto target = static_cast<Target*>(&obj.get());
+        return shared_instance<Target, Report, Threading>{Threading::alias(std::move(obj).ptr(), target)};
+    }
+
+    template<typename Target, typename Source, typename Report, typename Threading>
+    shared_instance<Target, Report, Threading> const_pointer_cast(shared_instance<Source, Report, Threading>&& obj)
+    {
+        REBOX_INSTANCE_EVENT(Target, cast);
+        auto target = const_cast<Target*>(&obj.get());
+        return shared_instance<Target, Report, Threading>{Threading::alias(std::move(obj).ptr(), target)};
+    }
+
+    // obj is left untouched if the cast fails
+    template<typename Target, typename Source, typename Report, typename Threading>
+    typename Threading::template pointer<Target> dynamic_pointer_cast(shared_instance<Source, Report, Threading>&& obj)
+    {
+        REBOX_INSTANCE_EVENT(Target, cast);
+
+        if (auto target = dynamic_cast<Target*>(&obj.get()))
+        {
+            return Threading::alias(std::move(obj).ptr(), target);
+        }
+
+        return typename Threading::template pointer<Target>{};
+    }
+
+    template<typename T, typename Report, typename Threading>
     void
-    swap(shared_instance<T, Report>& foo, shared_instance<T, Report>& bar)
+    swap(shared_instance<T, Report, Threading>& foo, shared_instance<T, Report, Threading>& bar)
     {
         foo.swap(bar);
     }
 
 
-    template<typename T, typename Report = throw_invalid_argument, typename... Args>
-    shared_instance<T, Report>
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Threading = multi_threaded,
+             typename... Args>
+    REBOX_REGISTRY_NOINLINE shared_instance<T, Report, Threading>
     make_shared_instance(Args&&... args)
     {
-        return shared_instance<T, Report>{std::make_shared<T>(args...)};
+        using instance = shared_instance<T, Report, Threading>;
+        REBOX_INSTANCE_EVENT(T, made);
+#if REBOX_INSTANCE_REGISTRY
+        auto obj = detail::instance_access::adopt<instance>(
+            detail::registering_make<Threading>::template make_shared<T>(REBOX_RETURN_ADDRESS(), std::forward<Args>(args)...));
+#else
+        auto obj = detail::instance_access::adopt<instance>(Threading::template make_shared<T>(std::forward<Args>(args)...));
+#endif
+        detail::type_tag_recorder<T>::record(obj.get());
+        return obj;
+    }
+
+    // allocates the object and its reference count in one go using alloc,
+    // for example a std::pmr::polymorphic_allocator
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Threading = multi_threaded,
+             typename Alloc,
+             typename... Args>
+    REBOX_REGISTRY_NOINLINE shared_instance<T, Report, Threading>
+    allocate_shared_instance(Alloc const& alloc, Args&&... args)
+    {
+        using instance = shared_instance<T, Report, Threading>;
+        REBOX_INSTANCE_EVENT(T, made);
+#if REBOX_INSTANCE_REGISTRY
+        auto obj = detail::instance_access::adopt<instance>(
+            detail::registering_make<Threading>::template allocate_shared<T>(REBOX_RETURN_ADDRESS(), alloc, std::forward<Args>(args)...));
+#else
+        auto obj = detail::instance_access::adopt<instance>(Threading::template allocate_shared<T>(alloc, std::forward<Args>(args)...));
+#endif
+        detail::type_tag_recorder<T>::record(obj.get());
+        return obj;
+    }
+
+
+    namespace detail
+    {
+        // whether Threading tells the address of the owner of its
+        // pointers, as the counted policies do; std::shared_ptr keeps it
+        // private
+        template<typename Threading, typename = void>
+        class has_owner : public std::false_type
+        {
+        };
+
+        template<typename Threading>
+        class has_owner<Threading, typename type_tag_void<decltype(Threading::owner(
+            std::declval<typename Threading::template pointer<int> const&>()))>::type>
+            : public std::true_type
+        {
+        };
     }
 
+    // hash by owner, consistent with owner_before; like std::hash, it
+    // leaves the reference count untouched
+    class owner_hash
+    {
+    public:
+        template<typename T, typename Report, typename Threading>
+        std::size_t operator()(shared_instance<T, Report, Threading> const& obj) const
+        {
+            static_assert(detail::has_owner<Threading>::value, "hashing by owner needs a counted policy");
+            return std::hash<void const*>()(Threading::owner(detail::instance_access::pointer(obj)));
+        }
+    };
+
+    // equality by owner, for all policies
+    class owner_equal
+    {
+    public:
+        template<typename T, typename TReport, typename U, typename UReport, typename Threading>
+        bool operator()(shared_instance<T, TReport, Threading> const& lhs,
+                        shared_instance<U, UReport, Threading> const& rhs) const
+        {
+            return !lhs.owner_before(rhs) && !rhs.owner_before(lhs);
+        }
+    };
+}
+
+namespace std
+{
+    // hashes the address of the object, like std::hash<std::shared_ptr>
+    template<typename T, typename Report, typename Threading>
+    struct hash<rebox::shared_instance<T, Report, Threading>>
+    {
+        std::size_t operator()(rebox::shared_instance<T, Report, Threading> const& obj) const
+        {
+            return std::hash<T*>()(&obj.get());
+        }
+    };
 }
 
 #endif
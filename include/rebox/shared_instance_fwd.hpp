@@ -1,12 +1,89 @@
 #ifndef REBOX_SHARED_INSTANCE_FWD_HPP
 #define REBOX_SHARED_INSTANCE_FWD_HPP
 
+#include <memory>
+
 namespace rebox
 {
     class throw_invalid_argument;
 
-    template<typename T, typename Report = throw_invalid_argument>
+    // threading policies
+    class multi_threaded;
+
+    template<typename Count>
+    class counted;
+
+    class plain_count;
+    class atomic_count;
+    class biased_count;
+
+    using single_threaded = counted<plain_count>;
+    using owner_biased = counted<biased_count>;
+    using atomic_counted = counted<atomic_count>;
+
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Threading = multi_threaded>
     class shared_instance;
+
+    template<typename T, typename Report = throw_invalid_argument>
+    using local_shared_instance = shared_instance<T, Report, single_threaded>;
+
+    template<typename T, typename Report = throw_invalid_argument>
+    class intrusive_instance;
+
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Deleter = std::default_delete<T>>
+    class unique_instance;
+
+    template<typename T>
+    class cow_instance;
+
+    template<typename T, typename Report = throw_invalid_argument>
+    class atomic_shared_instance;
+
+    template<typename T,
+             typename Report = throw_invalid_argument,
+             typename Threading = multi_threaded>
+    class instance_ref;
+
+    template<typename T, typename Report = throw_invalid_argument>
+    class sharded_instance;
+
+    template<typename T, typename Report = throw_invalid_argument>
+    class shared_instance_vector;
+
+    class reclaimer;
+
+    class address_key;
+    class owner_key;
+
+    template<typename Instance, typename Key = address_key>
+    class instance_set;
+
+    template<typename Instance, typename Value, typename Key = address_key>
+    class instance_map;
+
+    template<typename T>
+    class deferred_delete;
+
+    // defaults to std::hash<Key> and std::equal_to<Key>
+    template<typename Key, typename T, typename Hash, typename Equal>
+    class instance_cache;
+
+    template<typename T>
+    class persistent_vector;
+
+    template<typename T>
+    class transient_vector;
+
+    // defaults to std::hash<Key> and std::equal_to<Key>
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    class persistent_map;
+
+    template<typename Key, typename Value, typename Hash, typename Equal>
+    class transient_map;
 }
 
 #endif
@@ -0,0 +1,507 @@
+// shared_instance_vector.hpp -- a vector of shared_instance's split into hot and cold parts
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_SHARED_INSTANCE_VECTOR_HPP
+#define REBOX_SHARED_INSTANCE_VECTOR_HPP
+
+#include "shared_instance.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rebox
+{
+    namespace detail
+    {
+        // iterates over the objects behind an array of pointers
+        template<typename T>
+        class pointee_iterator
+        {
+        public:
+            using iterator_category = std::random_access_iterator_tag;
+            using value_type = typename std::remove_cv<T>::type;
+            using difference_type = std::ptrdiff_t;
+            using pointer = T*;
+            using reference = T&;
+
+            pointee_iterator()
+                : m_pos(nullptr)
+            {
+            }
+
+            explicit pointee_iterator(T* const* pos)
+                : m_pos(pos)
+            {
+            }
+
+            T& operator*() const
+            {
+                return **m_pos;
+            }
+
+            T* operator->() const
+            {
+                return *m_pos;
+            }
+
+            T& operator[](difference_type n) const
+            {
+                return *m_pos[n];
+            }
+
+            pointee_iterator& operator++()
+            {
+                ++m_pos;
+                return *this;
+            }
+
+            pointee_iterator operator++(int)
+            {
+                return pointee_iterator{m_pos++};
+            }
+
+            pointee_iterator& operator--()
+            {
+                --m_pos;
+                return *this;
+            }
+
+            pointee_iterator operator--(int)
+            {
+                return pointee_iterator{m_pos--};
+            }
+
+            pointee_iterator& operator+=(difference_type n)
+            {
+                m_pos += n;
+                return *this;
+            }
+
+            pointee_iterator& operator-=(difference_type n)
+            {
+                m_pos -= n;
+                return *this;
+            }
+
+            friend pointee_iterator operator+(pointee_iterator it, difference_type n)
+            {
+                return it += n;
+            }
+
+            friend pointee_iterator operator+(difference_type n, pointee_iterator it)
+            {
+                return it += n;
+            }
+
+            friend pointee_iterator operator-(pointee_iterator it, difference_type n)
+            {
+                return it -= n;
+            }
+
+            friend difference_type operator-(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos - rhs.m_pos;
+            }
+
+            friend bool operator==(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos == rhs.m_pos;
+            }
+
+            friend bool operator!=(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos != rhs.m_pos;
+            }
+
+            friend bool operator<(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos < rhs.m_pos;
+            }
+
+            friend bool operator>(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos > rhs.m_pos;
+            }
+
+            friend bool operator<=(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos <= rhs.m_pos;
+            }
+
+            friend bool operator>=(pointee_iterator const& lhs, pointee_iterator const& rhs)
+            {
+                return lhs.m_pos >= rhs.m_pos;
+            }
+
+            T* const* base() const
+            {
+                return m_pos;
+            }
+
+        private:
+            T* const* m_pos;
+        };
+    }
+
+    // A sequence of shared_instance's keeping the object pointers in one
+    // array and the owning references in another. Iterating yields the
+    // objects themselves and only reads the first array, which holds
+    // twice as many elements per cache line as a vector of
+    // shared_instance's. Elements are handed out as shared_instance's
+    // on request only.
+    //
+    // Moving elements in, out and within the vector never touches the
+    // reference counts.
+    template<typename T, typename Report>
+    class shared_instance_vector
+    {
+    public:
+        using value_type = shared_instance<T, Report>;
+        using size_type = std::size_t;
+        using difference_type = std::ptrdiff_t;
+        using reference = T&;
+        using iterator = detail::pointee_iterator<T>;
+        using const_iterator = iterator;
+
+        shared_instance_vector() = default;
+        shared_instance_vector(std::initializer_list<value_type>);
+
+        template<typename InputIt>
+        shared_instance_vector(InputIt first, InputIt last);
+
+        // element access, like std::vector<shared_instance<T>> the
+        // objects are not const even if the vector is
+        T& operator[](size_type) const;
+        T& at(size_type) const;
+        T& front() const;
+        T& back() const;
+
+        value_type instance(size_type) const;
+
+        iterator begin() const;
+        iterator end() const;
+        const_iterator cbegin() const;
+        const_iterator cend() const;
+
+        // capacity
+        bool empty() const;
+        size_type size() const;
+        size_type capacity() const;
+        void reserve(size_type);
+        void shrink_to_fit();
+
+        // modifiers
+        void clear();
+
+        void push_back(value_type const&);
+        void push_back(value_type&&);
+
+        template<typename... Args>
+        T& emplace_back(Args&&... args);
+
+        void pop_back();
+
+        iterator insert(const_iterator, value_type const&);
+        iterator insert(const_iterator, value_type&&);
+
+        // appends the shared_instance's in [first, last), reserving
+        // space for all of them once if the range allows to
+        template<typename InputIt>
+        void append(InputIt first, InputIt last);
+
+        iterator erase(const_iterator);
+        iterator erase(const_iterator, const_iterator);
+
+        void swap(shared_instance_vector&);
+
+    private:
+        template<typename InputIt>
+        void reserve_for(InputIt, InputIt, std::input_iterator_tag);
+
+        template<typename InputIt>
+        void reserve_for(InputIt first, InputIt last, std::forward_iterator_tag);
+
+        void grow(size_type count);
+        size_type index(const_iterator) const;
+
+        std::vector<T*> m_objects;
+        std::vector<std::shared_ptr<void>> m_owners;
+    };
+
+    template<typename T, typename Report>
+    shared_instance_vector<T, Report>::shared_instance_vector(std::initializer_list<value_type> values)
+    {
+        append(values.begin(), values.end());
+    }
+
+    template<typename T, typename Report>
+    template<typename InputIt>
+    shared_instance_vector<T, Report>::shared_instance_vector(InputIt first, InputIt last)
+    {
+        append(first, last);
+    }
+
+    template<typename T, typename Report>
+    T&
+    shared_instance_vector<T, Report>::operator[](size_type pos) const
+    {
+        return *m_objects[pos];
+    }
+
+    template<typename T, typename Report>
+    T&
+    shared_instance_vector<T, Report>::at(size_type pos) const
+    {
+        if (pos >= size())
+        {
+            throw std::out_of_range("shared_instance_vector::at");
+        }
+
+        return *m_objects[pos];
+    }
+
+    template<typename T, typename Report>
+    T&
+    shared_instance_vector<T, Report>::front() const
+    {
+        return *m_objects.front();
+    }
+
+    template<typename T, typename Report>
+    T&
+    shared_instance_vector<T, Report>::back() const
+    {
+        return *m_objects.back();
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::value_type
+    shared_instance_vector<T, Report>::instance(size_type pos) const
+    {
+        return detail::instance_access::adopt<value_type>(std::shared_ptr<T>(m_owners[pos], m_objects[pos]));
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::iterator
+    shared_instance_vector<T, Report>::begin() const
+    {
+        return iterator{m_objects.data()};
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::iterator
+    shared_instance_vector<T, Report>::end() const
+    {
+        return iterator{m_objects.data() + m_objects.size()};
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::const_iterator
+    shared_instance_vector<T, Report>::cbegin() const
+    {
+        return begin();
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::const_iterator
+    shared_instance_vector<T, Report>::cend() const
+    {
+        return end();
+    }
+
+    template<typename T, typename Report>
+    bool
+    shared_instance_vector<T, Report>::empty() const
+    {
+        return m_objects.empty();
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::size_type
+    shared_instance_vector<T, Report>::size() const
+    {
+        return m_objects.size();
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::size_type
+    shared_instance_vector<T, Report>::capacity() const
+    {
+        return m_objects.capacity();
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::reserve(size_type count)
+    {
+        m_objects.reserve(count);
+        m_owners.reserve(count);
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::shrink_to_fit()
+    {
+        m_objects.shrink_to_fit();
+        m_owners.shrink_to_fit();
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::clear()
+    {
+        m_objects.clear();
+        m_owners.clear();
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::push_back(value_type const& value)
+    {
+        push_back(value_type{value});
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::push_back(value_type&& value)
+    {
+        grow(1);
+
+        m_objects.push_back(&value.get());
+        m_owners.push_back(std::move(value).ptr());
+    }
+
+    template<typename T, typename Report>
+    template<typename... Args>
+    T&
+    shared_instance_vector<T, Report>::emplace_back(Args&&... args)
+    {
+        push_back(make_shared_instance<T, Report>(std::forward<Args>(args)...));
+        return back();
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::pop_back()
+    {
+        m_objects.pop_back();
+        m_owners.pop_back();
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::iterator
+    shared_instance_vector<T, Report>::insert(const_iterator pos, value_type const& value)
+    {
+        return insert(pos, value_type{value});
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::iterator
+    shared_instance_vector<T, Report>::insert(const_iterator pos, value_type&& value)
+    {
+        size_type at{index(pos)};
+
+        grow(1);
+
+        m_objects.insert(m_objects.begin() + at, &value.get());
+        m_owners.insert(m_owners.begin() + at, std::move(value).ptr());
+
+        return begin() + at;
+    }
+
+    template<typename T, typename Report>
+    template<typename InputIt>
+    void
+    shared_instance_vector<T, Report>::append(InputIt first, InputIt last)
+    {
+        reserve_for(first, last, typename std::iterator_traits<InputIt>::iterator_category{});
+
+        for (; first != last; ++first)
+        {
+            push_back(*first);
+        }
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::iterator
+    shared_instance_vector<T, Report>::erase(const_iterator pos)
+    {
+        return erase(pos, pos + 1);
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::iterator
+    shared_instance_vector<T, Report>::erase(const_iterator first, const_iterator last)
+    {
+        size_type from{index(first)};
+        size_type to{index(last)};
+
+        m_objects.erase(m_objects.begin() + from, m_objects.begin() + to);
+        m_owners.erase(m_owners.begin() + from, m_owners.begin() + to);
+
+        return begin() + from;
+    }
+
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::swap(shared_instance_vector& other)
+    {
+        m_objects.swap(other.m_objects);
+        m_owners.swap(other.m_owners);
+    }
+
+    template<typename T, typename Report>
+    template<typename InputIt>
+    void
+    shared_instance_vector<T, Report>::reserve_for(InputIt, InputIt, std::input_iterator_tag)
+    {
+    }
+
+    template<typename T, typename Report>
+    template<typename InputIt>
+    void
+    shared_instance_vector<T, Report>::reserve_for(InputIt first, InputIt last, std::forward_iterator_tag)
+    {
+        grow(static_cast<size_type>(std::distance(first, last)));
+    }
+
+    // both arrays grow before anything is added, so that a failing
+    // allocation leaves the vector unchanged and adding cannot throw
+    template<typename T, typename Report>
+    void
+    shared_instance_vector<T, Report>::grow(size_type count)
+    {
+        size_type required{size() + count};
+
+        if (required > m_objects.capacity() || required > m_owners.capacity())
+        {
+            reserve(std::max(required, 2 * size()));
+        }
+    }
+
+    template<typename T, typename Report>
+    typename shared_instance_vector<T, Report>::size_type
+    shared_instance_vector<T, Report>::index(const_iterator pos) const
+    {
+        return static_cast<size_type>(pos.base() - m_objects.data());
+    }
+
+    template<typename T, typename Report>
+    void swap(shared_instance_vector<T, Report>& lhs, shared_instance_vector<T, Report>& rhs)
+    {
+        lhs.swap(rhs);
+    }
+}
+
+#endif
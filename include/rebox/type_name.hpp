@@ -0,0 +1,49 @@
+// type_name.hpp -- readable type names for the diagnostic reports
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_TYPE_NAME_HPP
+#define REBOX_TYPE_NAME_HPP
+
+#include <memory>
+#include <string>
+
+// the Itanium C++ ABI, used by GCC and clang outside of Windows, has
+// type_info names mangled; the Microsoft ABI has them readable already
+#if defined(__GNUG__) && defined(__has_include)
+#  if __has_include(<cxxabi.h>)
+#    include <cxxabi.h>
+#    include <cstdlib>
+#    define REBOX_DEMANGLE 1
+#  endif
+#endif
+
+#ifndef REBOX_DEMANGLE
+#  define REBOX_DEMANGLE 0
+#endif
+
+namespace rebox
+{
+    namespace detail
+    {
+        // the readable name of a type from its type_info name
+        inline std::string demangle(char const* name)
+        {
+#if REBOX_DEMANGLE
+            int status{0};
+            std::unique_ptr<char, void (*)(void*)> readable{abi::__cxa_demangle(name, nullptr, nullptr, &status), std::free};
+
+            if (status == 0 && readable)
+            {
+                return readable.get();
+            }
+#endif
+            return name;
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,358 @@
+// unique_instance.hpp -- a std::unique_ptr wrapper that cannot be null
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef REBOX_UNIQUE_INSTANCE_HPP
+#define REBOX_UNIQUE_INSTANCE_HPP
+
+#include "shared_instance.hpp"
+
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+
+namespace rebox
+{
+    namespace detail
+    {
+        // the deleter of a unique_instance cast to Target
+        template<typename Deleter, typename Target>
+        class cast_deleter
+        {
+        public:
+            using type = Deleter;
+
+            static type convert(Deleter& deleter)
+            {
+                return std::move(deleter);
+            }
+        };
+
+        template<typename Source, typename Target>
+        class cast_deleter<std::default_delete<Source>, Target>
+        {
+        public:
+            using type = std::default_delete<Target>;
+
+            static type convert(std::default_delete<Source>&)
+            {
+                return type{};
+            }
+        };
+    }
+
+    // The single owner of an object, which like shared_instance cannot
+    // be null. Only an instance which has been moved from is null; it may
+    // merely be destroyed or assigned to.
+    template<typename T, typename Report, typename Deleter>
+    class unique_instance
+    {
+    public:
+        using type = T;
+        using deleter_type = Deleter;
+
+        unique_instance() = delete;
+
+        unique_instance(unique_instance const&) = delete;
+        unique_instance(unique_instance&&) = default;
+
+        template<typename Y, typename Z, typename E>
+        unique_instance(unique_instance<Y, Z, E>&&);
+
+        // constructors from std::unique_ptr's
+        template<typename Y, typename E>
+        explicit unique_instance(std::unique_ptr<Y, E>&&);
+
+        // constructors from plain pointers
+        template<typename Y>
+        explicit unique_instance(Y*);
+
+        template<typename Y>
+        unique_instance(Y*, Deleter);
+
+        unique_instance& operator=(unique_instance const&) = delete;
+        unique_instance& operator=(unique_instance&&) = default;
+
+        template<typename Y, typename Z, typename E>
+        unique_instance& operator=(unique_instance<Y, Z, E>&&);
+
+        operator T&() const;
+        T& get() const;
+
+        Deleter& get_deleter();
+        Deleter const& get_deleter() const;
+
+        void swap(unique_instance&);
+
+        // releases the object, leaving this instance moved from
+        std::unique_ptr<T, Deleter> ptr() &&;
+
+        // hands the object over to shared ownership; the check for null
+        // is skipped, only the control block is allocated
+        template<typename Y, typename Z>
+        operator shared_instance<Y, Z>() &&;
+
+    private:
+        template<typename, typename, typename>
+        friend class unique_instance;
+
+        friend class detail::instance_access;
+
+        class unchecked
+        {
+        };
+
+        unique_instance(std::unique_ptr<T, Deleter>&&, unchecked);
+
+        template<typename Y>
+        void check(Y const&) const;
+
+        std::unique_ptr<T, Deleter> m_obj;
+    };
+
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y, typename Z, typename E>
+    unique_instance<T, Report, Deleter>::unique_instance(unique_instance<Y, Z, E>&& other)
+        : m_obj(std::move(other.m_obj))
+    {
+        check(m_obj);
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y, typename E>
+    unique_instance<T, Report, Deleter>::unique_instance(std::unique_ptr<Y, E>&& other)
+        : m_obj(std::move(other))
+    {
+        check(m_obj);
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y>
+    unique_instance<T, Report, Deleter>::unique_instance(Y* obj)
+        : m_obj(obj)
+    {
+        check(m_obj);
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y>
+    unique_instance<T, Report, Deleter>::unique_instance(Y* obj, Deleter deleter)
+        : m_obj(obj, std::move(deleter))
+    {
+        check(m_obj);
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    unique_instance<T, Report, Deleter>::unique_instance(std::unique_ptr<T, Deleter>&& other, unchecked)
+        : m_obj(std::move(other))
+    {
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y, typename Z, typename E>
+    unique_instance<T, Report, Deleter>&
+    unique_instance<T, Report, Deleter>::operator=(unique_instance<Y, Z, E>&& other)
+    {
+        check(other.m_obj);
+        m_obj = std::move(other.m_obj);
+        return *this;
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    unique_instance<T, Report, Deleter>::operator T&() const
+    {
+        return *m_obj;
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    T&
+    unique_instance<T, Report, Deleter>::get() const
+    {
+        return *m_obj.get();
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    Deleter&
+    unique_instance<T, Report, Deleter>::get_deleter()
+    {
+        return m_obj.get_deleter();
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    Deleter const&
+    unique_instance<T, Report, Deleter>::get_deleter() const
+    {
+        return m_obj.get_deleter();
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    void
+    unique_instance<T, Report, Deleter>::swap(unique_instance& other)
+    {
+        m_obj.swap(other.m_obj);
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    std::unique_ptr<T, Deleter>
+    unique_instance<T, Report, Deleter>::ptr() &&
+    {
+        return std::move(m_obj);
+    }
+
+    // a conversion takes no call_site, so the registry lists the object
+    // by the address it was converted from
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y, typename Z>
+    REBOX_REGISTRY_NOINLINE
+    unique_instance<T, Report, Deleter>::operator shared_instance<Y, Z>() &&
+    {
+#if REBOX_INSTANCE_REGISTRY
+        std::shared_ptr<Y> shared{detail::registered(std::move(m_obj), call_site{"", "", 0}, REBOX_RETURN_ADDRESS())};
+#else
+        std::shared_ptr<Y> shared{std::move(m_obj)};
+#endif
+        return detail::instance_access::adopt<shared_instance<Y, Z>>(std::move(shared));
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    template<typename Y>
+    void
+    unique_instance<T, Report, Deleter>::check(Y const& ptr) const
+    {
+        if (!ptr)
+        {
+            Report()();
+        }
+    }
+
+    // compare two unique_instances
+    template<typename T, typename TReport, typename TDeleter, typename U, typename UReport, typename UDeleter>
+    bool operator==(const unique_instance<T, TReport, TDeleter>& lhs, const unique_instance<U, UReport, UDeleter>& rhs)
+    {
+        return &lhs.get() == &rhs.get();
+    }
+
+    template<typename T, typename TReport, typename TDeleter, typename U, typename UReport, typename UDeleter>
+    bool operator!=(const unique_instance<T, TReport, TDeleter>& lhs, const unique_instance<U, UReport, UDeleter>& rhs)
+    {
+        return &lhs.get() != &rhs.get();
+    }
+
+    template<typename T, typename TReport, typename TDeleter, typename U, typename UReport, typename UDeleter>
+    bool operator<(const unique_instance<T, TReport, TDeleter>& lhs, const unique_instance<U, UReport, UDeleter>& rhs)
+    {
+        return detail::address_less(&lhs.get(), &rhs.get());
+    }
+
+    template<typename T, typename TReport, typename TDeleter, typename U, typename UReport, typename UDeleter>
+    bool operator>(const unique_instance<T, TReport, TDeleter>& lhs, const unique_instance<U, UReport, UDeleter>& rhs)
+    {
+        return detail::address_less(&rhs.get(), &lhs.get());
+    }
+
+    template<typename T, typename TReport, typename TDeleter, typename U, typename UReport, typename UDeleter>
+    bool operator<=(const unique_instance<T, TReport, TDeleter>& lhs, const unique_instance<U, UReport, UDeleter>& rhs)
+    {
+        return !detail::address_less(&rhs.get(), &lhs.get());
+    }
+
+    template<typename T, typename TReport, typename TDeleter, typename U, typename UReport, typename UDeleter>
+    bool operator>=(const unique_instance<T, TReport, TDeleter>& lhs, const unique_instance<U, UReport, UDeleter>& rhs)
+    {
+        return !detail::address_less(&lhs.get(), &rhs.get());
+    }
+
+    template<typename T, typename U, typename V, typename Report, typename Deleter>
+    std::basic_ostream<U, V>& operator<< (std::basic_ostream<U, V>& out, unique_instance<T, Report, Deleter> const& obj)
+    {
+        out << &obj.get();
+        return out;
+    }
+
+    // casts taking over the ownership of obj, leaving obj moved from;
+    // a std::default_delete becomes one of Target
+    template<typename Target, typename Source, typename Report, typename Deleter>
+    unique_instance<Target, Report, typename detail::cast_deleter<Deleter, Target>::type>
+    static_pointer_cast(unique_instance<Source, Report, Deleter>&& obj)
+    {
+        using target_deleter = typename detail::cast_deleter<Deleter, Target>::type;
+        using instance = unique_instance<Target, Report, target_deleter>;
+
+        auto target = static_cast<Target*>(&obj.get());
+        target_deleter deleter(detail::cast_deleter<Deleter, Target>::convert(obj.get_deleter()));
+        std::move(obj).ptr().release();
+
+        return detail::instance_access::adopt<instance>(std::unique_ptr<Target, target_deleter>(target, std::move(deleter)));
+    }
+
+    template<typename Target, typename Source, typename Report, typename Deleter>
+    unique_instance<Target, Report, typename detail::cast_deleter<Deleter, Target>::type>
+    const_pointer_cast(unique_instance<Source, Report, Deleter>&& obj)
+    {
+        using target_deleter = typename detail::cast_deleter<Deleter, Target>::type;
+        using instance = unique_instance<Target, Report, target_deleter>;
+
+        auto target = const_cast<Target*>(&obj.get());
+        target_deleter deleter(detail::cast_deleter<Deleter, Target>::convert(obj.get_deleter()));
+        std::move(obj).ptr().release();
+
+        return detail::instance_access::adopt<instance>(std::unique_ptr<Target, target_deleter>(target, std::move(deleter)));
+    }
+
+    // as the cast may fail, a (possibly null) pointer is returned; obj is
+    // left untouched if the cast fails
+    template<typename Target, typename Source, typename Report, typename Deleter>
+    std::unique_ptr<Target, typename detail::cast_deleter<Deleter, Target>::type>
+    dynamic_pointer_cast(unique_instance<Source, Report, Deleter>&& obj)
+    {
+        using target_deleter = typename detail::cast_deleter<Deleter, Target>::type;
+
+        if (auto target = dynamic_cast<Target*>(&obj.get()))
+        {
+            target_deleter deleter(detail::cast_deleter<Deleter, Target>::convert(obj.get_deleter()));
+            std::move(obj).ptr().release();
+
+            return std::unique_ptr<Target, target_deleter>(target, std::move(deleter));
+        }
+
+        return std::unique_ptr<Target, target_deleter>(nullptr);
+    }
+
+    template<typename T, typename Report, typename Deleter>
+    void
+    swap(unique_instance<T, Report, Deleter>& foo, unique_instance<T, Report, Deleter>& bar)
+    {
+        foo.swap(bar);
+    }
+
+
+    template<typename T, typename Report = throw_invalid_argument, typename... Args>
+    unique_instance<T, Report>
+    make_unique_instance(Args&&... args)
+    {
+        using instance = unique_instance<T, Report>;
+        auto obj = detail::instance_access::adopt<instance>(std::unique_ptr<T>(new T(std::forward<Args>(args)...)));
+        detail::type_tag_recorder<T>::record(obj.get());
+        return obj;
+    }
+}
+
+namespace std
+{
+    // hashes the address of the object, like std::hash<std::unique_ptr>
+    template<typename T, typename Report, typename Deleter>
+    struct hash<rebox::unique_instance<T, Report, Deleter>>
+    {
+        std::size_t operator()(rebox::unique_instance<T, Report, Deleter> const& obj) const
+        {
+            return std::hash<T*>()(&obj.get());
+        }
+    };
+}
+
+#endif
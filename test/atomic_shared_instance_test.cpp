@@ -0,0 +1,199 @@
+// atomic_shared_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/atomic_shared_instance.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the instances alive
+    class Counted
+    {
+    public:
+        Counted(int value, std::atomic<int>& liveCount)
+            : value(value),
+              m_liveCount(liveCount)
+        {
+            ++m_liveCount;
+        }
+
+        ~Counted()
+        {
+            --m_liveCount;
+        }
+
+        int value;
+
+    private:
+        std::atomic<int>& m_liveCount;
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(load_yields_stored_instance)
+    {
+        auto foo = make_shared_instance<int>(42);
+        atomic_shared_instance<int> holder{foo};
+
+        shared_instance<int> bar{holder.load()};
+        BOOST_CHECK_EQUAL(&bar.get(), &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 3);
+
+        shared_instance<int> qux = holder;
+        BOOST_CHECK_EQUAL(&qux.get(), &foo.get());
+    }
+
+    BOOST_AUTO_TEST_CASE(store_releases_previous_instance)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            atomic_shared_instance<Counted> holder{make_shared_instance<Counted>(1, liveCount)};
+
+            holder.store(make_shared_instance<Counted>(2, liveCount));
+            BOOST_CHECK_EQUAL(liveCount, 1);
+            BOOST_CHECK_EQUAL(holder.load().get().value, 2);
+
+            holder = make_shared_instance<Counted>(3, liveCount);
+            BOOST_CHECK_EQUAL(liveCount, 1);
+            BOOST_CHECK_EQUAL(holder.load().get().value, 3);
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(exchange_yields_previous_instance)
+    {
+        auto foo = make_shared_instance<int>(42);
+        auto bar = make_shared_instance<int>(23);
+        atomic_shared_instance<int> holder{foo};
+
+        shared_instance<int> previous{holder.exchange(bar)};
+        BOOST_CHECK_EQUAL(&previous.get(), &foo.get());
+        BOOST_CHECK_EQUAL(&holder.load().get(), &bar.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(compare_exchange)
+    {
+        auto foo = make_shared_instance<int>(42);
+        auto bar = make_shared_instance<int>(23);
+        atomic_shared_instance<int> holder{foo};
+
+        shared_instance<int> expected{bar};
+        BOOST_CHECK(!holder.compare_exchange_strong(expected, bar));
+        BOOST_CHECK_EQUAL(&expected.get(), &foo.get());
+
+        BOOST_CHECK(holder.compare_exchange_strong(expected, bar));
+        BOOST_CHECK_EQUAL(&holder.load().get(), &bar.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+
+        expected = bar;
+        while (!holder.compare_exchange_weak(expected, foo))
+        {
+            BOOST_REQUIRE_EQUAL(&expected.get(), &bar.get());
+        }
+
+        BOOST_CHECK_EQUAL(&holder.load().get(), &foo.get());
+        BOOST_CHECK_EQUAL(bar.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(compare_exchange_distinguishes_owners)
+    {
+        auto foo = make_shared_instance<int>(42);
+        shared_instance<int> alias{std::shared_ptr<int>(std::make_shared<int>(23), &foo.get())};
+        atomic_shared_instance<int> holder{foo};
+
+        BOOST_CHECK(!holder.compare_exchange_strong(alias, foo));
+        BOOST_CHECK(alias.ptr() == foo.ptr());
+        BOOST_CHECK(!alias.owner_before(foo) && !foo.owner_before(alias));
+    }
+
+    BOOST_AUTO_TEST_CASE(is_lock_free)
+    {
+        atomic_shared_instance<int> holder{make_shared_instance<int>(42)};
+
+#if defined(__x86_64__) || defined(_M_X64)
+        BOOST_CHECK(holder.is_lock_free());
+#endif
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_loads_and_stores)
+    {
+        std::atomic<int> liveCount{0};
+        constexpr int stores{10000};
+
+        {
+            atomic_shared_instance<Counted> holder{make_shared_instance<Counted>(0, liveCount)};
+            std::atomic<bool> done{false};
+            std::atomic<bool> ordered{true};
+
+            std::vector<std::thread> readers;
+            for (int i = 0; i < 4; ++i)
+            {
+                readers.emplace_back([&]
+                {
+                    int last{0};
+
+                    while (!done)
+                    {
+                        int value{holder.load().get().value};
+
+                        if (value < last)
+                        {
+                            ordered = false;
+                        }
+
+                        last = value;
+                    }
+                });
+            }
+
+            std::thread incrementer{[&]
+            {
+                for (int i = 0; i < stores; ++i)
+                {
+                    shared_instance<Counted> expected{holder.load()};
+
+                    while (!holder.compare_exchange_weak(expected, make_shared_instance<Counted>(expected.get().value + 1, liveCount)))
+                    {
+                    }
+                }
+            }};
+
+            for (int i = 0; i < stores; ++i)
+            {
+                shared_instance<Counted> expected{holder.load()};
+
+                while (!holder.compare_exchange_strong(expected, make_shared_instance<Counted>(expected.get().value + 1, liveCount)))
+                {
+                }
+            }
+
+            incrementer.join();
+            done = true;
+
+            for (auto& reader : readers)
+            {
+                reader.join();
+            }
+
+            BOOST_CHECK(ordered);
+            BOOST_CHECK_EQUAL(holder.load().get().value, 2 * stores);
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+}
@@ -0,0 +1,185 @@
+// batch_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+#include <boost/mpl/list.hpp>
+
+#include "rebox/batch.hpp"
+#include "rebox/biased_count.hpp"
+
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the instances alive
+    class Counted
+    {
+    public:
+        explicit Counted(std::atomic<int>& liveCount)
+            : m_liveCount(liveCount)
+        {
+            ++m_liveCount;
+        }
+
+        ~Counted()
+        {
+            --m_liveCount;
+        }
+
+    private:
+        std::atomic<int>& m_liveCount;
+    };
+
+    using policies = boost::mpl::list<multi_threaded, single_threaded, atomic_counted, owner_biased>;
+
+
+
+    BOOST_AUTO_TEST_CASE_TEMPLATE(acquire_n_copies, Threading, policies)
+    {
+        auto foo = make_shared_instance<int, throw_invalid_argument, Threading>(42);
+
+        auto copies = acquire_n(foo, 5);
+
+        BOOST_CHECK_EQUAL(copies.size(), 5u);
+        BOOST_CHECK_EQUAL(foo.use_count(), 6);
+
+        for (auto const& copy : copies)
+        {
+            BOOST_CHECK_EQUAL(&copy.get(), &foo.get());
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE_TEMPLATE(acquire_none, Threading, policies)
+    {
+        auto foo = make_shared_instance<int, throw_invalid_argument, Threading>(42);
+
+        std::vector<shared_instance<int, throw_invalid_argument, Threading>> copies;
+        acquire_n(foo, 0, std::back_inserter(copies));
+
+        BOOST_CHECK(copies.empty());
+        BOOST_CHECK(foo.unique());
+    }
+
+    BOOST_AUTO_TEST_CASE_TEMPLATE(release_batch_coalesces_owners, Threading, policies)
+    {
+        using instance = shared_instance<Counted, throw_invalid_argument, Threading>;
+
+        std::atomic<int> liveCount{0};
+        std::vector<instance> instances;
+
+        {
+            auto foo = make_shared_instance<Counted, throw_invalid_argument, Threading>(liveCount);
+            auto bar = make_shared_instance<Counted, throw_invalid_argument, Threading>(liveCount);
+            auto baz = make_shared_instance<Counted, throw_invalid_argument, Threading>(liveCount);
+
+            for (int i = 0; i < 10; ++i)
+            {
+                instances.push_back(foo);
+                instances.push_back(bar);
+            }
+
+            instances.push_back(baz);
+
+            release_batch(instances);
+
+            BOOST_CHECK(instances.empty());
+            BOOST_CHECK(foo.unique());
+            BOOST_CHECK(bar.unique());
+            BOOST_CHECK(baz.unique());
+
+            instances.push_back(std::move(foo));
+            instances.push_back(std::move(bar));
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 2);
+
+        release_batch(instances);
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE_TEMPLATE(release_batch_skips_moved_from_instances, Threading, policies)
+    {
+        using instance = shared_instance<Counted, throw_invalid_argument, Threading>;
+
+        std::atomic<int> liveCount{0};
+        std::vector<instance> instances;
+
+        auto foo = make_shared_instance<Counted, throw_invalid_argument, Threading>(liveCount);
+        instances.push_back(foo);
+        instances.push_back(foo);
+        instances.push_back(make_shared_instance<Counted, throw_invalid_argument, Threading>(liveCount));
+
+        instance taken{std::move(instances[1])};
+        release_batch(instances);
+
+        BOOST_CHECK(instances.empty());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        BOOST_CHECK_EQUAL(liveCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(biased_release_of_references_from_other_threads)
+    {
+        using instance = shared_instance<Counted, throw_invalid_argument, owner_biased>;
+
+        std::atomic<int> liveCount{0};
+        std::vector<instance> instances;
+
+        {
+            auto foo = make_shared_instance<Counted, throw_invalid_argument, owner_biased>(liveCount);
+
+            // copies counted by another thread, released here together
+            // with the ones of the creating thread
+            std::thread{[&]
+            {
+                acquire_n(foo, 3, std::back_inserter(instances));
+            }}.join();
+
+            instances.push_back(std::move(foo));
+        }
+
+        BOOST_CHECK_EQUAL(instances.front().use_count(), 4);
+
+        release_batch(instances);
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_fan_out)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_shared_instance<Counted, throw_invalid_argument, atomic_counted>(liveCount);
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < 4; ++t)
+            {
+                threads.emplace_back([&foo]
+                {
+                    for (int i = 0; i < 100; ++i)
+                    {
+                        auto copies = acquire_n(foo, 64);
+                        release_batch(copies);
+                    }
+                });
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            BOOST_CHECK(foo.unique());
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+}
@@ -0,0 +1,229 @@
+// biased_count_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/biased_count.hpp"
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the instances alive
+    class Counted
+    {
+    public:
+        explicit Counted(std::atomic<int>& liveCount)
+            : m_liveCount(liveCount)
+        {
+            ++m_liveCount;
+        }
+
+        ~Counted()
+        {
+            --m_liveCount;
+        }
+
+    private:
+        std::atomic<int>& m_liveCount;
+    };
+
+    class Boom
+    {
+    public:
+        Boom()
+        {
+            throw std::runtime_error("boom");
+        }
+    };
+
+    template<typename T>
+    using biased_instance = shared_instance<T, throw_invalid_argument, owner_biased>;
+
+    template<typename T, typename... Args>
+    biased_instance<T> make_biased(Args&&... args)
+    {
+        return make_shared_instance<T, throw_invalid_argument, owner_biased>(std::forward<Args>(args)...);
+    }
+
+
+
+    BOOST_AUTO_TEST_CASE(copies_on_creating_thread)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_biased<Counted>(liveCount);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+
+            {
+                biased_instance<Counted> bar{foo};
+                BOOST_CHECK_EQUAL(foo.use_count(), 2);
+            }
+
+            BOOST_CHECK(foo.unique());
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(released_last_by_creating_thread)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_biased<Counted>(liveCount);
+
+            std::thread{[copy = foo]
+            {
+                biased_instance<Counted> another{copy};
+            }}.join();
+
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(released_last_by_other_thread)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_biased<Counted>(liveCount);
+            biased_instance<Counted> bar{foo};
+
+            std::thread{[moved = std::move(bar)]
+            {
+            }}.join();
+
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        // the release of the creating thread merged the counts
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(handed_off_and_released_elsewhere)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_biased<Counted>(liveCount);
+
+            std::thread{[moved = std::move(foo)]
+            {
+            }}.join();
+        }
+
+        // waits for the creating thread to merge
+        BOOST_CHECK_EQUAL(liveCount, 1);
+
+        biased_count::collect();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(throwing_constructor_leaves_no_count_behind)
+    {
+        BOOST_CHECK_THROW(make_biased<Boom>(), std::runtime_error);
+
+        // the failed count must not stay linked into the thread's list
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_biased<Counted>(liveCount);
+            auto bar = make_biased<Counted>(liveCount);
+            BOOST_CHECK(foo.unique());
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(creating_thread_exits_first)
+    {
+        std::atomic<int> liveCount{0};
+        std::vector<biased_instance<Counted>> instances;
+
+        std::thread{[&]
+        {
+            for (int i = 0; i < 10; ++i)
+            {
+                auto foo = make_biased<Counted>(liveCount);
+                instances.push_back(foo);
+                instances.push_back(std::move(foo));
+            }
+        }}.join();
+
+        BOOST_CHECK_EQUAL(liveCount, 10);
+        BOOST_CHECK_EQUAL(instances.front().use_count(), 2);
+
+        instances.clear();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(lock_weak_pointer_on_other_thread)
+    {
+        std::atomic<int> liveCount{0};
+
+        auto foo = make_biased<Counted>(liveCount);
+        counted_weak_ptr<Counted, biased_count> weak{foo.ptr()};
+
+        std::thread{[&]
+        {
+            counted_ptr<Counted, biased_count> locked{weak.lock()};
+            BOOST_CHECK(locked);
+        }}.join();
+
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_copies)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            std::vector<biased_instance<Counted>> instances;
+            for (int i = 0; i < 100; ++i)
+            {
+                instances.push_back(make_biased<Counted>(liveCount));
+            }
+
+            std::vector<std::thread> threads;
+            for (int t = 0; t < 4; ++t)
+            {
+                threads.emplace_back([&]
+                {
+                    for (int round = 0; round < 100; ++round)
+                    {
+                        std::vector<biased_instance<Counted>> copies{instances};
+                    }
+                });
+            }
+
+            for (int round = 0; round < 100; ++round)
+            {
+                std::vector<biased_instance<Counted>> copies{instances};
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            BOOST_CHECK_EQUAL(instances.front().use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+}
@@ -0,0 +1,188 @@
+// checked_cast_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/checked_cast.hpp"
+#include "rebox/local_shared_instance.hpp"
+#include "rebox/unique_instance.hpp"
+
+#include <memory>
+#include <stdexcept>
+
+
+namespace rebox
+{
+    class Message : public type_tagged<Message>
+    {
+    public:
+        virtual ~Message() = default;
+    };
+
+    class Ping final : public Message
+    {
+    };
+
+    class Pong : public Message
+    {
+    };
+
+    class LatePong : public Pong
+    {
+    };
+
+    // tagged, but without virtual functions to fall back on
+    class Plain : public type_tagged<Plain>
+    {
+    };
+
+    class PlainDerived : public Plain
+    {
+    };
+
+    class Untagged
+    {
+    public:
+        virtual ~Untagged() = default;
+    };
+
+    class UntaggedDerived : public Untagged
+    {
+    };
+
+    // made with the tag of another module, like a DLL keeping its own
+    // copy of type_tag<Foreign>
+    class Foreign final : public Message
+    {
+    };
+
+    namespace detail
+    {
+        template<>
+        class type_tag_recorder<Foreign>
+        {
+        public:
+            static void record(Foreign const& obj)
+            {
+                static char otherModule;
+                Message::type_tagged_type::record(obj, &otherModule);
+            }
+        };
+    }
+
+
+
+    BOOST_AUTO_TEST_CASE(tags_are_recorded_when_made)
+    {
+        shared_instance<Message> ping{make_shared_instance<Ping>()};
+        BOOST_CHECK_EQUAL(ping.get().type_tag(), Message::tag_of<Ping>());
+
+        shared_instance<Message const> pong{make_shared_instance<Pong const>()};
+        BOOST_CHECK_EQUAL(pong.get().type_tag(), Message::tag_of<Pong>());
+
+        shared_instance<Message> allocated{allocate_shared_instance<LatePong>(std::allocator<LatePong>())};
+        BOOST_CHECK_EQUAL(allocated.get().type_tag(), Message::tag_of<LatePong>());
+
+        auto unique = make_unique_instance<Ping>();
+        BOOST_CHECK_EQUAL(unique.get().type_tag(), Message::tag_of<Ping>());
+
+        BOOST_CHECK(Message::tag_of<Ping>() != Message::tag_of<Pong>());
+
+        // objects created otherwise have no tag, neither have copies
+        shared_instance<Message> created{new Ping()};
+        BOOST_CHECK(!created.get().type_tag());
+
+        Ping copy{static_cast<Ping const&>(ping.get())};
+        BOOST_CHECK(!copy.type_tag());
+    }
+
+    BOOST_AUTO_TEST_CASE(try_casts)
+    {
+        shared_instance<Message> ping{make_shared_instance<Ping>()};
+        shared_instance<Message> latePong{make_shared_instance<LatePong>()};
+
+        std::shared_ptr<Ping> asPing{try_pointer_cast<Ping>(ping)};
+        BOOST_CHECK_EQUAL(asPing.get(), &ping.get());
+        BOOST_CHECK_EQUAL(ping.use_count(), 2);
+
+        BOOST_CHECK(!try_pointer_cast<Ping>(latePong));
+        BOOST_CHECK(!try_pointer_cast<Pong>(ping));
+        BOOST_CHECK(try_pointer_cast<LatePong const>(latePong));
+
+        // types in between are found by dynamic_cast
+        BOOST_CHECK(try_pointer_cast<Pong>(latePong));
+
+        // as are objects without a tag
+        shared_instance<Message> created{new Pong()};
+        BOOST_CHECK(try_pointer_cast<Pong>(created));
+        BOOST_CHECK(!try_pointer_cast<Ping>(created));
+
+        shared_instance<Untagged> untagged{make_shared_instance<UntaggedDerived>()};
+        BOOST_CHECK(try_pointer_cast<UntaggedDerived>(untagged));
+    }
+
+    BOOST_AUTO_TEST_CASE(tags_of_other_modules_fall_back_to_dynamic_cast)
+    {
+        shared_instance<Message> foreign{make_shared_instance<Foreign>()};
+        BOOST_CHECK(foreign.get().type_tag() != Message::tag_of<Foreign>());
+
+        BOOST_CHECK(try_pointer_cast<Foreign>(foreign));
+        BOOST_CHECK(!try_pointer_cast<Ping>(foreign));
+        BOOST_CHECK_NO_THROW(checked_pointer_cast<Foreign>(std::move(foreign)));
+    }
+
+    BOOST_AUTO_TEST_CASE(rvalue_try_casts)
+    {
+        shared_instance<Message> ping{make_shared_instance<Ping>()};
+        Message* address{&ping.get()};
+
+        // a failing cast leaves the source untouched
+        BOOST_CHECK(!try_pointer_cast<Pong>(std::move(ping)));
+        BOOST_CHECK_EQUAL(&ping.get(), address);
+
+        std::shared_ptr<Ping> asPing{try_pointer_cast<Ping>(std::move(ping))};
+        BOOST_CHECK_EQUAL(asPing.get(), address);
+        BOOST_CHECK_EQUAL(asPing.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(checked_casts)
+    {
+        shared_instance<Message> pong{make_shared_instance<Pong>()};
+
+        shared_instance<Pong> asPong{checked_pointer_cast<Pong>(pong)};
+        BOOST_CHECK_EQUAL(&asPong.get(), &pong.get());
+
+        BOOST_CHECK_THROW(checked_pointer_cast<Ping>(pong), std::invalid_argument);
+        BOOST_CHECK_THROW(checked_pointer_cast<LatePong>(std::move(pong)), std::invalid_argument);
+
+        auto moved = checked_pointer_cast<Pong const>(std::move(pong));
+        BOOST_CHECK_EQUAL(&moved.get(), &asPong.get());
+        BOOST_CHECK_EQUAL(moved.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(non_polymorphic_hierarchies)
+    {
+        shared_instance<Plain> made{make_shared_instance<PlainDerived>()};
+        BOOST_CHECK(try_pointer_cast<PlainDerived>(made));
+
+        // without a tag and virtual functions the type is unknown
+        shared_instance<Plain> created{new PlainDerived()};
+        BOOST_CHECK(!try_pointer_cast<PlainDerived>(created));
+    }
+
+    BOOST_AUTO_TEST_CASE(counted_instances)
+    {
+        local_shared_instance<Message> ping{make_shared_instance<Ping, throw_invalid_argument, single_threaded>()};
+
+        auto asPing = checked_pointer_cast<Ping>(ping);
+        BOOST_CHECK_EQUAL(ping.use_count(), 2);
+
+        BOOST_CHECK(!try_pointer_cast<Pong>(ping));
+        BOOST_CHECK(try_pointer_cast<Ping>(std::move(ping)));
+    }
+}
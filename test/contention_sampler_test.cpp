@@ -0,0 +1,265 @@
+// contention_sampler_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define REBOX_CONTENTION_SAMPLING 1
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/local_shared_instance.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    class Sampled
+    {
+    };
+
+    class Shared
+    {
+    };
+
+    // copies are noexcept, so recording their samples must not throw
+    static_assert(noexcept(std::declval<detail::thread_samples&>().record(
+                      std::declval<detail::sample_key const&>(), "", 0)),
+                  "recording a sample must not throw");
+
+    // the samples taken at line of this file
+    std::vector<contention_sample> samples_at(unsigned line)
+    {
+        std::vector<contention_sample> result;
+
+        for (auto const& sample : contention_sampler::instance().collect())
+        {
+            if (sample.line == line && sample.file.find("contention_sampler_test") != std::string::npos)
+            {
+                result.push_back(sample);
+            }
+        }
+
+        return result;
+    }
+
+    // samples every operation for the lifetime of the fixture
+    class every_operation
+    {
+    public:
+        every_operation()
+        {
+            contention_sampler::instance().reset();
+            contention_sampler::instance().period(1);
+        }
+
+        ~every_operation()
+        {
+            contention_sampler::instance().period(64);
+        }
+    };
+
+
+
+    BOOST_FIXTURE_TEST_CASE(copies_are_sampled_at_their_call_site, every_operation)
+    {
+        auto foo = make_shared_instance<Sampled>();
+
+        unsigned const line{__LINE__ + 3};
+        for (int i = 0; i < 10; ++i)
+        {
+            shared_instance<Sampled> copy{foo};
+        }
+
+        auto samples = samples_at(line);
+        BOOST_REQUIRE_EQUAL(samples.size(), 2u);
+
+        auto copies = std::find_if(samples.begin(), samples.end(), [](contention_sample const& sample)
+        {
+            return sample.operation == count_operation::copy;
+        });
+
+        auto drops = std::find_if(samples.begin(), samples.end(), [](contention_sample const& sample)
+        {
+            return sample.operation == count_operation::drop;
+        });
+
+        BOOST_REQUIRE(copies != samples.end());
+        BOOST_REQUIRE(drops != samples.end());
+        BOOST_CHECK_EQUAL(copies->samples, 10u);
+        BOOST_CHECK_EQUAL(drops->samples, 10u);
+        BOOST_CHECK_EQUAL(copies->type, detail::demangle(typeid(Sampled).name()));
+#if REBOX_DEMANGLE
+        BOOST_CHECK_EQUAL(copies->type, "rebox::Sampled");
+#endif
+        BOOST_CHECK(copies->maxCycles <= copies->cycles);
+    }
+
+    BOOST_FIXTURE_TEST_CASE(ptr_and_assignment_are_sampled, every_operation)
+    {
+        auto foo = make_shared_instance<Sampled>();
+        auto other = make_shared_instance<Sampled>();
+
+        unsigned const targetLine{__LINE__ + 1};
+        shared_instance<Sampled> bar{other};
+
+        unsigned const line{__LINE__ + 1};
+        std::shared_ptr<Sampled> ptr{foo.ptr()};
+        bar = foo;
+
+        auto samples = samples_at(line);
+        BOOST_REQUIRE_EQUAL(samples.size(), 1u);
+        BOOST_CHECK(samples.front().operation == count_operation::copy);
+
+        // assignments are attributed to where the target was taken
+        auto assignments = samples_at(targetLine);
+        BOOST_REQUIRE_EQUAL(assignments.size(), 2u);
+        BOOST_CHECK(std::any_of(assignments.begin(), assignments.end(), [](contention_sample const& sample)
+        {
+            return sample.operation == count_operation::assign;
+        }));
+    }
+
+    BOOST_FIXTURE_TEST_CASE(counted_policies_are_sampled, every_operation)
+    {
+        auto foo = make_local_shared_instance<Sampled>();
+
+        unsigned const line{__LINE__ + 3};
+        for (int i = 0; i < 5; ++i)
+        {
+            local_shared_instance<Sampled> copy{foo};
+        }
+
+        auto samples = samples_at(line);
+        BOOST_REQUIRE_EQUAL(samples.size(), 2u);
+        BOOST_CHECK_EQUAL(samples.front().samples, 5u);
+        BOOST_CHECK_EQUAL(samples.back().samples, 5u);
+    }
+
+    BOOST_FIXTURE_TEST_CASE(sites_are_told_apart_by_name, every_operation)
+    {
+        // the same file as named by two translation units
+        static char const first[] = "contention_sampler_test/shared.hpp";
+        static char const second[] = "contention_sampler_test/shared.hpp";
+
+        auto foo = make_shared_instance<Sampled>();
+        shared_instance<Sampled> bar{foo, call_site{first, "bar", 7}};
+        shared_instance<Sampled> baz{foo, call_site{second, "baz", 7}};
+
+        auto samples = samples_at(7);
+        auto copies = std::count_if(samples.begin(), samples.end(), [](contention_sample const& sample)
+        {
+            return sample.operation == count_operation::copy;
+        });
+
+        BOOST_REQUIRE_EQUAL(copies, 1);
+        BOOST_CHECK_EQUAL(samples.front().samples, 2u);
+    }
+
+    BOOST_FIXTURE_TEST_CASE(last_reference_is_not_sampled, every_operation)
+    {
+        auto foo = make_shared_instance<Sampled>();
+
+        unsigned const line{__LINE__ + 2};
+        {
+            shared_instance<Sampled> copy{foo};
+            foo = make_shared_instance<Sampled>();
+        }
+
+        auto samples = samples_at(line);
+        BOOST_REQUIRE_EQUAL(samples.size(), 1u);
+        BOOST_CHECK(samples.front().operation == count_operation::copy);
+    }
+
+    BOOST_AUTO_TEST_CASE(sampling_period)
+    {
+        contention_sampler::instance().reset();
+        contention_sampler::instance().period(0);
+
+        auto foo = make_shared_instance<Sampled>();
+
+        unsigned const line{__LINE__ + 3};
+        for (int i = 0; i < 100; ++i)
+        {
+            shared_instance<Sampled> copy{foo};
+        }
+
+        BOOST_CHECK(samples_at(line).empty());
+
+        contention_sampler::instance().period(10);
+
+        unsigned const sampledLine{__LINE__ + 3};
+        for (int i = 0; i < 100; ++i)
+        {
+            shared_instance<Sampled> copy{foo};
+        }
+
+        // the intervals vary around the period
+        std::size_t sampled{0};
+        for (auto const& sample : samples_at(sampledLine))
+        {
+            sampled += sample.samples;
+        }
+
+        BOOST_CHECK(sampled >= 5u && sampled <= 50u);
+
+        contention_sampler::instance().period(64);
+    }
+
+    BOOST_FIXTURE_TEST_CASE(samples_of_exited_threads_are_kept, every_operation)
+    {
+        auto foo = make_shared_instance<Shared>();
+        std::vector<std::thread> threads;
+        unsigned const line{__LINE__ + 8};
+
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&foo]
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    shared_instance<Shared> copy{foo};
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        std::size_t copies{0};
+        for (auto const& sample : samples_at(line))
+        {
+            if (sample.operation == count_operation::copy)
+            {
+                copies += sample.samples;
+            }
+        }
+
+        BOOST_CHECK_EQUAL(copies, 4000u);
+    }
+
+    BOOST_FIXTURE_TEST_CASE(reports, every_operation)
+    {
+        auto foo = make_shared_instance<Sampled>();
+        shared_instance<Sampled> copy{foo};
+
+        std::ostringstream text;
+        contention_sampler::instance().report(text);
+        BOOST_CHECK(text.str().find("contention_sampler_test.cpp:" + std::to_string(__LINE__ - 4)) != std::string::npos);
+        BOOST_CHECK(text.str().find(" copy: samples=1 ") != std::string::npos);
+
+        std::ostringstream json;
+        contention_sampler::instance().report_json(json);
+        BOOST_CHECK_EQUAL(json.str().front(), '[');
+        BOOST_CHECK(json.str().find("\"operation\": \"copy\", \"samples\": 1,") != std::string::npos);
+        BOOST_CHECK(json.str().find("\"line\": " + std::to_string(__LINE__ - 11)) != std::string::npos);
+    }
+}
@@ -0,0 +1,236 @@
+// counted_ptr_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/counted_ptr.hpp"
+
+
+namespace rebox
+{
+    class Base
+    {
+    public:
+        explicit Base(int& deleteCount)
+            : m_deleteCount(deleteCount)
+        {
+        }
+
+        virtual ~Base()
+        {
+            ++m_deleteCount;
+        }
+
+    private:
+        int& m_deleteCount;
+    };
+
+
+    class Derived : public Base
+    {
+    public:
+        using Base::Base;
+    };
+
+
+    class TestDeleter
+    {
+    public:
+        TestDeleter(int& useCount)
+            : m_useCount(useCount)
+        {
+        }
+
+        void operator() (Base* value)
+        {
+            delete value;
+            ++m_useCount;
+        }
+
+    private:
+        int& m_useCount;
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(default_constructed_is_null)
+    {
+        local_shared_ptr<int> foo;
+        BOOST_CHECK(!foo);
+        BOOST_CHECK(foo == nullptr);
+        BOOST_CHECK_EQUAL(foo.use_count(), 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_plain_pointer)
+    {
+        int deleteCount{};
+
+        {
+            Base* ptr{new Base(deleteCount)};
+            local_shared_ptr<Base> foo{ptr};
+            BOOST_CHECK_EQUAL(foo.get(), ptr);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+
+            {
+                local_shared_ptr<Base> bar{foo};
+                BOOST_CHECK_EQUAL(foo.use_count(), 2);
+            }
+
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_with_deleter)
+    {
+        int deleteCount{};
+        int deleterUseCount{};
+
+        {
+            local_shared_ptr<Base> foo{new Derived(deleteCount), TestDeleter(deleterUseCount)};
+            BOOST_CHECK(get_deleter<TestDeleter>(foo) != nullptr);
+            BOOST_CHECK(get_deleter<std::default_delete<Base>>(foo) == nullptr);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+        BOOST_CHECK_EQUAL(deleterUseCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_unique_pointer)
+    {
+        int deleteCount{};
+
+        {
+            Derived* ptr{new Derived(deleteCount)};
+            std::unique_ptr<Derived> unique{ptr};
+            local_shared_ptr<Base> foo{std::move(unique)};
+
+            BOOST_CHECK(!unique);
+            BOOST_CHECK_EQUAL(foo.get(), ptr);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(move_leaves_source_empty)
+    {
+        local_shared_ptr<int> foo{new int(42)};
+        local_shared_ptr<int> bar{std::move(foo)};
+
+        BOOST_CHECK(!foo);
+        BOOST_CHECK_EQUAL(*bar, 42);
+        BOOST_CHECK_EQUAL(bar.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_assignment)
+    {
+        int deleteCount{};
+        int deleteCount2{};
+
+        {
+            local_shared_ptr<Base> foo{new Base(deleteCount)};
+            local_shared_ptr<Base> bar{new Base(deleteCount2)};
+
+            foo = bar;
+            BOOST_CHECK_EQUAL(deleteCount, 1);
+            BOOST_CHECK_EQUAL(bar.use_count(), 2);
+
+            foo = local_shared_ptr<Derived>{new Derived(deleteCount)};
+            BOOST_CHECK_EQUAL(bar.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+        BOOST_CHECK_EQUAL(deleteCount2, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_aliasing)
+    {
+        auto foo = make_counted<std::pair<int, int>, plain_count>(23, 42);
+        local_shared_ptr<int> bar{foo, &foo->second};
+
+        BOOST_CHECK_EQUAL(*bar, 42);
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        BOOST_CHECK(!foo.owner_before(bar) && !bar.owner_before(foo));
+    }
+
+    BOOST_AUTO_TEST_CASE(test_weak_pointer)
+    {
+        int deleteCount{};
+        local_weak_ptr<Base> weak;
+
+        {
+            local_shared_ptr<Base> foo{new Base(deleteCount)};
+            weak = foo;
+
+            BOOST_CHECK(!weak.expired());
+            BOOST_CHECK_EQUAL(weak.lock().get(), foo.get());
+            BOOST_CHECK_EQUAL(weak.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+        BOOST_CHECK(weak.expired());
+        BOOST_CHECK(!weak.lock());
+        BOOST_CHECK_THROW(local_shared_ptr<Base>{weak}, std::bad_weak_ptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_make_counted)
+    {
+        int deleteCount{};
+
+        {
+            auto foo = make_counted<Derived, plain_count>(deleteCount);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+
+            local_shared_ptr<Base> bar{foo};
+            BOOST_CHECK_EQUAL(bar.use_count(), 2);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_pointer_casts)
+    {
+        int deleteCount{};
+
+        {
+            local_shared_ptr<Base const> foo{make_counted<Derived, plain_count>(deleteCount)};
+
+            auto derived = static_pointer_cast<Derived const>(foo);
+            BOOST_CHECK_EQUAL(derived.get(), foo.get());
+
+            auto deconsted = const_pointer_cast<Base>(foo);
+            BOOST_CHECK_EQUAL(deconsted.get(), foo.get());
+
+            auto dynamic = dynamic_pointer_cast<Derived const>(foo);
+            BOOST_CHECK_EQUAL(dynamic.get(), foo.get());
+            BOOST_CHECK_EQUAL(foo.use_count(), 4);
+
+            local_shared_ptr<Base const> base{make_counted<Base, plain_count>(deleteCount)};
+            BOOST_CHECK(!dynamic_pointer_cast<Derived const>(base));
+            BOOST_CHECK_EQUAL(base.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_compare)
+    {
+        local_shared_ptr<int> foo{new int(42)};
+        local_shared_ptr<int> bar{new int(42)};
+
+        BOOST_CHECK(foo == foo);
+        BOOST_CHECK(foo != bar);
+        BOOST_CHECK((foo < bar) != (bar < foo));
+        BOOST_CHECK(foo <= foo);
+        BOOST_CHECK(foo >= foo);
+        BOOST_CHECK(foo != nullptr);
+    }
+
+}
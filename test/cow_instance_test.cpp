@@ -0,0 +1,143 @@
+// cow_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/cow_instance.hpp"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    class Document
+    {
+    public:
+        Document() = default;
+
+        explicit Document(std::string const& title)
+            : title(title)
+        {
+        }
+
+        bool operator==(Document const& other) const
+        {
+            return title == other.title && lines == other.lines;
+        }
+
+        std::string title;
+        std::vector<std::string> lines;
+    };
+
+
+    BOOST_AUTO_TEST_CASE(copies_share_the_object)
+    {
+        cow_instance<Document> doc{make_cow_instance<Document>("draft")};
+        BOOST_CHECK(doc.unique());
+
+        cow_instance<Document> copy{doc};
+        BOOST_CHECK_EQUAL(&copy.get(), &doc.get());
+        BOOST_CHECK_EQUAL(doc.use_count(), 2);
+        BOOST_CHECK(!doc.unique());
+
+        Document const& read = copy;
+        BOOST_CHECK_EQUAL(read.title, "draft");
+        BOOST_CHECK(copy == doc);
+    }
+
+    BOOST_AUTO_TEST_CASE(unique_objects_are_mutated_in_place)
+    {
+        cow_instance<Document> doc{Document{"draft"}};
+        Document const* address{&doc.get()};
+
+        doc.mutate().title = "final";
+        BOOST_CHECK_EQUAL(&doc.get(), address);
+        BOOST_CHECK_EQUAL(doc.get().title, "final");
+
+        // once the copy is gone the object is unique again
+        {
+            cow_instance<Document> copy{doc};
+        }
+
+        doc.mutate().lines.push_back("text");
+        BOOST_CHECK_EQUAL(&doc.get(), address);
+    }
+
+    BOOST_AUTO_TEST_CASE(shared_objects_are_copied)
+    {
+        cow_instance<Document> doc{make_cow_instance<Document>("draft")};
+        cow_instance<Document> copy{doc};
+
+        copy.mutate().title = "final";
+        BOOST_CHECK(&copy.get() != &doc.get());
+        BOOST_CHECK_EQUAL(doc.get().title, "draft");
+        BOOST_CHECK_EQUAL(copy.get().title, "final");
+        BOOST_CHECK(doc.unique());
+        BOOST_CHECK(copy.unique());
+        BOOST_CHECK(copy != doc);
+
+        // assignment shares again
+        doc = copy;
+        BOOST_CHECK_EQUAL(&copy.get(), &doc.get());
+
+        cow_instance<Document> other{Document{"other"}};
+        swap(doc, other);
+        BOOST_CHECK_EQUAL(doc.get().title, "other");
+        BOOST_CHECK_EQUAL(other.get().title, "final");
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_mutations)
+    {
+        constexpr std::size_t threads{4};
+        constexpr std::size_t rounds{1000};
+
+        cow_instance<Document> doc{make_cow_instance<Document>("draft")};
+        std::vector<cow_instance<Document>> copies(threads, doc);
+        std::vector<std::size_t> mismatches(threads, 0);
+
+        // the last thread to mutate the original object does so in
+        // place, after the other threads are done reading it
+        doc = make_cow_instance<Document>("other");
+
+        std::vector<std::thread> workers;
+
+        for (std::size_t thread = 0; thread < threads; ++thread)
+        {
+            workers.emplace_back([&, thread]
+            {
+                cow_instance<Document>& copy = copies[thread];
+
+                for (std::size_t round = 0; round < rounds; ++round)
+                {
+                    std::string title{copy.get().title};
+                    copy.mutate().lines.push_back(title);
+
+                    cow_instance<Document> snapshot{copy};
+                    if (snapshot.get().lines.size() != round + 1 || snapshot.get().lines.back() != "draft")
+                    {
+                        ++mismatches[thread];
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        for (std::size_t thread = 0; thread < threads; ++thread)
+        {
+            BOOST_CHECK_EQUAL(mismatches[thread], 0u);
+            BOOST_CHECK(copies[thread].unique());
+            BOOST_CHECK_EQUAL(copies[thread].get().lines.size(), rounds);
+        }
+    }
+}
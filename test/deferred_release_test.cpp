@@ -0,0 +1,216 @@
+// deferred_release_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/deferred_release.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the instances alive
+    class Counted
+    {
+    public:
+        explicit Counted(std::atomic<int>& liveCount)
+            : m_liveCount(liveCount)
+        {
+            ++m_liveCount;
+        }
+
+        ~Counted()
+        {
+            --m_liveCount;
+        }
+
+    private:
+        std::atomic<int>& m_liveCount;
+    };
+
+    // records the thread destroying it
+    class Tracked
+    {
+    public:
+        Tracked(std::atomic<int>& liveCount, std::thread::id& destroyedOn)
+            : m_liveCount(liveCount),
+              m_destroyedOn(destroyedOn)
+        {
+            ++m_liveCount;
+        }
+
+        ~Tracked()
+        {
+            m_destroyedOn = std::this_thread::get_id();
+            --m_liveCount;
+        }
+
+    private:
+        std::atomic<int>& m_liveCount;
+        std::thread::id& m_destroyedOn;
+    };
+
+    // blocks its destruction until released
+    class Blocking
+    {
+    public:
+        Blocking(std::atomic<bool>& entered, std::atomic<bool>& proceed)
+            : m_entered(entered),
+              m_proceed(proceed)
+        {
+        }
+
+        ~Blocking()
+        {
+            m_entered = true;
+            while (!m_proceed)
+            {
+                std::this_thread::yield();
+            }
+        }
+
+    private:
+        std::atomic<bool>& m_entered;
+        std::atomic<bool>& m_proceed;
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(last_release_is_deferred)
+    {
+        reclaimer target;
+        std::atomic<int> liveCount{0};
+        std::thread::id destroyedOn;
+
+        {
+            auto foo = make_deferred_shared_instance<Tracked>(target, liveCount, destroyedOn);
+            shared_instance<Tracked> bar{foo};
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        target.drain();
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+        BOOST_CHECK(destroyedOn != std::this_thread::get_id());
+
+        auto statistics = target.statistics();
+        BOOST_CHECK_EQUAL(statistics.deferred, 1u);
+        BOOST_CHECK_EQUAL(statistics.inlined, 0u);
+        BOOST_CHECK_EQUAL(statistics.pending, 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(deleter_for_plain_pointers)
+    {
+        reclaimer target;
+        std::atomic<int> liveCount{0};
+        std::thread::id destroyedOn;
+
+        {
+            shared_instance<Tracked> foo{new Tracked(liveCount, destroyedOn), deferred_delete<Tracked>(target)};
+        }
+
+        target.drain();
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+        BOOST_CHECK_EQUAL(target.statistics().deferred, 1u);
+    }
+
+    BOOST_AUTO_TEST_CASE(full_queue_releases_inline)
+    {
+        reclaimer target{1};
+        std::atomic<bool> entered{false};
+        std::atomic<bool> proceed{false};
+        std::atomic<int> liveCount{0};
+        std::thread::id destroyedOn;
+
+        make_deferred_shared_instance<Blocking>(target, entered, proceed);
+        while (!entered)
+        {
+            std::this_thread::yield();
+        }
+
+        // the reclamation thread is stuck, so the second object fills
+        // the queue and the third is destroyed right here
+        make_deferred_shared_instance<Tracked>(target, liveCount, destroyedOn);
+        make_deferred_shared_instance<Tracked>(target, liveCount, destroyedOn);
+
+        BOOST_CHECK_EQUAL(liveCount, 1);
+        BOOST_CHECK(destroyedOn == std::this_thread::get_id());
+
+        auto statistics = target.statistics();
+        BOOST_CHECK_EQUAL(statistics.deferred, 2u);
+        BOOST_CHECK_EQUAL(statistics.inlined, 1u);
+        BOOST_CHECK_EQUAL(statistics.pending, 1u);
+
+        proceed = true;
+        target.drain();
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+        BOOST_CHECK_EQUAL(target.statistics().pending, 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(destruction_releases_pending_objects)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            reclaimer target;
+
+            for (int i = 0; i < 100; ++i)
+            {
+                make_deferred_shared_instance<Counted>(target, liveCount);
+            }
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(default_reclaimer)
+    {
+        std::atomic<int> liveCount{0};
+        std::thread::id destroyedOn;
+
+        make_deferred_shared_instance<Tracked>(liveCount, destroyedOn);
+        reclaimer::instance().drain();
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+        BOOST_CHECK(destroyedOn != std::this_thread::get_id());
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_releases)
+    {
+        reclaimer target{16};
+        std::atomic<int> liveCount{0};
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&]
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    make_deferred_shared_instance<Counted>(target, liveCount);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        target.drain();
+
+        auto statistics = target.statistics();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+        BOOST_CHECK_EQUAL(statistics.deferred + statistics.inlined, 4000u);
+    }
+}
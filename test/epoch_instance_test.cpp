@@ -0,0 +1,253 @@
+// epoch_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/epoch_instance.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the instances alive
+    class Counted
+    {
+    public:
+        Counted(int value, std::atomic<int>& liveCount)
+            : value(value),
+              m_liveCount(liveCount)
+        {
+            ++m_liveCount;
+        }
+
+        ~Counted()
+        {
+            --m_liveCount;
+        }
+
+        int value;
+
+    private:
+        std::atomic<int>& m_liveCount;
+    };
+
+    // created before the epoch_domain, and destroyed after main
+    epoch_instance<int> staticSlot{make_shared_instance<int>(1)};
+
+    void collect_all()
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            epoch_domain::instance().collect();
+        }
+    }
+
+
+
+    BOOST_AUTO_TEST_CASE(get_leaves_the_count_untouched)
+    {
+        auto foo = make_shared_instance<int>(42);
+        epoch_instance<int> slot{foo};
+
+        epoch_guard guard;
+        int& value = slot.get(guard);
+
+        BOOST_CHECK_EQUAL(&value, &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(load_yields_a_new_reference)
+    {
+        auto foo = make_shared_instance<int>(42);
+        epoch_instance<int> slot{foo};
+
+        shared_instance<int> bar{slot.load()};
+        BOOST_CHECK_EQUAL(&bar.get(), &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 3);
+    }
+
+    BOOST_AUTO_TEST_CASE(static_instances_are_retired_at_exit)
+    {
+        staticSlot.store(make_shared_instance<int>(2));
+
+        epoch_guard guard;
+        BOOST_CHECK_EQUAL(staticSlot.get(guard), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(store_retires_previous_instance)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            epoch_instance<Counted> slot{make_shared_instance<Counted>(1, liveCount)};
+
+            slot.store(make_shared_instance<Counted>(2, liveCount));
+            collect_all();
+            BOOST_CHECK_EQUAL(liveCount, 1);
+            BOOST_CHECK_EQUAL(epoch_domain::instance().pending(), 0u);
+
+            epoch_guard guard;
+            BOOST_CHECK_EQUAL(slot.get(guard).value, 2);
+        }
+
+        collect_all();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(guard_delays_release)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            epoch_instance<Counted> slot{make_shared_instance<Counted>(1, liveCount)};
+
+            {
+                epoch_guard guard;
+                Counted& first = slot.get(guard);
+
+                slot.store(make_shared_instance<Counted>(2, liveCount));
+                collect_all();
+
+                BOOST_CHECK_EQUAL(liveCount, 2);
+                BOOST_CHECK_EQUAL(first.value, 1);
+                BOOST_CHECK_EQUAL(epoch_domain::instance().pending(), 1u);
+            }
+
+            collect_all();
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        collect_all();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(guard_of_other_thread_delays_release)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            epoch_instance<Counted> slot{make_shared_instance<Counted>(1, liveCount)};
+            std::atomic<int> stage{0};
+
+            std::thread reader{[&]
+            {
+                epoch_guard guard;
+                Counted& first = slot.get(guard);
+                stage = 1;
+
+                while (stage != 2)
+                {
+                    std::this_thread::yield();
+                }
+
+                BOOST_CHECK_EQUAL(first.value, 1);
+            }};
+
+            while (stage != 1)
+            {
+                std::this_thread::yield();
+            }
+
+            slot.store(make_shared_instance<Counted>(2, liveCount));
+            collect_all();
+            BOOST_CHECK_EQUAL(liveCount, 2);
+
+            stage = 2;
+            reader.join();
+
+            collect_all();
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        collect_all();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(nested_guards)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            epoch_instance<Counted> slot{make_shared_instance<Counted>(1, liveCount)};
+
+            {
+                epoch_guard outer;
+
+                {
+                    epoch_guard inner;
+                    BOOST_CHECK_EQUAL(slot.get(inner).value, 1);
+                }
+
+                slot.store(make_shared_instance<Counted>(2, liveCount));
+                collect_all();
+                BOOST_CHECK_EQUAL(liveCount, 2);
+            }
+
+            collect_all();
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        collect_all();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_reads_and_stores)
+    {
+        std::atomic<int> liveCount{0};
+        constexpr int stores{10000};
+
+        {
+            epoch_instance<Counted> slot{make_shared_instance<Counted>(0, liveCount)};
+            std::atomic<bool> done{false};
+            std::atomic<bool> ordered{true};
+
+            std::vector<std::thread> readers;
+            for (int i = 0; i < 4; ++i)
+            {
+                readers.emplace_back([&]
+                {
+                    int last{0};
+
+                    while (!done)
+                    {
+                        epoch_guard guard;
+                        int value{slot.get(guard).value};
+
+                        if (value < last)
+                        {
+                            ordered = false;
+                        }
+
+                        last = value;
+                    }
+                });
+            }
+
+            for (int i = 1; i <= stores; ++i)
+            {
+                slot.store(make_shared_instance<Counted>(i, liveCount));
+            }
+
+            done = true;
+
+            for (auto& reader : readers)
+            {
+                reader.join();
+            }
+
+            BOOST_CHECK(ordered);
+        }
+
+        collect_all();
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+}
@@ -0,0 +1,170 @@
+// instance_cache_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/instance_cache.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the objects created
+    class Schema
+    {
+    public:
+        explicit Schema(std::string const& source)
+            : source(source)
+        {
+            ++created();
+        }
+
+        static std::atomic<int>& created()
+        {
+            static std::atomic<int> count{0};
+            return count;
+        }
+
+        std::string source;
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(equal_keys_share_the_object)
+    {
+        instance_cache<std::string, Schema> cache;
+
+        auto foo = cache.get("foo");
+        auto again = cache.get("foo");
+        auto bar = cache.get("bar");
+
+        BOOST_CHECK_EQUAL(&foo.get(), &again.get());
+        BOOST_CHECK(&foo.get() != &bar.get());
+        BOOST_CHECK_EQUAL(foo.get().source, "foo");
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+
+        auto statistics = cache.statistics();
+        BOOST_CHECK_EQUAL(statistics.hits, 1u);
+        BOOST_CHECK_EQUAL(statistics.misses, 2u);
+        BOOST_CHECK_EQUAL(statistics.evictions, 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(factory_creates_on_miss)
+    {
+        instance_cache<int, std::string> cache;
+        int calls{0};
+
+        auto make = [&](int key)
+        {
+            ++calls;
+            return make_shared_instance<std::string>(std::to_string(key));
+        };
+
+        auto foo = cache.get(42, make);
+        auto again = cache.get(42, make);
+
+        BOOST_CHECK_EQUAL(foo.get(), "42");
+        BOOST_CHECK_EQUAL(&foo.get(), &again.get());
+        BOOST_CHECK_EQUAL(calls, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(released_objects_are_recreated)
+    {
+        instance_cache<std::string, Schema> cache;
+
+        cache.get("foo");
+        BOOST_CHECK(!cache.find("foo"));
+
+        int before{Schema::created()};
+        auto foo = cache.get("foo");
+        BOOST_CHECK_EQUAL(Schema::created(), before + 1);
+
+        BOOST_CHECK_EQUAL(cache.find("foo").get(), &foo.get());
+        BOOST_CHECK_EQUAL(cache.size(), 1u);
+        BOOST_CHECK_EQUAL(cache.statistics().evictions, 1u);
+    }
+
+    BOOST_AUTO_TEST_CASE(purge_drops_expired_entries)
+    {
+        instance_cache<int, std::string> cache{4};
+
+        auto keep = cache.get(0, [](int) { return make_shared_instance<std::string>("kept"); });
+
+        for (int i = 1; i < 100; ++i)
+        {
+            cache.get(i, [](int key) { return make_shared_instance<std::string>(std::to_string(key)); });
+        }
+
+        cache.purge();
+
+        BOOST_CHECK_EQUAL(cache.size(), 1u);
+        BOOST_CHECK_EQUAL(cache.find(0).get(), &keep.get());
+
+        // entries of the other shards were dropped on the misses already
+        auto statistics = cache.statistics();
+        BOOST_CHECK_EQUAL(statistics.evictions, 99u);
+        BOOST_CHECK_EQUAL(statistics.misses, 100u);
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_lookups_create_once)
+    {
+        instance_cache<std::string, Schema> cache;
+        std::vector<std::string> keys{"a", "b", "c", "d"};
+
+        // kept alive, so every key is created exactly once
+        std::vector<shared_instance<Schema>> pinned;
+        int before{Schema::created()};
+
+        std::atomic<bool> go{false};
+        std::atomic<int> mismatches{0};
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < 8; ++t)
+        {
+            threads.emplace_back([&]
+            {
+                while (!go)
+                {
+                    std::this_thread::yield();
+                }
+
+                for (int i = 0; i < 1000; ++i)
+                {
+                    auto schema = cache.get(keys[i % keys.size()]);
+                    if (schema.get().source != keys[i % keys.size()])
+                    {
+                        ++mismatches;
+                    }
+                }
+            });
+        }
+
+        for (auto const& key : keys)
+        {
+            pinned.push_back(cache.get(key));
+        }
+
+        go = true;
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        BOOST_CHECK_EQUAL(mismatches, 0);
+        BOOST_CHECK_EQUAL(Schema::created(), before + 4);
+
+        auto statistics = cache.statistics();
+        BOOST_CHECK_EQUAL(statistics.hits + statistics.misses, 8004u);
+        BOOST_CHECK_EQUAL(statistics.misses, 4u);
+    }
+}
@@ -0,0 +1,129 @@
+// instance_ref_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+#define REBOX_CHECKED_REFS 1
+#define REBOX_REF_VIOLATION(message) throw std::logic_error(message)
+
+#include "rebox/instance_ref.hpp"
+#include "rebox/local_shared_instance.hpp"
+
+#include <memory>
+#include <type_traits>
+
+
+namespace rebox
+{
+    int read(instance_ref<int> ref)
+    {
+        return ref;
+    }
+
+    shared_instance<int> keep(instance_ref<int> ref)
+    {
+        return ref.promote();
+    }
+
+
+
+    BOOST_AUTO_TEST_CASE(borrow_leaves_the_count_untouched)
+    {
+        auto foo = make_shared_instance<int>(42);
+        instance_ref<int> ref{foo};
+
+        BOOST_CHECK_EQUAL(&ref.get(), &foo.get());
+        BOOST_CHECK_EQUAL(read(foo), 42);
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(promote_shares_ownership)
+    {
+        auto foo = make_shared_instance<int>(42);
+
+        shared_instance<int> bar{keep(foo)};
+        BOOST_CHECK_EQUAL(&bar.get(), &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(borrow_from_local_shared_instance)
+    {
+        auto foo = make_local_shared_instance<int>(42);
+        instance_ref<int, throw_invalid_argument, single_threaded> ref{foo};
+
+        BOOST_CHECK_EQUAL(ref.get(), 42);
+        BOOST_CHECK_EQUAL(ref.promote().use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(no_borrow_from_temporaries)
+    {
+        BOOST_CHECK((!std::is_constructible<instance_ref<int>, shared_instance<int>&&>::value));
+        BOOST_CHECK((std::is_constructible<instance_ref<int>, shared_instance<int>&>::value));
+    }
+
+    BOOST_AUTO_TEST_CASE(compare)
+    {
+        auto foo = make_shared_instance<int>(42);
+        auto bar = make_shared_instance<int>(42);
+
+        BOOST_CHECK(instance_ref<int>{foo} == instance_ref<int>{foo});
+        BOOST_CHECK(instance_ref<int>{foo} != instance_ref<int>{bar});
+    }
+
+    BOOST_AUTO_TEST_CASE(reassigned_owner_is_detected)
+    {
+        auto foo = make_shared_instance<int>(42);
+        auto keepAlive = foo;
+        instance_ref<int> ref{foo};
+
+        foo = make_shared_instance<int>(23);
+        BOOST_CHECK_THROW(ref.get(), std::logic_error);
+        BOOST_CHECK_THROW(ref.promote(), std::logic_error);
+    }
+
+    BOOST_AUTO_TEST_CASE(destroyed_owner_is_detected)
+    {
+        auto foo = make_shared_instance<int>(42);
+        std::unique_ptr<shared_instance<int>> owner{new shared_instance<int>{foo}};
+        instance_ref<int> ref{*owner};
+        instance_ref<int> copy{ref};
+
+        // the object outlives the owner the reference was taken from
+        owner.reset();
+        BOOST_CHECK_THROW(ref.get(), std::logic_error);
+        BOOST_CHECK_THROW(copy.promote(), std::logic_error);
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(copied_owner_keeps_its_own_liveness)
+    {
+        auto foo = make_shared_instance<int>(42);
+        instance_ref<int> ref{foo};
+
+        {
+            shared_instance<int> bar{foo};
+            instance_ref<int> other{bar};
+            bar = make_shared_instance<int>(23);
+        }
+
+        BOOST_CHECK_EQUAL(ref.get(), 42);
+    }
+
+    BOOST_AUTO_TEST_CASE(destroyed_object_is_detected)
+    {
+        auto foo = make_shared_instance<int>(42);
+        instance_ref<int> ref{foo};
+
+        // the owner stays in place but lets go of the object
+        foo = make_shared_instance<int>(23);
+        BOOST_CHECK_THROW(ref.get(), std::logic_error);
+    }
+
+}
@@ -0,0 +1,264 @@
+// instance_registry_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define REBOX_INSTANCE_REGISTRY 1
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/local_shared_instance.hpp"
+#include "rebox/unique_instance.hpp"
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    class Graph
+    {
+    public:
+        explicit Graph(int nodes = 0)
+            : nodes(nodes)
+        {
+        }
+
+        int nodes;
+        char payload[1000];
+    };
+
+    class Self : public std::enable_shared_from_this<Self>
+    {
+    };
+
+    class Deleter
+    {
+    public:
+        void operator()(int* obj) const
+        {
+            delete obj;
+        }
+
+        int id{7};
+    };
+
+    std::vector<live_instance> instances_of(char const* type)
+    {
+        auto instances = instance_registry::instance().collect();
+        std::string const name{detail::demangle(type)};
+
+        instances.erase(std::remove_if(instances.begin(), instances.end(), [&](live_instance const& obj)
+        {
+            return obj.type != name;
+        }), instances.end());
+
+        return instances;
+    }
+
+
+
+    BOOST_AUTO_TEST_CASE(made_instances_are_listed_while_alive)
+    {
+        {
+            auto graph = make_shared_instance<Graph>(3);
+            shared_instance<Graph> copy{graph};
+
+            auto listed = instances_of(typeid(Graph).name());
+            BOOST_REQUIRE_EQUAL(listed.size(), 1u);
+            BOOST_CHECK_EQUAL(listed.front().object, &graph.get());
+            BOOST_CHECK_EQUAL(listed.front().useCount, 2);
+            BOOST_CHECK_EQUAL(listed.front().size, sizeof(Graph));
+            BOOST_CHECK(listed.front().caller != nullptr);
+        }
+
+        BOOST_CHECK(instances_of(typeid(Graph).name()).empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(weak_references_do_not_keep_objects_listed)
+    {
+        std::weak_ptr<Graph> weak;
+
+        {
+            auto graph = make_shared_instance<Graph>();
+            weak = graph.ptr();
+        }
+
+        BOOST_CHECK(weak.expired());
+        BOOST_CHECK(instances_of(typeid(Graph).name()).empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(pointers_are_listed_with_their_call_site)
+    {
+        unsigned const line{__LINE__ + 1};
+        shared_instance<Graph> graph{new Graph(1)};
+
+        auto listed = instances_of(typeid(Graph).name());
+        BOOST_REQUIRE_EQUAL(listed.size(), 1u);
+        BOOST_CHECK_EQUAL(listed.front().site.line, line);
+        BOOST_CHECK(std::string(listed.front().site.file).find("instance_registry_test") != std::string::npos);
+        BOOST_CHECK_EQUAL(listed.front().useCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(assigned_pointers_are_listed_with_their_caller)
+    {
+        shared_instance<Graph> graph{new Graph(1)};
+        graph = std::unique_ptr<Graph>(new Graph(2));
+
+        local_shared_instance<Graph> local{new Graph(3)};
+        local = std::unique_ptr<Graph>(new Graph(4));
+
+        auto listed = instances_of(typeid(Graph).name());
+        BOOST_REQUIRE_EQUAL(listed.size(), 2u);
+
+        for (auto const& obj : listed)
+        {
+            // not the assignment operator in the library
+            BOOST_CHECK_EQUAL(std::string(obj.site.file), "");
+            BOOST_CHECK(obj.caller != nullptr);
+        }
+    }
+
+    BOOST_AUTO_TEST_CASE(converted_instances_are_listed_with_their_caller)
+    {
+        unique_instance<Graph> unique{std::unique_ptr<Graph>(new Graph(1))};
+        shared_instance<Graph> graph{std::move(unique)};
+
+        auto listed = instances_of(typeid(Graph).name());
+        BOOST_REQUIRE_EQUAL(listed.size(), 1u);
+        BOOST_CHECK_EQUAL(listed.front().object, &graph.get());
+
+        // not the conversion operator in the library
+        BOOST_CHECK_EQUAL(std::string(listed.front().site.file), "");
+        BOOST_CHECK(listed.front().caller != nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(deleters_are_kept)
+    {
+        shared_instance<int> foo{new int(42), Deleter()};
+        BOOST_REQUIRE(get_deleter<Deleter>(foo));
+        BOOST_CHECK_EQUAL(get_deleter<Deleter>(foo)->id, 7);
+
+        shared_instance<int> bar{std::unique_ptr<int, Deleter>(new int(43))};
+        BOOST_REQUIRE(get_deleter<Deleter>(bar));
+
+        auto listed = instances_of(typeid(int).name());
+        BOOST_CHECK_EQUAL(listed.size(), 2u);
+
+        bar = std::unique_ptr<int, Deleter>(new int(44));
+        BOOST_CHECK_EQUAL(instances_of(typeid(int).name()).size(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(shared_from_this_still_works)
+    {
+        auto made = make_shared_instance<Self>();
+        BOOST_CHECK_EQUAL(made.get().shared_from_this().get(), &made.get());
+
+        shared_instance<Self> adopted{new Self()};
+        BOOST_CHECK_EQUAL(adopted.get().shared_from_this().get(), &adopted.get());
+
+        BOOST_CHECK_EQUAL(instances_of(typeid(Self).name()).size(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(null_pointers_are_not_listed)
+    {
+        std::size_t before{instance_registry::instance().size()};
+
+        BOOST_CHECK_THROW(shared_instance<Graph>{static_cast<Graph*>(nullptr)}, std::invalid_argument);
+        BOOST_CHECK_EQUAL(instance_registry::instance().size(), before);
+    }
+
+    BOOST_AUTO_TEST_CASE(counted_policies_are_listed)
+    {
+        {
+            auto made = make_local_shared_instance<Graph>(2);
+            local_shared_instance<Graph> copy{made};
+
+            unsigned const line{__LINE__ + 1};
+            local_shared_instance<Graph> adopted{new Graph(3)};
+
+            auto listed = instances_of(typeid(Graph).name());
+            BOOST_REQUIRE_EQUAL(listed.size(), 2u);
+
+            auto byMake = std::find_if(listed.begin(), listed.end(), [&](live_instance const& obj)
+            {
+                return obj.object == &made.get();
+            });
+
+            auto byPointer = std::find_if(listed.begin(), listed.end(), [&](live_instance const& obj)
+            {
+                return obj.object == &adopted.get();
+            });
+
+            BOOST_REQUIRE(byMake != listed.end());
+            BOOST_REQUIRE(byPointer != listed.end());
+            BOOST_CHECK_EQUAL(byMake->useCount, 2);
+            BOOST_CHECK(byMake->caller != nullptr);
+            BOOST_CHECK_EQUAL(byPointer->useCount, 1);
+            BOOST_CHECK_EQUAL(byPointer->site.line, line);
+        }
+
+        BOOST_CHECK(instances_of(typeid(Graph).name()).empty());
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_registration)
+    {
+        std::size_t before{instance_registry::instance().size()};
+        auto shared = make_shared_instance<Graph>();
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&shared]
+            {
+                std::vector<shared_instance<Graph>> graphs;
+
+                for (int i = 0; i < 1000; ++i)
+                {
+                    graphs.push_back(i % 2 ? make_shared_instance<Graph>(i) : shared_instance<Graph>{new Graph(i)});
+                    graphs.push_back(shared);
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        BOOST_CHECK_EQUAL(instance_registry::instance().size(), before + 1);
+        BOOST_CHECK(shared.unique());
+    }
+
+    BOOST_AUTO_TEST_CASE(types_are_named_readably)
+    {
+        auto foo = make_shared_instance<int>(42);
+
+        auto instances = instance_registry::instance().collect();
+        BOOST_CHECK(std::any_of(instances.begin(), instances.end(), [](live_instance const& obj)
+        {
+            return obj.type == "int";
+        }));
+    }
+
+    BOOST_AUTO_TEST_CASE(report_groups_by_type)
+    {
+        auto foo = make_shared_instance<Graph>();
+        auto bar = make_shared_instance<Graph>();
+        shared_instance<Graph> baz{bar};
+
+        std::ostringstream out;
+        instance_registry::instance().report(out);
+
+        std::string const summary{detail::demangle(typeid(Graph).name()) + ": 2 alive, "
+                                  + std::to_string(2 * sizeof(Graph)) + " bytes\n"};
+        BOOST_CHECK(out.str().find(summary) != std::string::npos);
+        BOOST_CHECK(out.str().find("use_count=2 from ") != std::string::npos);
+        BOOST_CHECK(out.str().find("use_count=1 from ") != std::string::npos);
+    }
+}
@@ -0,0 +1,271 @@
+// instance_set_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/instance_set.hpp"
+#include "rebox/local_shared_instance.hpp"
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+
+namespace rebox
+{
+    class Pair
+    {
+    public:
+        int first{1};
+        int second{2};
+    };
+
+    // plain count recording every modification of any control block
+    class recording_count : public plain_count
+    {
+    public:
+        static void increment(type& count)
+        {
+            ++operations;
+            plain_count::increment(count);
+        }
+
+        static bool increment_if_nonzero(type& count)
+        {
+            ++operations;
+            return plain_count::increment_if_nonzero(count);
+        }
+
+        static bool decrement(type& count)
+        {
+            ++operations;
+            return plain_count::decrement(count);
+        }
+
+        static int operations;
+    };
+
+    int recording_count::operations{};
+
+    template<typename T>
+    using recorded_instance = shared_instance<T, throw_invalid_argument, counted<recording_count>>;
+
+
+
+    BOOST_AUTO_TEST_CASE(std_hash_follows_the_object)
+    {
+        auto foo = make_shared_instance<int>(42);
+        shared_instance<int> bar{foo};
+        auto baz = make_shared_instance<int>(42);
+
+        std::hash<shared_instance<int>> hash;
+        BOOST_CHECK_EQUAL(hash(foo), hash(bar));
+        BOOST_CHECK_EQUAL(hash(foo), std::hash<std::shared_ptr<int>>()(foo.ptr()));
+
+        std::unordered_set<shared_instance<int>> instances{foo, bar, baz};
+        BOOST_CHECK_EQUAL(instances.size(), 2u);
+        BOOST_CHECK_EQUAL(instances.count(bar), 1u);
+        BOOST_CHECK_EQUAL(foo.use_count(), 3);
+    }
+
+    BOOST_AUTO_TEST_CASE(comparisons_leave_the_count_untouched)
+    {
+        auto foo = make_shared_instance<int>(42);
+        shared_instance<int> bar{foo};
+        auto baz = make_shared_instance<int>(42);
+
+        BOOST_CHECK(foo == bar);
+        BOOST_CHECK(foo != baz);
+        BOOST_CHECK_EQUAL(foo < baz, foo.ptr() < baz.ptr());
+        BOOST_CHECK_EQUAL(foo >= baz, foo.ptr() >= baz.ptr());
+        BOOST_CHECK(foo == bar.ptr());
+        BOOST_CHECK(baz.ptr() != foo);
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(owner_equal_of_aliases)
+    {
+        auto pair = make_shared_instance<Pair>();
+        shared_instance<int> first{std::shared_ptr<int>(pair.ptr(), &pair.get().first)};
+        shared_instance<int> second{std::shared_ptr<int>(pair.ptr(), &pair.get().second)};
+        auto other = make_shared_instance<int>(2);
+
+        BOOST_CHECK(first != second);
+        BOOST_CHECK(owner_equal()(first, second));
+        BOOST_CHECK(owner_equal()(pair, first));
+        BOOST_CHECK(!owner_equal()(first, other));
+    }
+
+    BOOST_AUTO_TEST_CASE(owner_hash_of_counted_instances)
+    {
+        auto pair = make_local_shared_instance<Pair>();
+        local_shared_instance<int> first{local_shared_ptr<int>(pair.ptr(), &pair.get().first)};
+        local_shared_instance<int> second{local_shared_ptr<int>(pair.ptr(), &pair.get().second)};
+        auto other = make_local_shared_instance<int>(2);
+
+        BOOST_CHECK(owner_equal()(pair, first));
+        BOOST_CHECK(!owner_equal()(first, other));
+        BOOST_CHECK_EQUAL(owner_hash()(first), owner_hash()(second));
+        BOOST_CHECK_EQUAL(owner_hash()(pair), owner_hash()(first));
+    }
+
+    BOOST_AUTO_TEST_CASE(set_by_address)
+    {
+        instance_set<shared_instance<int>> instances;
+        std::vector<shared_instance<int>> values;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            values.push_back(make_shared_instance<int>(i));
+            BOOST_CHECK(instances.insert(values.back()).second);
+        }
+
+        BOOST_CHECK(!instances.insert(values.front()).second);
+        BOOST_CHECK_EQUAL(instances.size(), 100u);
+        BOOST_CHECK_EQUAL(values.front().use_count(), 2);
+
+        // lookups by instance or by the object alone
+        BOOST_CHECK(instances.contains(values[42]));
+        BOOST_CHECK(instances.contains(values[42].get()));
+        BOOST_CHECK(!instances.contains(make_shared_instance<int>(42)));
+        BOOST_CHECK_EQUAL(&instances.find(values[7])->get(), &values[7].get());
+        BOOST_CHECK_EQUAL(values[7].use_count(), 2);
+
+        int sum{0};
+        for (auto const& obj : instances)
+        {
+            sum += obj.get();
+        }
+
+        BOOST_CHECK_EQUAL(sum, 4950);
+    }
+
+    BOOST_AUTO_TEST_CASE(set_erase)
+    {
+        instance_set<shared_instance<int>> instances;
+        std::vector<shared_instance<int>> values;
+
+        for (int i = 0; i < 1000; ++i)
+        {
+            values.push_back(make_shared_instance<int>(i));
+            instances.insert(values.back());
+        }
+
+        for (std::size_t i = 0; i < values.size(); i += 2)
+        {
+            BOOST_CHECK_EQUAL(instances.erase(values[i]), 1u);
+        }
+
+        BOOST_CHECK_EQUAL(instances.erase(values[0]), 0u);
+        BOOST_CHECK_EQUAL(instances.size(), 500u);
+
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            BOOST_CHECK_EQUAL(instances.contains(values[i]), i % 2 == 1);
+        }
+
+        BOOST_CHECK(values[0].unique());
+        BOOST_CHECK_EQUAL(values[1].use_count(), 2);
+
+        instances.clear();
+        BOOST_CHECK(instances.empty());
+        BOOST_CHECK(values[1].unique());
+    }
+
+    BOOST_AUTO_TEST_CASE(set_by_owner)
+    {
+        auto pair = make_local_shared_instance<Pair>();
+        local_shared_instance<int> first{local_shared_ptr<int>(pair.ptr(), &pair.get().first)};
+        local_shared_instance<int> second{local_shared_ptr<int>(pair.ptr(), &pair.get().second)};
+
+        instance_set<local_shared_instance<int>, owner_key> owners;
+
+        BOOST_CHECK(owners.insert(first).second);
+        BOOST_CHECK(!owners.insert(second).second);
+        BOOST_CHECK(owners.contains(second));
+        BOOST_CHECK(owners.contains(pair));
+        BOOST_CHECK(!owners.contains(make_local_shared_instance<int>(1)));
+    }
+
+    BOOST_AUTO_TEST_CASE(set_copies)
+    {
+        instance_set<shared_instance<int>> instances;
+        auto foo = make_shared_instance<int>(1);
+        instances.insert(foo);
+
+        instance_set<shared_instance<int>> copy{instances};
+        BOOST_CHECK(copy.contains(foo));
+        BOOST_CHECK_EQUAL(foo.use_count(), 3);
+
+        instance_set<shared_instance<int>> moved{std::move(copy)};
+        BOOST_CHECK(moved.contains(foo));
+        BOOST_CHECK_EQUAL(foo.use_count(), 3);
+    }
+
+    BOOST_AUTO_TEST_CASE(map_moves_its_entries)
+    {
+        std::vector<recorded_instance<int>> keys;
+        instance_map<recorded_instance<int>, int> values;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            keys.push_back(make_shared_instance<int, throw_invalid_argument, counted<recording_count>>(i));
+            values[keys.back()] = i;
+        }
+
+        recording_count::operations = 0;
+
+        // rehashing and shifting entries back move them
+        values.reserve(1000);
+        for (int i = 0; i < 100; i += 2)
+        {
+            values.erase(keys[i]);
+        }
+
+        BOOST_CHECK_EQUAL(recording_count::operations, 50);
+        BOOST_CHECK_EQUAL(values.size(), 50u);
+        BOOST_CHECK_EQUAL(values.at(keys[51]), 51);
+        BOOST_CHECK(keys[50].unique());
+        BOOST_CHECK_EQUAL(keys[51].use_count(), 2);
+
+        static_assert(std::is_same<decltype(*values.begin()), std::pair<recorded_instance<int> const, int>&>::value,
+                      "keys are handed out const");
+    }
+
+    BOOST_AUTO_TEST_CASE(map_of_instances)
+    {
+        instance_map<shared_instance<int>, std::string> names;
+
+        auto foo = make_shared_instance<int>(1);
+        auto bar = make_shared_instance<int>(2);
+
+        names[foo] = "foo";
+        BOOST_CHECK(names.try_emplace(bar, "bar").second);
+        BOOST_CHECK(!names.try_emplace(bar, "baz").second);
+        BOOST_CHECK(names.insert(std::make_pair(make_shared_instance<int>(3), std::string("baz"))).second);
+
+        BOOST_CHECK_EQUAL(names.size(), 3u);
+        BOOST_CHECK_EQUAL(names.at(foo), "foo");
+        BOOST_CHECK_EQUAL(names.at(bar.get()), "bar");
+        BOOST_CHECK_EQUAL(names.find(bar)->second, "bar");
+        BOOST_CHECK_THROW(names.at(make_shared_instance<int>(2)), std::out_of_range);
+
+        BOOST_CHECK_EQUAL(names.erase(foo), 1u);
+        BOOST_CHECK(!names.contains(foo));
+        BOOST_CHECK(foo.unique());
+
+        instance_map<shared_instance<int>, std::string> const& constNames = names;
+        int sum{0};
+        for (auto const& entry : constNames)
+        {
+            sum += entry.first.get();
+        }
+
+        BOOST_CHECK_EQUAL(sum, 5);
+    }
+}
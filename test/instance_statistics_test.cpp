@@ -0,0 +1,186 @@
+// instance_statistics_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define REBOX_INSTANCE_STATISTICS 1
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/local_shared_instance.hpp"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    class Base
+    {
+    public:
+        virtual ~Base() = default;
+    };
+
+    class Derived : public Base
+    {
+    };
+
+    class Threaded
+    {
+    };
+
+    class Named
+    {
+    };
+
+    class Member
+    {
+    };
+
+    class Local
+    {
+    };
+
+    class Projected
+    {
+    public:
+        Member member;
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(constructions_by_source)
+    {
+        instance_statistics<int>::reset();
+
+        shared_instance<int> foo{new int(1)};
+        shared_instance<int> bar{std::make_shared<int>(2)};
+        shared_instance<int> baz{std::weak_ptr<int>(bar.ptr())};
+        shared_instance<int> qux{std::unique_ptr<int>(new int(3))};
+        auto quux = make_shared_instance<int>(4);
+
+        auto counts = instance_statistics<int>::collect();
+        BOOST_CHECK_EQUAL(counts[instance_event::from_pointer], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::from_shared_ptr], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::from_weak_ptr], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::from_unique_ptr], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::made], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::ptr_copied], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::copied], 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(copies_moves_and_assignments)
+    {
+        instance_statistics<int>::reset();
+
+        auto foo = make_shared_instance<int>(1);
+        shared_instance<int> bar{foo};
+        shared_instance<int> baz{std::move(bar)};
+        shared_instance<int const> qux{foo};
+        shared_instance<int const> quux{std::move(baz)};
+
+        bar = foo;
+
+        auto counts = instance_statistics<int>::collect();
+        BOOST_CHECK_EQUAL(counts[instance_event::copied], 2u);
+        BOOST_CHECK_EQUAL(counts[instance_event::moved], 2u);
+        BOOST_CHECK_EQUAL(counts[instance_event::assigned], 1u);
+
+        // the converting copy goes through ptr()
+        BOOST_CHECK_EQUAL(counts[instance_event::ptr_copied], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::ptr_moved], 1u);
+    }
+
+    BOOST_AUTO_TEST_CASE(casts_and_null_checks)
+    {
+        instance_statistics<Base>::reset();
+        instance_statistics<Derived>::reset();
+
+        auto derived = make_shared_instance<Derived>();
+        auto base = static_pointer_cast<Base>(derived);
+        BOOST_CHECK(dynamic_pointer_cast<Derived>(base));
+
+        BOOST_CHECK_THROW(shared_instance<Base>{std::shared_ptr<Base>()}, std::invalid_argument);
+
+        std::shared_ptr<Base> null;
+        BOOST_CHECK_THROW(base.swap(null), std::invalid_argument);
+
+        auto baseCounts = instance_statistics<Base>::collect();
+        BOOST_CHECK_EQUAL(baseCounts[instance_event::cast], 1u);
+        BOOST_CHECK_EQUAL(baseCounts[instance_event::null_rejected], 2u);
+
+        auto derivedCounts = instance_statistics<Derived>::collect();
+        BOOST_CHECK_EQUAL(derivedCounts[instance_event::cast], 1u);
+        BOOST_CHECK_EQUAL(derivedCounts[instance_event::made], 1u);
+    }
+
+    BOOST_AUTO_TEST_CASE(projections)
+    {
+        instance_statistics<Member>::reset();
+
+        auto owner = make_shared_instance<Projected>();
+        auto member = owner.project(&Projected::member);
+        shared_instance<Member> alias{std::move(owner), member.get()};
+
+        BOOST_CHECK_EQUAL(instance_statistics<Member>::collect()[instance_event::projected], 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(counted_policies_are_counted)
+    {
+        instance_statistics<Local>::reset();
+
+        auto foo = make_local_shared_instance<Local>();
+        local_shared_instance<Local> bar{foo};
+        local_shared_instance<Local> baz{std::move(bar)};
+        local_shared_instance<Local> qux{local_shared_ptr<Local>(new Local)};
+
+        baz = qux;
+
+        auto counts = instance_statistics<Local>::collect();
+        BOOST_CHECK_EQUAL(counts[instance_event::made], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::copied], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::moved], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::from_shared_ptr], 1u);
+        BOOST_CHECK_EQUAL(counts[instance_event::assigned], 1u);
+    }
+
+    BOOST_AUTO_TEST_CASE(counts_of_exited_threads_are_kept)
+    {
+        auto foo = make_shared_instance<Threaded>();
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < 4; ++t)
+        {
+            threads.emplace_back([&foo]
+            {
+                for (int i = 0; i < 1000; ++i)
+                {
+                    shared_instance<Threaded> copy{foo};
+                }
+            });
+        }
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+
+        BOOST_CHECK_EQUAL(instance_statistics<Threaded>::collect()[instance_event::copied], 4000u);
+    }
+
+    BOOST_AUTO_TEST_CASE(report_lists_types)
+    {
+        auto foo = make_shared_instance<Named>();
+        foo.ptr();
+
+        std::ostringstream out;
+        report_instance_statistics(out);
+
+        std::string line{detail::demangle(typeid(Named).name()) + ": made=1 ptr_copied=1\n"};
+        BOOST_CHECK(out.str().find(line) != std::string::npos);
+    }
+}
@@ -0,0 +1,232 @@
+// intrusive_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/intrusive_instance.hpp"
+
+
+namespace rebox
+{
+    class Base : public intrusive_counted<Base>
+    {
+    public:
+        explicit Base(int& deleteCount)
+            : m_deleteCount(deleteCount)
+        {
+        }
+
+        virtual ~Base()
+        {
+            ++m_deleteCount;
+        }
+
+        int foo()
+        {
+            return 42;
+        }
+
+    private:
+        int& m_deleteCount;
+    };
+
+
+    class Derived : public Base
+    {
+    public:
+        using Base::Base;
+    };
+
+
+    // counted through free hooks instead of intrusive_counted
+    class Hooked
+    {
+    public:
+        int count{};
+        bool released{};
+    };
+
+    void intrusive_ptr_add_ref(Hooked* obj)
+    {
+        ++obj->count;
+    }
+
+    void intrusive_ptr_release(Hooked* obj)
+    {
+        if (--obj->count == 0)
+        {
+            obj->released = true;
+        }
+    }
+
+
+    // reports a null pointer without throwing
+    class count_null
+    {
+    public:
+        void operator()() const
+        {
+            ++reported;
+        }
+
+        static int reported;
+    };
+
+    int count_null::reported{};
+
+    static_assert(std::is_nothrow_move_constructible<intrusive_instance<Base>>::value,
+                  "intrusive_instance must be nothrow move constructible");
+    static_assert(std::is_nothrow_move_assignable<intrusive_instance<Base>>::value,
+                  "intrusive_instance must be nothrow move assignable");
+
+
+
+    BOOST_AUTO_TEST_CASE(construct_from_plain_null_pointer)
+    {
+        BOOST_CHECK_THROW(intrusive_instance<Base>(static_cast<Base*>(nullptr)),
+                          std::invalid_argument);
+    }
+
+    BOOST_AUTO_TEST_CASE(null_pointer_with_non_throwing_report)
+    {
+        count_null::reported = 0;
+
+        {
+            intrusive_instance<Hooked, count_null> foo{static_cast<Hooked*>(nullptr)};
+            BOOST_CHECK(foo.ptr() == nullptr);
+        }
+
+        BOOST_CHECK_EQUAL(count_null::reported, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(handle_is_one_pointer_wide)
+    {
+        BOOST_CHECK_EQUAL(sizeof(intrusive_instance<Base>), sizeof(Base*));
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_plain_pointer)
+    {
+        int deleteCount{};
+
+        {
+            Base* ptr{new Base(deleteCount)};
+            intrusive_instance<Base> foo{ptr};
+            BOOST_CHECK_EQUAL(&foo.get(), ptr);
+            BOOST_CHECK_EQUAL(foo.get().use_count(), 1);
+
+            {
+                intrusive_instance<Base> bar{foo};
+                BOOST_CHECK_EQUAL(ptr->use_count(), 2);
+            }
+
+            BOOST_CHECK_EQUAL(ptr->use_count(), 1);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_related_intrusive_instance)
+    {
+        int deleteCount{};
+
+        {
+            auto foo = make_intrusive_instance<Derived>(deleteCount);
+            intrusive_instance<Base> bar{foo};
+            BOOST_CHECK_EQUAL(&bar.get(), &foo.get());
+            BOOST_CHECK_EQUAL(foo.get().use_count(), 2);
+
+            intrusive_instance<Base> qux{std::move(foo)};
+            BOOST_CHECK_EQUAL(bar.get().use_count(), 2);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_assignment)
+    {
+        int deleteCount{};
+        int deleteCount2{};
+
+        {
+            auto foo = make_intrusive_instance<Base>(deleteCount);
+
+            {
+                auto bar = make_intrusive_instance<Derived>(deleteCount2);
+                foo = bar;
+
+                BOOST_CHECK_EQUAL(deleteCount, 1);
+                BOOST_CHECK_EQUAL(deleteCount2, 0);
+            }
+
+            BOOST_CHECK_EQUAL(deleteCount2, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount2, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_swap)
+    {
+        int deleteCount{};
+
+        auto foo = make_intrusive_instance<Base>(deleteCount);
+        auto bar = make_intrusive_instance<Base>(deleteCount);
+        Base* ptr{foo.ptr()};
+
+        swap(foo, bar);
+        BOOST_CHECK_EQUAL(bar.ptr(), ptr);
+        BOOST_CHECK(foo != bar);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_pointer_casts)
+    {
+        int deleteCount{};
+
+        {
+            intrusive_instance<Base const> foo{make_intrusive_instance<Derived>(deleteCount)};
+
+            intrusive_instance<Derived const> bar{static_pointer_cast<Derived const>(foo)};
+            BOOST_CHECK_EQUAL(&bar.get(), &foo.get());
+
+            intrusive_instance<Base> qux{const_pointer_cast<Base>(foo)};
+            BOOST_CHECK_EQUAL(qux.get().foo(), 42);
+            BOOST_CHECK_EQUAL(qux.get().use_count(), 3);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_free_hooks)
+    {
+        Hooked hooked;
+
+        {
+            intrusive_instance<Hooked> foo{&hooked};
+            intrusive_instance<Hooked> bar{foo};
+            BOOST_CHECK_EQUAL(hooked.count, 2);
+        }
+
+        BOOST_CHECK_EQUAL(hooked.count, 0);
+        BOOST_CHECK(hooked.released);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_compare)
+    {
+        int deleteCount{};
+
+        auto foo = make_intrusive_instance<Base>(deleteCount);
+        auto bar = make_intrusive_instance<Base>(deleteCount);
+
+        BOOST_CHECK(foo == foo);
+        BOOST_CHECK(foo != bar);
+        BOOST_CHECK((foo < bar) != (bar < foo));
+        BOOST_CHECK(foo <= foo);
+        BOOST_CHECK(foo >= foo);
+    }
+
+}
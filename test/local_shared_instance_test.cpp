@@ -0,0 +1,395 @@
+// local_shared_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/local_shared_instance.hpp"
+
+#include <vector>
+
+#if __cplusplus >= 201703L && __has_include(<memory_resource>)
+#include <memory_resource>
+#define REBOX_TEST_PMR
+#endif
+
+
+namespace rebox
+{
+    class Base
+    {
+    public:
+        explicit Base(int& deleteCount)
+            : m_deleteCount(deleteCount)
+        {
+        }
+
+        virtual ~Base()
+        {
+            ++m_deleteCount;
+        }
+
+        int foo()
+        {
+            return 42;
+        }
+
+    private:
+        int& m_deleteCount;
+    };
+
+
+    class Derived : public Base
+    {
+    public:
+        using Base::Base;
+    };
+
+
+
+    // plain count recording every modification of any control block
+    class recording_count : public plain_count
+    {
+    public:
+        static void increment(type& count)
+        {
+            ++operations;
+            plain_count::increment(count);
+        }
+
+        static bool increment_if_nonzero(type& count)
+        {
+            ++operations;
+            return plain_count::increment_if_nonzero(count);
+        }
+
+        static bool decrement(type& count)
+        {
+            ++operations;
+            return plain_count::decrement(count);
+        }
+
+        static int operations;
+    };
+
+    int recording_count::operations{};
+
+    template<typename T>
+    using recorded_instance = shared_instance<T, throw_invalid_argument, counted<recording_count>>;
+
+    // containers move their elements on reallocation only if moving cannot throw
+    static_assert(std::is_nothrow_move_constructible<local_shared_instance<int>>::value,
+                  "local_shared_instance must be nothrow move constructible");
+
+
+
+    BOOST_AUTO_TEST_CASE(construct_from_plain_null_pointer)
+    {
+        BOOST_CHECK_THROW(local_shared_instance<int>(static_cast<int*>(nullptr)),
+                          std::invalid_argument);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_null_counted_ptr)
+    {
+        local_shared_ptr<int> foo;
+        BOOST_CHECK_THROW(local_shared_instance<int>{foo}, std::invalid_argument);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_deleted_weak_pointer)
+    {
+        int deleteCount{};
+        local_weak_ptr<Base> weak;
+
+        {
+            local_shared_ptr<Base> shared{new Base(deleteCount)};
+            weak = shared;
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+        BOOST_CHECK_THROW(local_shared_instance<Base> foo(weak),
+                          std::invalid_argument);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_plain_pointer)
+    {
+        int deleteCount{};
+
+        {
+            Base* ptr{new Base(deleteCount)};
+            local_shared_instance<Base> foo(ptr);
+            BOOST_CHECK_EQUAL(&foo.get(), ptr);
+            BOOST_CHECK_EQUAL(foo.get().foo(), 42);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_related_shared_instance)
+    {
+        int deleteCount{};
+
+        {
+            Derived* ptr{new Derived(deleteCount)};
+            local_shared_instance<Derived> foo{ptr};
+
+            {
+                local_shared_instance<Base> bar{foo};
+                BOOST_CHECK_EQUAL(&bar.get(), ptr);
+                BOOST_CHECK_EQUAL(foo.use_count(), 2);
+            }
+
+            local_shared_instance<Base> qux{local_shared_instance<Derived>{foo}};
+            BOOST_CHECK_EQUAL(&qux.get(), ptr);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_from_unique_pointer)
+    {
+        int deleteCount{};
+
+        {
+            Base* ptr{new Base(deleteCount)};
+            local_shared_instance<Base> foo{std::unique_ptr<Base>{ptr}};
+            BOOST_CHECK_EQUAL(&foo.get(), ptr);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_assignment_from_null_counted_ptr)
+    {
+        int deleteCount{};
+        Base* ptr{new Base{deleteCount}};
+
+        local_shared_instance<Base> foo(ptr);
+
+        BOOST_CHECK_THROW(foo = local_shared_ptr<Base>(), std::invalid_argument);
+        BOOST_CHECK_THROW(foo = std::unique_ptr<Derived>(), std::invalid_argument);
+        BOOST_CHECK_EQUAL(deleteCount, 0);
+        BOOST_CHECK_EQUAL(&foo.get(), ptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_swap)
+    {
+        local_shared_instance<int> foo{new int(42)};
+        local_shared_instance<int> bar{new int(23)};
+
+        swap(foo, bar);
+        BOOST_CHECK_EQUAL(foo.get(), 23);
+        BOOST_CHECK_EQUAL(bar.get(), 42);
+
+        local_shared_ptr<int> empty;
+        BOOST_CHECK_THROW(foo.swap(empty), std::invalid_argument);
+        BOOST_CHECK_EQUAL(foo.get(), 23);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_use_count)
+    {
+        local_shared_instance<int> foo{new int(42)};
+        BOOST_CHECK(foo.unique());
+
+        {
+            local_shared_instance<int> bar{foo};
+            BOOST_CHECK_EQUAL(foo.use_count(), 2);
+            BOOST_CHECK(!bar.unique());
+        }
+
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_pointer_casts)
+    {
+        int deleteCount{};
+        Derived* ptr{new Derived{deleteCount}};
+
+        local_shared_instance<Base const> foo{ptr};
+
+        local_shared_instance<Derived const> bar{static_pointer_cast<Derived const>(foo)};
+        BOOST_CHECK_EQUAL(&bar.get(), ptr);
+
+        local_shared_instance<Base> qux{const_pointer_cast<Base>(foo)};
+        BOOST_CHECK_EQUAL(&qux.get(), ptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_dynamic_pointer_cast)
+    {
+        int deleteCount{};
+
+        local_shared_instance<Base> foo{new Derived{deleteCount}};
+        local_shared_instance<Base> bar{new Base{deleteCount}};
+
+        local_shared_ptr<Derived> derived{dynamic_pointer_cast<Derived>(foo)};
+        BOOST_CHECK_EQUAL(derived.get(), &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+
+        BOOST_CHECK(!dynamic_pointer_cast<Derived>(bar));
+        BOOST_CHECK_EQUAL(bar.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(copies_modify_the_count)
+    {
+        auto foo = make_shared_instance<int, throw_invalid_argument, counted<recording_count>>(42);
+
+        recording_count::operations = 0;
+        {
+            recorded_instance<int> bar{foo};
+        }
+        BOOST_CHECK_EQUAL(recording_count::operations, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(moves_leave_the_count_untouched)
+    {
+        int deleteCount{};
+
+        {
+            auto foo = make_shared_instance<Derived, throw_invalid_argument, counted<recording_count>>(deleteCount);
+            recording_count::operations = 0;
+
+            recorded_instance<Derived> bar{std::move(foo)};
+            recorded_instance<Base> qux{std::move(bar)};
+            recorded_instance<Base const> quux{std::move(qux)};
+            BOOST_CHECK_EQUAL(recording_count::operations, 0);
+            BOOST_CHECK_EQUAL(quux.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(reallocation_leaves_the_count_untouched)
+    {
+        int deleteCount{};
+
+        {
+            std::vector<recorded_instance<Base>> bases;
+            bases.push_back(make_shared_instance<Base, throw_invalid_argument, counted<recording_count>>(deleteCount));
+            recording_count::operations = 0;
+
+            bases.reserve(bases.capacity() + 16);
+            BOOST_CHECK_EQUAL(recording_count::operations, 0);
+            BOOST_CHECK_EQUAL(bases.front().use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(rvalue_casts_leave_the_count_untouched)
+    {
+        int deleteCount{};
+
+        {
+            recorded_instance<Base const> foo{make_shared_instance<Derived, throw_invalid_argument, counted<recording_count>>(deleteCount)};
+            Base const* ptr{&foo.get()};
+            recording_count::operations = 0;
+
+            auto bar = const_pointer_cast<Base>(std::move(foo));
+            auto qux = static_pointer_cast<Derived>(std::move(bar));
+            recorded_instance<Base> quux{std::move(qux)};
+            auto derived = dynamic_pointer_cast<Derived>(std::move(quux));
+
+            BOOST_CHECK_EQUAL(recording_count::operations, 0);
+            BOOST_CHECK_EQUAL(derived.get(), ptr);
+            BOOST_CHECK_EQUAL(derived.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(failed_rvalue_dynamic_cast_keeps_the_source)
+    {
+        int deleteCount{};
+
+        recorded_instance<Base> foo{make_shared_instance<Base, throw_invalid_argument, counted<recording_count>>(deleteCount)};
+        recording_count::operations = 0;
+
+        BOOST_CHECK(!dynamic_pointer_cast<Derived>(std::move(foo)));
+        BOOST_CHECK_EQUAL(recording_count::operations, 0);
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+    }
+
+    class Pair
+    {
+    public:
+        int first;
+        int second;
+    };
+
+    BOOST_AUTO_TEST_CASE(rvalue_projections_leave_the_count_untouched)
+    {
+        auto foo = make_shared_instance<Pair, throw_invalid_argument, counted<recording_count>>(Pair{1, 2});
+        recording_count::operations = 0;
+
+        recorded_instance<int> bar{foo.project(&Pair::second)};
+        BOOST_CHECK_EQUAL(recording_count::operations, 1);
+        BOOST_CHECK_EQUAL(bar.get(), 2);
+
+        recording_count::operations = 0;
+        recorded_instance<int> qux{std::move(foo).project(&Pair::first)};
+        BOOST_CHECK_EQUAL(recording_count::operations, 0);
+        BOOST_CHECK_EQUAL(qux.get(), 1);
+        BOOST_CHECK_EQUAL(qux.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_compare)
+    {
+        auto foo = make_local_shared_instance<int>(42);
+        auto bar = make_local_shared_instance<int>(42);
+
+        BOOST_CHECK(foo == foo);
+        BOOST_CHECK(foo != bar);
+        BOOST_CHECK((foo < bar) != (bar < foo));
+        BOOST_CHECK(foo <= foo);
+        BOOST_CHECK(foo >= foo);
+        BOOST_CHECK_NE(foo.owner_before(bar), bar.owner_before(foo));
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_via_make_shared_instance)
+    {
+        int deleteCount{};
+
+        {
+            auto foo = make_shared_instance<Derived, throw_invalid_argument, single_threaded>(deleteCount);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+
+            local_shared_instance<Base> bar{foo};
+            BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+
+        {
+            auto foo = make_local_shared_instance<Base>(deleteCount);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+#ifdef REBOX_TEST_PMR
+    BOOST_AUTO_TEST_CASE(construct_via_allocate_shared_instance_with_pmr)
+    {
+        int deleteCount{};
+        char buffer[1024];
+        std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+
+        {
+            std::pmr::polymorphic_allocator<Base> alloc{&arena};
+            auto foo = allocate_shared_instance<Derived, throw_invalid_argument, single_threaded>(alloc, deleteCount);
+
+            auto address = reinterpret_cast<char const*>(&foo.get());
+            BOOST_CHECK(address >= buffer && address < buffer + sizeof(buffer));
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+#endif
+
+}
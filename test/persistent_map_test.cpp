@@ -0,0 +1,266 @@
+// persistent_map_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/persistent_map.hpp"
+
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    namespace
+    {
+        // a few buckets, so that whole hashes collide
+        class Colliding
+        {
+        public:
+            std::size_t operator()(int key) const
+            {
+                return static_cast<std::size_t>(key % 3);
+            }
+        };
+
+        // a value whose moves may throw, so that slots are copied
+        class Label
+        {
+        public:
+            Label(std::string text)
+                : text(std::move(text))
+            {
+            }
+
+            Label(Label const&) = default;
+
+            Label(Label&& other) noexcept(false)
+                : text(std::move(other.text))
+            {
+            }
+
+            Label& operator=(Label const&) = default;
+            Label& operator=(Label&&) = default;
+
+            std::string text;
+        };
+
+        template<typename Map>
+        bool holds(Map const& map, std::map<int, std::string> const& expected)
+        {
+            std::map<int, std::string> found;
+
+            for (auto const& entry : map)
+            {
+                found.insert(entry);
+            }
+
+            for (auto const& entry : expected)
+            {
+                auto value = map.find(entry.first);
+
+                if (!value || *value != entry.second)
+                {
+                    return false;
+                }
+            }
+
+            return map.size() == expected.size() && found == expected;
+        }
+    }
+
+
+    BOOST_AUTO_TEST_CASE(set_find_erase)
+    {
+        persistent_map<int, std::string> empty;
+        BOOST_CHECK(empty.empty());
+        BOOST_CHECK(!empty.find(1));
+        BOOST_CHECK(empty.begin() == empty.end());
+
+        auto one = empty.set(1, "one");
+        auto two = one.set(2, "two");
+        auto replaced = two.set(1, "uno");
+
+        BOOST_CHECK(empty.empty());
+        BOOST_CHECK(holds(one, {{1, "one"}}));
+        BOOST_CHECK(holds(two, {{1, "one"}, {2, "two"}}));
+        BOOST_CHECK(holds(replaced, {{1, "uno"}, {2, "two"}}));
+
+        BOOST_CHECK(holds(replaced.erase(1), {{2, "two"}}));
+        BOOST_CHECK(holds(replaced.erase(3), {{1, "uno"}, {2, "two"}}));
+        BOOST_CHECK(replaced.erase(1).erase(2).empty());
+        BOOST_CHECK(replaced.contains(2));
+    }
+
+    BOOST_AUTO_TEST_CASE(versions_share_untouched_entries)
+    {
+        std::map<int, std::string> expected;
+        auto elements = persistent_map<int, std::string>{}.transient();
+
+        for (int key = 0; key != 10000; ++key)
+        {
+            elements.set(key, std::to_string(key));
+            expected[key] = std::to_string(key);
+        }
+
+        auto map = std::move(elements).persistent();
+        BOOST_CHECK(holds(map, expected));
+
+        auto changed = map.set(5, "five").erase(7);
+        BOOST_CHECK_EQUAL(*changed.find(5), "five");
+        BOOST_CHECK(!changed.contains(7));
+        BOOST_CHECK_EQUAL(changed.find(9999), map.find(9999));
+        BOOST_CHECK(holds(map, expected));
+
+        for (int key = 0; key != 10000; key += 2)
+        {
+            expected.erase(key);
+            map = map.erase(key);
+        }
+
+        BOOST_CHECK(holds(map, expected));
+    }
+
+    BOOST_AUTO_TEST_CASE(colliding_hashes)
+    {
+        std::map<int, std::string> expected;
+        persistent_map<int, std::string, Colliding> map;
+
+        for (int key = 0; key != 30; ++key)
+        {
+            map = map.set(key, std::to_string(key));
+            expected[key] = std::to_string(key);
+        }
+
+        BOOST_CHECK(holds(map, expected));
+
+        auto elements = map.transient();
+
+        for (int key = 0; key != 30; ++key)
+        {
+            if (key % 4 != 0)
+            {
+                elements.erase(key);
+                expected.erase(key);
+            }
+        }
+
+        BOOST_CHECK(holds(elements.persistent(), expected));
+        BOOST_CHECK_EQUAL(map.size(), 30u);
+    }
+
+    BOOST_AUTO_TEST_CASE(transients_write_in_place)
+    {
+        auto map = persistent_map<int, std::string>{}.set(1, "one").set(2, "two");
+        auto elements = map.transient();
+
+        // the first write copies the path shared with map
+        elements.set(1, "uno");
+        std::string const* value{elements.find(1)};
+        BOOST_CHECK(value != map.find(1));
+
+        elements.set(1, "eins");
+        BOOST_CHECK_EQUAL(elements.find(1), value);
+        BOOST_CHECK_EQUAL(*value, "eins");
+
+        auto snapshot = elements.persistent();
+        elements.set(1, "un");
+        BOOST_CHECK_EQUAL(*snapshot.find(1), "eins");
+        BOOST_CHECK_EQUAL(*elements.find(1), "un");
+        BOOST_CHECK_EQUAL(*map.find(1), "one");
+
+        elements.erase(1);
+        elements.erase(2);
+        BOOST_CHECK(elements.empty());
+        BOOST_CHECK_EQUAL(snapshot.size(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(values_moving_with_exceptions)
+    {
+        transient_map<int, Label, Colliding> elements;
+
+        for (int key = 0; key != 30; ++key)
+        {
+            elements.set(key, Label{std::to_string(key)});
+        }
+
+        // leaves single entries in the nodes of colliding keys
+        for (int key = 3; key != 30; ++key)
+        {
+            elements.erase(key);
+        }
+
+        BOOST_CHECK_EQUAL(elements.size(), 3u);
+        BOOST_CHECK_EQUAL(elements.find(0)->text, "0");
+        BOOST_CHECK_EQUAL(elements.find(2)->text, "2");
+        BOOST_CHECK(!elements.contains(3));
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_versions)
+    {
+        constexpr int threads{4};
+        constexpr int keys{5000};
+
+        auto elements = persistent_map<int, int>{}.transient();
+
+        for (int key = 0; key != keys; ++key)
+        {
+            elements.set(key, key);
+        }
+
+        auto map = std::move(elements).persistent();
+        std::vector<int> mismatches(threads, 0);
+        std::vector<std::thread> workers;
+
+        for (int thread = 0; thread < threads; ++thread)
+        {
+            workers.emplace_back([&, thread]
+            {
+                auto changes = map.transient();
+
+                for (int key = thread; key < keys; key += threads)
+                {
+                    changes.set(key, -key);
+                    changes.erase(key + 1);
+                }
+
+                auto changed = std::move(changes).persistent();
+
+                for (int key = 0; key != keys; ++key)
+                {
+                    if (*map.find(key) != key)
+                    {
+                        ++mismatches[thread];
+                    }
+
+                    // the keys following the changed ones are erased
+                    auto value = changed.find(key);
+                    bool erased{key % threads == (thread + 1) % threads && key != 0};
+                    int expected{key % threads == thread ? -key : key};
+
+                    if (erased ? value != nullptr : (!value || *value != expected))
+                    {
+                        ++mismatches[thread];
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        for (auto count : mismatches)
+        {
+            BOOST_CHECK_EQUAL(count, 0);
+        }
+    }
+}
@@ -0,0 +1,188 @@
+// persistent_vector_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/persistent_vector.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    namespace
+    {
+        // enough elements for a trie of three levels and a tail
+        constexpr std::size_t many{32 * 32 * 32 + 32 * 32 + 40};
+
+        persistent_vector<std::size_t> iota(std::size_t size)
+        {
+            transient_vector<std::size_t> elements;
+
+            for (std::size_t index = 0; index != size; ++index)
+            {
+                elements.push_back(index);
+            }
+
+            return std::move(elements).persistent();
+        }
+
+        bool holds_iota(persistent_vector<std::size_t> const& vector, std::size_t size)
+        {
+            std::vector<std::size_t> expected(size);
+            std::iota(expected.begin(), expected.end(), std::size_t{0});
+
+            return vector.size() == size && std::equal(vector.begin(), vector.end(), expected.begin(), expected.end());
+        }
+    }
+
+
+    BOOST_AUTO_TEST_CASE(empty_vectors)
+    {
+        persistent_vector<std::string> empty;
+        BOOST_CHECK(empty.empty());
+        BOOST_CHECK(empty.begin() == empty.end());
+
+        persistent_vector<std::string> listed{"one", "two"};
+        BOOST_CHECK_EQUAL(listed.size(), 2u);
+        BOOST_CHECK_EQUAL(listed.back(), "two");
+
+        persistent_vector<std::string> moved{std::move(listed)};
+        BOOST_CHECK(listed.empty());
+        BOOST_CHECK_EQUAL(moved[0], "one");
+    }
+
+    BOOST_AUTO_TEST_CASE(push_back_keeps_older_versions)
+    {
+        std::vector<persistent_vector<std::size_t>> versions{persistent_vector<std::size_t>{}};
+
+        for (std::size_t index = 0; index != many; ++index)
+        {
+            versions.push_back(versions.back().push_back(index));
+        }
+
+        for (std::size_t size = 0; size < versions.size(); size += 997)
+        {
+            BOOST_CHECK(holds_iota(versions[size], size));
+        }
+
+        BOOST_CHECK(holds_iota(versions.back(), many));
+    }
+
+    BOOST_AUTO_TEST_CASE(set_copies_the_path_only)
+    {
+        auto vector = iota(many);
+        auto changed = vector.set(1000, 0);
+
+        BOOST_CHECK_EQUAL(vector[1000], 1000u);
+        BOOST_CHECK_EQUAL(changed[1000], 0u);
+
+        // other leaves and the tail are shared
+        BOOST_CHECK(&vector[1000] != &changed[1000]);
+        BOOST_CHECK_EQUAL(&vector[2000], &changed[2000]);
+        BOOST_CHECK_EQUAL(&vector.back(), &changed.back());
+
+        auto tailChanged = vector.set(many - 1, 0);
+        BOOST_CHECK_EQUAL(&vector[1000], &tailChanged[1000]);
+        BOOST_CHECK_EQUAL(tailChanged.back(), 0u);
+        BOOST_CHECK(holds_iota(vector, many));
+    }
+
+    BOOST_AUTO_TEST_CASE(pop_back_to_empty)
+    {
+        auto vector = iota(many);
+        auto popped = vector;
+
+        for (std::size_t size = many; size != 0; --size)
+        {
+            BOOST_REQUIRE_EQUAL(popped.back(), size - 1);
+            popped = popped.pop_back();
+        }
+
+        BOOST_CHECK(popped.empty());
+        BOOST_CHECK(holds_iota(vector, many));
+        BOOST_CHECK(holds_iota(vector.pop_back().push_back(many - 1), many));
+    }
+
+    BOOST_AUTO_TEST_CASE(transients_write_in_place)
+    {
+        auto vector = iota(100);
+        auto elements = vector.transient();
+
+        // the first write copies the path shared with vector
+        elements.set(0, 42);
+        std::size_t const* first{&elements[0]};
+        BOOST_CHECK(first != &vector[0]);
+
+        elements.set(0, 43);
+        elements.push_back(100);
+        BOOST_CHECK_EQUAL(&elements[0], first);
+
+        auto snapshot = elements.persistent();
+        elements.set(0, 44);
+        BOOST_CHECK_EQUAL(snapshot[0], 43u);
+        BOOST_CHECK_EQUAL(elements[0], 44u);
+        BOOST_CHECK(&elements[0] != first);
+
+        while (!elements.empty())
+        {
+            elements.pop_back();
+        }
+
+        BOOST_CHECK_EQUAL(snapshot.size(), 101u);
+        BOOST_CHECK(holds_iota(vector, 100));
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_versions)
+    {
+        constexpr std::size_t threads{4};
+        auto vector = iota(many);
+        std::vector<std::size_t> mismatches(threads, 0);
+
+        std::vector<std::thread> workers;
+
+        for (std::size_t thread = 0; thread < threads; ++thread)
+        {
+            workers.emplace_back([&, thread]
+            {
+                auto elements = vector.transient();
+
+                for (std::size_t index = thread; index < many; index += 7)
+                {
+                    elements.set(index, thread);
+                }
+
+                auto changed = std::move(elements).persistent();
+
+                for (std::size_t index = 0; index < many; ++index)
+                {
+                    std::size_t expected{(index >= thread && (index - thread) % 7 == 0) ? thread : index};
+
+                    if (changed[index] != expected || vector[index] != index)
+                    {
+                        ++mismatches[thread];
+                    }
+                }
+            });
+        }
+
+        for (auto& worker : workers)
+        {
+            worker.join();
+        }
+
+        for (auto count : mismatches)
+        {
+            BOOST_CHECK_EQUAL(count, 0u);
+        }
+    }
+}
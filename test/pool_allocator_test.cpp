@@ -0,0 +1,191 @@
+// pool_allocator_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/pool_allocator.hpp"
+#include "rebox/local_shared_instance.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+
+namespace rebox
+{
+    class Base
+    {
+    public:
+        explicit Base(int& deleteCount)
+            : m_deleteCount(deleteCount)
+        {
+        }
+
+        virtual ~Base()
+        {
+            ++m_deleteCount;
+        }
+
+        int foo()
+        {
+            return 42;
+        }
+
+    private:
+        int& m_deleteCount;
+    };
+
+
+    class Derived : public Base
+    {
+    public:
+        using Base::Base;
+    };
+
+
+    class Large
+    {
+    public:
+        char data[4096];
+    };
+
+
+    class alignas(64) Aligned
+    {
+    public:
+        char data[64];
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(construct_via_pooled_make_shared_instance)
+    {
+        int deleteCount{};
+
+        {
+            auto foo = pooled_make_shared_instance<Derived>(deleteCount);
+            BOOST_CHECK_EQUAL(foo.get().foo(), 42);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+
+            shared_instance<Base> bar{foo};
+            BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+
+        {
+            auto foo = pooled_make_shared_instance<Base, throw_invalid_argument, single_threaded>(deleteCount);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(freed_blocks_are_reused)
+    {
+        int deleteCount{};
+
+        Base const* first{};
+        {
+            auto foo = pooled_make_shared_instance<Base>(deleteCount);
+            first = &foo.get();
+        }
+
+        pool_statistics before{local_pool_statistics()};
+
+        auto foo = pooled_make_shared_instance<Base>(deleteCount);
+        BOOST_CHECK_EQUAL(&foo.get(), first);
+
+        pool_statistics after{local_pool_statistics()};
+        BOOST_CHECK_EQUAL(after.hits, before.hits + 1);
+        BOOST_CHECK_EQUAL(after.misses, before.misses);
+        BOOST_CHECK_LT(after.bytesRetained, before.bytesRetained);
+    }
+
+    BOOST_AUTO_TEST_CASE(large_blocks_bypass_the_pool)
+    {
+        pool_statistics before{local_pool_statistics()};
+
+        {
+            auto foo = pooled_make_shared_instance<Large>();
+            foo.get().data[0] = 1;
+        }
+
+        pool_statistics after{local_pool_statistics()};
+        BOOST_CHECK_EQUAL(after.hits, before.hits);
+        BOOST_CHECK_EQUAL(after.misses, before.misses);
+    }
+
+#ifdef __cpp_aligned_new
+    BOOST_AUTO_TEST_CASE(over_aligned_blocks_are_aligned)
+    {
+        std::vector<shared_instance<Aligned>> objects;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            objects.push_back(pooled_make_shared_instance<Aligned>());
+            BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(&objects.back().get()) % alignof(Aligned), 0u);
+        }
+    }
+#endif
+
+    BOOST_AUTO_TEST_CASE(blocks_freed_by_other_threads_are_returned)
+    {
+        int deleteCount{};
+
+        std::vector<shared_instance<Base>> instances;
+        for (int i = 0; i < 100; ++i)
+        {
+            instances.push_back(pooled_make_shared_instance<Base>(deleteCount));
+        }
+
+        std::thread{[&] { instances.clear(); }}.join();
+        BOOST_CHECK_EQUAL(deleteCount, 100);
+
+        pool_statistics before{local_pool_statistics()};
+
+        for (int i = 0; i < 100; ++i)
+        {
+            instances.push_back(pooled_make_shared_instance<Base>(deleteCount));
+        }
+
+        pool_statistics after{local_pool_statistics()};
+        BOOST_CHECK_EQUAL(after.hits, before.hits + 100);
+        BOOST_CHECK_EQUAL(after.misses, before.misses);
+    }
+
+    BOOST_AUTO_TEST_CASE(blocks_outlive_their_thread)
+    {
+        int deleteCount{};
+        std::vector<shared_instance<Base>> instances;
+
+        std::thread{[&]
+        {
+            for (int i = 0; i < 100; ++i)
+            {
+                instances.push_back(pooled_make_shared_instance<Derived>(deleteCount));
+            }
+        }}.join();
+
+        BOOST_CHECK_EQUAL(deleteCount, 0);
+        BOOST_CHECK_EQUAL(instances.front().get().foo(), 42);
+
+        instances.clear();
+        BOOST_CHECK_EQUAL(deleteCount, 100);
+    }
+
+    BOOST_AUTO_TEST_CASE(allocator_compares_equal)
+    {
+        pool_allocator<int> foo;
+        pool_allocator<Base> bar{foo};
+
+        BOOST_CHECK(foo == bar);
+        BOOST_CHECK(!(foo != bar));
+    }
+
+}
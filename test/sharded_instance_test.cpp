@@ -0,0 +1,171 @@
+// sharded_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/sharded_instance.hpp"
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace rebox
+{
+    // counts the instances alive
+    class Counted
+    {
+    public:
+        explicit Counted(std::atomic<int>& liveCount)
+            : m_liveCount(liveCount)
+        {
+            ++m_liveCount;
+        }
+
+        virtual ~Counted()
+        {
+            --m_liveCount;
+        }
+
+    private:
+        std::atomic<int>& m_liveCount;
+    };
+
+    class Derived : public Counted
+    {
+    public:
+        using Counted::Counted;
+    };
+
+
+
+    BOOST_AUTO_TEST_CASE(no_default_construction)
+    {
+        BOOST_CHECK(!std::is_default_constructible<sharded_instance<int>>::value);
+    }
+
+    BOOST_AUTO_TEST_CASE(copies_share_the_object)
+    {
+        auto foo = make_sharded_instance<int>(42);
+        sharded_instance<int> bar{foo};
+
+        BOOST_CHECK_EQUAL(&foo.get(), &bar.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+
+        bar = make_sharded_instance<int>(23);
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+        BOOST_CHECK_EQUAL(bar.get(), 23);
+    }
+
+    BOOST_AUTO_TEST_CASE(last_copy_destroys)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_sharded_instance<Counted>(liveCount);
+            {
+                sharded_instance<Counted> bar{foo};
+            }
+            BOOST_CHECK_EQUAL(liveCount, 1);
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(convert_to_shared_instance)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            shared_instance<Counted> shared{make_shared_instance<Derived>(liveCount)};
+
+            {
+                sharded_instance<Derived> foo{make_sharded_instance<Derived>(liveCount)};
+                sharded_instance<Counted> bar{foo};
+                shared = bar;
+
+                BOOST_CHECK_EQUAL(liveCount, 1);
+            }
+
+            // the shared_instance outlives all sharded copies
+            BOOST_CHECK_EQUAL(liveCount, 1);
+            BOOST_CHECK(shared.unique());
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(from_shared_instance)
+    {
+        auto shared = make_shared_instance<int>(42);
+        sharded_instance<int> foo{shared};
+
+        BOOST_CHECK_EQUAL(&foo.get(), &shared.get());
+        BOOST_CHECK_EQUAL(shared.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(concurrent_copies)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            auto foo = make_sharded_instance<Counted>(liveCount);
+            std::vector<std::thread> threads;
+
+            for (int t = 0; t < 4; ++t)
+            {
+                threads.emplace_back([foo]
+                {
+                    for (int i = 0; i < 10000; ++i)
+                    {
+                        sharded_instance<Counted> copy{foo};
+                        sharded_instance<Counted> another{copy};
+                    }
+                });
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(released_on_other_threads)
+    {
+        std::atomic<int> liveCount{0};
+
+        {
+            std::vector<std::thread> threads;
+
+            {
+                auto foo = make_sharded_instance<Counted>(liveCount);
+
+                for (int t = 0; t < 4; ++t)
+                {
+                    threads.emplace_back([copy = foo]
+                    {
+                    });
+                }
+            }
+
+            for (auto& thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        BOOST_CHECK_EQUAL(liveCount, 0);
+    }
+
+}
@@ -0,0 +1,277 @@
+// shared_array_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/shared_array.hpp"
+#include "rebox/local_shared_instance.hpp"
+
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_set>
+
+
+// counts the allocations through the global operator new; the arrays
+// take no allocator to count with instead. Inlined into library code,
+// GCC sees free() called on memory from operator new and warns.
+static int allocations{0};
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#  pragma GCC diagnostic push
+#  pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(std::size_t size)
+{
+    ++allocations;
+
+    if (void* block = std::malloc(size ? size : 1))
+    {
+        return block;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* block) noexcept
+{
+    std::free(block);
+}
+
+void operator delete(void* block, std::size_t) noexcept
+{
+    std::free(block);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#  pragma GCC diagnostic pop
+#endif
+
+
+namespace rebox
+{
+    // counts the live objects, failing to construct the given one
+    class Counted
+    {
+    public:
+        Counted()
+        {
+            if (++constructed == failAt)
+            {
+                throw std::runtime_error("Counted");
+            }
+
+            ++alive;
+        }
+
+        ~Counted()
+        {
+            --alive;
+        }
+
+        static int alive;
+        static int constructed;
+        static int failAt;
+    };
+
+    int Counted::alive{0};
+    int Counted::constructed{0};
+    int Counted::failAt{-1};
+
+    class alignas(64) Line
+    {
+    public:
+        char bytes[64];
+    };
+
+    class Message
+    {
+    public:
+        Message(int id, std::string topic)
+            : id(id),
+              topic(std::move(topic))
+        {
+        }
+
+        int id;
+        std::string topic;
+    };
+
+    // the number of allocations made by f
+    template<typename F>
+    int allocations_of(F f)
+    {
+        int before{allocations};
+        f();
+        return allocations - before;
+    }
+
+    static_assert(sizeof(shared_instance<int[4]>) == sizeof(std::shared_ptr<int>), "the bound takes no space");
+    static_assert(shared_instance<int[4]>::size() == 4, "the bound is known at compile time");
+
+
+
+    BOOST_AUTO_TEST_CASE(make_unbounded)
+    {
+        auto foo = make_shared_instance<int[]>(5);
+        static_assert(std::is_same<decltype(foo), shared_instance<int[]>>::value, "array instance expected");
+
+        BOOST_CHECK_EQUAL(foo.size(), 5u);
+        BOOST_CHECK(!foo.empty());
+        BOOST_CHECK(foo.unique());
+        BOOST_CHECK_EQUAL(std::accumulate(foo.begin(), foo.end(), 0), 0);
+
+        std::iota(foo.begin(), foo.end(), 1);
+        BOOST_CHECK_EQUAL(foo[0], 1);
+        BOOST_CHECK_EQUAL(foo[4], 5);
+        BOOST_CHECK_EQUAL(foo.get()[2], 3);
+
+        auto bar = foo;
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        BOOST_CHECK(foo == bar);
+        BOOST_CHECK_EQUAL(bar.data(), foo.data());
+
+        // the elements are allocated along with the reference count
+        BOOST_CHECK_EQUAL(allocations_of([] { make_shared_instance<int[]>(5); }), 1);
+
+        auto strings = make_shared_instance<std::string[]>(3, "foo");
+        BOOST_CHECK_EQUAL(strings[0], "foo");
+        BOOST_CHECK_EQUAL(strings[2], "foo");
+    }
+
+    BOOST_AUTO_TEST_CASE(member_pointers_are_value_initialized)
+    {
+        // null is not all zero bits for pointers to data members
+        auto foo = make_shared_instance<int Message::*[]>(3);
+        BOOST_CHECK(foo[0] == nullptr);
+        BOOST_CHECK(foo[2] == nullptr);
+
+        auto bar = make_shared_instance<int Message::*[2]>();
+        BOOST_CHECK(bar[1] == nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(empty_arrays_are_not_null)
+    {
+        auto foo = make_shared_instance<int[]>(0);
+        BOOST_CHECK(foo.empty());
+        BOOST_CHECK(foo.data() != nullptr);
+        BOOST_CHECK(foo.begin() == foo.end());
+        BOOST_CHECK(foo.ptr() != nullptr);
+    }
+
+    BOOST_AUTO_TEST_CASE(make_bounded)
+    {
+        auto foo = make_shared_instance<double[3]>();
+        static_assert(std::is_same<decltype(foo), shared_instance<double[3]>>::value, "array instance expected");
+
+        BOOST_CHECK_EQUAL(foo.size(), 3u);
+        BOOST_CHECK_EQUAL(foo[2], 0.0);
+
+        double (&values)[3] = foo;
+        values[1] = 1.5;
+        BOOST_CHECK_EQUAL(foo[1], 1.5);
+
+        std::shared_ptr<double> ptr{foo.ptr()};
+        BOOST_CHECK_EQUAL(ptr.get(), foo.data());
+        BOOST_CHECK_EQUAL(allocations_of([] { make_shared_instance<double[3]>(); }), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(from_pointers)
+    {
+        shared_instance<int[]> foo{std::shared_ptr<int>(new int[3]{1, 2, 3}, std::default_delete<int[]>()), 3};
+        BOOST_CHECK_EQUAL(foo[2], 3);
+
+        shared_instance<int[]> bar{std::unique_ptr<int[]>(new int[2]{4, 5}), 2};
+        BOOST_CHECK_EQUAL(bar[1], 5);
+
+        shared_instance<int[2]> baz{std::shared_ptr<int>(new int[2]{6, 7}, std::default_delete<int[]>())};
+        BOOST_CHECK_EQUAL(baz[0], 6);
+
+        BOOST_CHECK_THROW((shared_instance<int[]>{std::shared_ptr<int>(), 0}), std::invalid_argument);
+        BOOST_CHECK_THROW((shared_instance<int[]>{std::unique_ptr<int[]>(), 0}), std::invalid_argument);
+        BOOST_CHECK_THROW(shared_instance<int[2]>{std::shared_ptr<int>()}, std::invalid_argument);
+
+        swap(foo, bar);
+        BOOST_CHECK_EQUAL(foo.size(), 2u);
+        BOOST_CHECK_EQUAL(bar.size(), 3u);
+        BOOST_CHECK_EQUAL(foo[1], 5);
+        BOOST_CHECK(foo != bar);
+
+        std::unordered_set<shared_instance<int[]>> set{foo, bar, foo};
+        BOOST_CHECK_EQUAL(set.size(), 2u);
+    }
+
+    BOOST_AUTO_TEST_CASE(elements_are_destroyed)
+    {
+        {
+            auto foo = make_shared_instance<Counted[]>(4);
+            BOOST_CHECK_EQUAL(Counted::alive, 4);
+
+            auto bar = foo;
+        }
+
+        BOOST_CHECK_EQUAL(Counted::alive, 0);
+
+        // the elements already constructed are destroyed again
+        Counted::constructed = 0;
+        Counted::failAt = 3;
+
+        BOOST_CHECK_THROW(make_shared_instance<Counted[]>(4), std::runtime_error);
+        BOOST_CHECK_EQUAL(Counted::alive, 0);
+
+        Counted::failAt = -1;
+    }
+
+    BOOST_AUTO_TEST_CASE(trailing_elements)
+    {
+        auto foo = make_trailing_instance<Message, char>(16, 7, "news");
+        static_assert(std::is_same<decltype(foo), shared_instance<trailing<Message, char>>>::value,
+                      "shared_instance of a trailing object expected");
+
+        trailing<Message, char>& message = foo;
+        BOOST_CHECK_EQUAL(message.header().id, 7);
+        BOOST_CHECK_EQUAL(message.header().topic, "news");
+        BOOST_CHECK_EQUAL(message.size(), 16u);
+
+        std::fill(message.begin(), message.end(), 'x');
+        BOOST_CHECK_EQUAL(message[15], 'x');
+
+        BOOST_CHECK_EQUAL(allocations_of([] { make_trailing_instance<int, char>(16, 7); }), 1);
+
+        {
+            auto counted = make_trailing_instance<int, Counted>(3, 42);
+            BOOST_CHECK_EQUAL(counted.get().header(), 42);
+            BOOST_CHECK_EQUAL(Counted::alive, 3);
+        }
+
+        BOOST_CHECK_EQUAL(Counted::alive, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(over_aligned_elements)
+    {
+        auto foo = make_shared_instance<Line[]>(3);
+        BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(foo.data()) % alignof(Line), 0u);
+
+        auto bar = make_trailing_instance<char, Line>(2, 'a');
+        BOOST_CHECK_EQUAL(reinterpret_cast<std::uintptr_t>(bar.get().data()) % alignof(Line), 0u);
+    }
+
+    BOOST_AUTO_TEST_CASE(local_trailing_instances)
+    {
+        auto foo = make_trailing_instance<int, Counted, throw_invalid_argument, single_threaded>(2, 1);
+        BOOST_CHECK_EQUAL(foo.get().size(), 2u);
+        BOOST_CHECK_EQUAL(Counted::alive, 2);
+
+        auto bar = foo;
+        BOOST_CHECK_EQUAL(bar.use_count(), 2);
+    }
+}
@@ -10,9 +10,18 @@
 
 #include "rebox/shared_instance.hpp"
 
+#if __cplusplus >= 201703L && __has_include(<memory_resource>)
+#include <memory_resource>
+#define REBOX_TEST_PMR
+#endif
+
 
 namespace rebox
 {
+    // whether or not NDEBUG is defined
+    static_assert(sizeof(shared_instance<int>) == sizeof(std::shared_ptr<int>),
+                  "shared_instance must be as small as std::shared_ptr");
+
     class Base
     {
     public:
@@ -63,6 +72,92 @@ namespace rebox
 
 
 
+    class CopyCounter
+    {
+    public:
+        explicit CopyCounter(int& copyCount)
+            : m_copyCount(copyCount)
+        {
+        }
+
+        CopyCounter(CopyCounter const& other)
+            : m_copyCount(other.m_copyCount)
+        {
+            ++m_copyCount;
+        }
+
+        CopyCounter(CopyCounter&&) = default;
+
+    private:
+        int& m_copyCount;
+    };
+
+
+    class Sink
+    {
+    public:
+        Sink(CopyCounter counter, std::unique_ptr<int> value)
+            : m_counter(std::move(counter)),
+              m_value(std::move(value))
+        {
+        }
+
+        int value() const
+        {
+            return *m_value;
+        }
+
+    private:
+        CopyCounter m_counter;
+        std::unique_ptr<int> m_value;
+    };
+
+
+    template<typename T>
+    class CountingAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit CountingAllocator(int& allocationCount)
+            : m_allocationCount(&allocationCount)
+        {
+        }
+
+        template<typename U>
+        CountingAllocator(CountingAllocator<U> const& other)
+            : m_allocationCount(other.m_allocationCount)
+        {
+        }
+
+        T* allocate(std::size_t n)
+        {
+            ++*m_allocationCount;
+            return std::allocator<T>().allocate(n);
+        }
+
+        void deallocate(T* ptr, std::size_t n)
+        {
+            std::allocator<T>().deallocate(ptr, n);
+        }
+
+        template<typename U>
+        bool operator==(CountingAllocator<U> const& other) const
+        {
+            return m_allocationCount == other.m_allocationCount;
+        }
+
+        template<typename U>
+        bool operator!=(CountingAllocator<U> const& other) const
+        {
+            return m_allocationCount != other.m_allocationCount;
+        }
+
+        int* m_allocationCount;
+    };
+
+
+
     BOOST_AUTO_TEST_CASE(construct_from_plain_null_pointer)
     {
         // from null pointer
@@ -658,6 +753,84 @@ namespace rebox
         BOOST_CHECK_EQUAL(bar.get(), 42);
     }
 
+    BOOST_AUTO_TEST_CASE(test_dynamic_pointer_cast)
+    {
+        int deleteCount{};
+
+        shared_instance<Base> foo{new Derived{deleteCount}};
+        shared_instance<Base> bar{new Base{deleteCount}};
+
+        std::shared_ptr<Derived> derived{dynamic_pointer_cast<Derived>(foo)};
+        BOOST_CHECK_EQUAL(derived.get(), &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+
+        BOOST_CHECK(!dynamic_pointer_cast<Derived>(bar));
+    }
+
+    BOOST_AUTO_TEST_CASE(test_rvalue_pointer_casts)
+    {
+        int deleteCount{};
+
+        {
+            shared_instance<Base const> foo{new Derived{deleteCount}};
+            Base const* ptr{&foo.get()};
+
+            shared_instance<Base> bar{const_pointer_cast<Base>(std::move(foo))};
+            shared_instance<Derived> qux{static_pointer_cast<Derived>(std::move(bar))};
+            BOOST_CHECK_EQUAL(&qux.get(), ptr);
+            BOOST_CHECK_EQUAL(qux.use_count(), 1);
+
+            shared_instance<Base> quux{std::move(qux)};
+            std::shared_ptr<Derived> derived{dynamic_pointer_cast<Derived>(std::move(quux))};
+            BOOST_CHECK_EQUAL(derived.get(), ptr);
+            BOOST_CHECK_EQUAL(derived.use_count(), 1);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(rvalue_upcasts_take_over_the_pointer)
+    {
+        int deleteCount{};
+
+        {
+            std::shared_ptr<Derived> derived{new Derived{deleteCount}};
+            Base* base{derived.get()};
+
+            std::shared_ptr<Base const> foo{multi_threaded::alias(std::move(derived), static_cast<Base const*>(base))};
+            BOOST_CHECK(!derived);
+            BOOST_CHECK_EQUAL(foo.get(), base);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+
+            shared_instance<Base const> bar{new Derived{deleteCount}};
+            shared_instance<Base const> qux{static_pointer_cast<Base const>(std::move(bar))};
+            BOOST_CHECK_EQUAL(qux.use_count(), 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_failed_rvalue_dynamic_pointer_cast)
+    {
+        int deleteCount{};
+
+        shared_instance<Base> foo{new Base{deleteCount}};
+
+        BOOST_CHECK(!dynamic_pointer_cast<Derived>(std::move(foo)));
+        BOOST_CHECK_EQUAL(foo.use_count(), 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(test_rvalue_ptr)
+    {
+        shared_instance<int> foo{new int(42)};
+        shared_instance<int> bar{foo};
+
+        std::shared_ptr<int> ptr{std::move(bar).ptr()};
+        BOOST_CHECK_EQUAL(ptr.use_count(), 2);
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+    }
+
     BOOST_AUTO_TEST_CASE(test_get_deleter)
     {
         std::shared_ptr<int> ptr{std::make_shared<int>(42)};
@@ -737,4 +910,143 @@ namespace rebox
         BOOST_CHECK_EQUAL(deleteCount, 2);
     }
 
+    BOOST_AUTO_TEST_CASE(make_shared_instance_forwards_arguments)
+    {
+        int copyCount{};
+
+        auto foo = make_shared_instance<Sink>(CopyCounter{copyCount},
+                                              std::unique_ptr<int>{new int(42)});
+
+        BOOST_CHECK_EQUAL(foo.get().value(), 42);
+        BOOST_CHECK_EQUAL(copyCount, 0);
+    }
+
+    BOOST_AUTO_TEST_CASE(construct_via_allocate_shared_instance)
+    {
+        int deleteCount{};
+        int allocationCount{};
+
+        {
+            auto foo = allocate_shared_instance<Derived>(CountingAllocator<Derived>{allocationCount},
+                                                         deleteCount);
+            BOOST_CHECK_EQUAL(foo.use_count(), 1);
+            BOOST_CHECK_EQUAL(allocationCount, 1);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    class Point
+    {
+    public:
+        int x;
+        int y;
+    };
+
+    class Shape
+    {
+    public:
+        explicit Shape(int& deleteCount)
+            : base(deleteCount),
+              origin{1, 2}
+        {
+        }
+
+        Derived base;
+        Point origin;
+    };
+
+    BOOST_AUTO_TEST_CASE(project_members)
+    {
+        int deleteCount{};
+
+        {
+            auto shape = make_shared_instance<Shape>(deleteCount);
+
+            shared_instance<Point> origin{shape.project(&Shape::origin)};
+            BOOST_CHECK_EQUAL(&origin.get(), &shape.get().origin);
+            BOOST_CHECK_EQUAL(shape.use_count(), 2);
+
+            // projections compose
+            auto y = shape.project(&Shape::origin).project(&Point::y);
+            BOOST_CHECK_EQUAL(y.get(), 2);
+            BOOST_CHECK_EQUAL(shape.use_count(), 3);
+
+            shared_instance<Shape const> constShape{shape};
+            auto x = constShape.project(&Shape::origin).project(&Point::x);
+            static_assert(std::is_same<decltype(x), shared_instance<int const>>::value, "constness is kept");
+
+            shared_instance<Base> base{shape, shape.get().base};
+            BOOST_CHECK_EQUAL(&base.get(), &shape.get().base);
+
+            // the object lives as long as any projection
+            shape = make_shared_instance<Shape>(deleteCount);
+            constShape = shape;
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+            BOOST_CHECK_EQUAL(x.get(), 1);
+            BOOST_CHECK_EQUAL(x.use_count(), 4);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(project_rvalues)
+    {
+        int deleteCount{};
+
+        {
+            auto shape = make_shared_instance<Shape>(deleteCount);
+            Point* address{&shape.get().origin};
+
+            shared_instance<Point> origin{std::move(shape).project(&Shape::origin)};
+            BOOST_CHECK_EQUAL(&origin.get(), address);
+            BOOST_CHECK_EQUAL(origin.use_count(), 1);
+
+            shared_instance<int> y{std::move(origin), address->y};
+            BOOST_CHECK_EQUAL(y.get(), 2);
+            BOOST_CHECK_EQUAL(y.use_count(), 1);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(multi_threaded_aliases_of_members)
+    {
+        int deleteCount{};
+        auto shape = std::make_shared<Shape>(deleteCount);
+        Point* origin{&shape->origin};
+
+        std::shared_ptr<Point> alias{multi_threaded::alias(std::move(shape), origin)};
+        BOOST_CHECK_EQUAL(alias.get(), origin);
+
+#if __cplusplus > 201703L
+        BOOST_CHECK(!shape);
+        BOOST_CHECK_EQUAL(alias.use_count(), 1);
+#else
+        // the copy taken before C++20 leaves the source its reference
+        BOOST_CHECK(shape);
+        BOOST_CHECK_EQUAL(alias.use_count(), 2);
+#endif
+    }
+
+#ifdef REBOX_TEST_PMR
+    BOOST_AUTO_TEST_CASE(construct_via_allocate_shared_instance_with_pmr)
+    {
+        int deleteCount{};
+        char buffer[1024];
+        std::pmr::monotonic_buffer_resource arena{buffer, sizeof(buffer), std::pmr::null_memory_resource()};
+
+        {
+            std::pmr::polymorphic_allocator<Base> alloc{&arena};
+            auto foo = allocate_shared_instance<Base>(alloc, deleteCount);
+
+            auto address = reinterpret_cast<char const*>(&foo.get());
+            BOOST_CHECK(address >= buffer && address < buffer + sizeof(buffer));
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+#endif
+
 }
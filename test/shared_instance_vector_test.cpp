@@ -0,0 +1,151 @@
+// shared_instance_vector_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/shared_instance_vector.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+
+namespace rebox
+{
+    BOOST_AUTO_TEST_CASE(push_and_access)
+    {
+        shared_instance_vector<int> v;
+        BOOST_CHECK(v.empty());
+
+        auto foo = make_shared_instance<int>(1);
+        v.push_back(foo);
+        v.push_back(make_shared_instance<int>(2));
+        v.emplace_back(3);
+
+        BOOST_CHECK_EQUAL(v.size(), 3u);
+        BOOST_CHECK_EQUAL(v[0], 1);
+        BOOST_CHECK_EQUAL(v.at(1), 2);
+        BOOST_CHECK_EQUAL(v.back(), 3);
+        BOOST_CHECK_EQUAL(&v.front(), &foo.get());
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        BOOST_CHECK_THROW(v.at(3), std::out_of_range);
+    }
+
+    BOOST_AUTO_TEST_CASE(hand_out_instance)
+    {
+        auto foo = make_shared_instance<int>(42);
+        shared_instance_vector<int> v{foo};
+
+        shared_instance<int> bar{v.instance(0)};
+        BOOST_CHECK(bar == foo);
+        BOOST_CHECK_EQUAL(foo.use_count(), 3);
+
+        v.clear();
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(move_keeps_count)
+    {
+        auto foo = make_shared_instance<int>(42);
+        shared_instance<int> moved{foo};
+
+        shared_instance_vector<int> v;
+        v.push_back(std::move(moved));
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+
+        for (int i = 0; i < 100; ++i)
+        {
+            v.emplace_back(i);
+        }
+
+        BOOST_CHECK_EQUAL(foo.use_count(), 2);
+        BOOST_CHECK_EQUAL(&v.front(), &foo.get());
+    }
+
+    BOOST_AUTO_TEST_CASE(iterate)
+    {
+        shared_instance_vector<int> v;
+        for (int i = 1; i <= 4; ++i)
+        {
+            v.emplace_back(i);
+        }
+
+        BOOST_CHECK_EQUAL(std::accumulate(v.begin(), v.end(), 0), 10);
+        BOOST_CHECK_EQUAL(v.end() - v.begin(), 4);
+
+        for (int& i : v)
+        {
+            i *= 2;
+        }
+
+        std::vector<int> values(v.cbegin(), v.cend());
+        BOOST_CHECK((values == std::vector<int>{2, 4, 6, 8}));
+
+        BOOST_CHECK_EQUAL(*std::max_element(v.begin(), v.end()), 8);
+    }
+
+    BOOST_AUTO_TEST_CASE(insert_and_erase)
+    {
+        shared_instance_vector<int> v;
+        for (int i = 0; i < 5; ++i)
+        {
+            v.emplace_back(i);
+        }
+
+        auto foo = make_shared_instance<int>(42);
+        auto inserted = v.insert(v.begin() + 2, foo);
+        BOOST_CHECK_EQUAL(*inserted, 42);
+        BOOST_CHECK_EQUAL(v.size(), 6u);
+        BOOST_CHECK_EQUAL(v[3], 2);
+        BOOST_CHECK(v.instance(2) == foo);
+
+        auto next = v.erase(v.begin() + 2);
+        BOOST_CHECK_EQUAL(*next, 2);
+        BOOST_CHECK(foo.unique());
+
+        next = v.erase(v.begin(), v.begin() + 3);
+        BOOST_CHECK_EQUAL(*next, 3);
+        BOOST_CHECK_EQUAL(v.size(), 2u);
+        BOOST_CHECK_EQUAL(v.instance(0).use_count(), 2);
+
+        v.pop_back();
+        BOOST_CHECK_EQUAL(v.size(), 1u);
+        BOOST_CHECK_EQUAL(v.back(), 3);
+    }
+
+    BOOST_AUTO_TEST_CASE(append_range)
+    {
+        std::vector<shared_instance<int>> source;
+        for (int i = 0; i < 10; ++i)
+        {
+            source.push_back(make_shared_instance<int>(i));
+        }
+
+        shared_instance_vector<int> v{source.begin(), source.end()};
+        BOOST_CHECK_EQUAL(v.size(), 10u);
+        BOOST_CHECK_EQUAL(source[0].use_count(), 2);
+
+        v.append(std::make_move_iterator(source.begin()), std::make_move_iterator(source.end()));
+        BOOST_CHECK_EQUAL(v.size(), 20u);
+        BOOST_CHECK_EQUAL(v.instance(10).use_count(), 3);
+        BOOST_CHECK_EQUAL(v[19], 9);
+    }
+
+    BOOST_AUTO_TEST_CASE(swap_vectors)
+    {
+        shared_instance_vector<int> v{make_shared_instance<int>(1)};
+        shared_instance_vector<int> w;
+
+        swap(v, w);
+        BOOST_CHECK(v.empty());
+        BOOST_CHECK_EQUAL(w[0], 1);
+    }
+
+}
@@ -0,0 +1,237 @@
+// unique_instance_test.cpp
+//
+// Copyright Robin Eckert 2014
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+#define BOOST_TEST_MAIN
+#include <boost/test/unit_test.hpp>
+
+#include "rebox/unique_instance.hpp"
+
+#include <string>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+
+namespace rebox
+{
+    class Base
+    {
+    public:
+        explicit Base(int& deleteCount)
+            : m_deleteCount(deleteCount)
+        {
+        }
+
+        virtual ~Base()
+        {
+            ++m_deleteCount;
+        }
+
+        virtual int foo() const
+        {
+            return 42;
+        }
+
+    private:
+        int& m_deleteCount;
+    };
+
+    class Derived : public Base
+    {
+    public:
+        using Base::Base;
+
+        int foo() const override
+        {
+            return 43;
+        }
+    };
+
+    class Other : public Base
+    {
+    public:
+        using Base::Base;
+    };
+
+    // counts its calls
+    class CountingDeleter
+    {
+    public:
+        explicit CountingDeleter(int* calls = nullptr)
+            : calls(calls)
+        {
+        }
+
+        void operator()(int* obj) const
+        {
+            ++*calls;
+            delete obj;
+        }
+
+        int* calls;
+    };
+
+    static_assert(!std::is_copy_constructible<unique_instance<int>>::value, "unique_instance must not be copied");
+    static_assert(!std::is_default_constructible<unique_instance<int>>::value, "unique_instance must not be null");
+    static_assert(sizeof(unique_instance<int>) == sizeof(int*), "unique_instance must be as small as std::unique_ptr");
+
+
+
+    BOOST_AUTO_TEST_CASE(construction)
+    {
+        auto foo = make_unique_instance<std::string>("foo");
+        BOOST_CHECK_EQUAL(foo.get(), "foo");
+
+        unique_instance<int> bar{new int(42)};
+        BOOST_CHECK_EQUAL(bar.get(), 42);
+
+        unique_instance<int> baz{std::unique_ptr<int>(new int(43))};
+        int& value = baz;
+        BOOST_CHECK_EQUAL(value, 43);
+    }
+
+    BOOST_AUTO_TEST_CASE(null_is_rejected)
+    {
+        BOOST_CHECK_THROW(unique_instance<int>{static_cast<int*>(nullptr)}, std::invalid_argument);
+        BOOST_CHECK_THROW(unique_instance<int>{std::unique_ptr<int>()}, std::invalid_argument);
+
+        auto foo = make_unique_instance<int>(1);
+        unique_instance<int> bar{std::move(foo)};
+
+        // moved from instances are rejected when converted
+        BOOST_CHECK_THROW(unique_instance<int const>{std::move(foo)}, std::invalid_argument);
+
+        unique_instance<int const> baz{make_unique_instance<int>(2)};
+        BOOST_CHECK_THROW(baz = std::move(foo), std::invalid_argument);
+        BOOST_CHECK_EQUAL(baz.get(), 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(moves_transfer_ownership)
+    {
+        int deleteCount{0};
+
+        {
+            auto foo = make_unique_instance<Derived>(deleteCount);
+            Derived* address{&foo.get()};
+
+            unique_instance<Base> bar{std::move(foo)};
+            BOOST_CHECK_EQUAL(&bar.get(), address);
+            BOOST_CHECK_EQUAL(bar.get().foo(), 43);
+
+            auto baz = make_unique_instance<Base>(deleteCount);
+            baz = std::move(bar);
+            BOOST_CHECK_EQUAL(deleteCount, 1);
+            BOOST_CHECK_EQUAL(&baz.get(), address);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(custom_deleters)
+    {
+        int calls{0};
+
+        {
+            unique_instance<int, throw_invalid_argument, CountingDeleter> foo{new int(1), CountingDeleter(&calls)};
+            BOOST_CHECK_EQUAL(foo.get_deleter().calls, &calls);
+
+            std::unique_ptr<int, CountingDeleter> ptr{std::move(foo).ptr()};
+            BOOST_CHECK_EQUAL(*ptr, 1);
+            BOOST_CHECK_EQUAL(calls, 0);
+        }
+
+        BOOST_CHECK_EQUAL(calls, 1);
+
+        {
+            unique_instance<int, throw_invalid_argument, CountingDeleter> foo{new int(2), CountingDeleter(&calls)};
+            shared_instance<int> bar{std::move(foo)};
+
+            BOOST_CHECK_EQUAL(bar.get(), 2);
+            BOOST_REQUIRE(get_deleter<CountingDeleter>(bar));
+        }
+
+        BOOST_CHECK_EQUAL(calls, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(into_shared_instance)
+    {
+        int deleteCount{0};
+
+        {
+            auto foo = make_unique_instance<Derived>(deleteCount);
+            Derived* address{&foo.get()};
+
+            shared_instance<Base> bar = std::move(foo);
+            BOOST_CHECK_EQUAL(&bar.get(), address);
+            BOOST_CHECK(bar.unique());
+
+            shared_instance<Derived> baz{make_unique_instance<Derived>(deleteCount)};
+            BOOST_CHECK(baz.unique());
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 2);
+    }
+
+    BOOST_AUTO_TEST_CASE(casts)
+    {
+        int deleteCount{0};
+
+        {
+            unique_instance<Base> foo{make_unique_instance<Derived>(deleteCount)};
+            Base* address{&foo.get()};
+
+            auto bar = static_pointer_cast<Derived>(std::move(foo));
+            static_assert(std::is_same<decltype(bar), unique_instance<Derived>>::value, "deleter follows the cast");
+            BOOST_CHECK_EQUAL(&bar.get(), address);
+
+            auto baz = const_pointer_cast<Derived const>(std::move(bar));
+            BOOST_CHECK_EQUAL(&baz.get(), address);
+
+            unique_instance<Base const> qux{std::move(baz)};
+            auto other = dynamic_pointer_cast<Other const>(std::move(qux));
+            BOOST_CHECK(!other);
+            BOOST_CHECK_EQUAL(&qux.get(), address);
+
+            auto derived = dynamic_pointer_cast<Derived const>(std::move(qux));
+            BOOST_REQUIRE(derived);
+            BOOST_CHECK_EQUAL(derived.get(), address);
+            BOOST_CHECK_EQUAL(deleteCount, 0);
+        }
+
+        BOOST_CHECK_EQUAL(deleteCount, 1);
+    }
+
+    BOOST_AUTO_TEST_CASE(comparisons_and_hash)
+    {
+        auto foo = make_unique_instance<int>(1);
+        auto bar = make_unique_instance<int>(1);
+
+        BOOST_CHECK(foo == foo);
+        BOOST_CHECK(foo != bar);
+        BOOST_CHECK_EQUAL(foo < bar, &foo.get() < &bar.get());
+        BOOST_CHECK_EQUAL(foo >= bar, !(foo < bar));
+
+        std::unordered_set<unique_instance<int>> instances;
+        instances.insert(std::move(foo));
+        instances.insert(std::move(bar));
+        BOOST_CHECK_EQUAL(instances.size(), 2u);
+
+        swap(foo, bar);
+    }
+
+    BOOST_AUTO_TEST_CASE(containers)
+    {
+        std::vector<unique_instance<std::string>> names;
+
+        for (int i = 0; i < 100; ++i)
+        {
+            names.push_back(make_unique_instance<std::string>(std::to_string(i)));
+        }
+
+        BOOST_CHECK_EQUAL(names[42].get(), "42");
+    }
+}